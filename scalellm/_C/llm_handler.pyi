@@ -44,7 +44,17 @@ class LLMHandler:
         max_tokens_per_batch: int
         max_seqs_per_batch: int
         num_speculative_tokens: int
+        prompt_lookup_max_ngram: int
+        prompt_lookup_num_branches: int
+        enable_adaptive_speculation: bool
         num_handling_threads: int
+        num_tokenization_threads: int
+        num_response_threads: int
+        stream_flush_tokens: int
+        stream_flush_interval_ms: int
+        max_pending_stream_outputs: int
+        num_loading_threads: int
+        weight_cache_dir: str
 
     def __init__(self, options: Options) -> None: ...
     def __repr__(self) -> str: ...
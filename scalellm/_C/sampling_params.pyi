@@ -1,4 +1,4 @@
-from typing import List, Optional
+from typing import Dict, List, Optional
 
 # Defined in csrc/sampling_params.cpp
 class SamplingParams:
@@ -20,6 +20,9 @@ class SamplingParams:
         ignore_eos: bool = False,
         stop: Optional[List[str]] = None,
         stop_token_ids: Optional[List[int]] = None,
+        min_p: float = 0.0,
+        logit_bias: Optional[Dict[int, float]] = None,
+        bad_words: Optional[List[str]] = None,
     ) -> None: ...
     def __repr__(self) -> str: ...
     # number of tokens to generate. truncted to model's max context length.
@@ -53,3 +56,9 @@ class SamplingParams:
     stop: Optional[List[str]]
     # the list of token ids to stop generating further tokens.
     stop_token_ids: Optional[List[int]]
+    # min_p sampling cutoff relative to the most likely token, between [0.0, 1.0]. default = 0.0 to disable.
+    min_p: float
+    # map from token id to a bias added to its logit, between [-100, 100].
+    logit_bias: Optional[Dict[int, float]]
+    # the list of words that are banned from the output.
+    bad_words: Optional[List[str]]
@@ -49,7 +49,18 @@ void init_llm_handler(py::module_& m) {
                &LLMHandler::schedule_chat_async,
                py::call_guard<py::gil_scoped_release>())
           .def("schedule_batch_async",
-               &LLMHandler::schedule_batch_async,
+               [](LLMHandler& self,
+                  std::vector<std::string> prompts,
+                  std::vector<SamplingParams> sps,
+                  Priority priority,
+                  bool stream,
+                  BatchOutputCallback callback) {
+                 return self.schedule_batch_async(std::move(prompts),
+                                                  std::move(sps),
+                                                  priority,
+                                                  stream,
+                                                  std::move(callback));
+               },
                py::call_guard<py::gil_scoped_release>())
           .def("schedule_chat_batch_async",
                &LLMHandler::schedule_chat_batch_async,
@@ -107,8 +118,28 @@ void init_llm_handler(py::module_& m) {
                      &LLMHandler::Options::max_seqs_per_batch_)
       .def_readwrite("num_speculative_tokens",
                      &LLMHandler::Options::num_speculative_tokens_)
+      .def_readwrite("prompt_lookup_max_ngram",
+                     &LLMHandler::Options::prompt_lookup_max_ngram_)
+      .def_readwrite("prompt_lookup_num_branches",
+                     &LLMHandler::Options::prompt_lookup_num_branches_)
+      .def_readwrite("enable_adaptive_speculation",
+                     &LLMHandler::Options::enable_adaptive_speculation_)
       .def_readwrite("num_handling_threads",
                      &LLMHandler::Options::num_handling_threads_)
+      .def_readwrite("num_tokenization_threads",
+                     &LLMHandler::Options::num_tokenization_threads_)
+      .def_readwrite("num_response_threads",
+                     &LLMHandler::Options::num_response_threads_)
+      .def_readwrite("stream_flush_tokens",
+                     &LLMHandler::Options::stream_flush_tokens_)
+      .def_readwrite("stream_flush_interval_ms",
+                     &LLMHandler::Options::stream_flush_interval_ms_)
+      .def_readwrite("max_pending_stream_outputs",
+                     &LLMHandler::Options::max_pending_stream_outputs_)
+      .def_readwrite("num_loading_threads",
+                     &LLMHandler::Options::num_loading_threads_)
+      .def_readwrite("weight_cache_dir",
+                     &LLMHandler::Options::weight_cache_dir_)
       .def("__repr__", [](const LLMHandler::Options& self) {
         return "Options(model_path={}, devices={}, draft_model_path={}, "
                "draft_devices={}, block_size={}, max_cache_size={}, "
@@ -116,7 +147,13 @@ void init_llm_handler(py::module_& m) {
                "enable_cuda_graph={}, cuda_graph_max_seq_len={}, "
                "cuda_graph_batch_sizes={}, draft_cuda_graph_batch_sizes={}, "
                "max_tokens_per_batch={}, max_seqs_per_batch={}, "
-               "num_speculative_tokens={}, num_handling_threads={})"_s.format(
+               "num_speculative_tokens={}, prompt_lookup_max_ngram={}, "
+               "prompt_lookup_num_branches={}, enable_adaptive_speculation={}, "
+               "num_handling_threads={}, "
+               "num_tokenization_threads={}, num_response_threads={}, "
+               "stream_flush_tokens={}, stream_flush_interval_ms={}, "
+               "max_pending_stream_outputs={}, "
+               "num_loading_threads={}, weight_cache_dir={})"_s.format(
                    self.model_path_,
                    self.devices_,
                    self.draft_model_path_,
@@ -132,7 +169,17 @@ void init_llm_handler(py::module_& m) {
                    self.max_tokens_per_batch_,
                    self.max_seqs_per_batch_,
                    self.num_speculative_tokens_,
-                   self.num_handling_threads_);
+                   self.prompt_lookup_max_ngram_,
+                   self.prompt_lookup_num_branches_,
+                   self.enable_adaptive_speculation_,
+                   self.num_handling_threads_,
+                   self.num_tokenization_threads_,
+                   self.num_response_threads_,
+                   self.stream_flush_tokens_,
+                   self.stream_flush_interval_ms_,
+                   self.max_pending_stream_outputs_,
+                   self.num_loading_threads_,
+                   self.weight_cache_dir_);
       });
 }
 
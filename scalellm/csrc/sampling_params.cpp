@@ -25,7 +25,11 @@ void init_sampling_params(py::module_& m) {
                     bool,                    /*skip_special_tokens*/
                     bool,                    /*ignore_eos*/
                     std::optional<std::vector<std::string>>, /*stop*/
-                    std::optional<std::vector<int32_t>>>(),  /*stop_token_ids*/
+                    std::optional<std::vector<int32_t>>, /*stop_token_ids*/
+                    float,                               /*min_p*/
+                    std::optional<std::unordered_map<int32_t, float>>,
+                    /*logit_bias*/
+                    std::optional<std::vector<std::string>>>(), /*bad_words*/
            py::arg("max_tokens") = 16,
            py::arg("n") = 1,
            py::arg("best_of") = std::nullopt,
@@ -41,7 +45,10 @@ void init_sampling_params(py::module_& m) {
            py::arg("skip_special_tokens") = true,
            py::arg("ignore_eos") = false,
            py::arg("stop") = std::nullopt,
-           py::arg("stop_token_ids") = std::nullopt)
+           py::arg("stop_token_ids") = std::nullopt,
+           py::arg("min_p") = 0.0,
+           py::arg("logit_bias") = std::nullopt,
+           py::arg("bad_words") = std::nullopt)
       .def_readwrite("max_tokens", &SamplingParams::max_tokens)
       .def_readwrite("n", &SamplingParams::n)
       .def_readwrite("best_of", &SamplingParams::best_of)
@@ -59,12 +66,16 @@ void init_sampling_params(py::module_& m) {
       .def_readwrite("ignore_eos", &SamplingParams::ignore_eos)
       .def_readwrite("stop", &SamplingParams::stop)
       .def_readwrite("stop_token_ids", &SamplingParams::stop_token_ids)
+      .def_readwrite("min_p", &SamplingParams::min_p)
+      .def_readwrite("logit_bias", &SamplingParams::logit_bias)
+      .def_readwrite("bad_words", &SamplingParams::bad_words)
       .def("__repr__", [](const SamplingParams& self) {
         return "SamplingParams(max_tokens={}, n={}, best_of={}, echo={}, "
                "frequency_penalty={}, presence_penalty={}, "
                "repetition_penalty={}, temperature={}, top_p={}, top_k={}, "
                "logprobs={}, top_logprobs={}, skip_special_tokens={}, "
-               "ignore_eos={}, stop={}, stop_token_ids={})"_s.format(
+               "ignore_eos={}, stop={}, stop_token_ids={}, min_p={}, "
+               "logit_bias={}, bad_words={})"_s.format(
                    self.max_tokens,
                    self.n,
                    self.best_of,
@@ -80,7 +91,10 @@ void init_sampling_params(py::module_& m) {
                    self.skip_special_tokens,
                    self.ignore_eos,
                    self.stop,
-                   self.stop_token_ids);
+                   self.stop_token_ids,
+                   self.min_p,
+                   self.logit_bias,
+                   self.bad_words);
       });
 }
 
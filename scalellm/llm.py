@@ -30,7 +30,17 @@ class LLM:
         max_tokens_per_batch: int = 409600,  # a big number to disable chunked prefill
         max_seqs_per_batch: int = 2048,  # a big number for better throughput
         num_speculative_tokens: int = 0,
+        prompt_lookup_max_ngram: int = 0,
+        prompt_lookup_num_branches: int = 1,
+        enable_adaptive_speculation: bool = False,
         num_handling_threads: int = 4,
+        num_tokenization_threads: int = 4,
+        num_response_threads: int = 4,
+        stream_flush_tokens: int = 1,
+        stream_flush_interval_ms: int = 0,
+        max_pending_stream_outputs: int = 8,
+        num_loading_threads: int = 4,
+        weight_cache_dir: str = "",
     ) -> None:
         # download hf model if it does not exist
         self._model = model
@@ -70,7 +80,17 @@ class LLM:
         options.max_tokens_per_batch = max_tokens_per_batch
         options.max_seqs_per_batch = max_seqs_per_batch
         options.num_speculative_tokens = num_speculative_tokens
+        options.prompt_lookup_max_ngram = prompt_lookup_max_ngram
+        options.prompt_lookup_num_branches = prompt_lookup_num_branches
+        options.enable_adaptive_speculation = enable_adaptive_speculation
         options.num_handling_threads = num_handling_threads
+        options.num_tokenization_threads = num_tokenization_threads
+        options.num_response_threads = num_response_threads
+        options.stream_flush_tokens = stream_flush_tokens
+        options.stream_flush_interval_ms = stream_flush_interval_ms
+        options.max_pending_stream_outputs = max_pending_stream_outputs
+        options.num_loading_threads = num_loading_threads
+        options.weight_cache_dir = weight_cache_dir
         # create the LLM handler
         self._handler = LLMHandler(options)
 
@@ -83,6 +83,9 @@ class ChatCompletionRequest(BaseModel):
     repetition_penalty: Optional[float] = 1.0
     top_p: Optional[float] = 1.0
     top_k: Optional[int] = -1
+    min_p: Optional[float] = 0.0
+    logit_bias: Optional[Dict[int, float]] = None
+    bad_words: Optional[List[str]] = None
     logprobs: Optional[bool] = False
     top_logprobs: Optional[int] = Field(0, ge=0, le=20)
     # user: Optional[str] = None
@@ -153,6 +156,9 @@ class CompletionRequest(BaseModel):
     repetition_penalty: Optional[float] = 1.0
     top_p: Optional[float] = 1.0
     top_k: Optional[int] = -1
+    min_p: Optional[float] = 0.0
+    logit_bias: Optional[Dict[int, float]] = None
+    bad_words: Optional[List[str]] = None
     # user: Optional[str] = None
     skip_special_tokens: Optional[bool] = True
     ignore_eos: Optional[bool] = False
@@ -144,7 +144,17 @@ if __name__ == "__main__":
         max_tokens_per_batch=args.max_tokens_per_batch,
         max_seqs_per_batch=args.max_seqs_per_batch,
         num_speculative_tokens=args.num_speculative_tokens,
+        prompt_lookup_max_ngram=args.prompt_lookup_max_ngram,
+        prompt_lookup_num_branches=args.prompt_lookup_num_branches,
+        enable_adaptive_speculation=args.enable_adaptive_speculation,
         num_handling_threads=args.num_handling_threads,
+        num_tokenization_threads=args.num_tokenization_threads,
+        num_response_threads=args.num_response_threads,
+        stream_flush_tokens=args.stream_flush_tokens,
+        stream_flush_interval_ms=args.stream_flush_interval_ms,
+        max_pending_stream_outputs=args.max_pending_stream_outputs,
+        num_loading_threads=args.num_loading_threads,
+        weight_cache_dir=args.weight_cache_dir,
     )
 
     try:
@@ -32,6 +32,9 @@ def to_sampling_params(request: ChatCompletionRequest) -> SamplingParams:
     sp.temperature = request.temperature
     sp.top_p = request.top_p
     sp.top_k = request.top_k
+    sp.min_p = request.min_p
+    sp.logit_bias = request.logit_bias
+    sp.bad_words = request.bad_words
     sp.logprobs = request.logprobs
     sp.top_logprobs = request.top_logprobs
     sp.skip_special_tokens = request.skip_special_tokens
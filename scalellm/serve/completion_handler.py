@@ -26,6 +26,9 @@ def to_sampling_params(request: CompletionRequest) -> SamplingParams:
     sp.temperature = request.temperature
     sp.top_p = request.top_p
     sp.top_k = request.top_k
+    sp.min_p = request.min_p
+    sp.logit_bias = request.logit_bias
+    sp.bad_words = request.bad_words
     if request.logprobs:
         sp.logprobs = True
         sp.top_logprobs = request.logprobs
@@ -110,12 +110,72 @@ def parse_args():
         default=0,
         help="Number of speculative tokens.",
     )
+    parser.add_argument(
+        "--prompt_lookup_max_ngram",
+        type=int,
+        default=0,
+        help="Max ngram size for prompt lookup decoding, only used without draft model.",
+    )
+    parser.add_argument(
+        "--prompt_lookup_num_branches",
+        type=int,
+        default=1,
+        help="Max number of branches of the draft token tree for prompt lookup decoding.",
+    )
+    parser.add_argument(
+        "--enable_adaptive_speculation",
+        type=lambda s: s.lower() in ["true", "t", "yes", "1"],
+        default=False,
+        help="Adapt the number of speculative tokens to the acceptance rate.",
+    )
     parser.add_argument(
         "--num_handling_threads",
         type=int,
         default=4,
         help="Number of handling threads.",
     )
+    parser.add_argument(
+        "--num_tokenization_threads",
+        type=int,
+        default=4,
+        help="Number of threads to encode long prompts in parallel, 0 to disable.",
+    )
+    parser.add_argument(
+        "--num_response_threads",
+        type=int,
+        default=4,
+        help="Number of threads to send responses.",
+    )
+    parser.add_argument(
+        "--stream_flush_tokens",
+        type=int,
+        default=1,
+        help="Flush streaming outputs every n tokens, 0 to flush by interval only.",
+    )
+    parser.add_argument(
+        "--stream_flush_interval_ms",
+        type=int,
+        default=0,
+        help="Flush streaming outputs every n milliseconds, 0 to disable.",
+    )
+    parser.add_argument(
+        "--max_pending_stream_outputs",
+        type=int,
+        default=8,
+        help="Max number of queued streaming outputs per request.",
+    )
+    parser.add_argument(
+        "--num_loading_threads",
+        type=int,
+        default=4,
+        help="Number of threads to read model weights files ahead.",
+    )
+    parser.add_argument(
+        "--weight_cache_dir",
+        type=str,
+        default="",
+        help="Directory to cache prepared weights for faster restarts, empty to disable.",
+    )
     parser.add_argument("--ssl-keyfile",
                         type=str, 
                         default=None,
@@ -0,0 +1,111 @@
+#include "chat_prefix_cache.h"
+
+#include <absl/hash/hash.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace llm {
+
+ChatPrefixCache::ChatPrefixCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+bool ChatPrefixCache::encode(const ChatMessages& messages,
+                             const std::string_view& prompt,
+                             const Tokenizer& tokenizer,
+                             std::vector<int32_t>* ids) {
+  // hashes[i] is the hash of messages[0, i]
+  std::vector<uint64_t> hashes;
+  hashes.reserve(messages.size());
+  uint64_t hash = 0;
+  for (const auto& message : messages) {
+    hash = absl::HashOf(hash, message.role, message.content);
+    hashes.push_back(hash);
+  }
+
+  const auto offsets = tokenizer.special_token_offsets(prompt);
+  if (offsets.empty() || hashes.empty()) {
+    // no safe offset to split the prompt
+    return tokenizer.encode(prompt, ids);
+  }
+
+  // the number of bytes of prompt encoded so far
+  size_t encoded = 0;
+  auto cached = lookup(hashes);
+  // the rendered prefix may change with following messages
+  if (cached != nullptr &&
+      prompt.compare(0, cached->text.size(), cached->text) == 0 &&
+      std::binary_search(offsets.begin(), offsets.end(), cached->text.size())) {
+    ids->insert(ids->end(), cached->ids.begin(), cached->ids.end());
+    encoded = cached->text.size();
+  }
+
+  // cache the longest prefix ending at a special token
+  const size_t end = offsets.back();
+  if (end > encoded) {
+    const auto text = prompt.substr(encoded, end - encoded);
+    const bool ok = encoded == 0 ? tokenizer.encode(text, ids)
+                                 : tokenizer.encode_chunk(text, ids);
+    if (!ok) {
+      return false;
+    }
+    auto entry = std::make_shared<Entry>();
+    entry->text = prompt.substr(0, end);
+    entry->ids = *ids;
+    insert(hashes.back(), std::move(entry));
+    encoded = end;
+  }
+  return tokenizer.encode_chunk(prompt.substr(encoded), ids);
+}
+
+std::shared_ptr<const ChatPrefixCache::Entry> ChatPrefixCache::lookup(
+    const std::vector<uint64_t>& hashes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = hashes.rbegin(); it != hashes.rend(); ++it) {
+    const auto entry_it = entries_.find(*it);
+    if (entry_it != entries_.end()) {
+      return entry_it->second;
+    }
+  }
+  return nullptr;
+}
+
+void ChatPrefixCache::insert(uint64_t hash,
+                             std::shared_ptr<const Entry> entry) {
+  const size_t entry_bytes = entry->num_bytes();
+  if (entry_bytes > max_bytes_) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = entries_.try_emplace(hash, entry);
+  if (!inserted) {
+    // replace the existing entry for the same messages
+    num_bytes_ -= it->second->num_bytes();
+    it->second = std::move(entry);
+  } else {
+    insertion_order_.push_back(hash);
+  }
+  num_bytes_ += entry_bytes;
+
+  // evict oldest entries until within the budget
+  while (num_bytes_ > max_bytes_ && !insertion_order_.empty()) {
+    const uint64_t oldest = insertion_order_.front();
+    insertion_order_.pop_front();
+    const auto oldest_it = entries_.find(oldest);
+    CHECK(oldest_it != entries_.end());
+    num_bytes_ -= oldest_it->second->num_bytes();
+    entries_.erase(oldest_it);
+  }
+}
+
+size_t ChatPrefixCache::num_entries() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+size_t ChatPrefixCache::num_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_bytes_;
+}
+
+}  // namespace llm
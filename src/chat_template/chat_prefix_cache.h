@@ -0,0 +1,72 @@
+#pragma once
+
+#include <absl/container/flat_hash_map.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chat_template.h"
+#include "tokenizer/tokenizer.h"
+
+namespace llm {
+
+// A cache of encoded conversation prefixes for multi-turn chat. Each turn
+// resends the whole conversation, so the prompt rendered for the previous
+// turn is mostly a prefix of the new one. Entries are keyed by a hash of the
+// message list and hold the longest prefix of the rendered prompt that ends
+// at a special token, together with its token ids. A new turn only encodes
+// the text after the cached prefix of its longest cached message prefix.
+// thread-safe.
+class ChatPrefixCache final {
+ public:
+  // max_bytes: the budget for cached text and ids, oldest entries are
+  // evicted first.
+  explicit ChatPrefixCache(size_t max_bytes);
+
+  // encode the prompt rendered from messages, reusing the ids of the longest
+  // cached conversation prefix if possible.
+  bool encode(const ChatMessages& messages,
+              const std::string_view& prompt,
+              const Tokenizer& tokenizer,
+              std::vector<int32_t>* ids);
+
+  size_t num_entries() const;
+
+  size_t num_bytes() const;
+
+ private:
+  struct Entry {
+    // the prefix of the rendered prompt
+    std::string text;
+    // ids of the text from tokenizer.encode()
+    std::vector<int32_t> ids;
+
+    size_t num_bytes() const {
+      return text.size() + ids.size() * sizeof(int32_t);
+    }
+  };
+
+  // find the entry for the longest message prefix, nullptr if none
+  std::shared_ptr<const Entry> lookup(const std::vector<uint64_t>& hashes);
+
+  void insert(uint64_t hash, std::shared_ptr<const Entry> entry);
+
+  const size_t max_bytes_;
+
+  mutable std::mutex mutex_;
+
+  // hash of message prefix to entry
+  absl::flat_hash_map<uint64_t, std::shared_ptr<const Entry>> entries_;
+
+  // hashes in insertion order for eviction
+  std::deque<uint64_t> insertion_order_;
+
+  size_t num_bytes_ = 0;
+};
+
+}  // namespace llm
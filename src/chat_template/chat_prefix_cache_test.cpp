@@ -0,0 +1,163 @@
+#include "chat_prefix_cache.h"
+
+#include <gtest/gtest.h>
+
+namespace llm {
+namespace {
+
+// a byte-level tokenizer with two special tokens and a prefix token
+class FakeTokenizer : public Tokenizer {
+ public:
+  bool encode(const std::string_view& text,
+              std::vector<int32_t>* ids) const override {
+    ids->push_back(kBosId);
+    return encode_chunk(text, ids);
+  }
+
+  bool encode_chunk(const std::string_view& text,
+                    std::vector<int32_t>* ids) const override {
+    num_encoded_bytes += text.size();
+    size_t pos = 0;
+    while (pos < text.size()) {
+      const size_t len = special_token_length(text.substr(pos));
+      if (len > 0) {
+        ids->push_back(text.substr(pos, len) == kStart ? kStartId : kEndId);
+        pos += len;
+      } else {
+        ids->push_back(static_cast<uint8_t>(text[pos]));
+        ++pos;
+      }
+    }
+    return true;
+  }
+
+  std::vector<size_t> special_token_offsets(
+      const std::string_view& text) const override {
+    std::vector<size_t> offsets;
+    size_t pos = 0;
+    while (pos < text.size()) {
+      const size_t len = special_token_length(text.substr(pos));
+      if (len == 0) {
+        ++pos;
+        continue;
+      }
+      if (pos > 0 && (offsets.empty() || offsets.back() != pos)) {
+        offsets.push_back(pos);
+      }
+      pos += len;
+      if (pos < text.size()) {
+        offsets.push_back(pos);
+      }
+    }
+    return offsets;
+  }
+
+  std::string decode(const Slice<int32_t>& /*ids*/,
+                     bool /*skip_special_tokens*/) const override {
+    return "";
+  }
+
+  std::optional<int32_t> token_to_id(
+      const std::string_view& /*token*/) const override {
+    return std::nullopt;
+  }
+
+  std::string id_to_token(int32_t /*id*/) const override { return ""; }
+
+  size_t vocab_size() const override { return 259; }
+
+  std::unique_ptr<Tokenizer> clone() const override {
+    return std::make_unique<FakeTokenizer>();
+  }
+
+  mutable size_t num_encoded_bytes = 0;
+
+ private:
+  static size_t special_token_length(const std::string_view& text) {
+    for (const auto& token : {kStart, kEnd}) {
+      if (text.substr(0, token.size()) == token) {
+        return token.size();
+      }
+    }
+    return 0;
+  }
+
+  static constexpr std::string_view kStart = "<|im_start|>";
+  static constexpr std::string_view kEnd = "<|im_end|>";
+  static constexpr int32_t kStartId = 256;
+  static constexpr int32_t kEndId = 257;
+  static constexpr int32_t kBosId = 258;
+};
+
+std::string render(const ChatMessages& messages) {
+  std::string prompt;
+  for (const auto& message : messages) {
+    prompt += "<|im_start|>" + message.role + "\n" + message.content +
+              "<|im_end|>\n";
+  }
+  prompt += "<|im_start|>assistant\n";
+  return prompt;
+}
+
+}  // namespace
+
+TEST(ChatPrefixCacheTest, MultiTurn) {
+  FakeTokenizer tokenizer;
+  ChatPrefixCache cache(/*max_bytes=*/1024 * 1024);
+
+  ChatMessages messages = {{"system", "you are a helpful assistant."}};
+  for (int turn = 0; turn < 10; ++turn) {
+    messages.emplace_back("user", "question " + std::to_string(turn));
+    const auto prompt = render(messages);
+
+    std::vector<int32_t> desired_ids;
+    ASSERT_TRUE(tokenizer.encode(prompt, &desired_ids));
+
+    tokenizer.num_encoded_bytes = 0;
+    std::vector<int32_t> ids;
+    ASSERT_TRUE(cache.encode(messages, prompt, tokenizer, &ids));
+    EXPECT_EQ(ids, desired_ids);
+    if (turn > 0) {
+      // only the new messages are encoded
+      EXPECT_LT(tokenizer.num_encoded_bytes, 100);
+    }
+
+    messages.emplace_back("assistant", "answer " + std::to_string(turn));
+  }
+  EXPECT_EQ(cache.num_entries(), 10);
+}
+
+TEST(ChatPrefixCacheTest, ChangedHistory) {
+  FakeTokenizer tokenizer;
+  ChatPrefixCache cache(/*max_bytes=*/1024 * 1024);
+
+  ChatMessages messages = {{"user", "hi"}};
+  std::vector<int32_t> ids;
+  ASSERT_TRUE(cache.encode(messages, render(messages), tokenizer, &ids));
+
+  // same messages with a different rendering can't reuse the cached prefix
+  messages.emplace_back("assistant", "hello");
+  messages.emplace_back("user", "how are you?");
+  const auto prompt = "<s>" + render(messages);
+  std::vector<int32_t> desired_ids;
+  ASSERT_TRUE(tokenizer.encode(prompt, &desired_ids));
+  ids.clear();
+  ASSERT_TRUE(cache.encode(messages, prompt, tokenizer, &ids));
+  EXPECT_EQ(ids, desired_ids);
+}
+
+TEST(ChatPrefixCacheTest, Eviction) {
+  FakeTokenizer tokenizer;
+  ChatPrefixCache cache(/*max_bytes=*/1024);
+
+  for (int i = 0; i < 100; ++i) {
+    const ChatMessages messages = {{"user", "question " + std::to_string(i)}};
+    std::vector<int32_t> ids;
+    ASSERT_TRUE(cache.encode(messages, render(messages), tokenizer, &ids));
+    EXPECT_LE(cache.num_bytes(), 1024);
+  }
+  EXPECT_GT(cache.num_entries(), 0);
+  EXPECT_LT(cache.num_entries(), 100);
+}
+
+}  // namespace llm
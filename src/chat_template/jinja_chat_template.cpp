@@ -19,27 +19,37 @@ JinjaChatTemplate::JinjaChatTemplate(const std::string& template_str,
 
 std::optional<std::string> JinjaChatTemplate::apply(
     const ChatMessages& messages) const {
-  // convert the messages to json object
-  nlohmann::json messages_json = nlohmann::json::array();
+  // build template values directly to avoid a round trip through json
+  jinja2::ValuesList messages_list;
+  messages_list.reserve(messages.size());
   for (const auto& message : messages) {
-    nlohmann::json message_json;
-    message_json["role"] = message.role;
-    message_json["content"] = message.content;
-    messages_json.push_back(message_json);
+    messages_list.emplace_back(jinja2::ValuesMap{
+        {"role", message.role},
+        {"content", message.content},
+    });
   }
-  // apply the template
-  return apply(messages_json);
+  return render(jinja2::Value(std::move(messages_list)));
 }
 
 std::optional<std::string> JinjaChatTemplate::apply(
     nlohmann::json& messages) const {
+  return render(jinja2::Reflect(messages));
+}
+
+std::optional<std::string> JinjaChatTemplate::render(
+    jinja2::Value messages) const {
   jinja2::ValuesMap values;
   // add the messages to the values
-  values["messages"] = jinja2::Reflect(messages);
+  values["messages"] = std::move(messages);
   // add the generation prompt
   values["add_generation_prompt"] = add_generation_prompt_;
-  // render the template
-  return template_.RenderAsString(values).value();
+  // render the template, which is parsed once in the constructor
+  auto result = template_.RenderAsString(values);
+  if (!result.has_value()) {
+    LOG(ERROR) << "Failed to render template: " << result.error().ToString();
+    return std::nullopt;
+  }
+  return std::move(result).value();
 }
 
 }  // namespace llm
\ No newline at end of file
@@ -23,6 +23,8 @@ class JinjaChatTemplate : public ChatTemplate {
   std::optional<std::string> apply(nlohmann::json& messages) const;
 
  private:
+  std::optional<std::string> render(jinja2::Value messages) const;
+
   mutable jinja2::Template template_;
   bool add_generation_prompt_;
 };
@@ -0,0 +1,112 @@
+#include "aho_corasick.h"
+
+#include <algorithm>
+#include <queue>
+
+namespace llm {
+
+AhoCorasick::AhoCorasick(const std::vector<std::string>& patterns) {
+  nodes_.emplace_back();
+
+  // build the trie
+  for (size_t p = 0; p < patterns.size(); ++p) {
+    const auto& pattern = patterns[p];
+    if (pattern.empty()) {
+      continue;
+    }
+    int32_t node = kRootState;
+    for (const char ch : pattern) {
+      const auto c = static_cast<uint8_t>(ch);
+      int32_t next = child(node, c);
+      if (next < 0) {
+        next = static_cast<int32_t>(nodes_.size());
+        auto& children = nodes_[node].children;
+        const auto it = std::lower_bound(
+            children.begin(), children.end(), std::make_pair(c, 0));
+        children.insert(it, {c, next});
+        auto& new_node = nodes_.emplace_back();
+        new_node.depth = nodes_[node].depth + 1;
+      }
+      node = next;
+    }
+    // keep the first pattern for duplicates
+    if (nodes_[node].output != node) {
+      nodes_[node].output = node;
+      nodes_[node].pattern = p;
+    }
+    ++num_patterns_;
+  }
+
+  // dense transitions for root, missing transitions go back to root
+  root_next_.assign(256, kRootState);
+  for (const auto& [c, next] : nodes_[kRootState].children) {
+    root_next_[c] = next;
+  }
+
+  // build failure and output links in bfs order
+  std::queue<int32_t> queue;
+  for (const auto& [c, next] : nodes_[kRootState].children) {
+    nodes_[next].fail = kRootState;
+    queue.push(next);
+  }
+  while (!queue.empty()) {
+    const int32_t node = queue.front();
+    queue.pop();
+    for (const auto& [c, next] : nodes_[node].children) {
+      const int32_t fail = next_state(nodes_[node].fail, static_cast<char>(c));
+      nodes_[next].fail = fail;
+      if (nodes_[next].output < 0) {
+        nodes_[next].output = nodes_[fail].output;
+      }
+      queue.push(next);
+    }
+  }
+}
+
+int32_t AhoCorasick::child(int32_t node, uint8_t c) const {
+  const auto& children = nodes_[node].children;
+  const auto it = std::lower_bound(
+      children.begin(), children.end(), std::make_pair(c, 0));
+  if (it != children.end() && it->first == c) {
+    return it->second;
+  }
+  return -1;
+}
+
+int32_t AhoCorasick::next_state(int32_t state, char ch) const {
+  const auto c = static_cast<uint8_t>(ch);
+  while (state != kRootState) {
+    const int32_t next = child(state, c);
+    if (next >= 0) {
+      return next;
+    }
+    state = nodes_[state].fail;
+  }
+  return root_next_[c];
+}
+
+std::optional<AhoCorasick::Match> AhoCorasick::find(
+    const std::string_view& text,
+    size_t pos) const {
+  std::optional<Match> best;
+  int32_t state = kRootState;
+  for (size_t i = pos; i < text.size(); ++i) {
+    state = next_state(state, text[i]);
+    const int32_t out = nodes_[state].output;
+    if (out >= 0) {
+      const size_t length = nodes_[out].depth;
+      const size_t start = i + 1 - length;
+      if (!best.has_value() || start < best->start ||
+          (start == best->start && length > best->length)) {
+        best = Match{start, length, nodes_[out].pattern};
+      }
+    }
+    // no more matches can start at or before the best match
+    if (best.has_value() && i + 1 - nodes_[state].depth > best->start) {
+      break;
+    }
+  }
+  return best;
+}
+
+}  // namespace llm
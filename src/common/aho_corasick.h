@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace llm {
+
+// Aho-Corasick automaton to match a set of byte strings in one pass.
+// https://en.wikipedia.org/wiki/Aho%E2%80%93Corasick_algorithm
+class AhoCorasick final {
+ public:
+  struct Match {
+    // start offset of the match in the text
+    size_t start = 0;
+    // length of the match
+    size_t length = 0;
+    // index of the matched pattern
+    size_t pattern = 0;
+  };
+
+  // empty patterns are ignored
+  explicit AhoCorasick(const std::vector<std::string>& patterns);
+
+  // find the leftmost-longest match in text starting from pos
+  std::optional<Match> find(const std::string_view& text,
+                            size_t pos = 0) const;
+
+  // ######### following functions are used for incremental matching #########
+  // the initial state
+  static constexpr int32_t kRootState = 0;
+
+  // transition to the next state after consuming a byte
+  int32_t next_state(int32_t state, char c) const;
+
+  // length of the longest suffix of consumed bytes that is a prefix of any
+  // pattern, any match can't start before it.
+  size_t depth(int32_t state) const { return nodes_[state].depth; }
+
+  // the longest pattern ending at the state, std::nullopt if none.
+  std::optional<size_t> longest_match(int32_t state) const {
+    const int32_t out = nodes_[state].output;
+    if (out < 0) {
+      return std::nullopt;
+    }
+    return nodes_[out].pattern;
+  }
+
+  // length of the longest pattern ending at the state, 0 if none.
+  size_t longest_match_length(int32_t state) const {
+    const int32_t out = nodes_[state].output;
+    return out < 0 ? 0 : nodes_[out].depth;
+  }
+
+  size_t num_patterns() const { return num_patterns_; }
+
+ private:
+  struct Node {
+    // children sorted by byte
+    std::vector<std::pair<uint8_t, int32_t>> children;
+    // the longest proper suffix that is also a prefix of any pattern
+    int32_t fail = 0;
+    // the nearest node (including itself) that ends a pattern, -1 if none
+    int32_t output = -1;
+    // the pattern ending at the node, only valid when output == itself
+    size_t pattern = 0;
+    // length of the string from root to the node
+    size_t depth = 0;
+  };
+
+  // get the child of the node for byte c, -1 if not exists
+  int32_t child(int32_t node, uint8_t c) const;
+
+  std::vector<Node> nodes_;
+
+  // dense transitions from root for fast restart
+  std::vector<int32_t> root_next_;
+
+  size_t num_patterns_ = 0;
+};
+
+}  // namespace llm
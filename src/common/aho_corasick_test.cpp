@@ -0,0 +1,59 @@
+#include "aho_corasick.h"
+
+#include <gtest/gtest.h>
+
+namespace llm {
+
+TEST(AhoCorasickTest, Find) {
+  AhoCorasick matcher({"he", "she", "his", "hers", ""});
+  EXPECT_EQ(matcher.num_patterns(), 4);
+
+  // leftmost match wins
+  auto match = matcher.find("ushers");
+  ASSERT_TRUE(match.has_value());
+  EXPECT_EQ(match->start, 1);
+  EXPECT_EQ(match->length, 3);
+  EXPECT_EQ(match->pattern, 1);
+
+  // longest match wins for the same start
+  match = matcher.find("ushers", /*pos=*/2);
+  ASSERT_TRUE(match.has_value());
+  EXPECT_EQ(match->start, 2);
+  EXPECT_EQ(match->length, 4);
+  EXPECT_EQ(match->pattern, 3);
+
+  EXPECT_FALSE(matcher.find("abc").has_value());
+  EXPECT_FALSE(matcher.find("").has_value());
+}
+
+TEST(AhoCorasickTest, OverlappingPrefixes) {
+  AhoCorasick matcher({"<|im", "<|im_start|>", "<|im_end|>"});
+  const std::string text = "a<|im_end|>b<|im_x";
+  auto match = matcher.find(text);
+  ASSERT_TRUE(match.has_value());
+  EXPECT_EQ(match->start, 1);
+  EXPECT_EQ(match->pattern, 2);
+
+  match = matcher.find(text, match->start + match->length);
+  ASSERT_TRUE(match.has_value());
+  EXPECT_EQ(match->start, 12);
+  EXPECT_EQ(match->pattern, 0);
+}
+
+TEST(AhoCorasickTest, IncrementalMatch) {
+  AhoCorasick matcher({"stop", "top!"});
+  int32_t state = AhoCorasick::kRootState;
+  std::vector<size_t> match_ends;
+  const std::string text = "nonstop!";
+  for (size_t i = 0; i < text.size(); ++i) {
+    state = matcher.next_state(state, text[i]);
+    if (matcher.longest_match(state).has_value()) {
+      match_ends.push_back(i);
+    }
+  }
+  EXPECT_EQ(match_ends, std::vector<size_t>({6, 7}));
+  EXPECT_EQ(matcher.longest_match_length(state), 4);
+  EXPECT_EQ(matcher.longest_match(state), 1);
+}
+
+}  // namespace llm
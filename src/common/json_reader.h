@@ -4,6 +4,7 @@
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace llm {
@@ -21,6 +22,11 @@ namespace llm {
 //
 class JsonReader {
  public:
+  JsonReader() = default;
+
+  // read from parsed json data
+  explicit JsonReader(nlohmann::json data) : data_(std::move(data)) {}
+
   // parse the json file, return true if success
   bool parse(const std::string& json_file_path);
 
@@ -0,0 +1,94 @@
+#include "numa_utils.h"
+
+#include <absl/strings/ascii.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_split.h>
+#include <glog/logging.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace llm {
+namespace {
+const char* const kNodePath = "/sys/devices/system/node";
+
+std::vector<int> all_cpus() {
+  const int n_cpus =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  std::vector<int> cpus(n_cpus);
+  for (int i = 0; i < n_cpus; ++i) {
+    cpus[i] = i;
+  }
+  return cpus;
+}
+}  // namespace
+
+std::vector<int> parse_cpu_list(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  for (absl::string_view range :
+       absl::StrSplit(cpu_list, ',', absl::SkipWhitespace())) {
+    range = absl::StripAsciiWhitespace(range);
+    const std::vector<absl::string_view> bounds = absl::StrSplit(range, '-');
+    int first = 0;
+    int last = 0;
+    if (bounds.empty() || bounds.size() > 2 ||
+        !absl::SimpleAtoi(bounds.front(), &first) ||
+        !absl::SimpleAtoi(bounds.back(), &last) || first > last) {
+      LOG(ERROR) << "Invalid cpu list: " << cpu_list;
+      return {};
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+int num_numa_nodes() {
+  std::error_code ec;
+  int n_nodes = 0;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(kNodePath, ec)) {
+    const std::string name = entry.path().filename().string();
+    int node = 0;
+    if (name.rfind("node", 0) == 0 &&
+        absl::SimpleAtoi(name.substr(4), &node)) {
+      ++n_nodes;
+    }
+  }
+  return std::max(n_nodes, 1);
+}
+
+std::vector<int> numa_node_cpus(int node) {
+  std::ifstream file(std::string(kNodePath) + "/node" + std::to_string(node) +
+                     "/cpulist");
+  std::string cpu_list;
+  if (!file || !std::getline(file, cpu_list)) {
+    return all_cpus();
+  }
+  auto cpus = parse_cpu_list(cpu_list);
+  return cpus.empty() ? all_cpus() : cpus;
+}
+
+bool bind_thread_to_cpus(const std::vector<int>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  // pid 0 for the calling thread
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    PLOG(WARNING) << "Failed to bind thread to cpus";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace llm
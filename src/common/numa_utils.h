@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace llm {
+
+// number of numa nodes of the machine, 1 if unknown
+int num_numa_nodes();
+
+// ids of cpus belonging to the numa node, all cpus if unknown
+std::vector<int> numa_node_cpus(int node);
+
+// bind the calling thread to the given cpus. threads created afterwards by
+// the calling thread, such as openmp workers, inherit the binding and pages
+// first touched by them are allocated on the local numa node.
+bool bind_thread_to_cpus(const std::vector<int>& cpus);
+
+// parse a linux cpu list, e.g. "0-3,8,10-11"
+std::vector<int> parse_cpu_list(const std::string& cpu_list);
+
+}  // namespace llm
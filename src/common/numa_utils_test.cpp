@@ -0,0 +1,25 @@
+#include "numa_utils.h"
+
+#include <gtest/gtest.h>
+
+namespace llm {
+
+TEST(NumaUtilsTest, ParseCpuList) {
+  EXPECT_EQ(parse_cpu_list("0-3,8,10-11"),
+            std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(parse_cpu_list("5"), std::vector<int>({5}));
+  EXPECT_TRUE(parse_cpu_list("").empty());
+  // invalid lists
+  EXPECT_TRUE(parse_cpu_list("3-1").empty());
+  EXPECT_TRUE(parse_cpu_list("0-a").empty());
+}
+
+TEST(NumaUtilsTest, NodeCpus) {
+  const int n_nodes = num_numa_nodes();
+  EXPECT_GE(n_nodes, 1);
+  for (int node = 0; node < n_nodes; ++node) {
+    EXPECT_FALSE(numa_node_cpus(node).empty());
+  }
+}
+
+}  // namespace llm
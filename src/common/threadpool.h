@@ -29,6 +29,9 @@ class ThreadPool final {
   // schedule a runnable to be executed
   void schedule(Runnable runnable);
 
+  // the number of threads in the pool
+  size_t size() const { return threads_.size(); }
+
  private:
   void internal_loop();
 
@@ -3,6 +3,8 @@
 #include <c10/core/DeviceType.h>
 #include <torch/torch.h>
 
+#include <algorithm>
+#include <tuple>
 #include <vector>
 
 #include "common/metrics.h"
@@ -31,6 +33,35 @@ void pad_2d_vector(std::vector<std::vector<T>>& vec, T pad_value) {
   }
 }
 
+// get the last token of each bad word whose prefix matches the tail of tokens
+std::vector<int64_t> banned_bad_word_tokens(
+    const Slice<int32_t>& token_ids,
+    const std::vector<std::vector<int32_t>>& bad_words) {
+  std::vector<int64_t> banned;
+  for (const auto& bad_word : bad_words) {
+    const size_t prefix_len = bad_word.size() - 1;
+    if (prefix_len > token_ids.size()) {
+      continue;
+    }
+    if (std::equal(bad_word.begin(),
+                   bad_word.end() - 1,
+                   token_ids.end() - prefix_len)) {
+      banned.push_back(bad_word.back());
+    }
+  }
+  return banned;
+}
+
+// get the depth of each node in a token tree, starting from 1 for children of
+// the root. nodes are in depth-first order so parents come before children.
+std::vector<int32_t> tree_depths(const std::vector<int32_t>& parents) {
+  std::vector<int32_t> depths(parents.size());
+  for (size_t i = 0; i < parents.size(); ++i) {
+    depths[i] = parents[i] < 0 ? 1 : depths[parents[i]] + 1;
+  }
+  return depths;
+}
+
 }  // namespace
 
 Batch::Batch(Sequence* sequence) { add(sequence); }
@@ -92,6 +123,10 @@ ModelInput Batch::prepare_model_input(uint32_t num_decoding_tokens,
   std::vector<std::vector<int32_t>> unique_token_counts_vec;
   std::vector<int32_t> unique_token_lens_vec;
 
+  // track the banned tokens that would complete a bad word
+  std::vector<std::vector<int64_t>> bad_token_ids_vec;
+  std::vector<int32_t> bad_token_lens_vec;
+
   bool empty_kv_cache = true;
   uint32_t max_seq_len = 0;
   uint32_t q_max_seq_len = 0;
@@ -101,6 +136,9 @@ ModelInput Batch::prepare_model_input(uint32_t num_decoding_tokens,
   std::vector<int32_t> new_token_slot_ids;
   std::vector<int32_t> block_tables;
   std::vector<int32_t> cu_block_lens = {0};
+  // sequences with draft token trees:
+  // (sequence index, index of the first query token, offset of the tree)
+  std::vector<std::tuple<int32_t, int32_t, int32_t>> tree_sequences;
   const int32_t num_sequences = static_cast<int32_t>(sequences_.size());
   for (int32_t i = 0; i < num_sequences; ++i) {
     auto* sequence = sequences_[i];
@@ -154,10 +192,27 @@ ModelInput Batch::prepare_model_input(uint32_t num_decoding_tokens,
       ++adjusted_token_to_count_map[token_ids[j]];
     }
 
+    // tree tokens are positioned by their depth in the tree
+    const auto& tree_parents = sequence->draft_tree_parents();
+    const uint32_t tree_start =
+        tree_parents.empty() ? n_tokens : sequence->draft_tree_start();
+    std::vector<int32_t> depths;
+    if (!tree_parents.empty()) {
+      CHECK(n_kv_cache_tokens < tree_start && seq_len == n_tokens)
+          << "draft tree should be processed in one step";
+      depths = tree_depths(tree_parents);
+      tree_sequences.emplace_back(i,
+                                  flatten_tokens_vec.size(),
+                                  tree_start - n_kv_cache_tokens);
+    }
+
     bool has_selected_token = false;
     for (uint32_t j = n_kv_cache_tokens; j < seq_len; ++j) {
       flatten_tokens_vec.push_back(token_ids[j]);
-      flatten_positions_vec.push_back(static_cast<int32_t>(j));
+      flatten_positions_vec.push_back(
+          j < tree_start ? static_cast<int32_t>(j)
+                         : static_cast<int32_t>(tree_start - 1) +
+                               depths[j - tree_start]);
 
       // skip prompt tokens except the last one
       if (j + 1 < n_prompt_tokens) {
@@ -190,6 +245,12 @@ ModelInput Batch::prepare_model_input(uint32_t num_decoding_tokens,
       }
       unique_token_lens_vec.push_back(static_cast<int32_t>(ids.size()));
 
+      // match bad words against the tokens up to the current one
+      const auto& banned = bad_token_ids_vec.emplace_back(
+          banned_bad_word_tokens(token_ids.slice(0, j + 1),
+                                 sequence->sampling_param()->bad_words));
+      bad_token_lens_vec.push_back(static_cast<int32_t>(banned.size()));
+
       // sample last token in the sequence
       if (j == seq_len - 1) {
         sample_idxes.push_back(
@@ -227,7 +288,8 @@ ModelInput Batch::prepare_model_input(uint32_t num_decoding_tokens,
     const bool same_num_decoding_tokens =
         q_max_seq_len == num_decoding_tokens &&
         n_tokens == num_sequences * num_decoding_tokens;
-    if (in_decoding_phase && same_num_decoding_tokens) {
+    if (in_decoding_phase && same_num_decoding_tokens &&
+        tree_sequences.empty()) {
       // add padding tokens to the batch
       for (int32_t i = num_sequences; i < min_decoding_bach_size; ++i) {
         for (int32_t k = 0; k < num_decoding_tokens; ++k) {
@@ -259,16 +321,50 @@ ModelInput Batch::prepare_model_input(uint32_t num_decoding_tokens,
   input_params.block_tables = torch::tensor(block_tables, torch::kInt);
   input_params.cu_block_lens = torch::tensor(cu_block_lens, torch::kInt);
 
+  if (!tree_sequences.empty()) {
+    // causal mask among query tokens of each sequence
+    const int64_t n_tokens = static_cast<int64_t>(flatten_tokens_vec.size());
+    auto tree_mask = torch::zeros({n_tokens, q_max_seq_len}, torch::kBool);
+    auto mask = tree_mask.accessor<bool, 2>();
+    for (size_t i = 0; i + 1 < q_cu_seq_lens.size(); ++i) {
+      const int32_t q_start = q_cu_seq_lens[i];
+      const int32_t q_len = q_cu_seq_lens[i + 1] - q_start;
+      for (int32_t r = 0; r < q_len; ++r) {
+        for (int32_t c = 0; c <= r; ++c) {
+          mask[q_start + r][c] = true;
+        }
+      }
+    }
+    // tree nodes only attend to their ancestors in the tree
+    for (const auto& [seq_idx, q_start, q_offset] : tree_sequences) {
+      const auto& parents = sequences_[seq_idx]->draft_tree_parents();
+      for (int32_t node = 0; node < static_cast<int32_t>(parents.size());
+           ++node) {
+        auto row = mask[q_start + q_offset + node];
+        for (int32_t c = 0; c < static_cast<int32_t>(parents.size()); ++c) {
+          row[q_offset + c] = false;
+        }
+        for (int32_t a = node; a >= 0; a = parents[a]) {
+          row[q_offset + a] = true;
+        }
+      }
+    }
+    input_params.tree_mask = tree_mask;
+  }
+
   CHECK_EQ(sampling_params.size(), selected_token_idxes.size());
   if (!selected_token_idxes.empty()) {
     pad_2d_vector<int64_t>(unique_token_ids_vec, /*pad_value=*/0);
     pad_2d_vector(unique_token_counts_vec, /*pad_value=*/0);
+    pad_2d_vector<int64_t>(bad_token_ids_vec, /*pad_value=*/0);
     model_inputs.sampling_params.init(sampling_params,
                                       selected_token_idxes,
                                       sample_idxes,
                                       unique_token_ids_vec,
                                       unique_token_counts_vec,
-                                      unique_token_lens_vec);
+                                      unique_token_lens_vec,
+                                      bad_token_ids_vec,
+                                      bad_token_lens_vec);
   }
 
   return model_inputs;
@@ -306,7 +402,10 @@ void Batch::process_sample_output(const SampleOutput& sample_output) {
   }
 }
 
-void Batch::process_validate_output(const SampleOutput& sample_output) {
+void Batch::process_validate_output(
+    const SampleOutput& sample_output,
+    const std::vector<uint32_t>& num_draft_tokens) {
+  CHECK(num_draft_tokens.empty() || num_draft_tokens.size() == size());
   // [num_seq, num_tokens] LongTensor
   const auto& next_tokens = safe_to(sample_output.next_tokens, torch::kCPU);
   // it is possible that the model output is empty for prefill sequences
@@ -319,7 +418,8 @@ void Batch::process_validate_output(const SampleOutput& sample_output) {
     const auto& top_logprobs = safe_to(sample_output.top_logprobs, torch::kCPU);
     const int64_t num_seqs = next_tokens.size(0);
     int64_t output_idx = 0;
-    for (auto* seq : sequences_) {
+    for (size_t i = 0; i < sequences_.size(); ++i) {
+      auto* seq = sequences_[i];
       if (seq->is_prefill_stage()) {
         // no sampling for prefill sequences
         continue;
@@ -334,7 +434,12 @@ void Batch::process_validate_output(const SampleOutput& sample_output) {
       const auto curr_top_logprobs =
           top_logprobs.defined() ? top_logprobs[curr_idx] : top_logprobs;
 
-      const int64_t num_tokens = curr_next_tokens.size(0);
+      // drop the padded tokens beyond the draft tokens and the bonus token
+      const int64_t num_tokens =
+          num_draft_tokens.empty()
+              ? curr_next_tokens.size(0)
+              : static_cast<int64_t>(num_draft_tokens[i]) + 1;
+      CHECK_LE(num_tokens, curr_next_tokens.size(0));
       std::vector<Token> tokens;
       tokens.reserve(num_tokens);
       for (int64_t i = 0; i < num_tokens; ++i) {
@@ -354,6 +459,61 @@ void Batch::process_validate_output(const SampleOutput& sample_output) {
   }
 }
 
+void Batch::process_validate_tree_output(const SampleOutput& sample_output,
+                                         const torch::Tensor& accepted_path) {
+  // [num_seq, n_nodes + 1] LongTensor
+  const auto& next_tokens = safe_to(sample_output.next_tokens, torch::kCPU);
+  if (!next_tokens.defined()) {
+    return;
+  }
+  // [num_seq, n_nodes] LongTensor
+  const auto path = safe_to(accepted_path, torch::kCPU).to(torch::kInt64);
+  // [num_seq, n_nodes + 1] FloatTensor
+  const auto& logprobs = safe_to(sample_output.logprobs, torch::kCPU);
+  // [num_seq, n_nodes + 1, topk] LongTensor
+  const auto& top_tokens = safe_to(sample_output.top_tokens, torch::kCPU);
+  // [num_seq, n_nodes + 1, topk] FloatTensor
+  const auto& top_logprobs = safe_to(sample_output.top_logprobs, torch::kCPU);
+  const int64_t num_seqs = next_tokens.size(0);
+  const auto path_accessor = path.accessor<int64_t, 2>();
+  int64_t output_idx = 0;
+  for (auto* seq : sequences_) {
+    if (seq->is_prefill_stage()) {
+      // no sampling for prefill sequences
+      continue;
+    }
+    CHECK_LT(output_idx, num_seqs);
+    const auto curr_idx = output_idx++;
+    const auto curr_next_tokens = next_tokens[curr_idx];
+    const auto curr_logprobs =
+        logprobs.defined() ? logprobs[curr_idx] : logprobs;
+    const auto curr_top_tokens =
+        top_tokens.defined() ? top_tokens[curr_idx] : top_tokens;
+    const auto curr_top_logprobs =
+        top_logprobs.defined() ? top_logprobs[curr_idx] : top_logprobs;
+
+    // the accepted path and one more token, padded with -1
+    std::vector<int32_t> nodes;
+    for (int64_t i = 0; i < path.size(1) && path_accessor[curr_idx][i] >= 0;
+         ++i) {
+      nodes.push_back(static_cast<int32_t>(path_accessor[curr_idx][i]));
+    }
+    std::vector<Token> tokens;
+    tokens.reserve(nodes.size() + 1);
+    for (size_t i = 0; i <= nodes.size(); ++i) {
+      tokens.push_back(build_token(i,
+                                   curr_next_tokens,
+                                   curr_logprobs,
+                                   curr_top_tokens,
+                                   curr_top_logprobs));
+    }
+
+    auto num_accepted_tokens = seq->validate_tree_tokens(nodes, tokens);
+    COUNTER_ADD(num_accepted_tokens_total, num_accepted_tokens);
+  }
+  CHECK_EQ(output_idx, num_seqs);
+}
+
 Token Batch::build_token(int64_t index,
                          torch::Tensor token_ids,
                          torch::Tensor logprobs,
@@ -44,6 +44,9 @@ class Batch {
   // TODO: remove this operator once refactoring is done
   Sequence* operator[](size_t i) { return sequences_[i]; }
 
+  // get the max number of tokens to process for the i-th sequence
+  uint32_t token_budget(size_t i) const { return token_budgets_[i]; }
+
   // prepare inputs for the batch, a stateful operation
   ModelInput prepare_model_input(uint32_t num_decoding_tokens,
                                  uint32_t min_decoding_bach_size);
@@ -52,7 +55,16 @@ class Batch {
   void process_sample_output(const SampleOutput& sample_output);
 
   // process the accepted output for each sequence
-  void process_validate_output(const SampleOutput& sample_output);
+  // num_draft_tokens: the number of draft tokens for each sequence, the output
+  // of each sequence is trimmed to num_draft_tokens + 1 tokens if provided.
+  void process_validate_output(
+      const SampleOutput& sample_output,
+      const std::vector<uint32_t>& num_draft_tokens = {});
+
+  // process the accepted path of draft token trees for each sequence
+  // accepted_path: [num_seq, n_nodes] node indices padded with -1
+  void process_validate_tree_output(const SampleOutput& sample_output,
+                                    const torch::Tensor& accepted_path);
 
   // set the engine type for the batch
   void set_engine_type(EngineType engine_type);
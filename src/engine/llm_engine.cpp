@@ -6,11 +6,18 @@
 
 #include <algorithm>
 #include <boost/algorithm/string.hpp>
+#include <deque>
+#include <filesystem>
 #include <memory>
+#include <sstream>
 
 #include "common/metrics.h"
 #include "common/pretty_print.h"
+#include "common/threadpool.h"
+#include "kernels/cpu/cpu_features.h"
 #include "model_loader/model_loader.h"
+#include "model_loader/state_dict.h"
+#include "model_loader/weight_cache.h"
 #include "model_parallel/parallel_args.h"
 #include "models/model_args.h"
 #include "worker.h"
@@ -23,11 +30,38 @@ namespace {
 const std::vector<uint32_t> kDefaultBatchSizesForCudaGraph =
     {1, 2, 4, 8, 16, 24, 32, 48, 64};
 
+torch::ScalarType parse_cpu_dtype(const std::string& dtype_str) {
+  using kernel::cpu::cpu_features;
+  if (dtype_str.empty() || boost::iequals(dtype_str, "auto")) {
+    // half the memory of weights and kv cache if bf16 runs natively
+    return kernel::cpu::has_native_bf16() ? torch::kBFloat16 : torch::kFloat32;
+  }
+  if (boost::iequals(dtype_str, "float") ||
+      boost::iequals(dtype_str, "float32")) {
+    return torch::kFloat32;
+  }
+  if (boost::iequals(dtype_str, "bfloat16")) {
+    LOG_IF(WARNING, !kernel::cpu::has_native_bf16())
+        << "bfloat16 is not natively supported by the cpu, falling back to "
+           "float32 computation: "
+        << cpu_features();
+    return torch::kBFloat16;
+  }
+  if (boost::iequals(dtype_str, "half") ||
+      boost::iequals(dtype_str, "float16")) {
+    LOG_IF(WARNING, !kernel::cpu::has_native_fp16())
+        << "float16 is not natively supported by the cpu, falling back to "
+           "float32 computation: "
+        << cpu_features();
+    return torch::kFloat16;
+  }
+  CHECK(false) << "Unsupported dtype: " << dtype_str << " on cpu";
+}
+
 torch::ScalarType parse_dtype(const std::string& dtype_str,
                               const torch::Device& device) {
   if (device.is_cpu()) {
-    // cpu only supports float32 for now
-    return torch::kFloat32;
+    return parse_cpu_dtype(dtype_str);
   }
 
   if (boost::iequals(dtype_str, "half") ||
@@ -71,7 +105,7 @@ LLMEngine::LLMEngine(const Options& options) : options_(options) {
 
   // initialize process groups if there are multiple devices
   if (devices.size() > 1) {
-    // create a process group for each device if there are multiple gpus
+    // create a process group for each device if there are multiple devices
     process_groups_ = ProcessGroup::create_process_groups(devices);
   }
 
@@ -191,12 +225,65 @@ bool LLMEngine::init_model(const std::string& model_weights_path) {
     }
   }
 
+  // restore prepared weights from the cache if exists
+  std::string weight_cache_key;
+  if (!options_.weight_cache_dir().empty()) {
+    std::ostringstream ss;
+    ss << "version=1, model=" << std::filesystem::absolute(model_weights_path)
+       << ", device=" << options_.devices()[0].type() << ", dtype=" << dtype_
+       << ", world_size=" << workers_.size() << ", args=" << args_
+       << ", quant_args=" << quant_args_ << ", files="
+       << WeightCache::files_fingerprint(model_loader->weights_files());
+    weight_cache_key = ss.str();
+    if (load_weight_cache(weight_cache_key)) {
+      LOG(INFO) << "Loaded prepared weights from cache in "
+                << options_.weight_cache_dir();
+      for (auto& worker : workers_) {
+        worker->prepack_weights();
+      }
+      return true;
+    }
+  }
+
+  // open and read weights files ahead on loading threads, overlapping file
+  // io with copying weights of earlier files into devices. at most
+  // num_loading_threads files are kept in memory besides the current one.
+  const size_t num_files = model_loader->weights_files_count();
+  const size_t num_loading_threads =
+      std::max<size_t>(options_.num_loading_threads(), 1);
+  ThreadPool loading_threadpool(num_loading_threads);
+  std::deque<folly::SemiFuture<std::unique_ptr<StateDict>>> pending_files;
+  size_t next_file = 0;
+  auto prefetch_next_file = [&]() {
+    folly::Promise<std::unique_ptr<StateDict>> promise;
+    pending_files.push_back(promise.getSemiFuture());
+    loading_threadpool.schedule([loader = model_loader.get(),
+                                 index = next_file,
+                                 promise = std::move(promise)]() mutable {
+      promise.setWith([&]() {
+        auto state_dict = loader->load_state_dict(index);
+        state_dict->prefetch();
+        return state_dict;
+      });
+    });
+    ++next_file;
+  };
+  while (next_file < std::min(num_files, num_loading_threads)) {
+    prefetch_next_file();
+  }
+
   // load the weights from the checkpoint in parallel
-  for (const auto& state_dict : *model_loader) {
+  while (!pending_files.empty()) {
+    auto state_dict = std::move(pending_files.front()).get();
+    pending_files.pop_front();
+    if (next_file < num_files) {
+      prefetch_next_file();
+    }
+
     std::vector<folly::SemiFuture<folly::Unit>> futures;
     futures.reserve(workers_.size());
     for (auto& worker : workers_) {
-      futures.push_back(worker->load_state_dict_async(state_dict));
+      futures.push_back(worker->load_state_dict_async(*state_dict));
     }
     // wait for all futures to complete
     auto results = folly::collectAll(futures).get();
@@ -211,9 +298,63 @@ bool LLMEngine::init_model(const std::string& model_weights_path) {
   for (const auto& worker : workers_) {
     worker->verify_loaded_weights();
   }
+
+  if (!weight_cache_key.empty()) {
+    save_weight_cache(weight_cache_key);
+  }
+  // prepacked weights are derived from the loaded ones, never cached
+  for (auto& worker : workers_) {
+    worker->prepack_weights();
+  }
+  return true;
+}
+
+bool LLMEngine::load_weight_cache(const std::string& key) {
+  const int world_size = static_cast<int>(workers_.size());
+  std::vector<folly::SemiFuture<bool>> futures;
+  futures.reserve(workers_.size());
+  for (int rank = 0; rank < world_size; ++rank) {
+    const auto path = WeightCache::cache_path(
+        options_.weight_cache_dir(), key, rank, world_size);
+    futures.push_back(workers_[rank]->load_weight_cache_async(path, key));
+  }
+  // all ranks have to be restored, otherwise load from the checkpoint
+  auto results = folly::collectAll(futures).get();
+  for (const auto& result : results) {
+    if (result.hasException() || !result.value()) {
+      return false;
+    }
+  }
   return true;
 }
 
+void LLMEngine::save_weight_cache(const std::string& key) {
+  std::error_code ec;
+  std::filesystem::create_directories(options_.weight_cache_dir(), ec);
+  if (ec) {
+    LOG(WARNING) << "Failed to create weight cache dir "
+                 << options_.weight_cache_dir() << ": " << ec.message();
+    return;
+  }
+  const int world_size = static_cast<int>(workers_.size());
+  std::vector<folly::SemiFuture<bool>> futures;
+  futures.reserve(workers_.size());
+  for (int rank = 0; rank < world_size; ++rank) {
+    const auto path = WeightCache::cache_path(
+        options_.weight_cache_dir(), key, rank, world_size);
+    futures.push_back(workers_[rank]->save_weight_cache_async(path, key));
+  }
+  auto results = folly::collectAll(futures).get();
+  for (const auto& result : results) {
+    if (result.hasException() || !result.value()) {
+      LOG(WARNING) << "Failed to save prepared weights to "
+                   << options_.weight_cache_dir();
+      return;
+    }
+  }
+  LOG(INFO) << "Saved prepared weights to " << options_.weight_cache_dir();
+}
+
 bool LLMEngine::capture_cuda_graphs() {
   if (!options_.enable_cuda_graph()) {
     return true;
@@ -257,6 +398,8 @@ int64_t LLMEngine::profile_memory_for_kv_cache() {
           total_memory * (1.0 - max_memory_utilization);
       available_memory -= buffer_memory;
     }
+    // cpu workers share the memory of the host
+    available_memory /= static_cast<int64_t>(workers_.size());
     if (max_cache_size > 0) {
       available_memory = std::min(available_memory, max_cache_size);
     }
@@ -56,6 +56,15 @@ class LLMEngine : public Engine {
 
     // batch sizes to capture cuda graphs
     DEFINE_ARG(std::optional<std::vector<uint32_t>>, cuda_graph_batch_sizes);
+
+    // the number of threads to read weights files ahead of loading them into
+    // devices, which is also the max number of files read ahead.
+    DEFINE_ARG(int32_t, num_loading_threads) = 4;
+
+    // the directory to cache prepared weights of each rank, so that restarts
+    // skip converting, fusing, sharding and repacking weights. empty to
+    // disable.
+    DEFINE_ARG(std::string, weight_cache_dir);
   };
 
   // create an engine with the given devices
@@ -99,6 +108,12 @@ class LLMEngine : public Engine {
   int64_t calculate_kv_cache_blocks(int64_t cache_size_in_bytes) const;
 
  private:
+  // restore prepared weights of all workers from the weight cache
+  bool load_weight_cache(const std::string& key);
+
+  // save prepared weights of all workers into the weight cache
+  void save_weight_cache(const std::string& key);
+
   // options
   Options options_;
 
@@ -129,8 +129,12 @@ torch::Tensor ModelRunner::forward(const torch::Tensor& tokens,
         params.q_max_seq_len == options_.num_decoding_tokens() &&
         n_tokens == batch_size * options_.num_decoding_tokens();
 
+    // the captured graph only supports causal attention
+    const bool causal_attention = !params.tree_mask.defined();
+
     // replay the graph if all conditions are met
-    if (in_decoding_phase && seq_len_supported && same_num_decoding_tokens) {
+    if (in_decoding_phase && seq_len_supported && same_num_decoding_tokens &&
+        causal_attention) {
       COUNTER_INC(num_cuda_graph_replayed_total);
       return it->second->replay(tokens, positions, params);
     }
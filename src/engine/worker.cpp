@@ -1,5 +1,6 @@
 #include "worker.h"
 
+#include <ATen/Parallel.h>
 #include <ATen/cuda/CUDAGraph.h>
 #include <c10/core/Device.h>
 #include <c10/cuda/CUDAGuard.h>
@@ -13,11 +14,13 @@
 #include <utility>
 
 #include "common/metrics.h"
+#include "common/numa_utils.h"
 #include "common/threadpool.h"
 #include "common/timer.h"
 #include "memory/kv_cache.h"
 #include "memory/memory.h"
 #include "model_loader/state_dict.h"
+#include "model_loader/weight_cache.h"
 #include "model_parallel/model_parallel.h"
 #include "models/parameters.h"
 #include "sampling/logits_processor.h"
@@ -37,6 +40,29 @@ DEFINE_COUNTER_INSTANCE(sampling_latency_seconds,
                         {{"stage", "sampling"}});
 
 namespace llm {
+namespace {
+// bind the calling thread to a numa node, ranks are assigned to nodes in
+// round-robin, and cpus of a node are split among ranks on it.
+void bind_to_numa_node(int32_t rank, int32_t world_size) {
+  const int32_t n_nodes = num_numa_nodes();
+  const int32_t node = rank % n_nodes;
+  const int32_t n_local_ranks = (world_size - node + n_nodes - 1) / n_nodes;
+  const int32_t local_rank = rank / n_nodes;
+
+  const auto node_cpus = numa_node_cpus(node);
+  const int64_t n_cpus = static_cast<int64_t>(node_cpus.size());
+  const int64_t begin = n_cpus * local_rank / n_local_ranks;
+  const int64_t end = n_cpus * (local_rank + 1) / n_local_ranks;
+  std::vector<int> cpus(node_cpus.begin() + begin, node_cpus.begin() + end);
+  if (cpus.empty() || !bind_thread_to_cpus(cpus)) {
+    return;
+  }
+  // one intra-op thread per cpu, which inherit the binding
+  at::set_num_threads(static_cast<int>(cpus.size()));
+  LOG(INFO) << "Bound worker " << rank << " to numa node " << node
+            << " with " << cpus.size() << " cpus";
+}
+}  // namespace
 
 Worker::Worker(const ParallelArgs& parallel_args,
                const torch::Device& device,
@@ -46,6 +72,15 @@ Worker::Worker(const ParallelArgs& parallel_args,
       runner_options_(runner_options) {
   // first worker is the driver
   driver_ = parallel_args.rank() == 0;
+
+  if (device_.is_cpu() && parallel_args.world_size() > 1) {
+    // pin the working thread before any allocation, so that the shard of
+    // weights and kv caches are first touched on local memory.
+    threadpool_.schedule([rank = parallel_args.rank(),
+                          world_size = parallel_args.world_size()]() {
+      bind_to_numa_node(rank, world_size);
+    });
+  }
 }
 
 bool Worker::init_model(torch::ScalarType dtype,
@@ -97,6 +132,47 @@ void Worker::verify_loaded_weights() const {
   model_->verify_loaded_weights();
 }
 
+void Worker::prepack_weights() {
+  CHECK(model_ != nullptr) << "Model is not initialized.";
+  model_->prepack_weights();
+}
+
+bool Worker::save_weight_cache(const std::string& path,
+                               const std::string& key) {
+  CHECK(model_ != nullptr) << "Model is not initialized.";
+  return WeightCache::save(path, key, model_->named_weights());
+}
+
+bool Worker::load_weight_cache(const std::string& path,
+                               const std::string& key) {
+  CHECK(model_ != nullptr) << "Model is not initialized.";
+  auto state_dict = WeightCache::load(path, key);
+  if (state_dict == nullptr) {
+    return false;
+  }
+  // check all weights before touching the model
+  auto weights = model_->named_weights();
+  for (const auto& [name, weight] : weights) {
+    const auto cached = state_dict->get_tensor(name);
+    if (!cached.defined() || cached.sizes() != weight.sizes() ||
+        cached.scalar_type() != weight.scalar_type()) {
+      LOG(WARNING) << "Weight " << name << " mismatches with cache " << path;
+      return false;
+    }
+  }
+  torch::NoGradGuard no_grad;
+  for (auto& [name, weight] : weights) {
+    const auto cached = state_dict->get_tensor(name);
+    if (weight.device().is_cpu()) {
+      // alias the read-only mapping, kept alive by the storage of cached
+      weight.set_data(cached);
+    } else {
+      weight.copy_(cached);
+    }
+  }
+  return true;
+}
+
 std::tuple<int64_t, int64_t> Worker::profile_device_memory() {
   CHECK(model_ != nullptr) << "Model is not initialized.";
   CHECK(device_.is_cuda()) << "Memory profiling is only supported on GPU.";
@@ -109,7 +185,9 @@ std::tuple<int64_t, int64_t> Worker::profile_device_memory() {
 
 void Worker::process_group_test() {
   torch::DeviceGuard device_guard(device_);
-  torch::cuda::synchronize();
+  if (device_.is_cuda()) {
+    torch::cuda::synchronize();
+  }
 
   // create random tensors
   const auto options = torch::dtype(torch::kHalf).device(device_);
@@ -118,7 +196,9 @@ void Worker::process_group_test() {
   reduce_from_model_parallel_region(tensor, parallel_args_);
   // call allgather
   gather_from_model_parallel_region(tensor, parallel_args_);
-  torch::cuda::synchronize();
+  if (device_.is_cuda()) {
+    torch::cuda::synchronize();
+  }
 }
 
 std::optional<ModelOutput> Worker::execute_model(const ModelInput& inputs) {
@@ -167,9 +247,12 @@ std::optional<ModelOutput> Worker::execute_model(const ModelInput& inputs) {
     output.logits = logits;
 
     timer.reset();
-    auto sampler = std::make_unique<Sampler>(sampling_params.do_sample,
-                                             sampling_params.logprobs,
-                                             sampling_params.max_top_logprobs);
+    auto sampler =
+        std::make_unique<Sampler>(sampling_params.do_sample,
+                                  sampling_params.logprobs,
+                                  sampling_params.max_top_logprobs,
+                                  sampling_params.logprobs_idxes,
+                                  sampling_params.top_logprobs_idxes);
     // select sample logits
     auto sample_logits =
         logits.index_select(/*dim=*/0, sampling_params.sample_idxes);
@@ -262,6 +345,30 @@ folly::SemiFuture<folly::Unit> Worker::capture_cuda_graph_async(
   return future;
 }
 
+folly::SemiFuture<bool> Worker::save_weight_cache_async(
+    const std::string& path,
+    const std::string& key) {
+  folly::Promise<bool> promise;
+  auto future = promise.getSemiFuture();
+  threadpool_.schedule(
+      [this, path, key, promise = std::move(promise)]() mutable {
+        promise.setValue(this->save_weight_cache(path, key));
+      });
+  return future;
+}
+
+folly::SemiFuture<bool> Worker::load_weight_cache_async(
+    const std::string& path,
+    const std::string& key) {
+  folly::Promise<bool> promise;
+  auto future = promise.getSemiFuture();
+  threadpool_.schedule(
+      [this, path, key, promise = std::move(promise)]() mutable {
+        promise.setValue(this->load_weight_cache(path, key));
+      });
+  return future;
+}
+
 folly::SemiFuture<folly::Unit> Worker::load_state_dict_async(
     const StateDict& state_dict) {
   folly::Promise<folly::Unit> promise;
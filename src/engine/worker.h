@@ -35,6 +35,16 @@ class Worker final {
   // verify if the model is loaded correctly
   void verify_loaded_weights() const;
 
+  // prepare weights for faster forward once loaded. blocking call
+  void prepack_weights();
+
+  // save the prepared weights into the cache file. blocking call
+  bool save_weight_cache(const std::string& path, const std::string& key);
+
+  // copy the prepared weights from the cache file into the model, returns
+  // false if the cache is missing or stale. blocking call
+  bool load_weight_cache(const std::string& path, const std::string& key);
+
   // returns available memory and total memory
   std::tuple<int64_t, int64_t> profile_device_memory();
 
@@ -57,6 +67,12 @@ class Worker final {
   folly::SemiFuture<folly::Unit> load_state_dict_async(
       const StateDict& state_dict);
 
+  folly::SemiFuture<bool> save_weight_cache_async(const std::string& path,
+                                                  const std::string& key);
+
+  folly::SemiFuture<bool> load_weight_cache_async(const std::string& path,
+                                                  const std::string& key);
+
   folly::SemiFuture<std::tuple<int64_t, int64_t>> profile_device_memory_async();
 
   // initialize kv cache. async call
@@ -5,7 +5,10 @@
 #include <grpcpp/grpcpp.h>
 
 #include <atomic>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 
@@ -22,15 +25,25 @@ class CallData {
 };
 
 // Class encompasing the state and logic needed to serve a server streaming
-// request.
+// request. Responses are queued by the callers and sent one by one from the
+// completion queue thread, so that a slow client never blocks the callers.
 template <typename Request, typename Response>
 class StreamCallData : public CallData {
  public:
   enum class Status { CREATE, WRITE, PENDING, FINISH };
 
+  // the max number of responses queued for a call, the call is cancelled once
+  // the client falls further behind.
+  static constexpr size_t kMaxPendingResponses = 1024;
+
+  // callback when a queued response is sent or dropped, called from the grpc
+  // handler thread with true if the response has been written to the client.
+  using OnSent = std::function<void(bool sent)>;
+
   // pack the response with state
   struct ResponseWithState {
-    ResponseWithState(Response _response) : response(std::move(_response)) {}
+    ResponseWithState(Response _response, OnSent _on_sent = nullptr)
+        : response(std::move(_response)), on_sent(std::move(_on_sent)) {}
 
     ResponseWithState(grpc::Status _grpc_status)
         : grpc_status(std::move(_grpc_status)) {}
@@ -43,6 +56,8 @@ class StreamCallData : public CallData {
     std::optional<Response> response;
     // grpc status to be sent to client
     std::optional<grpc::Status> grpc_status;
+    // callback once the response is sent or dropped
+    OnSent on_sent;
   };
 
   // callback for registering itself to the service
@@ -62,7 +77,10 @@ class StreamCallData : public CallData {
       : cq_(cq),
         responder_(&ctx_),
         on_register_(on_register),
-        on_new_request_(on_request) {
+        on_new_request_(on_request),
+        done_tag_(this) {
+    // get notified when the call is done or cancelled by the client
+    ctx_.AsyncNotifyWhenDone(&done_tag_);
     // register itself to the service for handling request
     on_register_(&ctx_, &request_, &responder_, cq_, cq_, this);
   }
@@ -72,23 +90,26 @@ class StreamCallData : public CallData {
   // returns true if the rpc is ok
   bool is_rpc_ok() const { return rpc_ok_.load(std::memory_order_relaxed); }
 
+  // flag that is set once the client has gone away
+  const std::shared_ptr<std::atomic_bool>& cancel_flag() const {
+    return cancel_flag_;
+  }
+
   // call following methods to reply to client
   // returns true if the response has been accepted and will be delivered
   // asynchronously.
   // returns false if the rpc channel has been closed/cancelled.
-  bool write(Response response) {
-    // pack the response with state
-    auto new_response =
-        std::make_shared<ResponseWithState>(std::move(response));
-    return send_response(new_response);
+  // on_sent is called once the response is sent or dropped, only if the
+  // response has been accepted.
+  bool write(Response response, OnSent on_sent = nullptr) {
+    return send_response(
+        ResponseWithState(std::move(response), std::move(on_sent)));
   }
 
   bool write_and_finish(Response response,
                         grpc::Status grpc_status = grpc::Status::OK) {
-    // pack the response with state
-    auto new_response = std::make_shared<ResponseWithState>(
-        std::move(response), std::move(grpc_status));
-    return send_response(new_response);
+    return send_response(
+        ResponseWithState(std::move(response), std::move(grpc_status)));
   }
 
   // returns false if the rpc channel has been closed/cancelled.
@@ -99,96 +120,171 @@ class StreamCallData : public CallData {
 
   // returns false if the rpc channel has been closed/cancelled.
   bool finish(grpc::Status grpc_status = grpc::Status::OK) {
-    // pack status with grpc status
-    auto new_response =
-        std::make_shared<ResponseWithState>(std::move(grpc_status));
-    return send_response(new_response);
+    return send_response(ResponseWithState(std::move(grpc_status)));
   }
 
-  bool send_response(std::shared_ptr<ResponseWithState> response) {
-    // wait previous response to be processed
-    std::shared_ptr<ResponseWithState> expected = nullptr;
-    while (
-        !std::atomic_compare_exchange_weak(&response_, &expected, response)) {
-      expected = nullptr;
+  // queue the response and return without waiting for it to be sent
+  bool send_response(ResponseWithState response) {
+    const bool finishing = response.grpc_status.has_value();
+    bool notify = false;
+    bool rpc_ok = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // the final status is always queued to release the call data
+      if (!finishing && !is_rpc_ok()) {
+        return false;
+      }
+      if (!finishing && responses_.size() >= kMaxPendingResponses) {
+        LOG(WARNING) << "Cancelling the call as the client can't keep up";
+        cancel();
+        ctx_.TryCancel();
+        return false;
+      }
+      responses_.push_back(std::move(response));
+      // wake up the grpc handler thread if it is idle
+      notify = !writing_;
+      writing_ = true;
+      // the call data may be released once the final status is queued
+      rpc_ok = is_rpc_ok();
     }
 
-    // notify the grpc handler thread
-    notify_alarm_.Set(
-        cq_, gpr_time_0(gpr_clock_type::GPR_CLOCK_MONOTONIC), this);
-    return rpc_ok_.load(std::memory_order_relaxed);
+    if (notify) {
+      notify_alarm_.Set(
+          cq_, gpr_time_0(gpr_clock_type::GPR_CLOCK_MONOTONIC), this);
+    }
+    return rpc_ok;
   }
 
   // proceed to the next state.
   bool proceed(bool rpc_ok) override {
-    // record the rpc status
-    if (!rpc_ok) {
-      rpc_ok_.store(false, std::memory_order_relaxed);
-    }
-    // rpc is ok only if all the ops are ok
-    rpc_ok = rpc_ok && rpc_ok_.load(std::memory_order_relaxed);
-
     // it is notification from cq for new request
     if (status_ == Status::CREATE) {
-      // Spawn a new CallData instance to serve new clients
-      new StreamCallData(cq_, on_register_, on_new_request_);
-
-      // rpc error before acctually processing the request, release the calldata
+      // the server is shutting down before the request arrived, release the
+      // calldata. the done notification is not delivered in this case.
       if (!rpc_ok) {
         return false;
       }
 
+      // Spawn a new CallData instance to serve new clients
+      new StreamCallData(cq_, on_register_, on_new_request_);
+
       // set status to WRITE to process response
       status_ = Status::WRITE;
       // The actual processing.
       on_new_request_(this);
-    } else if (status_ == Status::WRITE) {
-      if (auto rs = std::atomic_load(&response_)) {
-        // send the response to client
-        // WriteAndFinish
-        if (rs->response.has_value() && rs->grpc_status.has_value()) {
-          if (rpc_ok) {
-            // change the status to pending to wait for write op to finish
-            status_ = Status::FINISH;
-            responder_.WriteAndFinish(
-                rs->response.value(), {}, rs->grpc_status.value(), this);
-          } else {
-            // the request has been finished, release the calldata
-            return false;
-          }
-        } else if (rs->response.has_value()) {
-          // if rpc is ok, send the response to client, otherwise, wait for
-          // finish alarm
-          if (rpc_ok) {
-            // change the status to pending to wait for write op to finish
-            status_ = Status::PENDING;
-            responder_.Write(rs->response.value(), this);
-          } else {
-            std::atomic_store(&response_, {});
-          }
+      return true;
+    }
+
+    // record the rpc status
+    if (!rpc_ok) {
+      cancel();
+    }
+
+    if (status_ == Status::FINISH) {
+      // the call is finished, release it once the done notification arrived
+      return on_call_finished();
+    }
+    // the previous write op has been finished
+    if (status_ == Status::PENDING) {
+      on_sent(is_rpc_ok());
+    }
+    // the alarm is fired or the previous write op has been finished
+    status_ = Status::WRITE;
+    return write_next();
+  }
+
+ private:
+  // tag for the notification when the call is done
+  class DoneTag : public CallData {
+   public:
+    explicit DoneTag(StreamCallData* call_data) : call_data_(call_data) {}
+
+    bool proceed(bool /*rpc_ok*/) override {
+      call_data_->on_done();
+      // the tag is owned by the call data
+      return true;
+    }
+
+   private:
+    StreamCallData* call_data_;
+  };
+
+  // send the next queued response, called from the grpc handler thread only
+  bool write_next() {
+    while (true) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (responses_.empty()) {
+          // go idle, the next response will set the alarm
+          writing_ = false;
+          return true;
+        }
+        // keep the response alive until the write op is finished
+        current_.emplace(std::move(responses_.front()));
+        responses_.pop_front();
+      }
+
+      const auto& rs = current_.value();
+      if (rs.grpc_status.has_value()) {
+        if (!is_rpc_ok()) {
+          // the client has gone away, release the calldata
+          return on_call_finished();
+        }
+        status_ = Status::FINISH;
+        if (rs.response.has_value()) {
+          responder_.WriteAndFinish(
+              rs.response.value(), {}, rs.grpc_status.value(), this);
         } else {
-          if (rpc_ok) {
-            // the rpc is ok, send the finish status to client
-            status_ = Status::FINISH;
-            responder_.Finish(rs->grpc_status.value(), this);
-          } else {
-            // the request has been finished, release the calldata
-            return false;
-          }
+          responder_.Finish(rs.grpc_status.value(), this);
         }
+        return true;
       }
-    } else if (status_ == Status::PENDING) {
-      // the write op has been finished, proceed to the next write op
-      status_ = Status::WRITE;
-      std::atomic_store(&response_, {});
-    } else if (status_ == Status::FINISH) {
-      // Once in the FINISH state, deallocate CallData.
-      return false;
+
+      // drop the responses once the rpc is broken, wait for the final status
+      if (is_rpc_ok()) {
+        // change the status to pending to wait for write op to finish
+        status_ = Status::PENDING;
+        responder_.Write(rs.response.value(), this);
+        return true;
+      }
+      on_sent(/*sent=*/false);
+    }
+  }
+
+  // notify the caller that the current response is sent or dropped
+  void on_sent(bool sent) {
+    if (current_.has_value() && current_->on_sent != nullptr) {
+      // may queue more responses, never called with the lock held
+      auto callback = std::move(current_->on_sent);
+      current_.reset();
+      callback(sent);
+    }
+  }
+
+  // mark the call as cancelled, queued responses are dropped when sending
+  void cancel() {
+    rpc_ok_.store(false, std::memory_order_relaxed);
+    cancel_flag_->store(true, std::memory_order_relaxed);
+  }
+
+  // called when the final status is sent or dropped
+  bool on_call_finished() {
+    finished_ = true;
+    // wait for the done notification before releasing the call data
+    return !done_;
+  }
+
+  // called when the call is done, either finished or cancelled
+  void on_done() {
+    done_ = true;
+    if (ctx_.IsCancelled()) {
+      cancel();
+    }
+    if (finished_) {
+      delete this;
     }
-    return true;
   }
 
- private:
   Status status_ = Status::CREATE;
 
   // completion queue: the producer-consumer queue where for asynchronous server
@@ -210,14 +306,32 @@ class StreamCallData : public CallData {
   // it is used to record the rpc status
   std::atomic<bool> rpc_ok_{true};
 
+  // shared with the requests of the call to cancel them
+  std::shared_ptr<std::atomic_bool> cancel_flag_ =
+      std::make_shared<std::atomic_bool>(false);
+
   // callback for registering itself to the service
   OnRegister on_register_;
 
   // callback for new request
   OnRequest on_new_request_;
 
-  // next response to be sent to client
-  std::shared_ptr<ResponseWithState> response_;
+  // tag for the done notification
+  DoneTag done_tag_;
+
+  // the final status has been handled and the done notification has arrived,
+  // both are only accessed from the grpc handler thread.
+  bool finished_ = false;
+  bool done_ = false;
+
+  std::mutex mutex_;
+  // responses to be sent to client
+  std::deque<ResponseWithState> responses_;
+  // whether the grpc handler thread is sending responses
+  bool writing_ = false;
+
+  // the response being sent to client
+  std::optional<ResponseWithState> current_;
 };
 
 }  // namespace llm
@@ -0,0 +1,205 @@
+#include "call_data.h"
+
+#include <gtest/gtest.h>
+#include <grpcpp/grpcpp.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "completion.grpc.pb.h"
+
+namespace llm {
+namespace {
+
+using TestCallData =
+    StreamCallData<proto::CompletionRequest, proto::CompletionResponse>;
+
+proto::CompletionResponse make_response(const std::string& text) {
+  proto::CompletionResponse response;
+  response.add_choices()->set_text(text);
+  return response;
+}
+
+class StreamCallDataTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    grpc::ServerBuilder builder;
+    int port = 0;
+    builder.AddListeningPort(
+        "127.0.0.1:0", grpc::InsecureServerCredentials(), &port);
+    builder.RegisterService(&service_);
+    cq_ = builder.AddCompletionQueue();
+    server_ = builder.BuildAndStart();
+    ASSERT_NE(server_, nullptr);
+
+    new TestCallData(
+        cq_.get(),
+        [this](grpc::ServerContext* context,
+               proto::CompletionRequest* request,
+               grpc::ServerAsyncWriter<proto::CompletionResponse>* responder,
+               grpc::ServerCompletionQueue* new_call_cq,
+               grpc::ServerCompletionQueue* notification_cq,
+               void* tag) {
+          service_.RequestComplete(
+              context, request, responder, new_call_cq, notification_cq, tag);
+        },
+        [this](TestCallData* call_data) {
+          // serve the request from another thread like the engine does
+          producer_ =
+              std::thread([this, call_data] { on_request_(call_data); });
+        });
+    cq_thread_ = std::thread([this] {
+      void* tag = nullptr;
+      bool rpc_ok = false;
+      while (cq_->Next(&tag, &rpc_ok)) {
+        auto* call_data = static_cast<CallData*>(tag);
+        if (!call_data->proceed(rpc_ok)) {
+          delete call_data;
+        }
+      }
+    });
+
+    auto channel = grpc::CreateChannel("127.0.0.1:" + std::to_string(port),
+                                       grpc::InsecureChannelCredentials());
+    stub_ = proto::Completion::NewStub(channel);
+  }
+
+  void TearDown() override {
+    if (producer_.joinable()) {
+      producer_.join();
+    }
+    server_->Shutdown(std::chrono::system_clock::now());
+    cq_->Shutdown();
+    cq_thread_.join();
+  }
+
+  proto::Completion::AsyncService service_;
+  std::unique_ptr<grpc::ServerCompletionQueue> cq_;
+  std::unique_ptr<grpc::Server> server_;
+  std::unique_ptr<proto::Completion::Stub> stub_;
+  std::thread cq_thread_;
+
+  // handler for the new request, called from the producer thread
+  std::function<void(TestCallData*)> on_request_;
+  std::thread producer_;
+};
+
+TEST_F(StreamCallDataTest, WriteAndFinish) {
+  on_request_ = [](TestCallData* call_data) {
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_TRUE(call_data->write(make_response(std::to_string(i))));
+    }
+    call_data->finish();
+  };
+
+  grpc::ClientContext context;
+  auto reader = stub_->Complete(&context, proto::CompletionRequest());
+  proto::CompletionResponse response;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(reader->Read(&response));
+    EXPECT_EQ(response.choices(0).text(), std::to_string(i));
+  }
+  EXPECT_FALSE(reader->Read(&response));
+  EXPECT_TRUE(reader->Finish().ok());
+}
+
+TEST_F(StreamCallDataTest, OnSent) {
+  std::atomic<int> num_sent{0};
+  on_request_ = [&](TestCallData* call_data) {
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_TRUE(call_data->write(make_response(std::to_string(i)),
+                                   [&num_sent, call_data](bool sent) {
+                                     EXPECT_TRUE(sent);
+                                     // finish from the callback like batches
+                                     if (++num_sent == 3) {
+                                       call_data->finish();
+                                     }
+                                   }));
+    }
+  };
+
+  grpc::ClientContext context;
+  auto reader = stub_->Complete(&context, proto::CompletionRequest());
+  proto::CompletionResponse response;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(reader->Read(&response));
+    EXPECT_EQ(response.choices(0).text(), std::to_string(i));
+  }
+  EXPECT_FALSE(reader->Read(&response));
+  EXPECT_TRUE(reader->Finish().ok());
+  EXPECT_EQ(num_sent, 3);
+}
+
+TEST_F(StreamCallDataTest, ClientStopsReading) {
+  std::atomic<bool> write_failed{false};
+  std::atomic<bool> producer_done{false};
+  std::chrono::steady_clock::duration elapsed{};
+  on_request_ = [&](TestCallData* call_data) {
+    // large responses to fill up the flow control windows quickly
+    const std::string text(32 * 1024, 'x');
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100000; ++i) {
+      if (!call_data->write(make_response(text))) {
+        write_failed = true;
+        break;
+      }
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_TRUE(call_data->cancel_flag()->load());
+    call_data->finish();
+    producer_done = true;
+  };
+
+  grpc::ClientContext context;
+  auto reader = stub_->Complete(&context, proto::CompletionRequest());
+  proto::CompletionResponse response;
+  ASSERT_TRUE(reader->Read(&response));
+
+  // stop reading, writes never block and the call is cancelled once the
+  // queue is full
+  producer_.join();
+  EXPECT_TRUE(producer_done);
+  EXPECT_TRUE(write_failed);
+  EXPECT_LT(elapsed, std::chrono::seconds(10));
+
+  context.TryCancel();
+  while (reader->Read(&response)) {
+  }
+  EXPECT_FALSE(reader->Finish().ok());
+}
+
+TEST_F(StreamCallDataTest, ClientCancel) {
+  std::atomic<bool> cancelled{false};
+  on_request_ = [&](TestCallData* call_data) {
+    EXPECT_TRUE(call_data->write(make_response("first")));
+    // wait for the client to go away
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!call_data->cancel_flag()->load() &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    cancelled = call_data->cancel_flag()->load();
+    EXPECT_FALSE(call_data->is_rpc_ok());
+    EXPECT_FALSE(call_data->write(make_response("second")));
+    call_data->finish();
+  };
+
+  grpc::ClientContext context;
+  auto reader = stub_->Complete(&context, proto::CompletionRequest());
+  proto::CompletionResponse response;
+  ASSERT_TRUE(reader->Read(&response));
+  EXPECT_EQ(response.choices(0).text(), "first");
+  context.TryCancel();
+  EXPECT_EQ(reader->Finish().error_code(), grpc::StatusCode::CANCELLED);
+
+  producer_.join();
+  EXPECT_TRUE(cancelled);
+}
+
+}  // namespace
+}  // namespace llm
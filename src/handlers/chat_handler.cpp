@@ -204,6 +204,15 @@ SamplingParams grpc_request_to_sampling_params(
   if (request.has_top_k()) {
     sampling_params.top_k = request.top_k();
   }
+  if (request.has_min_p()) {
+    sampling_params.min_p = request.min_p();
+  }
+  if (request.logit_bias_size() > 0) {
+    auto& logit_bias = sampling_params.logit_bias.emplace();
+    for (const auto& [token_id, bias] : request.logit_bias()) {
+      logit_bias[token_id] = bias;
+    }
+  }
   if (request.has_logprobs()) {
     sampling_params.logprobs = request.logprobs();
   }
@@ -224,6 +233,10 @@ SamplingParams grpc_request_to_sampling_params(
     sampling_params.stop_token_ids = std::vector<int32_t>(
         request.stop_token_ids().begin(), request.stop_token_ids().end());
   }
+  if (request.bad_words_size() > 0) {
+    sampling_params.bad_words = std::vector<std::string>(
+        request.bad_words().begin(), request.bad_words().end());
+  }
   return sampling_params;
 }
 
@@ -1,13 +1,17 @@
 #include "completion_handler.h"
 
+#include <absl/synchronization/mutex.h>
 #include <absl/time/clock.h>
 #include <absl/time/time.h>
 #include <glog/logging.h>
 #include <grpcpp/grpcpp.h>
 #include <torch/torch.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "completion.pb.h"
 #include "request/output.h"
@@ -101,11 +105,10 @@ bool send_delta_to_client(CompletionCallData* call_data,
   return true;
 }
 
-bool send_result_to_client(CompletionCallData* call_data,
-                           const std::string& request_id,
-                           int64_t created_time,
-                           const std::string& model,
-                           const RequestOutput& req_output) {
+proto::CompletionResponse build_response(const std::string& request_id,
+                                         int64_t created_time,
+                                         const std::string& model,
+                                         const RequestOutput& req_output) {
   proto::CompletionResponse response;
   response.set_object("text_completion");
   response.set_id(request_id);
@@ -133,8 +136,16 @@ bool send_result_to_client(CompletionCallData* call_data,
         static_cast<int32_t>(usage.num_generated_tokens));
     proto_usage->set_total_tokens(static_cast<int32_t>(usage.num_total_tokens));
   }
+  return response;
+}
 
-  return call_data->write_and_finish(response);
+bool send_result_to_client(CompletionCallData* call_data,
+                           const std::string& request_id,
+                           int64_t created_time,
+                           const std::string& model,
+                           const RequestOutput& req_output) {
+  return call_data->write_and_finish(
+      build_response(request_id, created_time, model, req_output));
 }
 
 SamplingParams grpc_request_to_sampling_params(
@@ -170,6 +181,15 @@ SamplingParams grpc_request_to_sampling_params(
   if (request.has_top_k()) {
     sampling_params.top_k = request.top_k();
   }
+  if (request.has_min_p()) {
+    sampling_params.min_p = request.min_p();
+  }
+  if (request.logit_bias_size() > 0) {
+    auto& logit_bias = sampling_params.logit_bias.emplace();
+    for (const auto& [token_id, bias] : request.logit_bias()) {
+      logit_bias[token_id] = bias;
+    }
+  }
   if (request.has_logprobs()) {
     sampling_params.logprobs = true;
     sampling_params.top_logprobs = request.logprobs();
@@ -188,9 +208,131 @@ SamplingParams grpc_request_to_sampling_params(
     sampling_params.stop_token_ids = std::vector<int32_t>(
         request.stop_token_ids().begin(), request.stop_token_ids().end());
   }
+  if (request.bad_words_size() > 0) {
+    sampling_params.bad_words = std::vector<std::string>(
+        request.bad_words().begin(), request.bad_words().end());
+  }
   return sampling_params;
 }
 
+// the max number of prompts of a batch call in flight, including results
+// queued for the client
+constexpr size_t kMaxBatchConcurrency = 256;
+static_assert(kMaxBatchConcurrency <
+                  BatchCompletionCallData::kMaxPendingResponses,
+              "a slow client must not overflow the response queue");
+
+// states shared by the callbacks of a batch completion call
+struct BatchState {
+  BatchCompletionCallData* call_data = nullptr;
+  std::string model;
+  int64_t created_time = 0;
+  Priority priority = Priority::NORMAL;
+  size_t max_concurrency = kMaxBatchConcurrency;
+
+  // the number of prompts in the batch
+  size_t num_prompts = 0;
+
+  absl::Mutex mu;
+  // the number of prompts scheduled and finished, a prompt is finished once
+  // its result has been sent to the client
+  size_t num_scheduled GUARDED_BY(mu) = 0;
+  size_t num_finished GUARDED_BY(mu) = 0;
+  // stop scheduling once the client is gone
+  bool cancelled GUARDED_BY(mu) = false;
+};
+
+bool on_batch_output(LLMHandler* llm_handler,
+                     const std::shared_ptr<BatchState>& state,
+                     size_t index,
+                     const RequestOutput& req_output);
+
+// schedule the next window of prompts once half of the window has been
+// written to the client, so that a slow client throttles the batch instead of
+// queueing all prompts and results in memory.
+void schedule_next(LLMHandler* llm_handler,
+                   const std::shared_ptr<BatchState>& state) {
+  const size_t num_prompts = state->num_prompts;
+  size_t start = 0;
+  size_t end = 0;
+  {
+    absl::MutexLock lock(&state->mu);
+    const size_t num_inflight = state->num_scheduled - state->num_finished;
+    if (state->cancelled || state->num_scheduled >= num_prompts ||
+        num_inflight > state->max_concurrency / 2) {
+      return;
+    }
+    start = state->num_scheduled;
+    end = std::min(num_prompts, state->num_finished + state->max_concurrency);
+    state->num_scheduled = end;
+  }
+
+  // convert requests lazily, the call data holds the batch until finished
+  const auto& grpc_request = state->call_data->request();
+  std::vector<std::string> prompts;
+  std::vector<SamplingParams> sps;
+  prompts.reserve(end - start);
+  sps.reserve(end - start);
+  for (size_t i = start; i < end; ++i) {
+    const auto& request = grpc_request.requests(static_cast<int>(i));
+    prompts.push_back(request.prompt());
+    sps.push_back(grpc_request_to_sampling_params(request));
+  }
+  llm_handler->schedule_batch_async(
+      std::move(prompts),
+      std::move(sps),
+      state->priority,
+      /*stream=*/false,
+      [llm_handler, state, start](size_t index, const RequestOutput& output) {
+        return on_batch_output(llm_handler, state, start + index, output);
+      },
+      // cancel prompts in flight once the client has gone away
+      state->call_data->cancel_flag());
+}
+
+// called once the result of a prompt is sent to the client or dropped
+void on_batch_output_sent(LLMHandler* llm_handler,
+                          const std::shared_ptr<BatchState>& state,
+                          bool sent) {
+  bool done = false;
+  {
+    absl::MutexLock lock(&state->mu);
+    ++state->num_finished;
+    state->cancelled = state->cancelled || !sent;
+    done = state->num_finished == state->num_scheduled &&
+           (state->cancelled || state->num_scheduled == state->num_prompts);
+  }
+  if (done) {
+    state->call_data->finish();
+  } else {
+    schedule_next(llm_handler, state);
+  }
+}
+
+bool on_batch_output(LLMHandler* llm_handler,
+                     const std::shared_ptr<BatchState>& state,
+                     size_t index,
+                     const RequestOutput& req_output) {
+  proto::BatchCompletionResponse response;
+  response.set_index(static_cast<uint32_t>(index));
+  if (req_output.status.has_value() && !req_output.status.value().ok()) {
+    response.set_error(req_output.status.value().message());
+  } else {
+    *response.mutable_response() = build_response(
+        generate_request_id(), state->created_time, state->model, req_output);
+  }
+  // only queued, the window advances once it is sent from the grpc handler
+  // thread
+  const bool ok = state->call_data->write(
+      std::move(response), [llm_handler, state](bool sent) {
+        on_batch_output_sent(llm_handler, state, sent);
+      });
+  if (!ok) {
+    on_batch_output_sent(llm_handler, state, /*sent=*/false);
+  }
+  return ok;
+}
+
 }  // namespace
 
 CompletionHandler::CompletionHandler(LLMHandler* llm_handler,
@@ -255,4 +397,34 @@ void CompletionHandler::complete_async(CompletionCallData* call_data) {
       });
 }
 
+void CompletionHandler::batch_complete_async(
+    BatchCompletionCallData* call_data) {
+  const auto& grpc_request = call_data->request();
+  // check if model is supported
+  const auto& model = grpc_request.model();
+  if (!models_.contains(model)) {
+    call_data->finish_with_error(grpc::StatusCode::NOT_FOUND,
+                                 "Model not supported");
+    return;
+  }
+  if (grpc_request.requests_size() == 0) {
+    call_data->finish();
+    return;
+  }
+
+  auto state = std::make_shared<BatchState>();
+  state->call_data = call_data;
+  state->model = model;
+  state->created_time = absl::ToUnixSeconds(absl::Now());
+  state->priority = to_priority(grpc_request.priority());
+  if (grpc_request.has_max_concurrency() &&
+      grpc_request.max_concurrency() > 0) {
+    state->max_concurrency = std::min<size_t>(grpc_request.max_concurrency(),
+                                              kMaxBatchConcurrency);
+  }
+  state->num_prompts = grpc_request.requests_size();
+
+  schedule_next(llm_handler_, state);
+}
+
 }  // namespace llm
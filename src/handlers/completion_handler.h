@@ -11,6 +11,10 @@ namespace llm {
 using CompletionCallData =
     StreamCallData<proto::CompletionRequest, proto::CompletionResponse>;
 
+using BatchCompletionCallData =
+    StreamCallData<proto::BatchCompletionRequest,
+                   proto::BatchCompletionResponse>;
+
 // a class to handle completion requests
 class CompletionHandler final {
  public:
@@ -20,6 +24,9 @@ class CompletionHandler final {
   // caller needs to guarantee the lifetime of call_data.
   void complete_async(CompletionCallData* call_data);
 
+  // caller needs to guarantee the lifetime of call_data.
+  void batch_complete_async(BatchCompletionCallData* call_data);
+
  private:
   // llm handler
   LLMHandler* llm_handler_;
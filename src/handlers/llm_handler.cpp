@@ -2,15 +2,19 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <atomic>
 #include <future>
 #include <memory>
+#include <string_view>
 #include <thread>
 #include <utility>
 #include <vector>
 
+#include "common/aho_corasick.h"
 #include "common/metrics.h"
 #include "common/scope_guard.h"
+#include "common/threadpool.h"
 #include "common/timer.h"
 #include "engine/utils.h"
 #include "models/model_args.h"
@@ -18,6 +22,7 @@
 #include "request/output.h"
 #include "request/request.h"
 #include "speculative/speculative_engine.h"
+#include "tokenizer/parallel_encode.h"
 
 DEFINE_COUNTER_FAMILY(request_status_total, "Total number of request status");
 DEFINE_COUNTER_INSTANCE(request_ok, request_status_total, {{"code", "OK"}});
@@ -65,6 +70,15 @@ namespace {
 
 #define CALLBACK_WITH_ERROR(CODE, MSG) callback(Status{CODE, MSG});
 
+// prompts longer than two chunks are encoded in parallel
+constexpr size_t kTokenizationChunkSize = 16 * 1024;
+
+// the number of prompts encoded in a batch by one handling task
+constexpr size_t kTokenizationBatchSize = 256;
+
+// the memory budget for encoded conversation prefixes
+constexpr size_t kChatPrefixCacheBytes = 64 * 1024 * 1024;
+
 void log_request_status(StatusCode code) {
   switch (code) {
     case StatusCode::OK:
@@ -147,6 +161,24 @@ bool verify_params(const SamplingParams& sp, OutputCallback callback) {
     }
   }
 
+  // min_p between [0.0, 1.0]
+  if (sp.min_p < 0.0 || sp.min_p > 1.0) {
+    CALLBACK_WITH_ERROR(StatusCode::INVALID_ARGUMENT,
+                        "min_p must be between 0.0 and 1.0");
+    return false;
+  }
+
+  // logit_bias values between [-100.0, 100.0]
+  if (sp.logit_bias.has_value()) {
+    for (const auto& [token_id, bias] : sp.logit_bias.value()) {
+      if (bias < -100.0 || bias > 100.0) {
+        CALLBACK_WITH_ERROR(StatusCode::INVALID_ARGUMENT,
+                            "logit_bias values must be between -100 and 100");
+        return false;
+      }
+    }
+  }
+
   // presence_penalty between [-2.0, 2.0]
   if (sp.presence_penalty < -2.0 || sp.presence_penalty > 2.0) {
     CALLBACK_WITH_ERROR(StatusCode::INVALID_ARGUMENT,
@@ -170,15 +202,27 @@ LLMHandler::LLMHandler(const Options& options) : options_(options) {
   const auto devices = parse_devices(options.devices().value_or("auto"));
   LOG(INFO) << "Creating engine with devices: " << to_string(devices);
 
-  // create a speculative engine if draft model path is provided
+  // create a speculative engine if draft model path is provided or prompt
+  // lookup decoding is enabled
   const auto draft_model_path = options.draft_model_path().value_or("");
-  if (!draft_model_path.empty()) {
-    const auto draft_devices =
-        parse_devices(options.draft_devices().value_or("auto"));
-    LOG(INFO) << "Using draft devices: " << to_string(draft_devices);
+  const bool prompt_lookup = draft_model_path.empty() &&
+                             options.num_speculative_tokens() > 0 &&
+                             options.prompt_lookup_max_ngram() > 0;
+  if (!draft_model_path.empty() || prompt_lookup) {
     SpeculativeEngine::Options spec_options;
+    if (prompt_lookup) {
+      LOG(INFO) << "Using prompt lookup decoding with max ngram: "
+                << options.prompt_lookup_max_ngram()
+                << ", num branches: " << options.prompt_lookup_num_branches();
+      spec_options.prompt_lookup_max_ngram(options.prompt_lookup_max_ngram())
+          .prompt_lookup_num_branches(options.prompt_lookup_num_branches());
+    } else {
+      const auto draft_devices =
+          parse_devices(options.draft_devices().value_or("auto"));
+      LOG(INFO) << "Using draft devices: " << to_string(draft_devices);
+      spec_options.draft_devices(draft_devices);
+    }
     spec_options.devices(devices)
-        .draft_devices(draft_devices)
         .block_size(options.block_size())
         .max_cache_size(options.max_cache_size())
         .max_memory_utilization(options.max_memory_utilization())
@@ -187,7 +231,9 @@ LLMHandler::LLMHandler(const Options& options) : options_(options) {
         .enable_cuda_graph(options.enable_cuda_graph())
         .cuda_graph_max_seq_len(options.cuda_graph_max_seq_len())
         .cuda_graph_batch_sizes(options.cuda_graph_batch_sizes())
-        .draft_cuda_graph_batch_sizes(options.draft_cuda_graph_batch_sizes());
+        .draft_cuda_graph_batch_sizes(options.draft_cuda_graph_batch_sizes())
+        .num_loading_threads(options.num_loading_threads())
+        .weight_cache_dir(options.weight_cache_dir());
 
     auto spec_engine = std::make_unique<SpeculativeEngine>(spec_options);
     CHECK(spec_engine->init(options.model_path(), draft_model_path));
@@ -201,7 +247,9 @@ LLMHandler::LLMHandler(const Options& options) : options_(options) {
         .enable_prefix_cache(options.enable_prefix_cache())
         .enable_cuda_graph(options.enable_cuda_graph())
         .cuda_graph_max_seq_len(options.cuda_graph_max_seq_len())
-        .cuda_graph_batch_sizes(options.cuda_graph_batch_sizes());
+        .cuda_graph_batch_sizes(options.cuda_graph_batch_sizes())
+        .num_loading_threads(options.num_loading_threads())
+        .weight_cache_dir(options.weight_cache_dir());
 
     auto engine = std::make_unique<LLMEngine>(eng_options);
     CHECK(engine->init(options.model_path()));
@@ -213,7 +261,12 @@ LLMHandler::LLMHandler(const Options& options) : options_(options) {
   ContinuousScheduler::Options scheduler_options;
   scheduler_options.max_tokens_per_batch(options.max_tokens_per_batch())
       .max_seqs_per_batch(options.max_seqs_per_batch())
-      .num_speculative_tokens(options.num_speculative_tokens());
+      .num_speculative_tokens(options.num_speculative_tokens())
+      .enable_adaptive_speculation(options.enable_adaptive_speculation())
+      .num_response_threads(options.num_response_threads())
+      .stream_flush_tokens(options.stream_flush_tokens())
+      .stream_flush_interval_ms(options.stream_flush_interval_ms())
+      .max_pending_stream_outputs(options.max_pending_stream_outputs());
   scheduler_ =
       std::make_unique<ContinuousScheduler>(engine_.get(), scheduler_options);
 
@@ -224,6 +277,8 @@ LLMHandler::LLMHandler(const Options& options) : options_(options) {
     LOG(INFO) << "Using default chat template for model type: "
               << model_args_.model_type();
     chat_template_ = factory();
+    chat_prefix_cache_ =
+        std::make_unique<ChatPrefixCache>(kChatPrefixCacheBytes);
   } else {
     const auto& tokenizer_args = engine_->tokenizer_args();
     if (!tokenizer_args.chat_template().empty()) {
@@ -232,6 +287,11 @@ LLMHandler::LLMHandler(const Options& options) : options_(options) {
     }
   }
 
+  if (options.num_tokenization_threads() > 0) {
+    tokenization_threadpool_ =
+        std::make_unique<ThreadPool>(options.num_tokenization_threads());
+  }
+
   // construct tokenizers and handling threads
   const auto* tokenizer = engine_->tokenizer();
   for (size_t i = 0; i < options.num_handling_threads(); ++i) {
@@ -283,11 +343,13 @@ std::future<bool> LLMHandler::schedule_chat_async(std::vector<Message> messages,
       });
 }
 
-BatchFuture LLMHandler::schedule_batch_async(std::vector<std::string> prompts,
-                                             std::vector<SamplingParams> sps,
-                                             Priority priority,
-                                             bool stream,
-                                             BatchOutputCallback callback) {
+BatchFuture LLMHandler::schedule_batch_async(
+    std::vector<std::string> prompts,
+    std::vector<SamplingParams> sps,
+    Priority priority,
+    bool stream,
+    BatchOutputCallback callback,
+    std::shared_ptr<std::atomic_bool> cancel_flag) {
   CHECK(prompts.size() == sps.size() || sps.size() == 1)
       << "Number of prompts and sampling parameters should be the same";
 
@@ -295,19 +357,36 @@ BatchFuture LLMHandler::schedule_batch_async(std::vector<std::string> prompts,
   scheduler_->inc_pending_requests(num_requests);
   auto futures = std::make_unique<std::vector<std::future<bool>>>();
   futures->reserve(num_requests);
-  for (size_t i = 0; i < num_requests; ++i) {
-    auto future = schedule(std::move(prompts[i]),
-                           // the sampling parameter may be shared
-                           sps.size() == 1 ? sps[0] : std::move(sps[i]),
-                           priority,
-                           stream,
-                           [i, callback](const RequestOutput& output) {
-                             if (output.status.has_value()) {
-                               log_request_status(output.status.value().code());
-                             }
-                             return callback(i, output);
-                           });
-    futures->emplace_back(std::move(future));
+  // split prompts into groups to encode each group in a batch
+  for (size_t start = 0; start < num_requests;
+       start += kTokenizationBatchSize) {
+    const size_t end = std::min(start + kTokenizationBatchSize, num_requests);
+    std::vector<std::string> group_prompts;
+    std::vector<SamplingParams> group_sps;
+    std::vector<OutputCallback> group_callbacks;
+    group_prompts.reserve(end - start);
+    group_sps.reserve(end - start);
+    group_callbacks.reserve(end - start);
+    for (size_t i = start; i < end; ++i) {
+      group_prompts.emplace_back(std::move(prompts[i]));
+      // the sampling parameter may be shared
+      group_sps.emplace_back(sps.size() == 1 ? sps[0] : std::move(sps[i]));
+      group_callbacks.emplace_back([i, callback](const RequestOutput& output) {
+        if (output.status.has_value()) {
+          log_request_status(output.status.value().code());
+        }
+        return callback(i, output);
+      });
+    }
+    auto group_futures = schedule(std::move(group_prompts),
+                                  std::move(group_sps),
+                                  priority,
+                                  stream,
+                                  std::move(group_callbacks),
+                                  cancel_flag);
+    for (auto& future : group_futures) {
+      futures->emplace_back(std::move(future));
+    }
   }
   return {std::move(futures)};
 }
@@ -430,6 +509,84 @@ std::future<bool> LLMHandler::schedule(std::vector<Message> messages,
   return future;
 }
 
+std::vector<std::future<bool>> LLMHandler::schedule(
+    std::vector<std::string> prompts,
+    std::vector<SamplingParams> sps,
+    Priority priority,
+    bool stream,
+    std::vector<OutputCallback> callbacks,
+    std::shared_ptr<std::atomic_bool> cancel_flag) {
+  CHECK_EQ(prompts.size(), sps.size());
+  CHECK_EQ(prompts.size(), callbacks.size());
+  const size_t num_prompts = prompts.size();
+  std::vector<std::promise<bool>> promises(num_prompts);
+  std::vector<std::future<bool>> futures;
+  futures.reserve(num_prompts);
+  for (auto& promise : promises) {
+    futures.emplace_back(promise.get_future());
+  }
+  // add into the queue
+  queue_.push([this,
+               promises = std::move(promises),
+               prompts = std::move(prompts),
+               sps = std::move(sps),
+               priority,
+               stream,
+               callbacks = std::move(callbacks),
+               cancel_flag = std::move(cancel_flag)](size_t tid) mutable {
+    AUTO_COUNTER(completion_handling_latency_seconds);
+
+    // encode all prompts in one batch
+    Timer timer;
+    const std::vector<std::string_view> texts(prompts.begin(), prompts.end());
+    std::vector<std::vector<int32_t>> prompt_tokens;
+    const bool encoded = tokenizers_[tid]->encode_batch(
+        texts, tokenization_threadpool_.get(), &prompt_tokens);
+    COUNTER_ADD(tokenization_latency_seconds, timer.elapsed_seconds());
+
+    for (size_t i = 0; i < prompts.size(); ++i) {
+      // remove the pending request after scheduling
+      SCOPE_GUARD([this] { scheduler_->dec_pending_requests(); });
+
+      auto& callback = callbacks[i];
+      // verify the prompt
+      if (!verify_params(sps[i], callback)) {
+        promises[i].set_value(false);
+        continue;
+      }
+
+      // encode prompts one by one to report errors if the batch failed
+      auto request = encoded ? create_request(tid,
+                                              std::move(prompts[i]),
+                                              std::move(prompt_tokens[i]),
+                                              sps[i],
+                                              priority,
+                                              stream,
+                                              callback)
+                             : create_request(tid,
+                                              std::move(prompts[i]),
+                                              sps[i],
+                                              priority,
+                                              stream,
+                                              callback);
+      if (!request) {
+        promises[i].set_value(false);
+        continue;
+      }
+      request->cancel_flag = cancel_flag;
+
+      if (!scheduler_->schedule(request)) {
+        CALLBACK_WITH_ERROR(StatusCode::RESOURCE_EXHAUSTED,
+                            "No available resources to schedule request");
+        promises[i].set_value(false);
+        continue;
+      }
+      promises[i].set_value(true);
+    }
+  });
+  return futures;
+}
+
 void LLMHandler::handling_loop(size_t tid) {
   while (true) {
     Task task = queue_.pop();
@@ -489,7 +646,11 @@ std::unique_ptr<Request> LLMHandler::create_request(size_t tid,
   // encode the prompt
   Timer timer;
   std::vector<int> prompt_tokens;
-  if (!tokenizers_[tid]->encode(prompt, &prompt_tokens)) {
+  if (!parallel_encode(*tokenizers_[tid],
+                       prompt,
+                       kTokenizationChunkSize,
+                       tokenization_threadpool_.get(),
+                       &prompt_tokens)) {
     LOG(ERROR) << "Failed to encode prompt: " << prompt;
     CALLBACK_WITH_ERROR(StatusCode::INVALID_ARGUMENT,
                         "Failed to encode prompt");
@@ -497,6 +658,28 @@ std::unique_ptr<Request> LLMHandler::create_request(size_t tid,
   }
   COUNTER_ADD(tokenization_latency_seconds, timer.elapsed_seconds());
 
+  return create_request(tid,
+                        std::move(prompt),
+                        std::move(prompt_tokens),
+                        sp,
+                        priority,
+                        stream,
+                        std::move(callback));
+}
+
+std::unique_ptr<Request> LLMHandler::create_request(
+    size_t tid,
+    std::string prompt,
+    std::vector<int32_t> prompt_tokens,
+    const SamplingParams& sp,
+    Priority priority,
+    bool stream,
+    OutputCallback callback) {
+  if (prompt.empty()) {
+    CALLBACK_WITH_ERROR(StatusCode::INVALID_ARGUMENT, "Prompt is empty");
+    return nullptr;
+  }
+
   const int64_t max_context_len = model_args_.max_position_embeddings();
   if (prompt_tokens.size() >= max_context_len) {
     LOG(ERROR) << "Prompt is too long: " << prompt_tokens.size();
@@ -530,6 +713,33 @@ std::unique_ptr<Request> LLMHandler::create_request(size_t tid,
   sampling_param.temperature = sp.temperature;
   sampling_param.top_p = sp.top_p;
   sampling_param.top_k = sp.top_k;
+  sampling_param.min_p = sp.min_p;
+  if (sp.logit_bias.has_value()) {
+    const int64_t vocab_size = model_args_.vocab_size();
+    for (const auto& [token_id, bias] : sp.logit_bias.value()) {
+      if (token_id < 0 || token_id >= vocab_size) {
+        CALLBACK_WITH_ERROR(StatusCode::INVALID_ARGUMENT,
+                            "Invalid token id in logit_bias");
+        LOG(ERROR) << "Invalid token id in logit_bias: " << token_id;
+        return nullptr;
+      }
+      sampling_param.logit_bias.emplace_back(token_id, bias);
+    }
+  }
+  if (sp.bad_words.has_value()) {
+    for (const auto& s : sp.bad_words.value()) {
+      std::vector<int> bad_word_tokens;
+      if (!tokenizers_[tid]->encode(s, &bad_word_tokens)) {
+        CALLBACK_WITH_ERROR(StatusCode::INVALID_ARGUMENT,
+                            "Failed to encode bad word");
+        LOG(ERROR) << "Failed to encode bad word: " << s;
+        return nullptr;
+      }
+      if (!bad_word_tokens.empty()) {
+        sampling_param.bad_words.push_back(std::move(bad_word_tokens));
+      }
+    }
+  }
   sampling_param.logprobs = sp.logprobs;
   sampling_param.top_logprobs = sp.top_logprobs;
   if (best_of > sp.n) {
@@ -556,7 +766,14 @@ std::unique_ptr<Request> LLMHandler::create_request(size_t tid,
     stopping_criteria.stop_token_ids = model_args_.stop_token_ids();
   }
 
-  if (sp.stop.has_value()) {
+  const auto* token_bytes_table = tokenizers_[tid]->token_bytes_table();
+  if (sp.stop.has_value() && token_bytes_table != nullptr) {
+    // match stop strings in decoded text, which also catches stop strings
+    // spanning token boundaries with different tokenizations.
+    stopping_criteria.stop_strings =
+        std::make_shared<const AhoCorasick>(sp.stop.value());
+    stopping_criteria.token_bytes_table = token_bytes_table;
+  } else if (sp.stop.has_value()) {
     for (const auto& s : sp.stop.value()) {
       std::vector<int> stop_tokens;
       if (!tokenizers_[tid]->encode(s, &stop_tokens)) {
@@ -612,8 +829,30 @@ std::unique_ptr<Request> LLMHandler::create_chat_request(
   }
   COUNTER_ADD(chat_template_latency_seconds, timer.elapsed_seconds());
 
-  return create_request(
-      tid, std::move(prompt.value()), sp, priority, stream, callback);
+  if (prompt->empty()) {
+    CALLBACK_WITH_ERROR(StatusCode::INVALID_ARGUMENT, "Prompt is empty");
+    return nullptr;
+  }
+
+  // encode the prompt, reusing ids of the previous turns
+  timer.reset();
+  std::vector<int32_t> prompt_tokens;
+  if (!chat_prefix_cache_->encode(
+          messages, prompt.value(), *tokenizers_[tid], &prompt_tokens)) {
+    LOG(ERROR) << "Failed to encode prompt: " << prompt.value();
+    CALLBACK_WITH_ERROR(StatusCode::INVALID_ARGUMENT,
+                        "Failed to encode prompt");
+    return nullptr;
+  }
+  COUNTER_ADD(tokenization_latency_seconds, timer.elapsed_seconds());
+
+  return create_request(tid,
+                        std::move(prompt.value()),
+                        std::move(prompt_tokens),
+                        sp,
+                        priority,
+                        stream,
+                        callback);
 }
 
 std::optional<std::string> LLMHandler::apply_chat_template(
@@ -653,8 +892,10 @@ void LLMHandler::reset() {
   // release all underlying resources
   scheduler_.reset();
   engine_.reset();
+  tokenization_threadpool_.reset();
   tokenizers_.clear();
   chat_template_.reset();
+  chat_prefix_cache_.reset();
 
   // torch::cuda::empty_cache();
   c10::cuda::CUDACachingAllocator::emptyCache();
@@ -2,6 +2,7 @@
 
 #include <folly/Function.h>
 
+#include <atomic>
 #include <functional>
 #include <future>
 #include <memory>
@@ -9,8 +10,10 @@
 #include <thread>
 #include <vector>
 
+#include "chat_template/chat_prefix_cache.h"
 #include "chat_template/chat_template.h"
 #include "common/concurrent_queue.h"
+#include "common/threadpool.h"
 #include "engine/engine.h"
 #include "request/output.h"
 #include "sampling_params.h"
@@ -97,8 +100,45 @@ class LLMHandler {
     // the number of speculative tokens per step
     DEFINE_ARG(int32_t, num_speculative_tokens) = 0;
 
+    // max n-gram size for prompt lookup decoding, which proposes draft tokens
+    // by matching n-grams in the sequence. only used without a draft model.
+    DEFINE_ARG(int32_t, prompt_lookup_max_ngram) = 0;
+
+    // max number of branches of the draft token tree for prompt lookup
+    // decoding, requires an attention handler with tree mask support.
+    DEFINE_ARG(int32_t, prompt_lookup_num_branches) = 1;
+
+    // adapt the number of speculative tokens for each sequence to its draft
+    // acceptance rate, capped by num_speculative_tokens.
+    DEFINE_ARG(bool, enable_adaptive_speculation) = false;
+
     // the number of threads to use for handling requests
     DEFINE_ARG(size_t, num_handling_threads) = 4;
+
+    // the number of threads to encode chunks of long prompts and batches of
+    // prompts concurrently, 0 to always encode on the handling thread
+    DEFINE_ARG(size_t, num_tokenization_threads) = 4;
+
+    // the number of threads to send responses, outputs of each request are
+    // sent in order by the same thread
+    DEFINE_ARG(int32_t, num_response_threads) = 4;
+
+    // flush streaming outputs every n tokens, 0 to flush by interval only
+    DEFINE_ARG(int32_t, stream_flush_tokens) = 1;
+
+    // flush streaming outputs every n milliseconds, 0 to disable
+    DEFINE_ARG(int32_t, stream_flush_interval_ms) = 0;
+
+    // the max number of queued streaming outputs per request, new tokens of
+    // slow clients are coalesced into later outputs beyond this limit
+    DEFINE_ARG(int32_t, max_pending_stream_outputs) = 8;
+
+    // the number of threads to read weights files ahead while loading
+    DEFINE_ARG(int32_t, num_loading_threads) = 4;
+
+    // the directory to cache prepared weights for faster restarts, empty to
+    // disable
+    DEFINE_ARG(std::string, weight_cache_dir);
   };
 
   LLMHandler(const Options& options);
@@ -122,11 +162,14 @@ class LLMHandler {
                                         OutputCallback callback);
 
   // batch version
-  BatchFuture schedule_batch_async(std::vector<std::string> prompts,
-                                   std::vector<SamplingParams> sp,
-                                   Priority priority,
-                                   bool stream,
-                                   BatchOutputCallback callback);
+  // all scheduled requests are cancelled once the optional cancel_flag is set
+  BatchFuture schedule_batch_async(
+      std::vector<std::string> prompts,
+      std::vector<SamplingParams> sp,
+      Priority priority,
+      bool stream,
+      BatchOutputCallback callback,
+      std::shared_ptr<std::atomic_bool> cancel_flag = nullptr);
 
   BatchFuture schedule_chat_batch_async(
       std::vector<std::vector<Message>> conversations,
@@ -168,6 +211,15 @@ class LLMHandler {
                                           bool stream,
                                           OutputCallback callback);
 
+  // create a request with encoded prompt tokens
+  std::unique_ptr<Request> create_request(size_t tid,
+                                          std::string prompt,
+                                          std::vector<int32_t> prompt_tokens,
+                                          const SamplingParams& sp,
+                                          Priority priority,
+                                          bool stream,
+                                          OutputCallback callback);
+
   std::unique_ptr<Request> create_chat_request(
       size_t tid,
       const std::vector<Message>& messages,
@@ -188,6 +240,15 @@ class LLMHandler {
                              bool stream,
                              OutputCallback callback);
 
+  // schedule a group of prompts in one task to encode them in a batch
+  std::vector<std::future<bool>> schedule(
+      std::vector<std::string> prompts,
+      std::vector<SamplingParams> sps,
+      Priority priority,
+      bool stream,
+      std::vector<OutputCallback> callbacks,
+      std::shared_ptr<std::atomic_bool> cancel_flag);
+
   void handling_loop(size_t tid);
 
   const Options options_;
@@ -209,9 +270,15 @@ class LLMHandler {
   // for now
   std::vector<std::unique_ptr<Tokenizer>> tokenizers_;
 
+  // thread pool for encoding long prompts in chunks and batches of prompts
+  std::unique_ptr<ThreadPool> tokenization_threadpool_;
+
   // chat template instance
   std::unique_ptr<ChatTemplate> chat_template_;
 
+  // encoded conversation prefixes for multi-turn chat
+  std::unique_ptr<ChatPrefixCache> chat_prefix_cache_;
+
   // thread for moving forward the scheduler
   std::thread loop_thread_;
 
@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace llm {
@@ -26,7 +27,10 @@ struct SamplingParams {
                  bool skip_special_tokens,
                  bool ignore_eos,
                  std::optional<std::vector<std::string>> stop,
-                 std::optional<std::vector<int32_t>> stop_token_ids)
+                 std::optional<std::vector<int32_t>> stop_token_ids,
+                 float min_p,
+                 std::optional<std::unordered_map<int32_t, float>> logit_bias,
+                 std::optional<std::vector<std::string>> bad_words)
       : max_tokens(max_tokens),
         n(n),
         best_of(best_of),
@@ -42,7 +46,10 @@ struct SamplingParams {
         skip_special_tokens(skip_special_tokens),
         ignore_eos(ignore_eos),
         stop(stop),
-        stop_token_ids(stop_token_ids) {}
+        stop_token_ids(stop_token_ids),
+        min_p(min_p),
+        logit_bias(logit_bias),
+        bad_words(bad_words) {}
 
   // number of tokens to generate. truncted to model's max context length.
   uint32_t max_tokens = 16;
@@ -95,11 +102,22 @@ struct SamplingParams {
   bool ignore_eos = false;
 
   // the list of strings to stop generating further tokens.
-  // the output will contain the stop string.
+  // the stop string is excluded from the output if the tokenizer supports
+  // text matching, otherwise it is matched as tokens and kept in the output.
   std::optional<std::vector<std::string>> stop;
 
   // the list of token ids to stop generating further tokens.
   std::optional<std::vector<int32_t>> stop_token_ids;
+
+  // min_p sampling cutoff relative to the probability of the most likely
+  // token, between [0.0, 1.0]. default = 0.0 to disable.
+  float min_p = 0.0;
+
+  // map from token id to a bias added to its logit, between [-100, 100].
+  std::optional<std::unordered_map<int32_t, float>> logit_bias;
+
+  // the list of words that are banned from the output.
+  std::optional<std::vector<std::string>> bad_words;
 };
 
 }  // namespace llm
\ No newline at end of file
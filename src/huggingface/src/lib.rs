@@ -426,6 +426,10 @@ pub struct TokenizerWrapper {
     encode_ids: Vec<u32>,
     // Holds the decoded string to avoid dropping it
     decode_str: String,
+    // Holds the encoded ids of the last batch
+    encode_batch_ids: Vec<Vec<u32>>,
+    // Holds the decoded strings of the last batch
+    decode_batch_strs: Vec<String>,
     // Holds the result of the token_to_id function
     id_to_token_result: String,
 }
@@ -446,6 +450,25 @@ impl TokenizerWrapper {
         self.decode_str = self.tokenizer.decode(&ids, skip_special_tokens).unwrap();
     }
 
+    pub fn encode_batch(&mut self, texts: Vec<&str>, add_special_tokens: bool) {
+        // Encode the texts in parallel and store the ids
+        self.encode_batch_ids = self
+            .tokenizer
+            .encode_batch(texts, add_special_tokens)
+            .unwrap()
+            .iter()
+            .map(|encoding| Vec::from(encoding.get_ids()))
+            .collect();
+    }
+
+    pub fn decode_batch(&mut self, ids: &[&[u32]], skip_special_tokens: bool) {
+        // Decode the ids in parallel and store the strings
+        self.decode_batch_strs = self
+            .tokenizer
+            .decode_batch(ids, skip_special_tokens)
+            .unwrap();
+    }
+
     pub fn get_vocab_size(&self, with_added_tokens: bool) -> usize {
         self.tokenizer.get_vocab_size(with_added_tokens)
     }
@@ -463,6 +486,8 @@ extern "C" fn tokenizer_from_file(path: *const c_char) -> *mut TokenizerWrapper
         tokenizer: Tokenizer::from_file(path_str).unwrap().into(),
         encode_ids: Vec::new(),
         decode_str: String::new(),
+        encode_batch_ids: Vec::new(),
+        decode_batch_strs: Vec::new(),
         id_to_token_result: String::new(),
     });
 
@@ -519,6 +544,82 @@ extern "C" fn tokenizer_get_decode_str(
     }
 }
 
+#[no_mangle]
+extern "C" fn tokenizer_encode_batch(
+    handle: *mut TokenizerWrapper,
+    input_cstrs: *const *const u8,
+    input_lens: *const usize,
+    num_texts: usize,
+    add_special_tokens: bool,
+) {
+    unsafe {
+        let cstrs = std::slice::from_raw_parts(input_cstrs, num_texts);
+        let lens = std::slice::from_raw_parts(input_lens, num_texts);
+        let texts = cstrs
+            .iter()
+            .zip(lens.iter())
+            .map(|(&cstr, &len)| {
+                std::str::from_utf8(std::slice::from_raw_parts(cstr, len)).unwrap()
+            })
+            .collect();
+        (*handle).encode_batch(texts, add_special_tokens);
+    }
+}
+
+#[no_mangle]
+extern "C" fn tokenizer_get_encode_batch_ids(
+    handle: *mut TokenizerWrapper,
+    index: usize,
+    out_data: *mut *mut u32,
+    out_len: *mut usize,
+) {
+    unsafe {
+        let ids = &mut (*handle).encode_batch_ids[index];
+        *out_data = ids.as_mut_ptr();
+        *out_len = ids.len();
+    }
+}
+
+#[no_mangle]
+extern "C" fn tokenizer_decode_batch(
+    handle: *mut TokenizerWrapper,
+    input_ids: *const *const u32,
+    input_lens: *const usize,
+    num_seqs: usize,
+    skip_special_tokens: bool,
+) {
+    unsafe {
+        let ids_ptrs = std::slice::from_raw_parts(input_ids, num_seqs);
+        let lens = std::slice::from_raw_parts(input_lens, num_seqs);
+        let ids: Vec<&[u32]> = ids_ptrs
+            .iter()
+            .zip(lens.iter())
+            .map(|(&ptr, &len)| {
+                if len == 0 {
+                    &[][..]
+                } else {
+                    std::slice::from_raw_parts(ptr, len)
+                }
+            })
+            .collect();
+        (*handle).decode_batch(&ids, skip_special_tokens);
+    }
+}
+
+#[no_mangle]
+extern "C" fn tokenizer_get_decode_batch_str(
+    handle: *mut TokenizerWrapper,
+    index: usize,
+    out_cstr: *mut *mut u8,
+    out_len: *mut usize,
+) {
+    unsafe {
+        let str = &mut (*handle).decode_batch_strs[index];
+        *out_cstr = str.as_mut_ptr();
+        *out_len = str.len();
+    }
+}
+
 #[no_mangle]
 extern "C" fn tokenizer_free(wrapper: *mut TokenizerWrapper) {
     unsafe {
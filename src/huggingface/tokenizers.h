@@ -33,6 +33,32 @@ void tokenizer_get_encode_ids(TokenizerHandle handle,
                               const uint32_t** id_data,
                               size_t* len);
 
+// encode texts in parallel, the i-th text has lens[i] bytes
+void tokenizer_encode_batch(TokenizerHandle handle,
+                            const char* const* data,
+                            const size_t* lens,
+                            size_t num_texts,
+                            bool add_special_tokens);
+
+// get ids of the i-th text from the last tokenizer_encode_batch call
+void tokenizer_get_encode_batch_ids(TokenizerHandle handle,
+                                    size_t index,
+                                    const uint32_t** id_data,
+                                    size_t* len);
+
+// decode sequences in parallel, the i-th sequence has lens[i] ids
+void tokenizer_decode_batch(TokenizerHandle handle,
+                            const uint32_t* const* data,
+                            const size_t* lens,
+                            size_t num_seqs,
+                            bool skip_special_tokens);
+
+// get text of the i-th sequence from the last tokenizer_decode_batch call
+void tokenizer_get_decode_batch_str(TokenizerHandle handle,
+                                    size_t index,
+                                    const char** data,
+                                    size_t* len);
+
 void tokenizer_id_to_token(TokenizerHandle handle,
                            uint32_t id,
                            const char** data,
@@ -0,0 +1,112 @@
+#include "activation_kernels.h"
+
+#include <ATen/Dispatch.h>
+#include <ATen/Parallel.h>
+#include <glog/logging.h>
+#include <torch/torch.h>
+
+#include <vector>
+
+#include "vec_utils.h"
+
+namespace llm::kernel::cpu {
+
+namespace {
+using vec_utils::Vec;
+
+struct Silu {
+  // x / (1 + exp(-x))
+  Vec operator()(const Vec& x) const {
+    return x / (Vec(1.0f) + x.neg().exp());
+  }
+};
+
+// gelu_new and gelu_fast are the same tanh approximation
+struct GeluTanh {
+  // 0.5 * x * (1 + tanh(sqrt(2 / pi) * (x + 0.044715 * x^3)))
+  Vec operator()(const Vec& x) const {
+    const Vec inner =
+        Vec(0.7978845608028654f) * x * (Vec(1.0f) + Vec(0.044715f) * x * x);
+    return Vec(0.5f) * x * (Vec(1.0f) + inner.tanh());
+  }
+};
+
+// output[r] = act(input[r, :d]) (* input[r, d:2d] if with_mul)
+template <typename scalar_t, typename Act>
+void activation_rows(const scalar_t* input,
+                     scalar_t* output,
+                     int64_t n_rows,
+                     int64_t d,
+                     bool with_mul,
+                     const Act& act) {
+  const int64_t in_width = with_mul ? 2 * d : d;
+  const int64_t grain = vec_utils::grain_rows(in_width);
+  at::parallel_for(0, n_rows, grain, [&](int64_t begin, int64_t end) {
+    std::vector<float> x(d);
+    std::vector<float> y(with_mul ? d : 0);
+    for (int64_t r = begin; r < end; ++r) {
+      const scalar_t* in = input + r * in_width;
+      vec_utils::load_row(in, d, x.data());
+      if (with_mul) {
+        vec_utils::load_row(in + d, d, y.data());
+        vec_utils::map2_row(x.data(), y.data(), d, [&](Vec a, Vec b) {
+          return act(a) * b;
+        });
+      } else {
+        vec_utils::map_row(x.data(), d, act);
+      }
+      vec_utils::store_row(x.data(), d, output + r * d);
+    }
+  });
+}
+
+template <typename Act>
+torch::Tensor activation(const torch::Tensor& input, bool with_mul) {
+  CHECK(input.device().is_cpu()) << "cpu activation only supports cpu tensors";
+  const int64_t width = input.size(-1);
+  CHECK(!with_mul || width % 2 == 0) << "last dim must be even";
+  const int64_t d = with_mul ? width / 2 : width;
+
+  auto out_shape = input.sizes().vec();
+  out_shape.back() = d;
+  auto output = torch::empty(out_shape, input.options());
+  const auto x = input.contiguous();
+  const int64_t n_rows = width > 0 ? x.numel() / width : 0;
+  AT_DISPATCH_FLOATING_TYPES_AND2(
+      at::kBFloat16, at::kHalf, input.scalar_type(), "activation_cpu", [&] {
+        activation_rows<scalar_t>(x.data_ptr<scalar_t>(),
+                                  output.data_ptr<scalar_t>(),
+                                  n_rows,
+                                  d,
+                                  with_mul,
+                                  Act());
+      });
+  return output;
+}
+}  // namespace
+
+torch::Tensor gelu_new(torch::Tensor input) {
+  return activation<GeluTanh>(input, /*with_mul=*/false);
+}
+
+torch::Tensor gelu_fast(torch::Tensor input) {
+  return activation<GeluTanh>(input, /*with_mul=*/false);
+}
+
+torch::Tensor silu(torch::Tensor input) {
+  return activation<Silu>(input, /*with_mul=*/false);
+}
+
+torch::Tensor gelu_new_with_mul(torch::Tensor input) {
+  return activation<GeluTanh>(input, /*with_mul=*/true);
+}
+
+torch::Tensor gelu_fast_with_mul(torch::Tensor input) {
+  return activation<GeluTanh>(input, /*with_mul=*/true);
+}
+
+torch::Tensor silu_with_mul(torch::Tensor input) {
+  return activation<Silu>(input, /*with_mul=*/true);
+}
+
+}  // namespace llm::kernel::cpu
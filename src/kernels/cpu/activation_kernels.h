@@ -0,0 +1,22 @@
+#pragma once
+
+#include <torch/torch.h>
+
+// cpu kernels for activations, computed in fp32 and rounded once to the
+// input dtype. the *_with_mul variants fuse the gated mlp:
+// act(x[..., :d]) * x[..., d:] for input [..., 2 * d].
+namespace llm::kernel::cpu {
+
+torch::Tensor gelu_new(torch::Tensor input);
+
+torch::Tensor gelu_fast(torch::Tensor input);
+
+torch::Tensor silu(torch::Tensor input);
+
+torch::Tensor gelu_new_with_mul(torch::Tensor input);
+
+torch::Tensor gelu_fast_with_mul(torch::Tensor input);
+
+torch::Tensor silu_with_mul(torch::Tensor input);
+
+}  // namespace llm::kernel::cpu
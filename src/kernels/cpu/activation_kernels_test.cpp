@@ -0,0 +1,84 @@
+#include "activation_kernels.h"
+
+#include <gtest/gtest.h>
+#include <torch/torch.h>
+
+#include <map>
+#include <string>
+
+namespace llm::kernel::cpu {
+
+namespace {
+using ActFunc = torch::Tensor (*)(torch::Tensor);
+
+torch::Tensor gelu_tanh(torch::Tensor x) {
+  namespace F = torch::nn::functional;
+  return F::gelu(x, F::GELUFuncOptions().approximate("tanh"));
+}
+
+torch::Tensor silu_ref(torch::Tensor x) {
+  namespace F = torch::nn::functional;
+  return F::silu(x);
+}
+
+const std::map<std::string, std::pair<ActFunc, ActFunc>> kActivations = {
+    {"gelu_fast", {gelu_fast, gelu_tanh}},
+    {"gelu_new", {gelu_new, gelu_tanh}},
+    {"silu", {silu, silu_ref}},
+};
+
+const std::map<std::string, ActFunc> kFusedActivations = {
+    {"gelu_fast", gelu_fast_with_mul},
+    {"gelu_new", gelu_new_with_mul},
+    {"silu", silu_with_mul},
+};
+}  // namespace
+
+class CPUActivationTest
+    : public ::testing::TestWithParam<std::tuple<torch::ScalarType /*dtype*/,
+                                                 std::string /*activation*/,
+                                                 int64_t /*out_features*/>> {
+};
+
+TEST_P(CPUActivationTest, Activation) {
+  const auto& [dtype, activation, out_features] = GetParam();
+  torch::manual_seed(0);
+  // non-contiguous input
+  const auto input = (torch::randn({20, out_features * 2}) * 4)
+                         .to(dtype)
+                         .chunk(/*chunks=*/2, /*dim=*/1)[1];
+  const auto [kernel, reference] = kActivations.at(activation);
+
+  const auto output = kernel(input);
+  EXPECT_EQ(output.scalar_type(), dtype);
+  EXPECT_EQ(output.sizes(), input.sizes());
+  const auto desired = reference(input.to(torch::kFloat32)).to(dtype);
+  EXPECT_TRUE(torch::allclose(output, desired, /*rtol=*/1e-2, /*atol=*/1e-3));
+}
+
+TEST_P(CPUActivationTest, FusedActivation) {
+  const auto& [dtype, activation, out_features] = GetParam();
+  torch::manual_seed(0);
+  const auto input = (torch::randn({2, 10, out_features * 2}) * 4).to(dtype);
+  const auto reference = kActivations.at(activation).second;
+
+  const auto output = kFusedActivations.at(activation)(input);
+  EXPECT_EQ(output.scalar_type(), dtype);
+  EXPECT_EQ(output.sizes(), torch::IntArrayRef({2, 10, out_features}));
+  const auto chunks =
+      input.to(torch::kFloat32).chunk(/*chunks=*/2, /*dim=*/-1);
+  const auto desired = (reference(chunks[0]) * chunks[1]).to(dtype);
+  EXPECT_TRUE(torch::allclose(output, desired, /*rtol=*/1e-2, /*atol=*/1e-3));
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    CPU,
+    CPUActivationTest,
+    ::testing::Combine(::testing::Values(torch::kFloat32,
+                                         torch::kBFloat16,
+                                         torch::kHalf),
+                       ::testing::Values("gelu_fast", "gelu_new", "silu"),
+                       // with partial vectors
+                       ::testing::Values(256, 1090)));
+
+}  // namespace llm::kernel::cpu
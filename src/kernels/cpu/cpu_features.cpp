@@ -0,0 +1,83 @@
+#include "cpu_features.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace llm::kernel::cpu {
+namespace {
+
+#if defined(__x86_64__) || defined(__i386__)
+inline bool has_bit(uint32_t value, int bit) { return (value >> bit) & 1; }
+
+// read the extended control register with the state enabled by the os
+uint64_t read_xcr0() {
+  uint32_t eax = 0;
+  uint32_t edx = 0;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+
+CPUFeatures detect_features() {
+  CPUFeatures features;
+  uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !has_bit(ecx, 27)) {
+    // no osxsave, avx registers are not usable
+    return features;
+  }
+  const uint64_t xcr0 = read_xcr0();
+  // xmm and ymm states
+  const bool os_avx = (xcr0 & 0x6) == 0x6;
+  // opmask and zmm states
+  const bool os_avx512 = os_avx && (xcr0 & 0xe0) == 0xe0;
+  // tile config and tile data states
+  const bool os_amx = (xcr0 & 0x60000) == 0x60000;
+
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    features.avx2 = os_avx && has_bit(ebx, 5);
+    features.avx512f = os_avx512 && has_bit(ebx, 16);
+    features.avx512_fp16 = os_avx512 && has_bit(edx, 23);
+    features.amx_bf16 = os_amx && has_bit(edx, 22) && has_bit(edx, 24);
+  }
+  if (__get_cpuid_count(7, 1, &eax, &ebx, &ecx, &edx)) {
+    features.avx512_bf16 = os_avx512 && has_bit(eax, 5);
+    features.amx_fp16 = os_amx && has_bit(eax, 21);
+  }
+  return features;
+}
+#else
+CPUFeatures detect_features() { return {}; }
+#endif
+
+}  // namespace
+
+const CPUFeatures& cpu_features() {
+  static const CPUFeatures features = detect_features();
+  return features;
+}
+
+bool has_native_bf16() {
+  const auto& features = cpu_features();
+  return features.amx_bf16 || features.avx512_bf16;
+}
+
+bool has_native_fp16() {
+  const auto& features = cpu_features();
+  return features.amx_fp16 || features.avx512_fp16;
+}
+
+std::ostream& operator<<(std::ostream& os, const CPUFeatures& features) {
+  os << "CPUFeatures: [";
+  os << "avx2: " << features.avx2;
+  os << ", avx512f: " << features.avx512f;
+  os << ", avx512_bf16: " << features.avx512_bf16;
+  os << ", avx512_fp16: " << features.avx512_fp16;
+  os << ", amx_bf16: " << features.amx_bf16;
+  os << ", amx_fp16: " << features.amx_fp16;
+  os << "]";
+  return os;
+}
+
+}  // namespace llm::kernel::cpu
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <ostream>
+
+// runtime detection of cpu instruction sets, used to choose between native
+// bf16/fp16 kernels and fp32 fallbacks.
+namespace llm::kernel::cpu {
+
+struct CPUFeatures {
+  bool avx2 = false;
+  bool avx512f = false;
+  // dot products of bf16 pairs accumulated in fp32
+  bool avx512_bf16 = false;
+  // arithmetics on fp16 vectors
+  bool avx512_fp16 = false;
+  // tile matrix multiplications
+  bool amx_bf16 = false;
+  bool amx_fp16 = false;
+};
+
+// features of the running cpu, detected once. instruction sets whose
+// registers are not enabled by the os are reported as missing.
+const CPUFeatures& cpu_features();
+
+// whether bf16 matmuls run natively with amx or avx512-bf16
+bool has_native_bf16();
+
+// whether fp16 matmuls run natively with amx or avx512-fp16
+bool has_native_fp16();
+
+std::ostream& operator<<(std::ostream& os, const CPUFeatures& features);
+
+}  // namespace llm::kernel::cpu
@@ -0,0 +1,171 @@
+#include "linear_kernels.h"
+
+#include <ATen/Dispatch.h>
+#include <ATen/Parallel.h>
+#include <glog/logging.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+
+#include "cpu_features.h"
+
+namespace llm::kernel::cpu {
+
+namespace {
+// number of output features per tile, small enough to keep the fp32 tile
+// in cache for typical in_features.
+constexpr int64_t kTileRows = 64;
+
+// memory bound, read each packed weight once for all inputs
+template <typename scalar_t>
+void packed_gemv(const float* x,
+                 const scalar_t* packed,
+                 int64_t m,
+                 int64_t k,
+                 int64_t n,
+                 float* out) {
+  constexpr int64_t kPanel = kPackedPanelSize;
+  const int64_t n_panels = n / kPanel;
+  at::parallel_for(0, n_panels, 1, [&](int64_t begin, int64_t end) {
+    float w[kPanel];
+    float acc[kMaxPackedRows][kPanel];
+    for (int64_t p = begin; p < end; ++p) {
+      for (int64_t i = 0; i < m; ++i) {
+        std::fill(acc[i], acc[i] + kPanel, 0.0f);
+      }
+      const scalar_t* panel = packed + p * k * kPanel;
+      for (int64_t kk = 0; kk < k; ++kk) {
+        const scalar_t* row = panel + kk * kPanel;
+        for (int64_t j = 0; j < kPanel; ++j) {
+          w[j] = static_cast<float>(row[j]);
+        }
+        for (int64_t i = 0; i < m; ++i) {
+          const float xv = x[i * k + kk];
+          for (int64_t j = 0; j < kPanel; ++j) {
+            acc[i][j] += xv * w[j];
+          }
+        }
+      }
+      for (int64_t i = 0; i < m; ++i) {
+        std::copy_n(acc[i], kPanel, out + i * n + p * kPanel);
+      }
+    }
+  });
+}
+
+// whether matmuls of the dtype don't run natively, for which aten falls
+// back to slow reference kernels.
+bool needs_upconvert(torch::ScalarType dtype) {
+  switch (dtype) {
+    case torch::kBFloat16:
+      return !has_native_bf16();
+    case torch::kFloat16:
+      return !has_native_fp16();
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+namespace detail {
+torch::Tensor upconvert_linear(const torch::Tensor& input,
+                               const torch::Tensor& weight,
+                               const torch::Tensor& bias) {
+  CHECK_EQ(weight.dim(), 2) << "weight must be 2-D";
+  const int64_t k = weight.size(1);
+  const int64_t n = weight.size(0);
+  CHECK_EQ(input.size(-1), k) << "in_features mismatch";
+
+  const auto x = input.reshape({-1, k}).to(torch::kFloat32).contiguous();
+  const int64_t m = x.size(0);
+  auto out = torch::empty({m, n}, x.options());
+  const int64_t n_tiles = (n + kTileRows - 1) / kTileRows;
+  at::parallel_for(0, n_tiles, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t tile = begin; tile < end; ++tile) {
+      const int64_t j0 = tile * kTileRows;
+      const int64_t count = std::min(kTileRows, n - j0);
+      // [count, k]
+      const auto w = weight.narrow(0, j0, count).to(torch::kFloat32);
+      out.narrow(1, j0, count).copy_(torch::mm(x, w.t()));
+    }
+  });
+  if (bias.defined()) {
+    out.add_(bias.to(torch::kFloat32));
+  }
+
+  auto sizes = input.sizes().vec();
+  sizes.back() = n;
+  return out.to(input.scalar_type()).view(sizes);
+}
+}  // namespace detail
+
+torch::Tensor prepack_linear_weight(const torch::Tensor& weight) {
+  CHECK_EQ(weight.dim(), 2) << "weight must be 2-D";
+  const int64_t n = weight.size(0);
+  const int64_t k = weight.size(1);
+  CHECK_EQ(n % kPackedPanelSize, 0)
+      << "out_features must be a multiple of " << kPackedPanelSize;
+  return weight.view({n / kPackedPanelSize, kPackedPanelSize, k})
+      .transpose(1, 2)
+      .contiguous();
+}
+
+torch::Tensor linear(const torch::Tensor& input,
+                     const torch::Tensor& weight,
+                     const torch::Tensor& bias) {
+  CHECK(input.device().is_cpu()) << "cpu linear only supports cpu tensors";
+  // aten dispatches bf16 and fp16 matmuls to onednn, which picks amx or
+  // avx512 kernels at runtime and accumulates in fp32.
+  if (needs_upconvert(weight.scalar_type())) {
+    return detail::upconvert_linear(input, weight, bias);
+  }
+  namespace F = torch::nn::functional;
+  return F::linear(input, weight, bias);
+}
+
+torch::Tensor packed_linear(const torch::Tensor& input,
+                            const torch::Tensor& weight,
+                            const torch::Tensor& packed_weight,
+                            const torch::Tensor& bias) {
+  CHECK(input.device().is_cpu() && packed_weight.device().is_cpu())
+      << "cpu linear only supports cpu tensors";
+  CHECK(packed_weight.dim() == 3 &&
+        packed_weight.size(2) == kPackedPanelSize &&
+        packed_weight.is_contiguous())
+      << "weight is not prepacked: " << packed_weight.sizes();
+  const int64_t k = packed_weight.size(1);
+  const int64_t n = packed_weight.size(0) * kPackedPanelSize;
+  CHECK_EQ(input.size(-1), k) << "in_features mismatch";
+
+  auto x = input.reshape({-1, k});
+  const int64_t m = x.size(0);
+  if (m > kMaxPackedRows) {
+    // compute bound, blas reads the row-major weight directly
+    return linear(input, weight, bias);
+  }
+
+  x = x.to(torch::kFloat32).contiguous();
+  auto out = torch::empty({m, n}, x.options());
+  AT_DISPATCH_FLOATING_TYPES_AND2(
+      torch::kBFloat16,
+      torch::kHalf,
+      packed_weight.scalar_type(),
+      "packed_gemv",
+      [&] {
+        packed_gemv<scalar_t>(x.data_ptr<float>(),
+                              packed_weight.data_ptr<scalar_t>(),
+                              m,
+                              k,
+                              n,
+                              out.data_ptr<float>());
+      });
+  if (bias.defined()) {
+    out.add_(bias.to(torch::kFloat32));
+  }
+
+  auto sizes = input.sizes().vec();
+  sizes.back() = n;
+  return out.to(input.scalar_type()).view(sizes);
+}
+
+}  // namespace llm::kernel::cpu
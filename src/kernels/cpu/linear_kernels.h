@@ -0,0 +1,52 @@
+#pragma once
+
+#include <torch/torch.h>
+
+// cpu kernels for linear layers with fp32, bf16 or fp16 weights. products
+// are always accumulated in fp32.
+namespace llm::kernel::cpu {
+
+// y = x * w^T + b
+// input: [..., in_features]
+// weight: [out_features, in_features]
+// bias: [out_features], optional
+// returns: [..., out_features] of input dtype
+torch::Tensor linear(const torch::Tensor& input,
+                     const torch::Tensor& weight,
+                     const torch::Tensor& bias);
+
+// number of output features per panel of prepacked weights
+constexpr int64_t kPackedPanelSize = 16;
+
+// max number of input rows computed from prepacked weights, larger inputs
+// are compute bound and multiply row-major weights with blas.
+constexpr int64_t kMaxPackedRows = 16;
+
+// prepack weights once into panels of output features, so that the values
+// of a panel for each input feature are contiguous and read sequentially.
+// weight: [out_features, in_features], out_features % kPackedPanelSize == 0
+// returns: [out_features / kPackedPanelSize, in_features, kPackedPanelSize]
+torch::Tensor prepack_linear_weight(const torch::Tensor& weight);
+
+// y = x * w^T + b, reading weights prepacked by prepack_linear_weight for
+// up to kMaxPackedRows input rows and row-major weights otherwise.
+// input: [..., in_features]
+// weight: [out_features, in_features]
+// packed_weight: [n_panels, in_features, kPackedPanelSize]
+// bias: [out_features], optional
+// returns: [..., out_features] of input dtype
+torch::Tensor packed_linear(const torch::Tensor& input,
+                            const torch::Tensor& weight,
+                            const torch::Tensor& packed_weight,
+                            const torch::Tensor& bias);
+
+namespace detail {
+// fallback for bf16 and fp16 without native instructions: tiles of weights
+// are converted to fp32 on the fly and multiplied with fp32 blas, so that
+// weights are kept in half precision without being materialized in fp32.
+torch::Tensor upconvert_linear(const torch::Tensor& input,
+                               const torch::Tensor& weight,
+                               const torch::Tensor& bias);
+}  // namespace detail
+
+}  // namespace llm::kernel::cpu
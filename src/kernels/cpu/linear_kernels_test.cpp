@@ -0,0 +1,97 @@
+#include "linear_kernels.h"
+
+#include <gtest/gtest.h>
+#include <torch/torch.h>
+
+#include "cpu_features.h"
+
+namespace llm::kernel::cpu {
+
+class CPULinearTest
+    : public ::testing::TestWithParam<torch::ScalarType /*dtype*/> {};
+
+TEST_P(CPULinearTest, UpconvertMatchesFloatLinear) {
+  const auto dtype = GetParam();
+  torch::manual_seed(0);
+  // partial tile of output features
+  const auto input = torch::randn({2, 3, 96}).to(dtype);
+  const auto weight = torch::randn({100, 96}).to(dtype);
+  const auto bias = torch::randn({100}).to(dtype);
+
+  const auto output = detail::upconvert_linear(input, weight, bias);
+  EXPECT_EQ(output.scalar_type(), dtype);
+  EXPECT_EQ(output.sizes(), torch::IntArrayRef({2, 3, 100}));
+  namespace F = torch::nn::functional;
+  const auto desired = F::linear(input.to(torch::kFloat32),
+                                 weight.to(torch::kFloat32),
+                                 bias.to(torch::kFloat32));
+  // only rounded once to the output dtype
+  EXPECT_TRUE(torch::allclose(output.to(torch::kFloat32),
+                              desired.to(dtype).to(torch::kFloat32),
+                              /*rtol=*/1e-2,
+                              /*atol=*/1e-2));
+
+  // both native and fallback paths accumulate in fp32
+  const auto linear_output = linear(input, weight, bias);
+  EXPECT_EQ(linear_output.scalar_type(), dtype);
+  EXPECT_TRUE(torch::allclose(linear_output.to(torch::kFloat32),
+                              desired,
+                              /*rtol=*/5e-2,
+                              /*atol=*/5e-2));
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    CPU,
+    CPULinearTest,
+    ::testing::Values(torch::kFloat32, torch::kBFloat16, torch::kFloat16));
+
+// (dtype, m)
+class PackedLinearTest
+    : public ::testing::TestWithParam<std::tuple<torch::ScalarType, int64_t>> {
+};
+
+TEST_P(PackedLinearTest, MatchesLinear) {
+  const auto [dtype, m] = GetParam();
+  torch::manual_seed(0);
+  // 5 panels
+  const int64_t k = 72;
+  const int64_t n = 5 * kPackedPanelSize;
+  const auto input = torch::randn({m, k}).to(dtype);
+  const auto weight = torch::randn({n, k}).to(dtype);
+  const auto bias = torch::randn({n}).to(dtype);
+
+  const auto packed_weight = prepack_linear_weight(weight);
+  EXPECT_EQ(packed_weight.sizes(),
+            torch::IntArrayRef({5, k, kPackedPanelSize}));
+  const auto output = packed_linear(input, weight, packed_weight, bias);
+  EXPECT_EQ(output.scalar_type(), dtype);
+  EXPECT_EQ(output.sizes(), torch::IntArrayRef({m, n}));
+  namespace F = torch::nn::functional;
+  const auto desired = F::linear(input.to(torch::kFloat32),
+                                 weight.to(torch::kFloat32),
+                                 bias.to(torch::kFloat32));
+  EXPECT_TRUE(torch::allclose(output.to(torch::kFloat32),
+                              desired,
+                              /*rtol=*/5e-2,
+                              /*atol=*/5e-2));
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    CPU,
+    PackedLinearTest,
+    ::testing::Combine(::testing::Values(torch::kFloat32,
+                                         torch::kBFloat16,
+                                         torch::kFloat16),
+                       // packed and row-major paths
+                       ::testing::Values(1, 7, 16, 40)));
+
+TEST(CPUFeaturesTest, NativeImpliesFeatures) {
+  const auto& features = cpu_features();
+  EXPECT_EQ(has_native_bf16(), features.amx_bf16 || features.avx512_bf16);
+  EXPECT_EQ(has_native_fp16(), features.amx_fp16 || features.avx512_fp16);
+  // avx512 bf16 and fp16 extensions require avx512 foundation
+  EXPECT_TRUE(!features.avx512_bf16 || features.avx512f);
+  EXPECT_TRUE(!features.avx512_fp16 || features.avx512f);
+}
+
+}  // namespace llm::kernel::cpu
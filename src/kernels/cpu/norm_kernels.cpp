@@ -0,0 +1,124 @@
+#include "norm_kernels.h"
+
+#include <ATen/Dispatch.h>
+#include <ATen/Parallel.h>
+#include <glog/logging.h>
+#include <torch/torch.h>
+
+#include <cmath>
+#include <vector>
+
+#include "vec_utils.h"
+
+namespace llm::kernel::cpu {
+
+namespace {
+using vec_utils::Vec;
+
+enum class NormType { kLlama, kGemma };
+
+template <typename scalar_t>
+void rms_norm_rows(scalar_t* out,
+                   scalar_t* residual,
+                   const scalar_t* input,
+                   const scalar_t* weight,
+                   int64_t n_rows,
+                   int64_t dim,
+                   float eps,
+                   NormType type) {
+  const int64_t grain = vec_utils::grain_rows(dim);
+  at::parallel_for(0, n_rows, grain, [&](int64_t begin, int64_t end) {
+    std::vector<float> x(dim);
+    std::vector<float> w(dim);
+    vec_utils::load_row(weight, dim, w.data());
+    if (type == NormType::kGemma) {
+      vec_utils::map_row(w.data(), dim, [](Vec v) { return v + Vec(1.0f); });
+    }
+    for (int64_t r = begin; r < end; ++r) {
+      vec_utils::load_row(input + r * dim, dim, x.data());
+      if (residual != nullptr) {
+        // accumulate the residual in fp32 and write it back in place
+        scalar_t* res = residual + r * dim;
+        for (int64_t i = 0; i < dim; ++i) {
+          x[i] += static_cast<float>(res[i]);
+          res[i] = static_cast<scalar_t>(x[i]);
+        }
+      }
+      const float mean = vec_utils::sum_of_squares(x.data(), dim) / dim;
+      const Vec scale(1.0f / std::sqrt(mean + eps));
+      vec_utils::map_row(x.data(), dim, [&](Vec v) { return v * scale; });
+
+      scalar_t* o = out + r * dim;
+      if (type == NormType::kGemma) {
+        // (x * (1 + w)).to(dtype)
+        vec_utils::map2_row(
+            x.data(), w.data(), dim, [](Vec a, Vec b) { return a * b; });
+        vec_utils::store_row(x.data(), dim, o);
+      } else {
+        // x.to(dtype) * w, rounded twice like the reference
+        for (int64_t i = 0; i < dim; ++i) {
+          const float normed = static_cast<float>(static_cast<scalar_t>(x[i]));
+          o[i] = static_cast<scalar_t>(normed * w[i]);
+        }
+      }
+    }
+  });
+}
+
+void rms_norm_impl(torch::Tensor& out,
+                   torch::Tensor* residual,
+                   const torch::Tensor& input,
+                   const torch::Tensor& weight,
+                   float eps,
+                   NormType type) {
+  CHECK(input.device().is_cpu()) << "cpu rms norm only supports cpu tensors";
+  const int64_t dim = input.size(-1);
+  CHECK_EQ(weight.numel(), dim) << "weight size mismatch";
+  CHECK(out.is_contiguous()) << "out must be contiguous";
+  CHECK_EQ(out.numel(), input.numel()) << "out size mismatch";
+  if (residual != nullptr) {
+    CHECK(residual->is_contiguous()) << "residual must be contiguous";
+    CHECK_EQ(residual->numel(), input.numel()) << "residual size mismatch";
+  }
+
+  const auto x = input.contiguous();
+  const auto w = weight.to(input.scalar_type()).contiguous();
+  const int64_t n_rows = dim > 0 ? input.numel() / dim : 0;
+  AT_DISPATCH_FLOATING_TYPES_AND2(
+      at::kBFloat16, at::kHalf, input.scalar_type(), "rms_norm_cpu", [&] {
+        rms_norm_rows<scalar_t>(
+            out.data_ptr<scalar_t>(),
+            residual != nullptr ? residual->data_ptr<scalar_t>() : nullptr,
+            x.data_ptr<scalar_t>(),
+            w.data_ptr<scalar_t>(),
+            n_rows,
+            dim,
+            eps,
+            type);
+      });
+}
+}  // namespace
+
+void rms_norm(torch::Tensor& out,
+              const torch::Tensor& input,
+              const torch::Tensor& weight,
+              float eps) {
+  rms_norm_impl(out, nullptr, input, weight, eps, NormType::kLlama);
+}
+
+void gemma_rms_norm(torch::Tensor& out,
+                    const torch::Tensor& input,
+                    const torch::Tensor& weight,
+                    float eps) {
+  rms_norm_impl(out, nullptr, input, weight, eps, NormType::kGemma);
+}
+
+void rms_norm_residual(torch::Tensor& out,
+                       torch::Tensor& residual,
+                       const torch::Tensor& input,
+                       const torch::Tensor& weight,
+                       float eps) {
+  rms_norm_impl(out, &residual, input, weight, eps, NormType::kLlama);
+}
+
+}  // namespace llm::kernel::cpu
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <torch/torch.h>
+
+// cpu kernels for rms normalization. each row is normalized in fp32 by one
+// thread, in a single pass over the row.
+namespace llm::kernel::cpu {
+
+// out = (x / rms(x)).to(dtype) * w
+// out: [..., dim], contiguous
+// input: [..., dim]
+// weight: [dim]
+void rms_norm(torch::Tensor& out,
+              const torch::Tensor& input,
+              const torch::Tensor& weight,
+              float eps);
+
+// out = (x / rms(x) * (1 + w)).to(dtype)
+void gemma_rms_norm(torch::Tensor& out,
+                    const torch::Tensor& input,
+                    const torch::Tensor& weight,
+                    float eps);
+
+// fused residual add and rms norm:
+// residual = input + residual, out = rms_norm(residual)
+// residual: [..., dim], contiguous, updated in place
+void rms_norm_residual(torch::Tensor& out,
+                       torch::Tensor& residual,
+                       const torch::Tensor& input,
+                       const torch::Tensor& weight,
+                       float eps);
+
+}  // namespace llm::kernel::cpu
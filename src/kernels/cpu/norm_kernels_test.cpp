@@ -0,0 +1,67 @@
+#include "norm_kernels.h"
+
+#include <gtest/gtest.h>
+#include <torch/torch.h>
+
+namespace llm::kernel::cpu {
+
+namespace {
+torch::Tensor norm(const torch::Tensor& x, float eps) {
+  const auto mean = x.pow(/*exponent=*/2).mean(/*dim=*/-1, /*keepdim=*/true);
+  return x * torch::rsqrt(mean + eps);
+}
+}  // namespace
+
+class CPUNormTest
+    : public ::testing::TestWithParam<std::tuple<torch::ScalarType /*dtype*/,
+                                                 int64_t /*dim*/>> {};
+
+TEST_P(CPUNormTest, RMSNorm) {
+  const auto [dtype, dim] = GetParam();
+  torch::manual_seed(0);
+  const float eps = 1e-5;
+  const auto weight = torch::rand({dim}).to(dtype);
+  const auto input = torch::randn({3, 5, dim}).to(dtype);
+
+  auto output = torch::empty_like(input);
+  rms_norm(output, input, weight, eps);
+  const auto desired =
+      norm(input.to(torch::kFloat32), eps).to(dtype) * weight;
+  EXPECT_TRUE(torch::allclose(output, desired, /*rtol=*/1e-2, /*atol=*/1e-3));
+
+  auto gemma_output = torch::empty_like(input);
+  gemma_rms_norm(gemma_output, input, weight, eps);
+  const auto gemma_desired = (norm(input.to(torch::kFloat32), eps) *
+                              (1.0 + weight.to(torch::kFloat32)))
+                                 .to(dtype);
+  EXPECT_TRUE(torch::allclose(
+      gemma_output, gemma_desired, /*rtol=*/1e-2, /*atol=*/1e-3));
+}
+
+TEST_P(CPUNormTest, RMSNormResidual) {
+  const auto [dtype, dim] = GetParam();
+  torch::manual_seed(0);
+  const float eps = 1e-5;
+  const auto weight = torch::rand({dim}).to(dtype);
+  const auto input = torch::randn({7, dim}).to(dtype);
+  auto residual = torch::randn({7, dim}).to(dtype);
+  const auto sum = input.to(torch::kFloat32) + residual.to(torch::kFloat32);
+
+  auto output = torch::empty_like(input);
+  rms_norm_residual(output, residual, input, weight, eps);
+  const auto desired = norm(sum, eps).to(dtype) * weight;
+  EXPECT_TRUE(torch::allclose(output, desired, /*rtol=*/1e-2, /*atol=*/1e-3));
+  // residual is updated in place
+  EXPECT_TRUE(torch::equal(residual, sum.to(dtype)));
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    CPU,
+    CPUNormTest,
+    ::testing::Combine(::testing::Values(torch::kFloat32,
+                                         torch::kBFloat16,
+                                         torch::kHalf),
+                       // with partial vectors
+                       ::testing::Values(64, 1038)));
+
+}  // namespace llm::kernel::cpu
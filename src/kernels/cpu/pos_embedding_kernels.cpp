@@ -0,0 +1,134 @@
+#include "pos_embedding_kernels.h"
+
+#include <ATen/Dispatch.h>
+#include <ATen/Parallel.h>
+#include <glog/logging.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "vec_utils.h"
+
+namespace llm::kernel::cpu {
+
+namespace {
+using vec_utils::Vec;
+
+// [x1, x2] => [x1 * cos - x2 * sin, x2 * cos + x1 * sin]
+void rotate_half(float* x, const float* cos, const float* sin, int64_t half) {
+  float* x2_ptr = x + half;
+  for (int64_t i = 0; i < half; i += Vec::size()) {
+    const int64_t count = std::min<int64_t>(Vec::size(), half - i);
+    const auto x1 = Vec::loadu(x + i, count);
+    const auto x2 = Vec::loadu(x2_ptr + i, count);
+    const auto c = Vec::loadu(cos + i, count);
+    const auto s = Vec::loadu(sin + i, count);
+    (x1 * c - x2 * s).store(x + i, count);
+    (x2 * c + x1 * s).store(x2_ptr + i, count);
+  }
+}
+
+// [x0, x1, ...] => [x0 * cos - x1 * sin, x1 * cos + x0 * sin, ...]
+void rotate_every_two(float* x,
+                      const float* cos,
+                      const float* sin,
+                      int64_t half) {
+  for (int64_t i = 0; i < half; ++i) {
+    const float x0 = x[2 * i];
+    const float x1 = x[2 * i + 1];
+    x[2 * i] = x0 * cos[i] - x1 * sin[i];
+    x[2 * i + 1] = x1 * cos[i] + x0 * sin[i];
+  }
+}
+
+// rotate the first rotary_dim values of each head of the token in place
+template <typename scalar_t>
+void rotate_heads(scalar_t* data,
+                  int64_t n_heads,
+                  int64_t head_stride,
+                  const float* cos,
+                  const float* sin,
+                  int64_t rotary_dim,
+                  bool interleaved,
+                  float* buffer) {
+  const int64_t half = rotary_dim / 2;
+  for (int64_t h = 0; h < n_heads; ++h) {
+    scalar_t* head = data + h * head_stride;
+    vec_utils::load_row(head, rotary_dim, buffer);
+    if (interleaved) {
+      rotate_every_two(buffer, cos, sin, half);
+    } else {
+      rotate_half(buffer, cos, sin, half);
+    }
+    vec_utils::store_row(buffer, rotary_dim, head);
+  }
+}
+}  // namespace
+
+void apply_rotary_pos_emb(torch::Tensor& query,
+                          torch::Tensor& key,
+                          const torch::Tensor& positions,
+                          const torch::Tensor& cos_sin,
+                          int rotary_dim,
+                          bool interleaved) {
+  CHECK(query.device().is_cpu() && key.device().is_cpu())
+      << "cpu rotary embedding only supports cpu tensors";
+  CHECK_EQ(query.dim(), 3) << "query must be 3-D";
+  CHECK_EQ(key.dim(), 3) << "key must be 3-D";
+  CHECK(query.stride(-1) == 1 && key.stride(-1) == 1)
+      << "head_dim of query and key must be contiguous";
+  CHECK_EQ(query.scalar_type(), key.scalar_type());
+  CHECK_EQ(rotary_dim % 2, 0) << "rotary_dim must be even";
+  CHECK_LE(rotary_dim, query.size(-1));
+  CHECK_EQ(cos_sin.size(-1), rotary_dim) << "cos_sin size mismatch";
+
+  const int64_t n_tokens = query.size(0);
+  const int64_t n_heads = query.size(1);
+  const int64_t n_kv_heads = key.size(1);
+  const int64_t q_token_stride = query.stride(0);
+  const int64_t q_head_stride = query.stride(1);
+  const int64_t k_token_stride = key.stride(0);
+  const int64_t k_head_stride = key.stride(1);
+  const auto pos = positions.to(torch::kInt64).contiguous();
+  const auto cache = cos_sin.to(torch::kFloat32).contiguous();
+  const int64_t max_positions = cache.size(0);
+  const int64_t* pos_ptr = pos.data_ptr<int64_t>();
+  const float* cache_ptr = cache.data_ptr<float>();
+
+  const int64_t grain =
+      vec_utils::grain_rows((n_heads + n_kv_heads) * rotary_dim);
+  AT_DISPATCH_FLOATING_TYPES_AND2(
+      at::kBFloat16, at::kHalf, query.scalar_type(), "rotary_cpu", [&] {
+        scalar_t* q_ptr = query.data_ptr<scalar_t>();
+        scalar_t* k_ptr = key.data_ptr<scalar_t>();
+        at::parallel_for(0, n_tokens, grain, [&](int64_t begin, int64_t end) {
+          std::vector<float> buffer(rotary_dim);
+          for (int64_t t = begin; t < end; ++t) {
+            const int64_t p = pos_ptr[t];
+            DCHECK(p >= 0 && p < max_positions) << "position out of range";
+            // cos and sin of the position
+            const float* cos = cache_ptr + p * rotary_dim;
+            const float* sin = cos + rotary_dim / 2;
+            rotate_heads(q_ptr + t * q_token_stride,
+                         n_heads,
+                         q_head_stride,
+                         cos,
+                         sin,
+                         rotary_dim,
+                         interleaved,
+                         buffer.data());
+            rotate_heads(k_ptr + t * k_token_stride,
+                         n_kv_heads,
+                         k_head_stride,
+                         cos,
+                         sin,
+                         rotary_dim,
+                         interleaved,
+                         buffer.data());
+          }
+        });
+      });
+}
+
+}  // namespace llm::kernel::cpu
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <torch/torch.h>
+
+namespace llm::kernel::cpu {
+
+// apply rotary embedding to query and key inplace, rotations are computed
+// in fp32 with the cached cos and sin of each position.
+void apply_rotary_pos_emb(
+    torch::Tensor& query,            // [n_tokens, n_heads, head_dim]
+    torch::Tensor& key,              // [n_tokens, n_kv_heads, head_dim]
+    const torch::Tensor& positions,  // [n_tokens]
+    const torch::Tensor& cos_sin,    // [max_positions, 2, rotary_dim/2] fp32
+    int rotary_dim,
+    bool interleaved);
+
+}  // namespace llm::kernel::cpu
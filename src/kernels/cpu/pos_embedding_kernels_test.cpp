@@ -0,0 +1,105 @@
+#include "pos_embedding_kernels.h"
+
+#include <gtest/gtest.h>
+#include <torch/torch.h>
+
+namespace llm::kernel::cpu {
+
+namespace {
+using torch::indexing::None;
+using ISlice = torch::indexing::Slice;
+
+// rotate x in fp32 with cos and sin of [n_tokens, 1, rotary_dim / 2]
+torch::Tensor rotate(const torch::Tensor& x,
+                     const torch::Tensor& cos,
+                     const torch::Tensor& sin,
+                     int64_t rotary_dim,
+                     bool interleaved) {
+  const auto rotary = x.index({"...", ISlice(0, rotary_dim)});
+  const auto pass = x.index({"...", ISlice(rotary_dim, None)});
+  torch::Tensor x1, x2;
+  if (interleaved) {
+    x1 = rotary.index({"...", ISlice(0, None, 2)});
+    x2 = rotary.index({"...", ISlice(1, None, 2)});
+  } else {
+    const auto chunks = rotary.chunk(/*chunks=*/2, /*dim=*/-1);
+    x1 = chunks[0];
+    x2 = chunks[1];
+  }
+  const auto o1 = x1 * cos - x2 * sin;
+  const auto o2 = x2 * cos + x1 * sin;
+  const auto rotated = interleaved
+                           ? torch::stack({o1, o2}, /*dim=*/-1).flatten(-2)
+                           : torch::cat({o1, o2}, /*dim=*/-1);
+  return torch::cat({rotated, pass}, /*dim=*/-1);
+}
+}  // namespace
+
+class CPURotaryTest
+    : public ::testing::TestWithParam<std::tuple<torch::ScalarType /*dtype*/,
+                                                 int64_t /*rotary_dim*/,
+                                                 bool /*interleaved*/>> {};
+
+TEST_P(CPURotaryTest, MatchesReference) {
+  const auto [dtype, rotary_dim, interleaved] = GetParam();
+  torch::manual_seed(0);
+  const int64_t n_tokens = 5;
+  const int64_t n_heads = 8;
+  const int64_t n_kv_heads = 2;
+  const int64_t head_dim = 128;
+  const int64_t max_positions = 1024;
+
+  const auto inv_freq =
+      1.0 / torch::pow(10000.0,
+                       torch::arange(0, rotary_dim, 2, torch::kFloat32) /
+                           rotary_dim);
+  const auto freqs = torch::outer(
+      torch::arange(0, max_positions, 1, torch::kFloat32), inv_freq);
+  const auto cos_sin = torch::cat({freqs.cos(), freqs.sin()}, /*dim=*/-1);
+  const auto positions =
+      torch::randint(0, max_positions, {n_tokens}, torch::kInt);
+
+  // query and key are views of a fused qkv tensor
+  const auto qkv = torch::randn(
+      {n_tokens, (n_heads + 2 * n_kv_heads) * head_dim}).to(dtype);
+  auto query = qkv.index({ISlice(), ISlice(0, n_heads * head_dim)})
+                   .view({n_tokens, n_heads, head_dim});
+  auto key = qkv.index({ISlice(),
+                        ISlice(n_heads * head_dim,
+                               (n_heads + n_kv_heads) * head_dim)})
+                 .view({n_tokens, n_kv_heads, head_dim});
+
+  // [n_tokens, 1, rotary_dim / 2]
+  const auto pos_freqs =
+      freqs.index({positions.to(torch::kLong)}).unsqueeze(1);
+  const auto cos = pos_freqs.cos();
+  const auto sin = pos_freqs.sin();
+  const auto query_ref =
+      rotate(query.to(torch::kFloat32), cos, sin, rotary_dim, interleaved)
+          .to(dtype);
+  const auto key_ref =
+      rotate(key.to(torch::kFloat32), cos, sin, rotary_dim, interleaved)
+          .to(dtype);
+  const auto value = qkv.index(
+      {ISlice(), ISlice((n_heads + n_kv_heads) * head_dim, None)}).clone();
+
+  apply_rotary_pos_emb(
+      query, key, positions, cos_sin, rotary_dim, interleaved);
+  EXPECT_TRUE(torch::allclose(query, query_ref, /*rtol=*/1e-2, /*atol=*/1e-2));
+  EXPECT_TRUE(torch::allclose(key, key_ref, /*rtol=*/1e-2, /*atol=*/1e-2));
+  // rotated in place without touching values
+  EXPECT_TRUE(torch::equal(
+      qkv.index({ISlice(), ISlice((n_heads + n_kv_heads) * head_dim, None)}),
+      value));
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    CPU,
+    CPURotaryTest,
+    ::testing::Combine(::testing::Values(torch::kFloat32,
+                                         torch::kBFloat16,
+                                         torch::kHalf),
+                       ::testing::Values(128, 40),  // rotary_dim
+                       ::testing::Values(false, true)));
+
+}  // namespace llm::kernel::cpu
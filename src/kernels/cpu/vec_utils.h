@@ -0,0 +1,81 @@
+#pragma once
+
+#include <ATen/Parallel.h>
+#include <ATen/cpu/vec/vec.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// helpers shared by cpu kernels working on rows converted to fp32.
+// at::vec maps to the widest simd the translation unit is compiled for.
+namespace llm::kernel::cpu::vec_utils {
+
+using Vec = at::vec::Vectorized<float>;
+
+// number of rows of the given width per parallel task
+inline int64_t grain_rows(int64_t width) {
+  const int64_t grain = at::internal::GRAIN_SIZE / std::max<int64_t>(width, 1);
+  return std::max<int64_t>(grain, 1);
+}
+
+template <typename scalar_t>
+inline void load_row(const scalar_t* src, int64_t n, float* dst) {
+  for (int64_t i = 0; i < n; ++i) {
+    dst[i] = static_cast<float>(src[i]);
+  }
+}
+
+template <typename scalar_t>
+inline void store_row(const float* src, int64_t n, scalar_t* dst) {
+  for (int64_t i = 0; i < n; ++i) {
+    dst[i] = static_cast<scalar_t>(src[i]);
+  }
+}
+
+// apply op on vectors of x in place, the tail is handled with partial loads
+template <typename Op>
+inline void map_row(float* x, int64_t n, const Op& op) {
+  int64_t i = 0;
+  for (; i + Vec::size() <= n; i += Vec::size()) {
+    op(Vec::loadu(x + i)).store(x + i);
+  }
+  if (i < n) {
+    const int64_t count = n - i;
+    op(Vec::loadu(x + i, count)).store(x + i, count);
+  }
+}
+
+// x[i] = op(x[i], y[i]) in place
+template <typename Op>
+inline void map2_row(float* x, const float* y, int64_t n, const Op& op) {
+  int64_t i = 0;
+  for (; i + Vec::size() <= n; i += Vec::size()) {
+    op(Vec::loadu(x + i), Vec::loadu(y + i)).store(x + i);
+  }
+  if (i < n) {
+    const int64_t count = n - i;
+    op(Vec::loadu(x + i, count), Vec::loadu(y + i, count)).store(x + i, count);
+  }
+}
+
+// sum of x[i] * x[i]
+inline float sum_of_squares(const float* x, int64_t n) {
+  Vec acc(0.0f);
+  int64_t i = 0;
+  for (; i + Vec::size() <= n; i += Vec::size()) {
+    const auto v = Vec::loadu(x + i);
+    acc = at::vec::fmadd(v, v, acc);
+  }
+  float partial[Vec::size()];
+  acc.store(partial);
+  float sum = 0.0f;
+  for (int64_t j = 0; j < Vec::size(); ++j) {
+    sum += partial[j];
+  }
+  for (; i < n; ++i) {
+    sum += x[i] * x[i];
+  }
+  return sum;
+}
+
+}  // namespace llm::kernel::cpu::vec_utils
@@ -0,0 +1,254 @@
+#include "qmatmul_kernels.h"
+
+#include <ATen/Parallel.h>
+#include <glog/logging.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace llm::kernel::cpu {
+
+namespace {
+// max number of input rows to accumulate unpacked integers directly, larger
+// inputs dequantize tiles of weights and multiply with blas.
+constexpr int64_t kMaxGemvRows = 8;
+// number of output features per tile, a multiple of all pack factors
+constexpr int64_t kTileCols = 64;
+
+// position of the i-th value in an int32 along the packed dimension
+constexpr int32_t kSequentialOrder[] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+// argsort of the awq interleaving [0, 2, 4, 6, 1, 3, 5, 7] and [0, 2, 1, 3]
+constexpr int32_t kAWQOrderBits4[] = {0, 4, 1, 5, 2, 6, 3, 7};
+constexpr int32_t kAWQOrderBits8[] = {0, 2, 1, 3};
+
+struct QuantFormat {
+  int64_t bits = 0;
+  int64_t pack_factor = 0;
+  // whether qweight is packed along input features (gptq) or along output
+  // features (awq). qzeros are always packed along output features.
+  bool pack_rows = true;
+  // order of values packed along output features
+  const int32_t* col_order = kSequentialOrder;
+  // added to stored zeros
+  float zero_offset = 0;
+};
+
+// unpack count values packed along output features
+inline void unpack_cols(const int32_t* packed,
+                        int64_t count,
+                        const QuantFormat& format,
+                        float* out) {
+  const int64_t pack_factor = format.pack_factor;
+  const uint32_t mask = (1u << format.bits) - 1;
+  for (int64_t p = 0; p < count / pack_factor; ++p) {
+    const auto v = static_cast<uint32_t>(packed[p]);
+    for (int64_t t = 0; t < pack_factor; ++t) {
+      const uint32_t shift = format.bits * format.col_order[t];
+      out[p * pack_factor + t] = static_cast<float>((v >> shift) & mask);
+    }
+  }
+}
+
+// a view of quantized weights of one call
+struct QuantWeights {
+  const int32_t* qweight = nullptr;
+  const int32_t* qzeros = nullptr;
+  const float* scales = nullptr;
+  int64_t k = 0;
+  int64_t n = 0;
+  int64_t group_size = 0;
+  QuantFormat format;
+
+  // unpack values of input feature kk for output features [j0, j0 + count)
+  void unpack_row(int64_t kk, int64_t j0, int64_t count, float* out) const {
+    const int64_t pack_factor = format.pack_factor;
+    if (!format.pack_rows) {
+      unpack_cols(qweight + kk * (n / pack_factor) + j0 / pack_factor,
+                  count,
+                  format,
+                  out);
+      return;
+    }
+    const int32_t* row = qweight + (kk / pack_factor) * n + j0;
+    const uint32_t shift = format.bits * (kk % pack_factor);
+    const uint32_t mask = (1u << format.bits) - 1;
+    for (int64_t j = 0; j < count; ++j) {
+      out[j] = static_cast<float>((static_cast<uint32_t>(row[j]) >> shift) &
+                                  mask);
+    }
+  }
+
+  // load scales and scaled zeros of group g for output features
+  // [j0, j0 + count), so that weight = q * scale - scaled_zero
+  void load_group(int64_t g,
+                  int64_t j0,
+                  int64_t count,
+                  float* scale,
+                  float* scaled_zero) const {
+    const int64_t pack_factor = format.pack_factor;
+    unpack_cols(qzeros + g * (n / pack_factor) + j0 / pack_factor,
+                count,
+                format,
+                scaled_zero);
+    const float* s = scales + g * n + j0;
+    for (int64_t j = 0; j < count; ++j) {
+      scale[j] = s[j];
+      scaled_zero[j] = (scaled_zero[j] + format.zero_offset) * s[j];
+    }
+  }
+};
+
+torch::Tensor quant_matmul(const torch::Tensor& input,
+                           const torch::Tensor& qweight,
+                           const torch::Tensor& qzeros,
+                           const torch::Tensor& scales,
+                           const QuantFormat& format) {
+  CHECK_EQ(input.dim(), 2) << "input must be 2-D";
+  CHECK(input.device().is_cpu() && qweight.device().is_cpu())
+      << "cpu quantized matmul only supports cpu tensors";
+  CHECK_EQ(qweight.scalar_type(), torch::kInt32) << "qweight must be int32";
+  CHECK_EQ(qzeros.scalar_type(), torch::kInt32) << "qzeros must be int32";
+  const int64_t m = input.size(0);
+  const int64_t k = input.size(1);
+  const int64_t n = scales.size(1);
+  const int64_t n_groups = scales.size(0);
+  const int64_t pack_factor = format.pack_factor;
+  CHECK_EQ(n % pack_factor, 0) << "out features must be packed in int32s";
+  if (format.pack_rows) {
+    CHECK_EQ(k % pack_factor, 0) << "in features must be packed in int32s";
+    CHECK(qweight.sizes() == torch::IntArrayRef({k / pack_factor, n}))
+        << "qweight size mismatch: " << qweight.sizes();
+  } else {
+    CHECK(qweight.sizes() == torch::IntArrayRef({k, n / pack_factor}))
+        << "qweight size mismatch: " << qweight.sizes();
+  }
+  CHECK(qzeros.sizes() == torch::IntArrayRef({n_groups, n / pack_factor}))
+      << "qzeros size mismatch: " << qzeros.sizes();
+  CHECK(n_groups > 0 && k % n_groups == 0)
+      << "in features " << k << " not divisible by " << n_groups << " groups";
+
+  const auto x = input.to(torch::kFloat32).contiguous();
+  const auto qw = qweight.contiguous();
+  const auto qz = qzeros.contiguous();
+  const auto s = scales.to(torch::kFloat32).contiguous();
+  QuantWeights weights;
+  weights.qweight = qw.data_ptr<int32_t>();
+  weights.qzeros = qz.data_ptr<int32_t>();
+  weights.scales = s.data_ptr<float>();
+  weights.k = k;
+  weights.n = n;
+  weights.group_size = k / n_groups;
+  weights.format = format;
+  const int64_t group_size = weights.group_size;
+
+  auto out = torch::empty({m, n}, x.options());
+  const float* x_ptr = x.data_ptr<float>();
+  float* out_ptr = out.data_ptr<float>();
+  const int64_t n_tiles = (n + kTileCols - 1) / kTileCols;
+  if (m <= kMaxGemvRows) {
+    // memory bound, read each packed weight once for all inputs. integers
+    // are accumulated per group and scaled once at the end of the group:
+    // sum(x * (q * s - z * s)) = s * sum(x * q) - z * s * sum(x)
+    at::parallel_for(0, n_tiles, 1, [&](int64_t begin, int64_t end) {
+      std::vector<float> q(kTileCols);
+      std::vector<float> scale(kTileCols);
+      std::vector<float> scaled_zero(kTileCols);
+      std::vector<float> acc(m * kTileCols);
+      std::vector<float> sum(m * kTileCols);
+      std::vector<float> x_sum(m);
+      for (int64_t tile = begin; tile < end; ++tile) {
+        const int64_t j0 = tile * kTileCols;
+        const int64_t count = std::min(kTileCols, n - j0);
+        std::fill(sum.begin(), sum.end(), 0.0f);
+        for (int64_t g = 0; g < n_groups; ++g) {
+          weights.load_group(g, j0, count, scale.data(), scaled_zero.data());
+          std::fill(acc.begin(), acc.end(), 0.0f);
+          std::fill(x_sum.begin(), x_sum.end(), 0.0f);
+          for (int64_t kk = g * group_size; kk < (g + 1) * group_size; ++kk) {
+            weights.unpack_row(kk, j0, count, q.data());
+            for (int64_t i = 0; i < m; ++i) {
+              const float xv = x_ptr[i * k + kk];
+              x_sum[i] += xv;
+              float* a = acc.data() + i * kTileCols;
+              for (int64_t j = 0; j < count; ++j) {
+                a[j] += xv * q[j];
+              }
+            }
+          }
+          for (int64_t i = 0; i < m; ++i) {
+            const float* a = acc.data() + i * kTileCols;
+            float* o = sum.data() + i * kTileCols;
+            for (int64_t j = 0; j < count; ++j) {
+              o[j] += scale[j] * a[j] - scaled_zero[j] * x_sum[i];
+            }
+          }
+        }
+        for (int64_t i = 0; i < m; ++i) {
+          std::copy_n(sum.data() + i * kTileCols, count, out_ptr + i * n + j0);
+        }
+      }
+    });
+  } else {
+    // compute bound, dequantize tiles of weights and multiply with blas
+    at::parallel_for(0, n_tiles, 1, [&](int64_t begin, int64_t end) {
+      std::vector<float> scale(kTileCols);
+      std::vector<float> scaled_zero(kTileCols);
+      auto tile_weights = torch::empty({k, kTileCols}, torch::kFloat32);
+      float* w_ptr = tile_weights.data_ptr<float>();
+      for (int64_t tile = begin; tile < end; ++tile) {
+        const int64_t j0 = tile * kTileCols;
+        const int64_t count = std::min(kTileCols, n - j0);
+        for (int64_t g = 0; g < n_groups; ++g) {
+          weights.load_group(g, j0, count, scale.data(), scaled_zero.data());
+          for (int64_t kk = g * group_size; kk < (g + 1) * group_size; ++kk) {
+            float* w = w_ptr + kk * kTileCols;
+            weights.unpack_row(kk, j0, count, w);
+            for (int64_t j = 0; j < count; ++j) {
+              w[j] = w[j] * scale[j] - scaled_zero[j];
+            }
+          }
+        }
+        out.narrow(1, j0, count)
+            .copy_(torch::mm(x, tile_weights.narrow(1, 0, count)));
+      }
+    });
+  }
+  return out.to(input.scalar_type());
+}
+
+}  // namespace
+
+torch::Tensor gptq_matmul(const torch::Tensor& input,
+                          const torch::Tensor& qweight,
+                          const torch::Tensor& qzeros,
+                          const torch::Tensor& scales,
+                          int64_t bits) {
+  CHECK(bits == 2 || bits == 4 || bits == 8)
+      << "Only 2,4,8 bits are supported, got " << bits;
+  QuantFormat format;
+  format.bits = bits;
+  format.pack_factor = 32 / bits;
+  format.pack_rows = true;
+  format.col_order = kSequentialOrder;
+  format.zero_offset = 1.0f;
+  return quant_matmul(input, qweight, qzeros, scales, format);
+}
+
+torch::Tensor awq_matmul(const torch::Tensor& input,
+                         const torch::Tensor& qweight,
+                         const torch::Tensor& qzeros,
+                         const torch::Tensor& scales,
+                         int64_t bits) {
+  CHECK(bits == 4 || bits == 8) << "Only 4,8 bits are supported for AWQ";
+  QuantFormat format;
+  format.bits = bits;
+  format.pack_factor = 32 / bits;
+  format.pack_rows = false;
+  format.col_order = bits == 4 ? kAWQOrderBits4 : kAWQOrderBits8;
+  format.zero_offset = 0.0f;
+  return quant_matmul(input, qweight, qzeros, scales, format);
+}
+
+}  // namespace llm::kernel::cpu
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <torch/torch.h>
+
+#include <cstdint>
+
+// cpu kernels for weight-only quantized matmul with gptq and awq weights.
+// int2/int4/int8 values are packed into int32s, with one scale and zero per
+// group of input features and output feature. tiles of weights are
+// dequantized on the fly so that weights are never materialized in full.
+namespace llm::kernel::cpu {
+
+// gptq weights, packed along input features, zeros are stored minus one.
+// input: [m, k]
+// qweight: [k / pack_factor, n] int32
+// qzeros: [n_groups, n / pack_factor] int32
+// scales: [n_groups, n]
+// returns: [m, n] of input dtype
+torch::Tensor gptq_matmul(const torch::Tensor& input,
+                          const torch::Tensor& qweight,
+                          const torch::Tensor& qzeros,
+                          const torch::Tensor& scales,
+                          int64_t bits);
+
+// awq weights, packed along output features in the interleaved awq order.
+// input: [m, k]
+// qweight: [k, n / pack_factor] int32
+// qzeros: [n_groups, n / pack_factor] int32
+// scales: [n_groups, n]
+// returns: [m, n] of input dtype
+torch::Tensor awq_matmul(const torch::Tensor& input,
+                         const torch::Tensor& qweight,
+                         const torch::Tensor& qzeros,
+                         const torch::Tensor& scales,
+                         int64_t bits);
+
+}  // namespace llm::kernel::cpu
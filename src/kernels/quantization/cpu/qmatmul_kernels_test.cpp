@@ -0,0 +1,139 @@
+#include "qmatmul_kernels.h"
+
+#include <gtest/gtest.h>
+#include <torch/torch.h>
+
+#include <tuple>
+#include <vector>
+
+namespace llm::kernel::cpu {
+
+namespace {
+// pack values along dim 0 into int32s in sequential order
+torch::Tensor pack_rows(const torch::Tensor& values, int64_t bits) {
+  const int64_t pack_factor = 32 / bits;
+  const auto shifts =
+      torch::arange(0, 32, bits, torch::kInt64).view({1, -1, 1});
+  return torch::bitwise_left_shift(
+             values.to(torch::kInt64).view({-1, pack_factor, values.size(1)}),
+             shifts)
+      .sum(1)
+      .to(torch::kInt32);
+}
+
+// pack values along dim 1 into int32s, the i-th value of each int32 is
+// stored at position order[i]
+torch::Tensor pack_cols(const torch::Tensor& values,
+                        int64_t bits,
+                        const std::vector<int64_t>& order) {
+  const int64_t pack_factor = 32 / bits;
+  const auto shifts = torch::tensor(order, torch::kInt64).mul(bits);
+  return torch::bitwise_left_shift(
+             values.to(torch::kInt64).view({values.size(0), -1, pack_factor}),
+             shifts)
+      .sum(2)
+      .to(torch::kInt32);
+}
+
+struct QuantizedWeights {
+  torch::Tensor qweight;
+  torch::Tensor qzeros;
+  torch::Tensor scales;
+  // dequantized weights: [k, n]
+  torch::Tensor weights;
+};
+
+QuantizedWeights random_weights(int64_t k,
+                                int64_t n,
+                                int64_t group_size,
+                                int64_t bits,
+                                bool awq) {
+  const int64_t n_groups = k / group_size;
+  const int64_t max_value = 1 << bits;
+  const auto values = torch::randint(0, max_value, {k, n}, torch::kInt32);
+  // gptq stores zeros minus one
+  const auto zeros =
+      torch::randint(awq ? 0 : 1, max_value, {n_groups, n}, torch::kInt32);
+  const auto scales = torch::rand({n_groups, n}) * 0.01 + 0.001;
+  const auto group_index = torch::arange(k).div(group_size, "floor");
+  const auto weights =
+      scales.index({group_index}) *
+      (values - zeros.index({group_index})).to(torch::kFloat32);
+
+  QuantizedWeights result;
+  result.scales = scales;
+  result.weights = weights;
+  if (awq) {
+    const std::vector<int64_t> order = bits == 4
+                                           ? std::vector<int64_t>{0, 4, 1, 5,
+                                                                  2, 6, 3, 7}
+                                           : std::vector<int64_t>{0, 2, 1, 3};
+    result.qweight = pack_cols(values, bits, order);
+    result.qzeros = pack_cols(zeros, bits, order);
+  } else {
+    std::vector<int64_t> order(32 / bits);
+    for (size_t i = 0; i < order.size(); ++i) {
+      order[i] = static_cast<int64_t>(i);
+    }
+    result.qweight = pack_rows(values, bits);
+    result.qzeros = pack_cols(zeros - 1, bits, order);
+  }
+  return result;
+}
+
+}  // namespace
+
+// (awq, bits, m)
+class QMatmulTest
+    : public ::testing::TestWithParam<std::tuple<bool, int64_t, int64_t>> {};
+
+TEST_P(QMatmulTest, MatchesDequantizedMatmul) {
+  const auto [awq, bits, m] = GetParam();
+  torch::manual_seed(0);
+  // 3 tiles with a partial one, 4 groups
+  const int64_t k = 256;
+  const int64_t n = 160;
+  const int64_t group_size = 64;
+  const auto w = random_weights(k, n, group_size, bits, awq);
+  const auto input = torch::randn({m, k});
+
+  const auto output =
+      awq ? awq_matmul(input, w.qweight, w.qzeros, w.scales, bits)
+          : gptq_matmul(input, w.qweight, w.qzeros, w.scales, bits);
+  const auto desired = torch::mm(input, w.weights);
+  EXPECT_EQ(output.sizes(), desired.sizes());
+  EXPECT_TRUE(torch::allclose(output, desired, /*rtol=*/1e-3, /*atol=*/1e-3));
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    GPTQ,
+    QMatmulTest,
+    ::testing::Combine(::testing::Values(false),
+                       ::testing::Values(2, 4, 8),
+                       ::testing::Values(1, 3, 20)));
+
+INSTANTIATE_TEST_SUITE_P(
+    AWQ,
+    QMatmulTest,
+    ::testing::Combine(::testing::Values(true),
+                       ::testing::Values(4, 8),
+                       ::testing::Values(1, 3, 20)));
+
+TEST(QMatmulKernelTest, HalfInputWithSingleGroup) {
+  torch::manual_seed(0);
+  const int64_t k = 128;
+  const int64_t n = 64;
+  const auto w = random_weights(k, n, /*group_size=*/k, /*bits=*/4, false);
+  const auto input = torch::randn({2, k}).to(torch::kHalf);
+  const auto output = gptq_matmul(
+      input, w.qweight, w.qzeros, w.scales.to(torch::kHalf), /*bits=*/4);
+  EXPECT_EQ(output.scalar_type(), torch::kHalf);
+  // scales are rounded to half as well
+  const auto half_scales = w.scales.to(torch::kHalf).to(torch::kFloat32);
+  const auto desired = torch::mm(input.to(torch::kFloat32),
+                                 w.weights * (half_scales / w.scales));
+  EXPECT_TRUE(torch::allclose(
+      output.to(torch::kFloat32), desired, /*rtol=*/1e-2, /*atol=*/1e-2));
+}
+
+}  // namespace llm::kernel::cpu
@@ -0,0 +1,453 @@
+#include "ggml_kernels.h"
+
+#include <ATen/Parallel.h>
+#include <c10/util/Half.h>
+#include <glog/logging.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace llm::kernel::ggml {
+
+namespace {
+// elements per block of legacy and k-quant types
+constexpr int64_t QK = 32;
+constexpr int64_t QK_K = 256;
+
+// max number of input rows to use dot products with dequantized rows,
+// larger inputs dequantize tiles of weights and multiply with blas.
+constexpr int64_t kMaxGemvRows = 8;
+// number of weight rows per tile
+constexpr int64_t kTileRows = 64;
+
+// dequantize nb blocks from x into y
+using DequantizeFn = void (*)(const uint8_t* x, float* y, int64_t nb);
+
+struct TypeTraits {
+  const char* name;
+  int64_t block_size;
+  int64_t type_size;
+  // nullptr for types that can't be dequantized
+  DequantizeFn dequantize;
+};
+
+inline uint16_t load_u16(const uint8_t* p) {
+  uint16_t v = 0;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline float load_fp16(const uint8_t* p) {
+  return c10::detail::fp16_ieee_to_fp32_value(load_u16(p));
+}
+
+inline float load_bf16(const uint8_t* p) {
+  const uint32_t bits = static_cast<uint32_t>(load_u16(p)) << 16;
+  float v = 0;
+  std::memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+void dequantize_f32(const uint8_t* x, float* y, int64_t nb) {
+  std::memcpy(y, x, nb * sizeof(float));
+}
+
+void dequantize_f16(const uint8_t* x, float* y, int64_t nb) {
+  for (int64_t i = 0; i < nb; ++i) {
+    y[i] = load_fp16(x + i * 2);
+  }
+}
+
+void dequantize_bf16(const uint8_t* x, float* y, int64_t nb) {
+  for (int64_t i = 0; i < nb; ++i) {
+    y[i] = load_bf16(x + i * 2);
+  }
+}
+
+// block: half d, uint8 qs[16]
+void dequantize_q4_0(const uint8_t* x, float* y, int64_t nb) {
+  for (int64_t i = 0; i < nb; ++i, x += 18, y += QK) {
+    const float d = load_fp16(x);
+    const uint8_t* qs = x + 2;
+    for (int64_t j = 0; j < QK / 2; ++j) {
+      y[j] = static_cast<float>((qs[j] & 0xF) - 8) * d;
+      y[j + QK / 2] = static_cast<float>((qs[j] >> 4) - 8) * d;
+    }
+  }
+}
+
+// block: half d, half m, uint8 qs[16]
+void dequantize_q4_1(const uint8_t* x, float* y, int64_t nb) {
+  for (int64_t i = 0; i < nb; ++i, x += 20, y += QK) {
+    const float d = load_fp16(x);
+    const float m = load_fp16(x + 2);
+    const uint8_t* qs = x + 4;
+    for (int64_t j = 0; j < QK / 2; ++j) {
+      y[j] = static_cast<float>(qs[j] & 0xF) * d + m;
+      y[j + QK / 2] = static_cast<float>(qs[j] >> 4) * d + m;
+    }
+  }
+}
+
+// block: half d, uint8 qh[4], uint8 qs[16]
+void dequantize_q5_0(const uint8_t* x, float* y, int64_t nb) {
+  for (int64_t i = 0; i < nb; ++i, x += 22, y += QK) {
+    const float d = load_fp16(x);
+    uint32_t qh = 0;
+    std::memcpy(&qh, x + 2, sizeof(qh));
+    const uint8_t* qs = x + 6;
+    for (int64_t j = 0; j < QK / 2; ++j) {
+      const uint8_t xh_0 = ((qh >> j) << 4) & 0x10;
+      const uint8_t xh_1 = (qh >> (j + 12)) & 0x10;
+      y[j] = static_cast<float>(((qs[j] & 0xF) | xh_0) - 16) * d;
+      y[j + QK / 2] = static_cast<float>(((qs[j] >> 4) | xh_1) - 16) * d;
+    }
+  }
+}
+
+// block: half d, half m, uint8 qh[4], uint8 qs[16]
+void dequantize_q5_1(const uint8_t* x, float* y, int64_t nb) {
+  for (int64_t i = 0; i < nb; ++i, x += 24, y += QK) {
+    const float d = load_fp16(x);
+    const float m = load_fp16(x + 2);
+    uint32_t qh = 0;
+    std::memcpy(&qh, x + 4, sizeof(qh));
+    const uint8_t* qs = x + 8;
+    for (int64_t j = 0; j < QK / 2; ++j) {
+      const uint8_t xh_0 = ((qh >> j) << 4) & 0x10;
+      const uint8_t xh_1 = (qh >> (j + 12)) & 0x10;
+      y[j] = static_cast<float>((qs[j] & 0xF) | xh_0) * d + m;
+      y[j + QK / 2] = static_cast<float>((qs[j] >> 4) | xh_1) * d + m;
+    }
+  }
+}
+
+// block: half d, int8 qs[32]
+void dequantize_q8_0(const uint8_t* x, float* y, int64_t nb) {
+  for (int64_t i = 0; i < nb; ++i, x += 34, y += QK) {
+    const float d = load_fp16(x);
+    const auto* qs = reinterpret_cast<const int8_t*>(x + 2);
+    for (int64_t j = 0; j < QK; ++j) {
+      y[j] = static_cast<float>(qs[j]) * d;
+    }
+  }
+}
+
+// unpack 6-bit scale and min of sub-block j from 12 bytes of scales
+inline void get_scale_min_k4(int64_t j,
+                             const uint8_t* q,
+                             uint8_t* d,
+                             uint8_t* m) {
+  if (j < 4) {
+    *d = q[j] & 63;
+    *m = q[j + 4] & 63;
+  } else {
+    *d = (q[j + 4] & 0xF) | ((q[j - 4] >> 6) << 4);
+    *m = (q[j + 4] >> 4) | ((q[j] >> 6) << 4);
+  }
+}
+
+// block: half d, half dmin, uint8 scales[12], uint8 qs[128]
+void dequantize_q4_k(const uint8_t* x, float* y, int64_t nb) {
+  for (int64_t i = 0; i < nb; ++i, x += 144) {
+    const float d = load_fp16(x);
+    const float min = load_fp16(x + 2);
+    const uint8_t* scales = x + 4;
+    const uint8_t* q = x + 16;
+    for (int64_t j = 0, is = 0; j < QK_K; j += 64, is += 2, q += 32) {
+      uint8_t sc = 0;
+      uint8_t m = 0;
+      get_scale_min_k4(is, scales, &sc, &m);
+      const float d1 = d * sc;
+      const float m1 = min * m;
+      get_scale_min_k4(is + 1, scales, &sc, &m);
+      const float d2 = d * sc;
+      const float m2 = min * m;
+      for (int64_t l = 0; l < 32; ++l) {
+        *y++ = d1 * static_cast<float>(q[l] & 0xF) - m1;
+      }
+      for (int64_t l = 0; l < 32; ++l) {
+        *y++ = d2 * static_cast<float>(q[l] >> 4) - m2;
+      }
+    }
+  }
+}
+
+// block: half d, half dmin, uint8 scales[12], uint8 qh[32], uint8 qs[128]
+void dequantize_q5_k(const uint8_t* x, float* y, int64_t nb) {
+  for (int64_t i = 0; i < nb; ++i, x += 176) {
+    const float d = load_fp16(x);
+    const float min = load_fp16(x + 2);
+    const uint8_t* scales = x + 4;
+    const uint8_t* qh = x + 16;
+    const uint8_t* ql = x + 48;
+    uint8_t u1 = 1;
+    uint8_t u2 = 2;
+    for (int64_t j = 0, is = 0; j < QK_K; j += 64, is += 2, ql += 32) {
+      uint8_t sc = 0;
+      uint8_t m = 0;
+      get_scale_min_k4(is, scales, &sc, &m);
+      const float d1 = d * sc;
+      const float m1 = min * m;
+      get_scale_min_k4(is + 1, scales, &sc, &m);
+      const float d2 = d * sc;
+      const float m2 = min * m;
+      for (int64_t l = 0; l < 32; ++l) {
+        const int q = (ql[l] & 0xF) + ((qh[l] & u1) ? 16 : 0);
+        *y++ = d1 * static_cast<float>(q) - m1;
+      }
+      for (int64_t l = 0; l < 32; ++l) {
+        const int q = (ql[l] >> 4) + ((qh[l] & u2) ? 16 : 0);
+        *y++ = d2 * static_cast<float>(q) - m2;
+      }
+      u1 <<= 2;
+      u2 <<= 2;
+    }
+  }
+}
+
+// block: uint8 ql[128], uint8 qh[64], int8 scales[16], half d
+void dequantize_q6_k(const uint8_t* x, float* y, int64_t nb) {
+  for (int64_t i = 0; i < nb; ++i, x += 210) {
+    const float d = load_fp16(x + 208);
+    const uint8_t* ql = x;
+    const uint8_t* qh = x + 128;
+    const auto* sc = reinterpret_cast<const int8_t*>(x + 192);
+    for (int64_t n = 0; n < QK_K; n += 128, y += 128) {
+      for (int64_t l = 0; l < 32; ++l) {
+        const int64_t is = l / 16;
+        const int q1 = ((ql[l] & 0xF) | (((qh[l] >> 0) & 3) << 4)) - 32;
+        const int q2 = ((ql[l + 32] & 0xF) | (((qh[l] >> 2) & 3) << 4)) - 32;
+        const int q3 = ((ql[l] >> 4) | (((qh[l] >> 4) & 3) << 4)) - 32;
+        const int q4 = ((ql[l + 32] >> 4) | (((qh[l] >> 6) & 3) << 4)) - 32;
+        y[l] = d * sc[is] * static_cast<float>(q1);
+        y[l + 32] = d * sc[is + 2] * static_cast<float>(q2);
+        y[l + 64] = d * sc[is + 4] * static_cast<float>(q3);
+        y[l + 96] = d * sc[is + 6] * static_cast<float>(q4);
+      }
+      ql += 64;
+      qh += 32;
+      sc += 8;
+    }
+  }
+}
+
+const TypeTraits* get_traits(GGMLType type) {
+  static const TypeTraits kF32{"f32", 1, 4, dequantize_f32};
+  static const TypeTraits kF16{"f16", 1, 2, dequantize_f16};
+  static const TypeTraits kBF16{"bf16", 1, 2, dequantize_bf16};
+  static const TypeTraits kQ4_0{"q4_0", QK, 18, dequantize_q4_0};
+  static const TypeTraits kQ4_1{"q4_1", QK, 20, dequantize_q4_1};
+  static const TypeTraits kQ5_0{"q5_0", QK, 22, dequantize_q5_0};
+  static const TypeTraits kQ5_1{"q5_1", QK, 24, dequantize_q5_1};
+  static const TypeTraits kQ8_0{"q8_0", QK, 34, dequantize_q8_0};
+  static const TypeTraits kQ8_1{"q8_1", QK, 36, nullptr};
+  static const TypeTraits kQ2_K{"q2_k", QK_K, 84, nullptr};
+  static const TypeTraits kQ3_K{"q3_k", QK_K, 110, nullptr};
+  static const TypeTraits kQ4_K{"q4_k", QK_K, 144, dequantize_q4_k};
+  static const TypeTraits kQ5_K{"q5_k", QK_K, 176, dequantize_q5_k};
+  static const TypeTraits kQ6_K{"q6_k", QK_K, 210, dequantize_q6_k};
+  static const TypeTraits kQ8_K{"q8_k", QK_K, 292, nullptr};
+  static const TypeTraits kI8{"i8", 1, 1, nullptr};
+  static const TypeTraits kI16{"i16", 1, 2, nullptr};
+  static const TypeTraits kI32{"i32", 1, 4, nullptr};
+  static const TypeTraits kI64{"i64", 1, 8, nullptr};
+  static const TypeTraits kF64{"f64", 1, 8, nullptr};
+
+  switch (type) {
+    case GGMLType::F32:
+      return &kF32;
+    case GGMLType::F16:
+      return &kF16;
+    case GGMLType::BF16:
+      return &kBF16;
+    case GGMLType::Q4_0:
+      return &kQ4_0;
+    case GGMLType::Q4_1:
+      return &kQ4_1;
+    case GGMLType::Q5_0:
+      return &kQ5_0;
+    case GGMLType::Q5_1:
+      return &kQ5_1;
+    case GGMLType::Q8_0:
+      return &kQ8_0;
+    case GGMLType::Q8_1:
+      return &kQ8_1;
+    case GGMLType::Q2_K:
+      return &kQ2_K;
+    case GGMLType::Q3_K:
+      return &kQ3_K;
+    case GGMLType::Q4_K:
+      return &kQ4_K;
+    case GGMLType::Q5_K:
+      return &kQ5_K;
+    case GGMLType::Q6_K:
+      return &kQ6_K;
+    case GGMLType::Q8_K:
+      return &kQ8_K;
+    case GGMLType::I8:
+      return &kI8;
+    case GGMLType::I16:
+      return &kI16;
+    case GGMLType::I32:
+      return &kI32;
+    case GGMLType::I64:
+      return &kI64;
+    case GGMLType::F64:
+      return &kF64;
+  }
+  return nullptr;
+}
+
+const TypeTraits& get_supported_traits(GGMLType type) {
+  const auto* traits = get_traits(type);
+  CHECK(traits != nullptr && traits->dequantize != nullptr)
+      << "Unsupported ggml type " << type_name(type);
+  return *traits;
+}
+
+// dot product with independent accumulators, vectorized by the compiler
+inline float dot(const float* a, const float* b, int64_t n) {
+  constexpr int64_t kLanes = 8;
+  float acc[kLanes] = {0};
+  int64_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (int64_t l = 0; l < kLanes; ++l) {
+      acc[l] += a[i + l] * b[i + l];
+    }
+  }
+  float sum = 0;
+  for (int64_t l = 0; l < kLanes; ++l) {
+    sum += acc[l];
+  }
+  for (; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+// check qweight and return a contiguous view of it
+torch::Tensor check_qweight(const torch::Tensor& qweight,
+                            GGMLType type,
+                            int64_t n) {
+  CHECK_EQ(qweight.dim(), 2) << "qweight must be 2-D";
+  CHECK(qweight.device().is_cpu()) << "ggml kernels only support cpu";
+  CHECK_EQ(qweight.scalar_type(), torch::kUInt8) << "qweight must be uint8";
+  CHECK_EQ(qweight.size(1), row_bytes(type, n))
+      << "qweight row size mismatch for " << type_name(type) << " with "
+      << n << " elements";
+  return qweight.contiguous();
+}
+
+}  // namespace
+
+const char* type_name(GGMLType type) {
+  const auto* traits = get_traits(type);
+  return traits != nullptr ? traits->name : "unknown";
+}
+
+bool is_known(GGMLType type) { return get_traits(type) != nullptr; }
+
+bool is_supported(GGMLType type) {
+  const auto* traits = get_traits(type);
+  return traits != nullptr && traits->dequantize != nullptr;
+}
+
+int64_t block_size(GGMLType type) {
+  const auto* traits = get_traits(type);
+  CHECK(traits != nullptr) << "Unknown ggml type " << static_cast<int>(type);
+  return traits->block_size;
+}
+
+int64_t row_bytes(GGMLType type, int64_t n) {
+  const auto* traits = get_traits(type);
+  CHECK(traits != nullptr) << "Unknown ggml type " << static_cast<int>(type);
+  CHECK_EQ(n % traits->block_size, 0)
+      << "row size " << n << " is not a multiple of block size "
+      << traits->block_size << " for " << traits->name;
+  return n / traits->block_size * traits->type_size;
+}
+
+torch::Tensor dequantize(const torch::Tensor& qweight,
+                         GGMLType type,
+                         int64_t n,
+                         torch::ScalarType dtype) {
+  const auto& traits = get_supported_traits(type);
+  const auto qw = check_qweight(qweight, type, n);
+  const int64_t rows = qw.size(0);
+  const int64_t nb = n / traits.block_size;
+  const int64_t rb = qw.size(1);
+  const uint8_t* w_ptr = qw.data_ptr<uint8_t>();
+
+  auto out = torch::empty({rows, n}, torch::dtype(dtype));
+  at::parallel_for(0, rows, kTileRows, [&](int64_t begin, int64_t end) {
+    if (dtype == torch::kFloat32) {
+      float* out_ptr = out.data_ptr<float>();
+      for (int64_t r = begin; r < end; ++r) {
+        traits.dequantize(w_ptr + r * rb, out_ptr + r * n, nb);
+      }
+      return;
+    }
+    // dequantize a tile into float then convert, to bound the memory
+    auto tile = torch::empty({kTileRows, n}, torch::kFloat32);
+    float* tile_ptr = tile.data_ptr<float>();
+    for (int64_t start = begin; start < end; start += kTileRows) {
+      const int64_t count = std::min(kTileRows, end - start);
+      for (int64_t r = 0; r < count; ++r) {
+        traits.dequantize(w_ptr + (start + r) * rb, tile_ptr + r * n, nb);
+      }
+      out.narrow(0, start, count).copy_(tile.narrow(0, 0, count));
+    }
+  });
+  return out;
+}
+
+torch::Tensor matmul(const torch::Tensor& input,
+                     const torch::Tensor& qweight,
+                     GGMLType type) {
+  CHECK_EQ(input.dim(), 2) << "input must be 2-D";
+  const auto& traits = get_supported_traits(type);
+  const int64_t m = input.size(0);
+  const int64_t k = input.size(1);
+  const auto qw = check_qweight(qweight, type, k);
+  const int64_t n = qw.size(0);
+  const int64_t nb = k / traits.block_size;
+  const int64_t rb = qw.size(1);
+  const uint8_t* w_ptr = qw.data_ptr<uint8_t>();
+
+  const auto x = input.to(torch::kFloat32).contiguous();
+  auto out = torch::empty({m, n}, x.options());
+  if (m <= kMaxGemvRows) {
+    // memory bound, dequantize each row once and reuse it for all inputs
+    const float* x_ptr = x.data_ptr<float>();
+    float* out_ptr = out.data_ptr<float>();
+    at::parallel_for(0, n, kTileRows / 4, [&](int64_t begin, int64_t end) {
+      std::vector<float> row(k);
+      for (int64_t j = begin; j < end; ++j) {
+        traits.dequantize(w_ptr + j * rb, row.data(), nb);
+        for (int64_t i = 0; i < m; ++i) {
+          out_ptr[i * n + j] = dot(x_ptr + i * k, row.data(), k);
+        }
+      }
+    });
+  } else {
+    // compute bound, dequantize tiles of rows and multiply with blas
+    at::parallel_for(0, n, kTileRows, [&](int64_t begin, int64_t end) {
+      auto tile = torch::empty({kTileRows, k}, torch::kFloat32);
+      float* tile_ptr = tile.data_ptr<float>();
+      for (int64_t start = begin; start < end; start += kTileRows) {
+        const int64_t count = std::min(kTileRows, end - start);
+        for (int64_t r = 0; r < count; ++r) {
+          traits.dequantize(w_ptr + (start + r) * rb, tile_ptr + r * k, nb);
+        }
+        out.narrow(1, start, count)
+            .copy_(torch::mm(x, tile.narrow(0, 0, count).t()));
+      }
+    });
+  }
+  return out.to(input.scalar_type());
+}
+
+}  // namespace llm::kernel::ggml
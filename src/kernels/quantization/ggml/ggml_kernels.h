@@ -0,0 +1,67 @@
+#pragma once
+
+#include <torch/torch.h>
+
+#include <cstdint>
+
+// cpu kernels for tensors in ggml block formats, used by gguf models.
+// a row of n elements is stored as n / block_size blocks of type_size bytes.
+namespace llm::kernel::ggml {
+
+// values match ggml_type in ggml.h
+enum class GGMLType : int32_t {
+  F32 = 0,
+  F16 = 1,
+  Q4_0 = 2,
+  Q4_1 = 3,
+  Q5_0 = 6,
+  Q5_1 = 7,
+  Q8_0 = 8,
+  Q8_1 = 9,
+  Q2_K = 10,
+  Q3_K = 11,
+  Q4_K = 12,
+  Q5_K = 13,
+  Q6_K = 14,
+  Q8_K = 15,
+  I8 = 24,
+  I16 = 25,
+  I32 = 26,
+  I64 = 27,
+  F64 = 28,
+  BF16 = 30,
+};
+
+// name of the type, "unknown" for types without traits
+const char* type_name(GGMLType type);
+
+// whether the type has known block layout
+bool is_known(GGMLType type);
+
+// whether rows of the type can be dequantized and multiplied
+bool is_supported(GGMLType type);
+
+// number of elements per block
+int64_t block_size(GGMLType type);
+
+// bytes of a row with n elements, n must be a multiple of block_size
+int64_t row_bytes(GGMLType type, int64_t n);
+
+// dequantize rows of blocks
+// qweight: [rows, row_bytes(type, n)] uint8
+// returns: [rows, n] of dtype
+torch::Tensor dequantize(const torch::Tensor& qweight,
+                         GGMLType type,
+                         int64_t n,
+                         torch::ScalarType dtype = torch::kFloat32);
+
+// multiply input with quantized weights, dequantizing rows on the fly so
+// that weights are never materialized in full.
+// input: [m, k]
+// qweight: [n, row_bytes(type, k)] uint8
+// returns: [m, n] of input dtype
+torch::Tensor matmul(const torch::Tensor& input,
+                     const torch::Tensor& qweight,
+                     GGMLType type);
+
+}  // namespace llm::kernel::ggml
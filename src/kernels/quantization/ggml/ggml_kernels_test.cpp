@@ -0,0 +1,307 @@
+#include "ggml_kernels.h"
+
+#include <c10/util/Half.h>
+#include <gtest/gtest.h>
+#include <torch/torch.h>
+
+#include <cstring>
+#include <vector>
+
+namespace llm::kernel::ggml {
+
+namespace {
+// set the fp16 field at offset of each block to value
+void set_half_field(torch::Tensor& qweight,
+                    int64_t type_size,
+                    int64_t offset,
+                    float value) {
+  const uint16_t bits = c10::Half(value).x;
+  uint8_t* data = qweight.data_ptr<uint8_t>();
+  for (int64_t i = offset; i < qweight.numel(); i += type_size) {
+    std::memcpy(data + i, &bits, sizeof(bits));
+  }
+}
+
+// store value as fp16 at p
+void store_half(uint8_t* p, float value) {
+  const uint16_t bits = c10::Half(value).x;
+  std::memcpy(p, &bits, sizeof(bits));
+}
+
+// pack 6-bit scale and min of sub-block j into 12 bytes of k-quant scales
+void pack_scale_min_k4(int j, uint8_t sc, uint8_t m, uint8_t* q) {
+  if (j < 4) {
+    q[j] |= sc;
+    q[j + 4] |= m;
+  } else {
+    q[j + 4] |= (sc & 0xF) | ((m & 0xF) << 4);
+    q[j - 4] |= (sc >> 4) << 6;
+    q[j] |= (m >> 4) << 6;
+  }
+}
+
+// one row of a single block and its expected values
+torch::Tensor to_qweight(const std::vector<uint8_t>& block) {
+  return torch::tensor(std::vector<int64_t>(block.begin(), block.end()))
+      .to(torch::kUInt8)
+      .unsqueeze(0);
+}
+
+torch::Tensor to_weight(const std::vector<float>& values) {
+  return torch::tensor(values, torch::kFloat32).unsqueeze(0);
+}
+
+// random blocks with sane scales
+torch::Tensor random_blocks(GGMLType type, int64_t rows, int64_t k) {
+  auto qweight = torch::randint(
+      0, 256, {rows, row_bytes(type, k)}, torch::dtype(torch::kUInt8));
+  switch (type) {
+    case GGMLType::Q4_0:
+      set_half_field(qweight, 18, 0, 0.01f);
+      break;
+    case GGMLType::Q4_1:
+      set_half_field(qweight, 20, 0, 0.01f);
+      set_half_field(qweight, 20, 2, -0.05f);
+      break;
+    case GGMLType::Q5_0:
+      set_half_field(qweight, 22, 0, 0.01f);
+      break;
+    case GGMLType::Q5_1:
+      set_half_field(qweight, 24, 0, 0.01f);
+      set_half_field(qweight, 24, 2, -0.05f);
+      break;
+    case GGMLType::Q8_0:
+      set_half_field(qweight, 34, 0, 0.01f);
+      break;
+    case GGMLType::Q4_K:
+      set_half_field(qweight, 144, 0, 0.01f);
+      set_half_field(qweight, 144, 2, 0.005f);
+      break;
+    case GGMLType::Q5_K:
+      set_half_field(qweight, 176, 0, 0.01f);
+      set_half_field(qweight, 176, 2, 0.005f);
+      break;
+    case GGMLType::Q6_K:
+      set_half_field(qweight, 210, 208, 0.01f);
+      break;
+    default:
+      LOG(FATAL) << "not a quantized type";
+  }
+  return qweight;
+}
+}  // namespace
+
+TEST(GGMLKernelsTest, RowBytes) {
+  EXPECT_EQ(row_bytes(GGMLType::F32, 64), 256);
+  EXPECT_EQ(row_bytes(GGMLType::F16, 64), 128);
+  EXPECT_EQ(row_bytes(GGMLType::Q4_0, 64), 36);
+  EXPECT_EQ(row_bytes(GGMLType::Q8_0, 64), 68);
+  EXPECT_EQ(row_bytes(GGMLType::Q4_K, 512), 288);
+  EXPECT_EQ(row_bytes(GGMLType::Q6_K, 256), 210);
+  EXPECT_TRUE(is_supported(GGMLType::Q4_K));
+  EXPECT_TRUE(is_known(GGMLType::Q3_K));
+  EXPECT_FALSE(is_supported(GGMLType::Q3_K));
+  EXPECT_FALSE(is_known(static_cast<GGMLType>(1000)));
+}
+
+TEST(GGMLKernelsTest, DequantizeQ8_0) {
+  // one block: d = 0.5, qs = [-16, 15]
+  auto qweight = torch::zeros({1, 34}, torch::kUInt8);
+  set_half_field(qweight, 34, 0, 0.5f);
+  auto* qs = reinterpret_cast<int8_t*>(qweight.data_ptr<uint8_t>() + 2);
+  for (int i = 0; i < 32; ++i) {
+    qs[i] = static_cast<int8_t>(i - 16);
+  }
+  const auto weight = dequantize(qweight, GGMLType::Q8_0, 32);
+  const auto expected =
+      (torch::arange(32, torch::kFloat32) - 16).mul(0.5).unsqueeze(0);
+  EXPECT_TRUE(torch::equal(weight, expected));
+}
+
+TEST(GGMLKernelsTest, DequantizeQ4_0) {
+  // one block: d = 2, low nibbles hold [0, 16), high nibbles hold 15 - j
+  auto qweight = torch::zeros({1, 18}, torch::kUInt8);
+  set_half_field(qweight, 18, 0, 2.0f);
+  uint8_t* qs = qweight.data_ptr<uint8_t>() + 2;
+  for (int j = 0; j < 16; ++j) {
+    qs[j] = static_cast<uint8_t>(j | ((15 - j) << 4));
+  }
+  const auto weight = dequantize(qweight, GGMLType::Q4_0, 32);
+  const auto low = torch::arange(16, torch::kFloat32);
+  const auto high = 15 - low;
+  const auto expected = torch::cat({low, high}).sub(8).mul(2).unsqueeze(0);
+  EXPECT_TRUE(torch::equal(weight, expected));
+}
+
+TEST(GGMLKernelsTest, DequantizeQ4_1) {
+  // one block: d = 2, m = -3, low nibbles hold [0, 16), high nibbles 15 - j
+  std::vector<uint8_t> block(20);
+  store_half(&block[0], 2.0f);
+  store_half(&block[2], -3.0f);
+  std::vector<float> expected(32);
+  for (int j = 0; j < 16; ++j) {
+    block[4 + j] = static_cast<uint8_t>(j | ((15 - j) << 4));
+    expected[j] = j * 2.0f - 3.0f;
+    expected[j + 16] = (15 - j) * 2.0f - 3.0f;
+  }
+  const auto weight = dequantize(to_qweight(block), GGMLType::Q4_1, 32);
+  EXPECT_TRUE(torch::equal(weight, to_weight(expected)));
+}
+
+TEST(GGMLKernelsTest, DequantizeQ5_0) {
+  // one block: d = 0.5, the 5th bit of element i is bit i of qh
+  std::vector<uint8_t> block(22);
+  store_half(&block[0], 0.5f);
+  const uint32_t qh = 0xF0F0A5C3;
+  std::memcpy(&block[2], &qh, sizeof(qh));
+  std::vector<float> expected(32);
+  for (int i = 0; i < 32; ++i) {
+    // element i is in the low nibble of byte i % 16 for the first half
+    const int low = (i * 5 + i / 16 + 3) % 16;
+    block[6 + i % 16] |= i < 16 ? low : low << 4;
+    const int q = low | (((qh >> i) & 1) << 4);
+    expected[i] = (q - 16) * 0.5f;
+  }
+  const auto weight = dequantize(to_qweight(block), GGMLType::Q5_0, 32);
+  EXPECT_TRUE(torch::equal(weight, to_weight(expected)));
+}
+
+TEST(GGMLKernelsTest, DequantizeQ5_1) {
+  // one block: d = 0.25, m = 1, the 5th bit of element i is bit i of qh
+  std::vector<uint8_t> block(24);
+  store_half(&block[0], 0.25f);
+  store_half(&block[2], 1.0f);
+  const uint32_t qh = 0x3C5A0FF1;
+  std::memcpy(&block[4], &qh, sizeof(qh));
+  std::vector<float> expected(32);
+  for (int i = 0; i < 32; ++i) {
+    const int low = (i * 7 + i / 16 + 1) % 16;
+    block[8 + i % 16] |= i < 16 ? low : low << 4;
+    const int q = low | (((qh >> i) & 1) << 4);
+    expected[i] = q * 0.25f + 1.0f;
+  }
+  const auto weight = dequantize(to_qweight(block), GGMLType::Q5_1, 32);
+  EXPECT_TRUE(torch::equal(weight, to_weight(expected)));
+}
+
+TEST(GGMLKernelsTest, DequantizeQ4_K) {
+  // one block: d = 0.5, dmin = 0.25, 8 sub-blocks of 32 elements with 6-bit
+  // scales and mins. sub-blocks 2c and 2c + 1 share 32 bytes of quants, in
+  // the low and high nibbles.
+  std::vector<uint8_t> block(144);
+  store_half(&block[0], 0.5f);
+  store_half(&block[2], 0.25f);
+  for (int s = 0; s < 8; ++s) {
+    pack_scale_min_k4(s, 1 + 7 * s, 63 - 5 * s, &block[4]);
+  }
+  std::vector<float> expected(256);
+  for (int e = 0; e < 256; ++e) {
+    const int s = e / 32;
+    const int q = (e * 7 + s + 3) % 16;
+    block[16 + 32 * (s / 2) + e % 32] |= s % 2 == 0 ? q : q << 4;
+    expected[e] = 0.5f * (1 + 7 * s) * q - 0.25f * (63 - 5 * s);
+  }
+  const auto weight = dequantize(to_qweight(block), GGMLType::Q4_K, 256);
+  EXPECT_TRUE(torch::equal(weight, to_weight(expected)));
+}
+
+TEST(GGMLKernelsTest, DequantizeQ5_K) {
+  // same as q4_k, with the 5th bit of element l of sub-block s in bit s of
+  // qh[l]
+  std::vector<uint8_t> block(176);
+  store_half(&block[0], 0.5f);
+  store_half(&block[2], 0.25f);
+  for (int s = 0; s < 8; ++s) {
+    pack_scale_min_k4(s, 60 - 7 * s, 2 + 8 * s, &block[4]);
+  }
+  std::vector<float> expected(256);
+  for (int e = 0; e < 256; ++e) {
+    const int s = e / 32;
+    const int l = e % 32;
+    const int q = (e * 11 + s + 5) % 32;
+    block[48 + 32 * (s / 2) + l] |= s % 2 == 0 ? q & 0xF : (q & 0xF) << 4;
+    block[16 + l] |= (q >> 4) << s;
+    expected[e] = 0.5f * (60 - 7 * s) * q - 0.25f * (2 + 8 * s);
+  }
+  const auto weight = dequantize(to_qweight(block), GGMLType::Q5_K, 256);
+  EXPECT_TRUE(torch::equal(weight, to_weight(expected)));
+}
+
+TEST(GGMLKernelsTest, DequantizeQ6_K) {
+  // one block: 16 sub-blocks of 16 elements with int8 scales, d = 0.125.
+  // each half of 128 elements has 64 bytes of low nibbles and 32 bytes of
+  // high 2 bits, quarter c of a half uses the low or high nibbles of the
+  // first or second 32 bytes, and bits 2c of qh.
+  std::vector<uint8_t> block(210);
+  store_half(&block[208], 0.125f);
+  for (int i = 0; i < 16; ++i) {
+    block[192 + i] = static_cast<uint8_t>(static_cast<int8_t>(i - 8));
+  }
+  std::vector<float> expected(256);
+  for (int e = 0; e < 256; ++e) {
+    const int h = e / 128;
+    const int c = (e % 128) / 32;
+    const int l = e % 32;
+    const int q = (e * 13 + e / 32 + 7) % 64;
+    const int ql = 64 * h + 32 * (c % 2) + l;
+    block[ql] |= c < 2 ? q & 0xF : (q & 0xF) << 4;
+    block[128 + 32 * h + l] |= (q >> 4) << (2 * c);
+    expected[e] = 0.125f * ((e / 16) - 8) * (q - 32);
+  }
+  const auto weight = dequantize(to_qweight(block), GGMLType::Q6_K, 256);
+  EXPECT_TRUE(torch::equal(weight, to_weight(expected)));
+}
+
+TEST(GGMLKernelsTest, DequantizeToHalf) {
+  const auto qweight = random_blocks(GGMLType::Q4_K, 100, 256);
+  const auto weight = dequantize(qweight, GGMLType::Q4_K, 256);
+  const auto weight_half =
+      dequantize(qweight, GGMLType::Q4_K, 256, torch::kHalf);
+  EXPECT_EQ(weight_half.scalar_type(), torch::kHalf);
+  EXPECT_TRUE(torch::allclose(weight_half.to(torch::kFloat32),
+                              weight,
+                              /*rtol=*/1e-3,
+                              /*atol=*/1e-3));
+}
+
+class GGMLMatmulTest : public ::testing::TestWithParam<GGMLType> {};
+
+TEST_P(GGMLMatmulTest, MatchesDequantized) {
+  const GGMLType type = GetParam();
+  const int64_t n = 200;
+  const int64_t k = 512;
+  const auto qweight = random_blocks(type, n, k);
+  const auto weight = dequantize(qweight, type, k);
+  ASSERT_EQ(weight.sizes(), torch::IntArrayRef({n, k}));
+
+  // row by row for small inputs and tiled for large inputs
+  for (const int64_t m : {1, 3, 20}) {
+    const auto input = torch::randn({m, k});
+    const auto output = matmul(input, qweight, type);
+    const auto expected = torch::mm(input, weight.t());
+    EXPECT_TRUE(torch::allclose(output, expected, /*rtol=*/1e-4, /*atol=*/1e-4))
+        << "type: " << type_name(type) << ", m: " << m;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(GGMLKernelsTest,
+                         GGMLMatmulTest,
+                         ::testing::Values(GGMLType::Q4_0,
+                                           GGMLType::Q4_1,
+                                           GGMLType::Q5_0,
+                                           GGMLType::Q5_1,
+                                           GGMLType::Q8_0,
+                                           GGMLType::Q4_K,
+                                           GGMLType::Q5_K,
+                                           GGMLType::Q6_K));
+
+TEST(GGMLKernelsTest, MatmulHalfWeights) {
+  const auto weight = torch::randn({64, 128}).to(torch::kHalf);
+  const auto qweight = weight.view(torch::kUInt8);
+  const auto input = torch::randn({2, 128});
+  const auto output = matmul(input, qweight, GGMLType::F16);
+  const auto expected = torch::mm(input, weight.to(torch::kFloat32).t());
+  EXPECT_TRUE(torch::allclose(output, expected, /*rtol=*/1e-4, /*atol=*/1e-4));
+}
+
+}  // namespace llm::kernel::ggml
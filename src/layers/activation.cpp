@@ -3,6 +3,7 @@
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <kernels/activation_kernels.h>
+#include <kernels/cpu/activation_kernels.h>
 #include <torch/torch.h>
 
 #include <boost/algorithm/string.hpp>
@@ -10,6 +11,25 @@
 DECLARE_bool(disable_custom_kernels);
 
 namespace llm {
+namespace {
+// use the custom kernel for the device if available
+ActFunc select_kernel(const torch::Device& device,
+                      ActFunc cuda_kernel,
+                      ActFunc cpu_kernel,
+                      ActFunc fallback) {
+  if (FLAGS_disable_custom_kernels) {
+    return fallback;
+  }
+  if (device.is_cuda()) {
+    return cuda_kernel;
+  }
+  if (device.is_cpu()) {
+    return cpu_kernel;
+  }
+  return fallback;
+}
+}  // namespace
+
 namespace detail {
 torch::Tensor gelu(torch::Tensor x) {
   namespace F = torch::nn::functional;
@@ -85,12 +105,12 @@ ActFunc Activation::get_act_func(const std::string& name,
     return gelu;
   }
   if (boost::iequals(name, "gelu_fast")) {
-    return device.is_cuda() && !FLAGS_disable_custom_kernels ? kernel::gelu_fast
-                                                             : gelu_fast;
+    return select_kernel(
+        device, kernel::gelu_fast, kernel::cpu::gelu_fast, gelu_fast);
   }
   if (boost::iequals(name, "gelu_new")) {
-    return device.is_cuda() && !FLAGS_disable_custom_kernels ? kernel::gelu_new
-                                                             : gelu_new;
+    return select_kernel(
+        device, kernel::gelu_new, kernel::cpu::gelu_new, gelu_new);
   }
   if (boost::iequals(name, "gelu_pytorch_tanh")) {
     return gelu_pytorch_tanh;
@@ -99,8 +119,7 @@ ActFunc Activation::get_act_func(const std::string& name,
     return relu;
   }
   if (boost::iequals(name, "silu")) {
-    return device.is_cuda() && !FLAGS_disable_custom_kernels ? kernel::silu
-                                                             : silu;
+    return select_kernel(device, kernel::silu, kernel::cpu::silu, silu);
   }
 
   LOG(ERROR) << "Unsupported activation function: " << name;
@@ -115,14 +134,16 @@ ActFunc Activation::get_act_with_mul_func(const std::string& name,
     return gelu_with_mul;
   }
   if (boost::iequals(name, "gelu_fast")) {
-    return device.is_cuda() && !FLAGS_disable_custom_kernels
-               ? kernel::gelu_fast_with_mul
-               : gelu_fast_with_mul;
+    return select_kernel(device,
+                         kernel::gelu_fast_with_mul,
+                         kernel::cpu::gelu_fast_with_mul,
+                         gelu_fast_with_mul);
   }
   if (boost::iequals(name, "gelu_new")) {
-    return device.is_cuda() && !FLAGS_disable_custom_kernels
-               ? kernel::gelu_new_with_mul
-               : gelu_new_with_mul;
+    return select_kernel(device,
+                         kernel::gelu_new_with_mul,
+                         kernel::cpu::gelu_new_with_mul,
+                         gelu_new_with_mul);
   }
   if (boost::iequals(name, "gelu_pytorch_tanh")) {
     return gelu_pytorch_tanh_with_mul;
@@ -131,9 +152,10 @@ ActFunc Activation::get_act_with_mul_func(const std::string& name,
     return relu_with_mul;
   }
   if (boost::iequals(name, "silu")) {
-    return device.is_cuda() && !FLAGS_disable_custom_kernels
-               ? kernel::silu_with_mul
-               : silu_with_mul;
+    return select_kernel(device,
+                         kernel::silu_with_mul,
+                         kernel::cpu::silu_with_mul,
+                         silu_with_mul);
   }
 
   LOG(ERROR) << "Unsupported activation function: " << name;
@@ -70,6 +70,60 @@ std::tuple<torch::Tensor, torch::Tensor> get_kv_cache(
   return std::make_tuple(torch::stack(keys), torch::stack(values));
 }
 
+TEST(AttentionTreeMaskTest, RefHandler) {
+  const int64_t n_heads = 4;
+  const int64_t head_dim = 16;
+  const float sm_scale = 0.25;
+  const auto options = torch::dtype(torch::kFloat32);
+
+  // 3 prompt tokens, the root token and a token tree:
+  // root -> {node0 -> node1, node2}
+  const int64_t n_tokens = 7;
+  torch::Tensor query = torch::rand({n_tokens, n_heads, head_dim}, options);
+  torch::Tensor key = torch::rand({n_tokens, n_heads, head_dim}, options);
+  torch::Tensor value = torch::rand({n_tokens, n_heads, head_dim}, options);
+
+  // node2 can't see node0 and node1
+  auto tree_mask = torch::ones({n_tokens, n_tokens}, torch::kBool).tril();
+  tree_mask.index_put_({6, ISlice(4, 6)}, false);
+
+  InputParameters input_params;
+  input_params.q_cu_seq_lens = torch::tensor({0, 7}, torch::kInt32);
+  input_params.kv_cu_seq_lens = input_params.q_cu_seq_lens;
+  input_params.q_max_seq_len = n_tokens;
+  input_params.kv_max_seq_len = n_tokens;
+  input_params.tree_mask = tree_mask;
+
+  RefHandler ref_handler(sm_scale, /*logits_soft_cap=*/0, torch::nullopt);
+  torch::Tensor output = torch::empty_like(query);
+  ref_handler.batch_prefill(
+      query, key, value, input_params, /*sliding_window=*/-1, output);
+
+  // the tree is equivalent to causal attention along each path
+  input_params.tree_mask = torch::Tensor();
+  torch::Tensor causal_output = torch::empty_like(query);
+  ref_handler.batch_prefill(
+      query, key, value, input_params, /*sliding_window=*/-1, causal_output);
+  EXPECT_TRUE(torch::allclose(output.slice(/*dim=*/0, /*start=*/0, /*end=*/6),
+                              causal_output.slice(/*dim=*/0, 0, 6)));
+
+  // path: prompt tokens, root, node2
+  const auto idx = torch::tensor({0, 1, 2, 3, 6}, torch::kInt64);
+  input_params.q_cu_seq_lens = torch::tensor({0, 5}, torch::kInt32);
+  input_params.kv_cu_seq_lens = input_params.q_cu_seq_lens;
+  input_params.q_max_seq_len = 5;
+  input_params.kv_max_seq_len = 5;
+  const auto path_query = query.index_select(/*dim=*/0, idx);
+  torch::Tensor path_output = torch::empty_like(path_query);
+  ref_handler.batch_prefill(path_query,
+                            key.index_select(/*dim=*/0, idx),
+                            value.index_select(/*dim=*/0, idx),
+                            input_params,
+                            /*sliding_window=*/-1,
+                            path_output);
+  EXPECT_TRUE(torch::allclose(output[6], path_output[4]));
+}
+
 // Tests self-attention for prefill stage
 class AttentionPrefillTest
     : public ::testing::TestWithParam<std::tuple<torch::Device,
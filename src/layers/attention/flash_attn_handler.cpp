@@ -1,6 +1,7 @@
 #include "flash_attn_handler.h"
 
 #include <cuda_runtime.h>
+#include <glog/logging.h>
 #include <torch/torch.h>
 
 #include "kernels/attention/flash_attn/flash_api.h"
@@ -50,6 +51,8 @@ void FlashAttnHandler::batch_prefill(
     const InputParameters& input_params,  // input paras used for attention
     int32_t sliding_window,               // sliding window size
     torch::Tensor& output) {
+  CHECK(!input_params.tree_mask.defined())
+      << "tree attention mask is not supported by flash_attn";
   // don't use kv cache in prefill stage
   mha_varlen_fwd(output,
                  query,
@@ -77,6 +80,8 @@ void FlashAttnHandler::batch_decode(
     const InputParameters& input_params,  // input paras used for attention
     int32_t sliding_window,               // sliding window size
     torch::Tensor& output) {
+  CHECK(!input_params.tree_mask.defined())
+      << "tree attention mask is not supported by flash_attn";
   auto [key_cache, value_cache] = kv_cache.get_kv_cache();
   mha_varlen_fwd(output,
                  query,
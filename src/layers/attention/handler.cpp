@@ -82,6 +82,15 @@ std::unique_ptr<AttentionHandler> AttentionHandler::create_handler_with_alibi(
       sm_scale, args.attn_logit_soft_cap(), alibi_slopes);
 }
 
+// only the ref handler supports tree attention masks for now
+bool AttentionHandler::support_tree_mask(const torch::Device& device) {
+  if (boost::iequals(FLAGS_attention_handler, "pytorch")) {
+    return true;
+  }
+  // flash_attn is chosen for cuda devices
+  return !device.is_cuda();
+}
+
 // create an attention handler with ROPE
 std::unique_ptr<AttentionHandler> AttentionHandler::create_handler_with_rope(
     const ModelArgs& args,
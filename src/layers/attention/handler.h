@@ -73,6 +73,9 @@ class AttentionHandler {
       const ModelArgs& args,
       bool interleaved,
       const torch::TensorOptions& options);
+
+  // whether the handler chosen for the device supports tree attention masks
+  static bool support_tree_mask(const torch::Device& device);
 };
 
 }  // namespace llm
@@ -50,6 +50,7 @@ void varlen_masked_self_attention(
     const torch::Tensor& value,           // [n_tokens, n_kv_heads, head_dim]
     const torch::Tensor& q_cu_seq_lens,   // [n_seqs + 1]
     const torch::Tensor& kv_cu_seq_lens,  // [n_seqs + 1]
+    const torch::Tensor& tree_mask,       // [n_tokens, q_max_seq_len]
     const torch::optional<torch::Tensor> alibi_slopes,  // [n_heads]
     float sm_scale,
     float logits_soft_cap,
@@ -68,6 +69,14 @@ void varlen_masked_self_attention(
   const int32_t* q_cu_lens = q_cu_seq_lens_cpu.data_ptr<int32_t>();
   const int32_t* kv_cu_lens = kv_cu_seq_lens_cpu.data_ptr<int32_t>();
 
+  // alibi biases are based on token index instead of position
+  CHECK(!tree_mask.defined() || !alibi_slopes)
+      << "tree attention mask is not supported with alibi";
+  torch::Tensor tree_mask_cpu;
+  if (tree_mask.defined()) {
+    tree_mask_cpu = tree_mask.cpu();
+  }
+
   // process sequence one by one
   for (int64_t i = 0; i < n_seqs; ++i) {
     // calaculate attention for each sequence
@@ -106,7 +115,17 @@ void varlen_masked_self_attention(
 
     // causal mask
     // returns the lower triangular part of a matrix
-    mask = torch::tril(mask, /*diagonal=*/kv_len - q_len).to(query);
+    mask = torch::tril(mask, /*diagonal=*/kv_len - q_len);
+
+    // tree mask among query tokens, tokens in kv cache are always visible
+    if (tree_mask_cpu.defined()) {
+      auto q_mask = mask.slice(/*dim=*/-1, /*start=*/kv_len - q_len);
+      q_mask.logical_and_(
+          tree_mask_cpu.slice(/*dim=*/0, /*start=*/q_start, /*end=*/q_end)
+              .slice(/*dim=*/1, /*start=*/0, /*end=*/q_len)
+              .unsqueeze(/*dim=*/0));
+    }
+    mask = mask.to(query);
 
     torch::Tensor bias;
     if (alibi_slopes) {
@@ -115,7 +134,9 @@ void varlen_masked_self_attention(
 
       // calculate alibi attention bias
       // since it's causal mask, we can just use [0, 1, ...,, kv_len)
-      auto distance = torch::arange(0, kv_len, query.options());
+      // in float, half precision can't represent large distances exactly
+      auto distance =
+          torch::arange(0, kv_len, query.options().dtype(torch::kFloat32));
       // [n_heads, 1, kv_len]
       bias = distance.view({1, 1, kv_len}) * slopes.view({n_heads, 1, 1});
     }
@@ -173,6 +194,7 @@ void RefHandler::batch_prefill(
                                value,
                                input_params.q_cu_seq_lens,
                                input_params.kv_cu_seq_lens,
+                               input_params.tree_mask,
                                alibi_slopes_,
                                sm_scale_,
                                logits_soft_cap_,
@@ -197,6 +219,7 @@ void RefHandler::batch_decode(
                                value,
                                input_params.q_cu_seq_lens,
                                input_params.kv_cu_seq_lens,
+                               input_params.tree_mask,
                                alibi_slopes_,
                                sm_scale_,
                                logits_soft_cap_,
@@ -7,6 +7,7 @@
 
 #include "model_loader/state_dict.h"
 #include "model_parallel/model_parallel.h"
+#include "weight_utils.h"
 
 namespace llm {
 
@@ -39,7 +40,7 @@ class EmbeddingImpl : public torch::nn::Module {
     if (weight.defined()) {
       CHECK_EQ(weight_.sizes(), weight.sizes())
           << "weight size mismatch for " << name();
-      weight_.copy_(weight);
+      WeightUtils::assign_weight(state_dict, weight, weight_);
       is_loaded_ = true;
     }
   }
@@ -107,7 +108,7 @@ class ParallelEmbeddingImpl : public torch::nn::Module {
     if (weight.defined()) {
       CHECK_EQ(weight_.sizes(), weight.sizes())
           << "weight size mismatch for " << name();
-      weight_.copy_(weight);
+      WeightUtils::assign_weight(state_dict, weight, weight_);
       is_loaded_ = true;
     }
   }
@@ -187,7 +188,7 @@ class VocabParallelEmbeddingImpl : public torch::nn::Module {
     if (weight.defined()) {
       CHECK_EQ(weight_.sizes(), weight.sizes())
           << "weight size mismatch for " << name();
-      weight_.copy_(weight);
+      WeightUtils::assign_weight(state_dict, weight, weight_);
       is_loaded_ = true;
     }
   }
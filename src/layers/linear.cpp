@@ -10,8 +10,10 @@
 #include "quantization/qlinear_awq_impl.h"
 #include "quantization/qlinear_awq_marlin_impl.h"
 #include "quantization/qlinear_exllamav2_impl.h"
+#include "quantization/qlinear_gguf_impl.h"
 #include "quantization/qlinear_gptq_impl.h"
 #include "quantization/qlinear_gptq_marlin_impl.h"
+#include "quantization/qlinear_rtn_impl.h"
 
 DEFINE_string(
     qlinear_gptq_impl,
@@ -118,6 +120,33 @@ std::shared_ptr<ParallelLinearImpl> create_column_parallel_qlinear(
     const QuantArgs& quant_args,
     const ParallelArgs& parallel_args,
     const torch::TensorOptions& options) {
+  // gguf weights have their own block formats
+  if (boost::iequals(quant_args.quant_method(), "gguf")) {
+    return MAKE_COLUMN_PARALLEL_QLINEAR(ColumnParallelQLinearGGUFImpl);
+  }
+  // unquantized weights are quantized into gptq format when loaded
+  if (boost::iequals(quant_args.quant_method(), "rtn")) {
+    const int64_t world_size = parallel_args.world_size();
+    CHECK(out_features % world_size == 0)
+        << "out_features " << out_features << " not divisible by world_size "
+        << world_size;
+    auto qlinear = create_column_parallel_qlinear(
+        in_features,
+        out_features / world_size,
+        /*bias=*/false,
+        /*gather_output=*/false,
+        detail::rtn_gptq_quant_args(quant_args),
+        ParallelArgs(0, 1, nullptr),
+        options);
+    return std::make_shared<ColumnParallelQLinearRTNImpl>(in_features,
+                                                          out_features,
+                                                          bias,
+                                                          quant_args,
+                                                          gather_output,
+                                                          parallel_args,
+                                                          options,
+                                                          std::move(qlinear));
+  }
   if (auto qlinear = create_column_parallel_qlinear_by_impl(in_features,
                                                             out_features,
                                                             bias,
@@ -127,6 +156,31 @@ std::shared_ptr<ParallelLinearImpl> create_column_parallel_qlinear(
                                                             options)) {
     return qlinear;
   }
+  if (options.device().is_cpu()) {
+    // marlin kernels are cuda only, dequantize tiles on the fly with cpu
+    // kernels instead
+    if (boost::iequals(quant_args.quant_method(), "gptq")) {
+      return std::make_shared<ColumnParallelQLinearImpl>(in_features,
+                                                         out_features,
+                                                         bias,
+                                                         quant_args,
+                                                         /*qweight_pack_dim=*/0,
+                                                         gather_output,
+                                                         parallel_args,
+                                                         options);
+    }
+    if (boost::iequals(quant_args.quant_method(), "awq") ||
+        boost::iequals(quant_args.quant_method(), "GEMM")) {
+      return std::make_shared<ColumnParallelQLinearImpl>(in_features,
+                                                         out_features,
+                                                         bias,
+                                                         quant_args,
+                                                         /*qweight_pack_dim=*/1,
+                                                         gather_output,
+                                                         parallel_args,
+                                                         options);
+    }
+  }
   if (boost::iequals(quant_args.quant_method(), "gptq")) {
     // default to use marlin implementation for gptq
     return MAKE_COLUMN_PARALLEL_QLINEAR(ColumnParallelQLinearGPTQMarlinImpl);
@@ -149,6 +203,33 @@ std::shared_ptr<ParallelLinearImpl> create_row_parallel_qlinear(
     const QuantArgs& quant_args,
     const ParallelArgs& parallel_args,
     const torch::TensorOptions& options) {
+  // gguf weights have their own block formats
+  if (boost::iequals(quant_args.quant_method(), "gguf")) {
+    return MAKE_ROW_PARALLEL_QLINEAR(RowParallelQLinearGGUFImpl);
+  }
+  // unquantized weights are quantized into gptq format when loaded
+  if (boost::iequals(quant_args.quant_method(), "rtn")) {
+    const int64_t world_size = parallel_args.world_size();
+    CHECK(in_features % world_size == 0)
+        << "in_features " << in_features << " not divisible by world_size "
+        << world_size;
+    auto qlinear = create_row_parallel_qlinear(
+        in_features / world_size,
+        out_features,
+        /*bias=*/false,
+        /*input_is_parallelized=*/true,
+        detail::rtn_gptq_quant_args(quant_args),
+        ParallelArgs(0, 1, nullptr),
+        options);
+    return std::make_shared<RowParallelQLinearRTNImpl>(in_features,
+                                                       out_features,
+                                                       bias,
+                                                       quant_args,
+                                                       input_is_parallelized,
+                                                       parallel_args,
+                                                       options,
+                                                       std::move(qlinear));
+  }
   if (auto qlinear = create_row_parallel_qlinear_by_impl(in_features,
                                                          out_features,
                                                          bias,
@@ -158,6 +239,31 @@ std::shared_ptr<ParallelLinearImpl> create_row_parallel_qlinear(
                                                          options)) {
     return qlinear;
   }
+  if (options.device().is_cpu()) {
+    // marlin kernels are cuda only, dequantize tiles on the fly with cpu
+    // kernels instead
+    if (boost::iequals(quant_args.quant_method(), "gptq")) {
+      return std::make_shared<RowParallelQLinearImpl>(in_features,
+                                                      out_features,
+                                                      bias,
+                                                      quant_args,
+                                                      /*qweight_pack_dim=*/0,
+                                                      input_is_parallelized,
+                                                      parallel_args,
+                                                      options);
+    }
+    if (boost::iequals(quant_args.quant_method(), "awq") ||
+        boost::iequals(quant_args.quant_method(), "GEMM")) {
+      return std::make_shared<RowParallelQLinearImpl>(in_features,
+                                                      out_features,
+                                                      bias,
+                                                      quant_args,
+                                                      /*qweight_pack_dim=*/1,
+                                                      input_is_parallelized,
+                                                      parallel_args,
+                                                      options);
+    }
+  }
   if (boost::iequals(quant_args.quant_method(), "gptq")) {
     // default to use marlin implementation for gptq
     return MAKE_ROW_PARALLEL_QLINEAR(RowParallelQLinearGPTQMarlinImpl);
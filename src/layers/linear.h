@@ -24,6 +24,10 @@ class ParallelLinearImpl : public torch::nn::Module {
 
   virtual void verify_loaded_weights(const std::string& prefix = "") const = 0;
 
+  // called once all weights are loaded, to prepare weights for faster
+  // forward without changing the registered parameters
+  virtual void prepack_weights() {}
+
   // load state dict with a transform function
   virtual void load_state_dict(const StateDict& /*state_dict*/,
                                TensorTransform /*transform_func*/) {
@@ -1,13 +1,46 @@
 #include "linear_impl.h"
 
 #include <c10/core/TensorImpl.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <torch/torch.h>
 
+#include "kernels/cpu/linear_kernels.h"
 #include "model_loader/state_dict.h"
 #include "model_parallel/model_parallel.h"
 
+DEFINE_bool(prepack_cpu_weights,
+            false,
+            "prepack weights of linear layers on cpu into panels once "
+            "loaded, for faster decoding. the packed copy is private memory "
+            "on top of the row-major weights, which may be shared mappings");
+
 namespace llm {
+namespace {
+torch::Tensor linear(const torch::Tensor& input,
+                     const torch::Tensor& weight,
+                     const torch::Tensor& packed_weight,
+                     const torch::Tensor& bias) {
+  if (!input.device().is_cpu()) {
+    namespace F = torch::nn::functional;
+    return F::linear(input, weight, bias);
+  }
+  if (packed_weight.defined()) {
+    return kernel::cpu::packed_linear(input, weight, packed_weight, bias);
+  }
+  return kernel::cpu::linear(input, weight, bias);
+}
+
+// the row-major weight is kept for prefill and for saving and reloading
+torch::Tensor prepack_weight(const torch::Tensor& weight) {
+  if (!FLAGS_prepack_cpu_weights || !weight.device().is_cpu() ||
+      weight.size(0) % kernel::cpu::kPackedPanelSize != 0) {
+    return torch::Tensor();
+  }
+  torch::NoGradGuard no_grad;
+  return kernel::cpu::prepack_linear_weight(weight);
+}
+}  // namespace
 
 // Linear layer with column parallelism.
 ColumnParallelLinearImpl::ColumnParallelLinearImpl(
@@ -40,14 +73,17 @@ ColumnParallelLinearImpl::ColumnParallelLinearImpl(
 }
 
 torch::Tensor ColumnParallelLinearImpl::forward(torch::Tensor input) {
-  namespace F = torch::nn::functional;
-  auto output = F::linear(input, weight_, bias_);
+  auto output = linear(input, weight_, packed_weight_, bias_);
   if (parallel_args_.world_size() > 1 && gather_output_) {
     output = gather_from_model_parallel_region(output, parallel_args_);
   }
   return output;
 }
 
+void ColumnParallelLinearImpl::prepack_weights() {
+  packed_weight_ = prepack_weight(weight_);
+}
+
 // load the weight from the checkpoint
 void ColumnParallelLinearImpl::load_state_dict(const StateDict& state_dict) {
   // call load_state_dict with identity transform
@@ -58,6 +94,8 @@ void ColumnParallelLinearImpl::load_state_dict(const StateDict& state_dict) {
 void ColumnParallelLinearImpl::load_state_dict(const StateDict& state_dict,
                                                TensorTransform transform_func) {
   CHECK(transform_func != nullptr) << "transform_func must be provided";
+  // stale once the weight is reloaded
+  packed_weight_.reset();
   const auto rank = parallel_args_.rank();
   const auto world_size = parallel_args_.world_size();
 
@@ -74,6 +112,8 @@ void ColumnParallelLinearImpl::load_state_dict(const StateDict& state_dict,
 void ColumnParallelLinearImpl::load_state_dict(
     const StateDict& state_dict,
     const std::vector<std::string>& prefixes) {
+  // stale once the weight is reloaded
+  packed_weight_.reset();
   const auto rank = parallel_args_.rank();
   const auto world_size = parallel_args_.world_size();
 
@@ -115,11 +155,11 @@ RowParallelLinearImpl::RowParallelLinearImpl(
 }
 
 torch::Tensor RowParallelLinearImpl::forward(torch::Tensor input) {
-  namespace F = torch::nn::functional;
   if (!input_is_parallelized_) {
     input = scatter_to_model_parallel_region(input, parallel_args_);
   }
-  auto output = F::linear(input, weight_);
+  auto output =
+      linear(input, weight_, packed_weight_, /*bias=*/torch::Tensor());
   if (parallel_args_.world_size() > 1) {
     output = reduce_from_model_parallel_region(output, parallel_args_);
   }
@@ -130,8 +170,14 @@ torch::Tensor RowParallelLinearImpl::forward(torch::Tensor input) {
   return output;
 }
 
+void RowParallelLinearImpl::prepack_weights() {
+  packed_weight_ = prepack_weight(weight_);
+}
+
 // load the weight from the checkpoint
 void RowParallelLinearImpl::load_state_dict(const StateDict& state_dict) {
+  // stale once the weight is reloaded
+  packed_weight_.reset();
   const auto rank = parallel_args_.rank();
   const auto world_size = parallel_args_.world_size();
 
@@ -23,6 +23,9 @@ class ColumnParallelLinearImpl : public ParallelLinearImpl {
 
   torch::Tensor forward(torch::Tensor input) override;
 
+  // prepack the loaded weight for cpu gemm
+  void prepack_weights() override;
+
   // load the weight from the checkpoint
   void load_state_dict(const StateDict& state_dict) override;
 
@@ -56,6 +59,9 @@ class ColumnParallelLinearImpl : public ParallelLinearImpl {
   DEFINE_FUSED_WEIGHT(weight);
   DEFINE_FUSED_WEIGHT(bias);
 
+  // weight prepacked for cpu gemm once loaded, empty if not packed
+  torch::Tensor packed_weight_;
+
   // whether to gather the output
   bool gather_output_;
 
@@ -84,6 +90,9 @@ class RowParallelLinearImpl : public ParallelLinearImpl {
 
   torch::Tensor forward(torch::Tensor input) override;
 
+  // prepack the loaded weight for cpu gemm
+  void prepack_weights() override;
+
   // load the weight from the checkpoint
   void load_state_dict(const StateDict& state_dict) override;
 
@@ -109,6 +118,9 @@ class RowParallelLinearImpl : public ParallelLinearImpl {
   DEFINE_WEIGHT(weight);
   DEFINE_WEIGHT(bias);
 
+  // weight prepacked for cpu gemm once loaded, empty if not packed
+  torch::Tensor packed_weight_;
+
   // whether the input is already parallelized
   bool input_is_parallelized_;
 
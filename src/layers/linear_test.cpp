@@ -1,5 +1,6 @@
 #include <c10/core/Device.h>
 #include <c10/core/ScalarType.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <torch/torch.h>
@@ -11,6 +12,8 @@
 #include "linear_impl.h"
 #include "model_loader/state_dict.h"
 
+DECLARE_bool(prepack_cpu_weights);
+
 namespace llm {
 
 TEST(LinearTest, RowParallelLoadWeight) {
@@ -235,4 +238,53 @@ TEST(LinearTest, ColumnParallelLoadFusedWeight) {
   }
 }
 
+TEST(LinearTest, PrepackedForwardCPU) {
+  gflags::FlagSaver flag_saver;
+  FLAGS_prepack_cpu_weights = true;
+
+  const int64_t in_features = 64;
+  const int64_t out_features = 48;
+  const auto options = torch::dtype(torch::kFloat).device(torch::kCPU);
+  ParallelArgs parallel_args(0, 1, nullptr);
+  ColumnParallelLinearImpl column(in_features,
+                                  out_features,
+                                  /*bias=*/true,
+                                  /*gather_output=*/false,
+                                  parallel_args,
+                                  options);
+  RowParallelLinearImpl row(in_features,
+                            out_features,
+                            /*bias=*/true,
+                            /*input_is_parallelized=*/true,
+                            parallel_args,
+                            options);
+
+  namespace F = torch::nn::functional;
+  // packed weights are rebuilt after reloading
+  for (int reload = 0; reload < 2; ++reload) {
+    const auto weight = torch::randn({out_features, in_features});
+    const auto bias = torch::randn({out_features});
+    StateDict state_dict({{"weight", weight}, {"bias", bias}});
+    column.load_state_dict(state_dict);
+    row.load_state_dict(state_dict);
+    column.prepack_weights();
+    row.prepack_weights();
+
+    // packed and row-major paths
+    for (const int64_t n_tokens : {1, 3, 64}) {
+      const auto input = torch::randn({n_tokens, in_features}, options);
+      const auto desired_output = F::linear(input, weight, bias);
+      EXPECT_TRUE(torch::allclose(column.forward(input),
+                                  desired_output,
+                                  /*rtol=*/1e-4,
+                                  /*atol=*/1e-4));
+      EXPECT_TRUE(torch::allclose(
+          row.forward(input), desired_output, /*rtol=*/1e-4, /*atol=*/1e-4));
+    }
+    // registered weights are kept as loaded
+    EXPECT_TRUE(torch::equal(column.weight(), weight));
+    EXPECT_TRUE(torch::equal(row.weight(), weight));
+  }
+}
+
 }  // namespace llm
@@ -5,6 +5,7 @@
 #include <glog/logging.h>
 #include <torch/torch.h>
 
+#include "kernels/cpu/norm_kernels.h"
 #include "kernels/layernorm_kernels.h"
 #include "model_loader/state_dict.h"
 
@@ -158,6 +159,11 @@ class RMSNormImpl : public torch::nn::Module {
       kernel::rms_norm(output, input, weight_, eps_);
       return output;
     }
+    if (input.is_cpu() && !FLAGS_disable_custom_kernels) {
+      auto output = torch::empty(input.sizes(), input.options());
+      kernel::cpu::rms_norm(output, input, weight_, eps_);
+      return output;
+    }
     return detail::rms_norm(input, weight_, eps_);
   }
 
@@ -208,6 +214,11 @@ class GemmaRMSNormImpl : public torch::nn::Module {
       kernel::gemma_rms_norm(output, input, weight_, eps_);
       return output;
     }
+    if (input.is_cpu() && !FLAGS_disable_custom_kernels) {
+      auto output = torch::empty(input.sizes(), input.options());
+      kernel::cpu::gemma_rms_norm(output, input, weight_, eps_);
+      return output;
+    }
     return detail::gemma_rms_norm(input, weight_, eps_);
   }
 
@@ -266,6 +277,16 @@ class RMSNormResidualImpl : public torch::nn::Module {
       }
       return output;
     }
+    if (input.is_cpu() && !FLAGS_disable_custom_kernels) {
+      auto output = torch::empty(input.sizes(), input.options());
+      if (residual.defined()) {
+        kernel::cpu::rms_norm_residual(output, residual, input, weight_, eps_);
+      } else {
+        residual = input;
+        kernel::cpu::rms_norm(output, input, weight_, eps_);
+      }
+      return output;
+    }
 
     if (residual.defined()) {
       return detail::rms_norm_residual(input, residual, weight_, eps_);
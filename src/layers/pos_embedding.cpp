@@ -7,6 +7,7 @@
 #include <memory>
 
 #include "common/slice.h"
+#include "kernels/cpu/pos_embedding_kernels.h"
 #include "kernels/pos_embedding_kernels.h"
 
 DEFINE_bool(disable_custom_kernels, false, "disable all custom kernels");
@@ -59,7 +60,8 @@ std::shared_ptr<RotaryEmbeddingImpl> create(
     torch::Tensor inv_freq,
     bool interleaved,
     const torch::TensorOptions& options) {
-  if (options.device().is_cuda() && !FLAGS_disable_custom_kernels) {
+  const auto& device = options.device();
+  if ((device.is_cuda() || device.is_cpu()) && !FLAGS_disable_custom_kernels) {
     // use custom kernels
     return std::make_shared<RotaryEmbeddingKernel>(
         rotary_dim, max_position_embeddings, inv_freq, interleaved, options);
@@ -155,7 +157,12 @@ RotaryEmbeddingGeneric::RotaryEmbeddingGeneric(
   }
 
   const auto cos_sin = torch::cat({emd.cos(), emd.sin()}, /*dim=*/-1);
-  cos_sin_cache_ = register_buffer("cos_sin_cache", cos_sin.to(options));
+  // keep float precision on cpu, where rotations of half precision inputs
+  // are computed in float as well
+  const auto cache_options =
+      options.device().is_cpu() ? options.dtype(torch::kFloat32) : options;
+  cos_sin_cache_ =
+      register_buffer("cos_sin_cache", cos_sin.to(cache_options));
 }
 
 // inplace rotary positional embedding
@@ -174,10 +181,15 @@ std::tuple<torch::Tensor, torch::Tensor> RotaryEmbeddingGeneric::forward(
   auto cos_sin = F::embedding(positions, cos_sin_cache_);
   // add a new dimension for n_heads
   cos_sin = cos_sin.unsqueeze(1);
-  std::tie(query_rotary, key_rotary) = detail::apply_rotary_pos_emb(
-      query_rotary, key_rotary, cos_sin, interleaved_);
-  return std::make_tuple(torch::cat({query_rotary, query_pass}, /*dim=*/-1),
-                         torch::cat({key_rotary, key_pass}, /*dim=*/-1));
+  std::tie(query_rotary, key_rotary) =
+      detail::apply_rotary_pos_emb(query_rotary.to(cos_sin.scalar_type()),
+                                   key_rotary.to(cos_sin.scalar_type()),
+                                   cos_sin,
+                                   interleaved_);
+  return std::make_tuple(
+      torch::cat({query_rotary.to(query.scalar_type()), query_pass},
+                 /*dim=*/-1),
+      torch::cat({key_rotary.to(key.scalar_type()), key_pass}, /*dim=*/-1));
 }
 
 RotaryEmbeddingKernel::RotaryEmbeddingKernel(
@@ -193,7 +205,11 @@ RotaryEmbeddingKernel::RotaryEmbeddingKernel(
   const auto freqs = torch::einsum("i,j->ij", {t, inv_freq});
 
   const auto cos_sin = torch::cat({freqs.cos(), freqs.sin()}, /*dim=*/-1);
-  cos_sin_cache_ = register_buffer("cos_sin_cache", cos_sin.to(options));
+  // cpu kernels rotate in float
+  const auto cache_options =
+      options.device().is_cpu() ? options.dtype(torch::kFloat32) : options;
+  cos_sin_cache_ =
+      register_buffer("cos_sin_cache", cos_sin.to(cache_options));
 }
 
 // inplace rotary positional embedding
@@ -205,6 +221,15 @@ std::tuple<torch::Tensor, torch::Tensor> RotaryEmbeddingKernel::forward(
   DCHECK_GE(query.size(-1), rotary_dim_);
   torch::Tensor _query = query;
   torch::Tensor _key = key;
+  if (query.is_cpu()) {
+    kernel::cpu::apply_rotary_pos_emb(_query,
+                                      _key,
+                                      positions,
+                                      cos_sin_cache_,
+                                      static_cast<int>(rotary_dim_),
+                                      interleaved_);
+    return std::make_tuple(query, key);
+  }
   kernel::apply_rotary_pos_emb(_query,
                                _key,
                                positions,
@@ -2,6 +2,26 @@
 
 namespace llm {
 
+void WeightUtils::assign_weight(const StateDict& state_dict,
+                                const torch::Tensor& tensor,
+                                torch::Tensor& weight) {
+  if (!weight.device().is_cpu()) {
+    weight.copy_(tensor);
+    return;
+  }
+  if (state_dict.is_memory_mapped() && tensor.device().is_cpu() &&
+      weight.scalar_type() == tensor.scalar_type() && tensor.is_contiguous()) {
+    // the storage of the tensor keeps the memory mapping alive
+    weight.set_data(tensor);
+  } else {
+    // copy into new memory, the weight may alias a read-only mapping
+    weight.set_data(tensor.to(weight.options(),
+                              /*non_blocking=*/false,
+                              /*copy=*/true,
+                              torch::MemoryFormat::Contiguous));
+  }
+}
+
 void WeightUtils::load_weight(const StateDict& state_dict,
                               const std::string& name,
                               torch::Tensor& weight,
@@ -12,7 +32,7 @@ void WeightUtils::load_weight(const StateDict& state_dict,
         << "weight already loaded, name: " << state_dict.prefix() << name;
     CHECK_EQ(weight.sizes(), tensor.sizes())
         << "weight size mismatch for " << state_dict.prefix() << name;
-    weight.copy_(tensor);
+    assign_weight(state_dict, tensor, weight);
     weight_is_loaded = true;
   }
 }
@@ -29,7 +49,7 @@ void WeightUtils::load_sharded_weight(const StateDict& state_dict,
   if (tensor.defined()) {
     CHECK_EQ(weight.sizes(), tensor.sizes())
         << "weight size mismatch for " << state_dict.prefix() << name;
-    weight.copy_(tensor);
+    assign_weight(state_dict, tensor, weight);
     weight_is_loaded = true;
   }
 }
@@ -49,7 +69,7 @@ void WeightUtils::load_sharded_weight(const StateDict& state_dict,
         << "weight already loaded, name: " << state_dict.prefix() << name;
     CHECK_EQ(weight.sizes(), tensor.sizes())
         << "weight size mismatch for " << state_dict.prefix() << name;
-    weight.copy_(tensor);
+    assign_weight(state_dict, tensor, weight);
     weight_is_loaded = true;
   }
 }
@@ -104,7 +124,7 @@ void WeightUtils::load_fused_weight(
     const auto merged_weight = torch::cat(tensors, /*dim=*/dim);
     CHECK_EQ(weight.sizes(), merged_weight.sizes())
         << "weight size mismatch for " << state_dict.prefix() << name;
-    weight.copy_(merged_weight);
+    assign_weight(state_dict, merged_weight, weight);
     // release the memory for weight_list
     accumulated_tensors.clear();
     weight_is_loaded = true;
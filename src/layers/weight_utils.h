@@ -10,6 +10,15 @@ namespace llm {
 
 class WeightUtils {
  public:
+  // set the weight to the loaded tensor. cpu weights alias tensors of memory
+  // mapped state dicts if the dtype matches and the tensor is contiguous,
+  // so that pages are shared across processes instead of copied. such
+  // weights are read-only, and are replaced instead of written in place when
+  // loaded again.
+  static void assign_weight(const StateDict& state_dict,
+                            const torch::Tensor& tensor,
+                            torch::Tensor& weight);
+
   static void load_weight(const StateDict& state_dict,
                           const std::string& name,
                           torch::Tensor& weight,
@@ -52,7 +52,10 @@ DEFINE_string(residual_post_layernorm,
               "whether to apply residual after layernorm");
 
 // define gflags for all quant args defined in src/models/args.h
-DEFINE_string(quant_method, "", "quantization method, e.g. awq, gptq");
+DEFINE_string(quant_method,
+              "",
+              "quantization method, e.g. awq, gptq, or rtn to quantize "
+              "unquantized weights when loaded");
 DEFINE_string(bits, "", "number of bits for quantization");
 DEFINE_string(group_size, "", "group size for quantization");
 DEFINE_string(desc_act, "", "desc_act for quantization");
@@ -0,0 +1,467 @@
+#include "gguf_file.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+#include "kernels/quantization/ggml/ggml_kernels.h"
+
+namespace llm {
+namespace {
+// "GGUF" in little endian
+constexpr uint32_t kMagic = 0x46554747;
+constexpr uint64_t kDefaultAlignment = 32;
+// the max nesting depth of metadata arrays
+constexpr int kMaxArrayDepth = 8;
+
+// value types of metadata
+enum class ValueType : uint32_t {
+  UINT8 = 0,
+  INT8 = 1,
+  UINT16 = 2,
+  INT16 = 3,
+  UINT32 = 4,
+  INT32 = 5,
+  FLOAT32 = 6,
+  BOOL = 7,
+  STRING = 8,
+  ARRAY = 9,
+  UINT64 = 10,
+  INT64 = 11,
+  FLOAT64 = 12,
+};
+
+// bounds checked reader over the mapped file
+class Reader {
+ public:
+  Reader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  template <typename T>
+  bool read(T* value) {
+    if (sizeof(T) > size_ - pos_) {
+      return false;
+    }
+    std::memcpy(value, data_ + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  bool read_string(std::string* value) {
+    uint64_t len = 0;
+    if (!read(&len) || len > size_ - pos_) {
+      return false;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    value->assign(reinterpret_cast<const char*>(data_ + pos_), len);
+    pos_ += len;
+    return true;
+  }
+
+  size_t pos() const { return pos_; }
+
+  size_t remaining() const { return size_ - pos_; }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  size_t pos_ = 0;
+};
+
+// read a scalar of integer or bool type, widened to int64_t
+bool read_integer(Reader& reader, ValueType type, int64_t* value) {
+  switch (type) {
+    case ValueType::UINT8:
+    case ValueType::BOOL: {
+      uint8_t v = 0;
+      return reader.read(&v) && ((*value = v), true);
+    }
+    case ValueType::INT8: {
+      int8_t v = 0;
+      return reader.read(&v) && ((*value = v), true);
+    }
+    case ValueType::UINT16: {
+      uint16_t v = 0;
+      return reader.read(&v) && ((*value = v), true);
+    }
+    case ValueType::INT16: {
+      int16_t v = 0;
+      return reader.read(&v) && ((*value = v), true);
+    }
+    case ValueType::UINT32: {
+      uint32_t v = 0;
+      return reader.read(&v) && ((*value = v), true);
+    }
+    case ValueType::INT32: {
+      int32_t v = 0;
+      return reader.read(&v) && ((*value = v), true);
+    }
+    case ValueType::UINT64: {
+      uint64_t v = 0;
+      return reader.read(&v) && ((*value = static_cast<int64_t>(v)), true);
+    }
+    case ValueType::INT64: {
+      int64_t v = 0;
+      return reader.read(&v) && ((*value = v), true);
+    }
+    default:
+      return false;
+  }
+}
+
+bool is_integer(ValueType type) {
+  switch (type) {
+    case ValueType::UINT8:
+    case ValueType::INT8:
+    case ValueType::UINT16:
+    case ValueType::INT16:
+    case ValueType::UINT32:
+    case ValueType::INT32:
+    case ValueType::UINT64:
+    case ValueType::INT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// read a scalar of float type, widened to double
+bool read_float(Reader& reader, ValueType type, double* value) {
+  if (type == ValueType::FLOAT32) {
+    float v = 0;
+    return reader.read(&v) && ((*value = v), true);
+  }
+  if (type == ValueType::FLOAT64) {
+    return reader.read(value);
+  }
+  return false;
+}
+
+// multiply with overflow check
+bool checked_mul(uint64_t a, uint64_t b, uint64_t* result) {
+  if (b != 0 && a > std::numeric_limits<uint64_t>::max() / b) {
+    return false;
+  }
+  *result = a * b;
+  return true;
+}
+
+// the smallest encoded size of a value, 0 for unknown types
+uint64_t min_value_size(ValueType type) {
+  switch (type) {
+    case ValueType::UINT8:
+    case ValueType::INT8:
+    case ValueType::BOOL:
+      return 1;
+    case ValueType::UINT16:
+    case ValueType::INT16:
+      return 2;
+    case ValueType::UINT32:
+    case ValueType::INT32:
+    case ValueType::FLOAT32:
+      return 4;
+    case ValueType::UINT64:
+    case ValueType::INT64:
+    case ValueType::FLOAT64:
+      return 8;
+    // the length of the string
+    case ValueType::STRING:
+      return 8;
+    // the element type and count of the array
+    case ValueType::ARRAY:
+      return 12;
+    default:
+      return 0;
+  }
+}
+
+// read the element type and count of an array, rejecting counts that can't
+// fit in the rest of the file before anything is allocated for them
+bool read_array_header(Reader& reader, ValueType* elem_type, uint64_t* count) {
+  uint32_t raw_elem_type = 0;
+  if (!reader.read(&raw_elem_type) || !reader.read(count)) {
+    return false;
+  }
+  *elem_type = static_cast<ValueType>(raw_elem_type);
+  const uint64_t elem_size = min_value_size(*elem_type);
+  uint64_t bytes = 0;
+  return elem_size > 0 && checked_mul(*count, elem_size, &bytes) &&
+         bytes <= reader.remaining();
+}
+
+// skip a value of any type, used for nested arrays
+bool skip_value(Reader& reader, ValueType type, int depth) {
+  if (type == ValueType::STRING) {
+    std::string v;
+    return reader.read_string(&v);
+  }
+  if (type == ValueType::FLOAT32 || type == ValueType::FLOAT64) {
+    double v = 0;
+    return read_float(reader, type, &v);
+  }
+  if (type == ValueType::ARRAY) {
+    ValueType elem_type = ValueType::UINT8;
+    uint64_t count = 0;
+    if (depth >= kMaxArrayDepth ||
+        !read_array_header(reader, &elem_type, &count)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+      if (!skip_value(reader, elem_type, depth + 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  int64_t v = 0;
+  return read_integer(reader, type, &v);
+}
+
+}  // namespace
+
+std::unique_ptr<GGUFFile> GGUFFile::open(const std::string& path) {
+  std::unique_ptr<GGUFFile> file(new GGUFFile());
+  if (!file->parse(path)) {
+    return nullptr;
+  }
+  return file;
+}
+
+bool GGUFFile::parse(const std::string& path) {
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(path, ec)) {
+    LOG(ERROR) << "Failed to find gguf file " << path;
+    return false;
+  }
+
+  // pages are faulted in on first access or by prefetch()
+  folly::MemoryMapping::Options options;
+  options.setReadable(true);
+  mem_map_ = std::make_shared<folly::MemoryMapping>(path.c_str(),
+                                                    0,   // offset
+                                                    -1,  // length
+                                                    options);
+  const folly::ByteRange content = mem_map_->range();
+  data_ = content.data();
+  size_ = content.size();
+
+  Reader reader(data_, size_);
+  uint32_t magic = 0;
+  if (!reader.read(&magic) || magic != kMagic) {
+    LOG(ERROR) << "Invalid gguf magic in " << path;
+    return false;
+  }
+  // version 1 used 32 bits counts and is long deprecated
+  if (!reader.read(&version_) || version_ < 2) {
+    LOG(ERROR) << "Unsupported gguf version " << version_ << " in " << path;
+    return false;
+  }
+  uint64_t n_tensors = 0;
+  uint64_t n_kv = 0;
+  if (!reader.read(&n_tensors) || !reader.read(&n_kv)) {
+    LOG(ERROR) << "Truncated gguf header in " << path;
+    return false;
+  }
+
+  // metadata key-value pairs
+  for (uint64_t i = 0; i < n_kv; ++i) {
+    std::string key;
+    uint32_t raw_type = 0;
+    if (!reader.read_string(&key) || !reader.read(&raw_type)) {
+      LOG(ERROR) << "Truncated gguf metadata in " << path;
+      return false;
+    }
+    const auto type = static_cast<ValueType>(raw_type);
+    bool ok = true;
+    if (type == ValueType::STRING) {
+      std::string v;
+      ok = reader.read_string(&v);
+      metadata_[key] = std::move(v);
+    } else if (type == ValueType::BOOL) {
+      int64_t v = 0;
+      ok = read_integer(reader, type, &v);
+      metadata_[key] = v != 0;
+    } else if (type == ValueType::FLOAT32 || type == ValueType::FLOAT64) {
+      double v = 0;
+      ok = read_float(reader, type, &v);
+      metadata_[key] = v;
+    } else if (is_integer(type)) {
+      int64_t v = 0;
+      ok = read_integer(reader, type, &v);
+      metadata_[key] = v;
+    } else if (type == ValueType::ARRAY) {
+      ValueType elem_type = ValueType::UINT8;
+      uint64_t count = 0;
+      ok = read_array_header(reader, &elem_type, &count);
+      if (ok && elem_type == ValueType::STRING) {
+        std::vector<std::string> values(count);
+        for (uint64_t j = 0; ok && j < count; ++j) {
+          ok = reader.read_string(&values[j]);
+        }
+        metadata_[key] = std::move(values);
+      } else if (ok && (elem_type == ValueType::FLOAT32 ||
+                        elem_type == ValueType::FLOAT64)) {
+        std::vector<double> values(count);
+        for (uint64_t j = 0; ok && j < count; ++j) {
+          ok = read_float(reader, elem_type, &values[j]);
+        }
+        metadata_[key] = std::move(values);
+      } else if (ok &&
+                 (is_integer(elem_type) || elem_type == ValueType::BOOL)) {
+        std::vector<int64_t> values(count);
+        for (uint64_t j = 0; ok && j < count; ++j) {
+          ok = read_integer(reader, elem_type, &values[j]);
+        }
+        metadata_[key] = std::move(values);
+      } else {
+        // nested arrays are not used by models, skip them
+        for (uint64_t j = 0; ok && j < count; ++j) {
+          ok = skip_value(reader, elem_type, /*depth=*/1);
+        }
+      }
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      LOG(ERROR) << "Failed to read gguf metadata " << key << " in " << path;
+      return false;
+    }
+  }
+
+  // tensor infos
+  tensors_.reserve(std::min<uint64_t>(n_tensors, reader.remaining()));
+  for (uint64_t i = 0; i < n_tensors; ++i) {
+    TensorInfo info;
+    uint32_t n_dims = 0;
+    if (!reader.read_string(&info.name) || !reader.read(&n_dims) ||
+        n_dims > 4) {
+      LOG(ERROR) << "Invalid gguf tensor info in " << path;
+      return false;
+    }
+    info.dims.resize(n_dims);
+    for (uint32_t j = 0; j < n_dims; ++j) {
+      uint64_t dim = 0;
+      if (!reader.read(&dim) || dim == 0 ||
+          dim > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+        LOG(ERROR) << "Invalid gguf tensor info in " << path;
+        return false;
+      }
+      info.dims[j] = static_cast<int64_t>(dim);
+    }
+    if (!reader.read(&info.type) || !reader.read(&info.offset)) {
+      LOG(ERROR) << "Invalid gguf tensor info in " << path;
+      return false;
+    }
+    tensors_.push_back(std::move(info));
+  }
+
+  // the data section starts at the next aligned offset
+  const uint64_t alignment =
+      get_int("general.alignment").value_or(kDefaultAlignment);
+  if (alignment == 0) {
+    LOG(ERROR) << "Invalid gguf alignment in " << path;
+    return false;
+  }
+  data_offset_ = (reader.pos() + alignment - 1) / alignment * alignment;
+
+  // check tensors are within the file
+  for (const auto& info : tensors_) {
+    const auto type = static_cast<kernel::ggml::GGMLType>(info.type);
+    if (!kernel::ggml::is_known(type)) {
+      // data of unknown types can't be used anyway
+      continue;
+    }
+    const int64_t n = info.dims.empty() ? 1 : info.dims[0];
+    const int64_t block_size = kernel::ggml::block_size(type);
+    if (n % block_size != 0) {
+      LOG(ERROR) << "Invalid shape of gguf tensor " << info.name << " in "
+                 << path;
+      return false;
+    }
+    // rows of n / block_size blocks, checked against overflow
+    uint64_t bytes = 0;
+    bool ok = checked_mul(n / block_size,
+                          kernel::ggml::row_bytes(type, block_size),
+                          &bytes);
+    for (size_t j = 1; ok && j < info.dims.size(); ++j) {
+      ok = checked_mul(bytes, info.dims[j], &bytes);
+    }
+    if (!ok || data_offset_ > size_ || info.offset > size_ - data_offset_ ||
+        bytes > size_ - data_offset_ - info.offset) {
+      LOG(ERROR) << "Gguf tensor " << info.name << " is out of range in "
+                 << path;
+      return false;
+    }
+  }
+  return true;
+}
+
+const GGUFFile::Value* GGUFFile::find(const std::string& key) const {
+  const auto it = metadata_.find(key);
+  return it != metadata_.end() ? &it->second : nullptr;
+}
+
+std::optional<int64_t> GGUFFile::get_int(const std::string& key) const {
+  const auto* value = find(key);
+  if (value != nullptr) {
+    if (const auto* v = std::get_if<int64_t>(value)) {
+      return *v;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<double> GGUFFile::get_float(const std::string& key) const {
+  const auto* value = find(key);
+  if (value != nullptr) {
+    if (const auto* v = std::get_if<double>(value)) {
+      return *v;
+    }
+    if (const auto* v = std::get_if<int64_t>(value)) {
+      return static_cast<double>(*v);
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<bool> GGUFFile::get_bool(const std::string& key) const {
+  const auto* value = find(key);
+  if (value != nullptr) {
+    if (const auto* v = std::get_if<bool>(value)) {
+      return *v;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<std::string> GGUFFile::get_string(const std::string& key) const {
+  const auto* value = find(key);
+  if (value != nullptr) {
+    if (const auto* v = std::get_if<std::string>(value)) {
+      return *v;
+    }
+  }
+  return std::nullopt;
+}
+
+const std::vector<int64_t>* GGUFFile::get_ints(const std::string& key) const {
+  const auto* value = find(key);
+  return value != nullptr ? std::get_if<std::vector<int64_t>>(value)
+                          : nullptr;
+}
+
+const std::vector<double>* GGUFFile::get_floats(const std::string& key) const {
+  const auto* value = find(key);
+  return value != nullptr ? std::get_if<std::vector<double>>(value) : nullptr;
+}
+
+const std::vector<std::string>* GGUFFile::get_strings(
+    const std::string& key) const {
+  const auto* value = find(key);
+  return value != nullptr ? std::get_if<std::vector<std::string>>(value)
+                          : nullptr;
+}
+
+}  // namespace llm
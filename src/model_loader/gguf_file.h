@@ -0,0 +1,88 @@
+#pragma once
+
+#include <folly/system/MemoryMapping.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace llm {
+
+// A reader for gguf files, the single file model format of llama.cpp.
+// the file is memory mapped, metadata and tensor infos are parsed when
+// opened, and tensor data is accessed in place.
+// https://github.com/ggerganov/ggml/blob/master/docs/gguf.md
+class GGUFFile final {
+ public:
+  struct TensorInfo {
+    std::string name;
+    // dimensions with the innermost first, same as ne in ggml
+    std::vector<int64_t> dims;
+    // ggml type of the data
+    int32_t type = 0;
+    // offset of the data from the start of the data section
+    uint64_t offset = 0;
+  };
+
+  // open and parse the file, return nullptr if the file is invalid.
+  static std::unique_ptr<GGUFFile> open(const std::string& path);
+
+  uint32_t version() const { return version_; }
+
+  // metadata getters, return nullopt or nullptr if the key is not found or
+  // holds a value of another type. integers are widened to int64_t and
+  // floats to double, get_float accepts integers as well.
+  std::optional<int64_t> get_int(const std::string& key) const;
+  std::optional<double> get_float(const std::string& key) const;
+  std::optional<bool> get_bool(const std::string& key) const;
+  std::optional<std::string> get_string(const std::string& key) const;
+  const std::vector<int64_t>* get_ints(const std::string& key) const;
+  const std::vector<double>* get_floats(const std::string& key) const;
+  const std::vector<std::string>* get_strings(const std::string& key) const;
+
+  const std::vector<TensorInfo>& tensors() const { return tensors_; }
+
+  // pointer to the data of the tensor
+  const uint8_t* tensor_data(const TensorInfo& info) const {
+    return data_ + data_offset_ + info.offset;
+  }
+
+  // the mapping of the whole file, tensors should hold a reference to it
+  const std::shared_ptr<folly::MemoryMapping>& mem_map() const {
+    return mem_map_;
+  }
+
+ private:
+  using Value = std::variant<int64_t,
+                             double,
+                             bool,
+                             std::string,
+                             std::vector<int64_t>,
+                             std::vector<double>,
+                             std::vector<std::string>>;
+
+  GGUFFile() = default;
+
+  bool parse(const std::string& path);
+
+  const Value* find(const std::string& key) const;
+
+  std::shared_ptr<folly::MemoryMapping> mem_map_;
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+
+  uint32_t version_ = 0;
+
+  std::unordered_map<std::string, Value> metadata_;
+
+  std::vector<TensorInfo> tensors_;
+
+  // offset of the data section from the start of the file
+  size_t data_offset_ = 0;
+};
+
+}  // namespace llm
@@ -0,0 +1,208 @@
+#include "gguf_file.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace llm {
+namespace {
+
+// minimal writer of little endian gguf files
+class GGUFWriter {
+ public:
+  template <typename T>
+  void write(T value) {
+    const auto* bytes = reinterpret_cast<const char*>(&value);
+    data_.append(bytes, sizeof(T));
+  }
+
+  void write_string(const std::string& value) {
+    write<uint64_t>(value.size());
+    data_.append(value);
+  }
+
+  void pad(size_t alignment) {
+    data_.resize((data_.size() + alignment - 1) / alignment * alignment);
+  }
+
+  void append(const void* data, size_t size) {
+    data_.append(static_cast<const char*>(data), size);
+  }
+
+  bool save(const std::string& path) const {
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(data_.data(), static_cast<std::streamsize>(data_.size()));
+    return ofs.good();
+  }
+
+ private:
+  std::string data_;
+};
+
+}  // namespace
+
+TEST(GGUFFileTest, ParseMetadataAndTensors) {
+  GGUFWriter writer;
+  writer.write<uint32_t>(0x46554747);  // magic
+  writer.write<uint32_t>(3);           // version
+  writer.write<uint64_t>(1);           // n_tensors
+  writer.write<uint64_t>(5);           // n_kv
+
+  writer.write_string("general.architecture");
+  writer.write<uint32_t>(8);  // string
+  writer.write_string("llama");
+
+  writer.write_string("llama.block_count");
+  writer.write<uint32_t>(4);  // uint32
+  writer.write<uint32_t>(2);
+
+  writer.write_string("llama.rope.freq_base");
+  writer.write<uint32_t>(6);  // float32
+  writer.write<float>(10000.0f);
+
+  writer.write_string("tokenizer.ggml.add_bos_token");
+  writer.write<uint32_t>(7);  // bool
+  writer.write<uint8_t>(1);
+
+  writer.write_string("tokenizer.ggml.tokens");
+  writer.write<uint32_t>(9);  // array
+  writer.write<uint32_t>(8);  // of strings
+  writer.write<uint64_t>(2);
+  writer.write_string("<s>");
+  writer.write_string("hello");
+
+  // tensor with 4 columns and 2 rows of f32
+  writer.write_string("token_embd.weight");
+  writer.write<uint32_t>(2);
+  writer.write<uint64_t>(4);
+  writer.write<uint64_t>(2);
+  writer.write<uint32_t>(0);  // f32
+  writer.write<uint64_t>(0);  // offset
+  writer.pad(32);
+  const std::vector<float> values = {1, 2, 3, 4, 5, 6, 7, 8};
+  writer.append(values.data(), values.size() * sizeof(float));
+
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "gguf_file_test.gguf")
+          .string();
+  ASSERT_TRUE(writer.save(path));
+
+  const auto file = GGUFFile::open(path);
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(file->version(), 3);
+  EXPECT_EQ(file->get_string("general.architecture"), "llama");
+  EXPECT_EQ(file->get_int("llama.block_count"), 2);
+  EXPECT_EQ(file->get_float("llama.rope.freq_base"), 10000.0);
+  // integers are accepted as floats
+  EXPECT_EQ(file->get_float("llama.block_count"), 2.0);
+  EXPECT_EQ(file->get_bool("tokenizer.ggml.add_bos_token"), true);
+  // missing keys or mismatched types
+  EXPECT_FALSE(file->get_int("general.architecture").has_value());
+  EXPECT_FALSE(file->get_string("missing").has_value());
+  EXPECT_EQ(file->get_ints("tokenizer.ggml.tokens"), nullptr);
+
+  const auto* tokens = file->get_strings("tokenizer.ggml.tokens");
+  ASSERT_NE(tokens, nullptr);
+  EXPECT_EQ(*tokens, std::vector<std::string>({"<s>", "hello"}));
+
+  ASSERT_EQ(file->tensors().size(), 1);
+  const auto& info = file->tensors()[0];
+  EXPECT_EQ(info.name, "token_embd.weight");
+  EXPECT_EQ(info.dims, std::vector<int64_t>({4, 2}));
+  EXPECT_EQ(info.type, 0);
+  std::vector<float> data(values.size());
+  std::memcpy(data.data(), file->tensor_data(info), data.size() * 4);
+  EXPECT_EQ(data, values);
+  std::filesystem::remove(path);
+}
+
+TEST(GGUFFileTest, RejectInvalidFiles) {
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "gguf_file_invalid.gguf")
+          .string();
+  // bad magic
+  GGUFWriter bad_magic;
+  bad_magic.write<uint32_t>(0x12345678);
+  bad_magic.write<uint32_t>(3);
+  ASSERT_TRUE(bad_magic.save(path));
+  EXPECT_EQ(GGUFFile::open(path), nullptr);
+
+  // tensor data out of the file
+  GGUFWriter truncated;
+  truncated.write<uint32_t>(0x46554747);
+  truncated.write<uint32_t>(3);
+  truncated.write<uint64_t>(1);
+  truncated.write<uint64_t>(0);
+  truncated.write_string("output.weight");
+  truncated.write<uint32_t>(1);
+  truncated.write<uint64_t>(64);
+  truncated.write<uint32_t>(0);
+  truncated.write<uint64_t>(0);
+  ASSERT_TRUE(truncated.save(path));
+  EXPECT_EQ(GGUFFile::open(path), nullptr);
+
+  // zero, negative or overflowing dims
+  for (const uint64_t dim1 :
+       {uint64_t{0}, ~uint64_t{0}, uint64_t{1} << 62}) {
+    GGUFWriter bad_dims;
+    bad_dims.write<uint32_t>(0x46554747);
+    bad_dims.write<uint32_t>(3);
+    bad_dims.write<uint64_t>(1);
+    bad_dims.write<uint64_t>(0);
+    bad_dims.write_string("output.weight");
+    bad_dims.write<uint32_t>(2);
+    bad_dims.write<uint64_t>(1);
+    bad_dims.write<uint64_t>(dim1);
+    bad_dims.write<uint32_t>(0);
+    bad_dims.write<uint64_t>(0);
+    bad_dims.pad(32);
+    ASSERT_TRUE(bad_dims.save(path));
+    EXPECT_EQ(GGUFFile::open(path), nullptr) << dim1;
+  }
+
+  // deeply nested arrays
+  GGUFWriter nested;
+  nested.write<uint32_t>(0x46554747);
+  nested.write<uint32_t>(3);
+  nested.write<uint64_t>(0);
+  nested.write<uint64_t>(1);
+  nested.write_string("nested");
+  nested.write<uint32_t>(9);  // array
+  for (int i = 0; i < 64; ++i) {
+    nested.write<uint32_t>(9);  // of arrays
+    nested.write<uint64_t>(1);
+  }
+  nested.write<uint32_t>(4);  // of uint32
+  nested.write<uint64_t>(1);
+  nested.write<uint32_t>(1);
+  ASSERT_TRUE(nested.save(path));
+  EXPECT_EQ(GGUFFile::open(path), nullptr);
+
+  // array counts that fit the file in bytes but not in elements
+  for (const uint32_t elem_type : {uint32_t{8}, uint32_t{10}, uint32_t{9}}) {
+    GGUFWriter huge_array;
+    huge_array.write<uint32_t>(0x46554747);
+    huge_array.write<uint32_t>(3);
+    huge_array.write<uint64_t>(0);
+    huge_array.write<uint64_t>(1);
+    huge_array.write_string("huge");
+    huge_array.write<uint32_t>(9);  // array
+    huge_array.write<uint32_t>(elem_type);
+    huge_array.write<uint64_t>(64);
+    // 64 bytes, one per element
+    for (int i = 0; i < 8; ++i) {
+      huge_array.write<uint64_t>(0);
+    }
+    ASSERT_TRUE(huge_array.save(path));
+    EXPECT_EQ(GGUFFile::open(path), nullptr) << elem_type;
+  }
+
+  EXPECT_EQ(GGUFFile::open(path + ".missing"), nullptr);
+  std::filesystem::remove(path);
+}
+
+}  // namespace llm
@@ -0,0 +1,551 @@
+#include "gguf_model_loader.h"
+
+#include <absl/strings/match.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_replace.h>
+#include <glog/logging.h>
+#include <torch/torch.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "args_overrider.h"
+#include "common/json_reader.h"
+#include "kernels/quantization/ggml/ggml_kernels.h"
+#include "model_loader/state_dict.h"
+#include "models/model_registry.h"
+#include "sentencepiece_model.pb.h"
+#include "tokenizer/hf_tokenizer.h"
+#include "tokenizer/sentencepiece_tokenizer.h"
+
+namespace llm {
+namespace {
+using kernel::ggml::GGMLType;
+
+// tensors of each layer: gguf name -> huggingface name
+constexpr std::pair<std::string_view, std::string_view> kLayerTensors[] = {
+    {"attn_norm", "input_layernorm"},
+    {"ffn_norm", "post_attention_layernorm"},
+    {"attn_q", "self_attn.q_proj"},
+    {"attn_k", "self_attn.k_proj"},
+    {"attn_v", "self_attn.v_proj"},
+    {"attn_output", "self_attn.o_proj"},
+    {"ffn_gate", "mlp.gate_proj"},
+    {"ffn_up", "mlp.up_proj"},
+    {"ffn_down", "mlp.down_proj"},
+};
+
+// token types in gguf metadata, same as types of sentencepiece pieces
+constexpr int64_t kTokenNormal = 1;
+constexpr int64_t kTokenControl = 3;
+constexpr int64_t kTokenUserDefined = 4;
+constexpr int64_t kTokenByte = 6;
+
+// pre-tokenizer regex patterns of bpe tokenizers
+constexpr char kGPT2Pattern[] =
+    R"('s|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+)";
+constexpr char kLlama3Pattern[] =
+    R"((?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}{1,3}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+)";
+constexpr char kQwen2Pattern[] =
+    R"((?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+)";
+
+// map the gguf tensor name to the huggingface name, return false if the
+// tensor is not used.
+bool map_tensor_name(const std::string& gguf_name, std::string* name) {
+  if (gguf_name == "token_embd.weight") {
+    *name = "model.embed_tokens.weight";
+    return true;
+  }
+  if (gguf_name == "output_norm.weight") {
+    *name = "model.norm.weight";
+    return true;
+  }
+  if (gguf_name == "output.weight") {
+    *name = "lm_head.weight";
+    return true;
+  }
+
+  // tensors of layers: blk.{layer_id}.{tensor}.{weight|bias}
+  std::string_view rest = gguf_name;
+  if (!absl::ConsumePrefix(&rest, "blk.")) {
+    return false;
+  }
+  const size_t dot = rest.find('.');
+  int64_t layer_id = 0;
+  if (dot == std::string_view::npos ||
+      !absl::SimpleAtoi(rest.substr(0, dot), &layer_id)) {
+    return false;
+  }
+  rest.remove_prefix(dot + 1);
+  const size_t suffix_pos = rest.rfind('.');
+  if (suffix_pos == std::string_view::npos) {
+    return false;
+  }
+  const auto tensor = rest.substr(0, suffix_pos);
+  const auto suffix = rest.substr(suffix_pos);
+  for (const auto& [gguf_tensor, hf_tensor] : kLayerTensors) {
+    if (tensor == gguf_tensor) {
+      *name = absl::StrCat("model.layers.", layer_id, ".", hf_tensor, suffix);
+      return true;
+    }
+  }
+  return false;
+}
+
+// dtype of tensors that can be used in place without dequantization
+std::optional<torch::ScalarType> get_dense_dtype(GGMLType type) {
+  switch (type) {
+    case GGMLType::F32:
+      return torch::kFloat32;
+    case GGMLType::F16:
+      return torch::kFloat16;
+    case GGMLType::BF16:
+      return torch::kBFloat16;
+    default:
+      return std::nullopt;
+  }
+}
+
+// llama.cpp permutes rows of q and k of llama models for its interleaved
+// rotary embedding, undo it for the rotary embedding of huggingface.
+torch::Tensor unpermute_rows(const torch::Tensor& tensor, int64_t n_heads) {
+  const auto index = torch::arange(tensor.size(0), torch::kLong)
+                         .view({n_heads, -1, 2})
+                         .transpose(1, 2)
+                         .reshape({-1});
+  return tensor.index_select(/*dim=*/0, index);
+}
+
+// write the file atomically, other processes see either no file or the
+// whole file.
+bool write_file(const std::filesystem::path& path, const std::string& data) {
+  const std::string tmp_path =
+      absl::StrCat(path.string(), ".tmp.", ::getpid());
+  {
+    std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+    ofs.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!ofs.good()) {
+      LOG(ERROR) << "Failed to write file " << tmp_path;
+      return false;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, path, ec);
+  if (ec) {
+    LOG(ERROR) << "Failed to rename " << tmp_path << " to " << path << ": "
+               << ec.message();
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+GGUFModelLoader::GGUFModelLoader(const std::string& model_weights_path)
+    : model_weights_path_(model_weights_path) {
+  if (std::filesystem::is_directory(model_weights_path)) {
+    for (const auto& entry :
+         std::filesystem::directory_iterator(model_weights_path)) {
+      if (entry.path().extension() == ".gguf") {
+        model_weights_files_.push_back(entry.path().string());
+      }
+    }
+  } else {
+    model_weights_files_.push_back(model_weights_path);
+  }
+  CHECK(!model_weights_files_.empty())
+      << "Failed to find gguf files in " << model_weights_path;
+  // split files are named as {name}-00001-of-0000N.gguf, and metadata is
+  // stored in the first one.
+  std::sort(model_weights_files_.begin(), model_weights_files_.end());
+
+  const auto file = GGUFFile::open(model_weights_files_[0]);
+  CHECK(file != nullptr) << "Failed to open gguf file "
+                         << model_weights_files_[0];
+
+  // scan tensors of all files for the vocab size and the output weight
+  int64_t vocab_size = 0;
+  bool has_output = false;
+  for (size_t i = 0; i < model_weights_files_.size(); ++i) {
+    std::unique_ptr<GGUFFile> split;
+    if (i > 0) {
+      split = GGUFFile::open(model_weights_files_[i]);
+      CHECK(split != nullptr)
+          << "Failed to open gguf file " << model_weights_files_[i];
+    }
+    for (const auto& info : (i > 0 ? split : file)->tensors()) {
+      if (info.name == "output.weight") {
+        has_output = true;
+      } else if (info.name == "token_embd.weight" && info.dims.size() == 2) {
+        vocab_size = info.dims[1];
+      }
+    }
+  }
+  tie_word_embeddings_ = !has_output;
+
+  CHECK(load_model_args(*file, vocab_size))
+      << "Failed to load model args from " << model_weights_files_[0];
+  CHECK(load_tokenizer(*file))
+      << "Failed to load tokenizer from " << model_weights_files_[0];
+}
+
+std::unique_ptr<Tokenizer> GGUFModelLoader::tokenizer() const {
+  if (is_sentencepiece_) {
+    LOG(INFO) << "Using SentencePiece tokenizer from gguf metadata.";
+    return std::make_unique<SentencePieceTokenizer>(tokenizer_dir_,
+                                                    tokenizer_args_);
+  }
+  LOG(INFO) << "Using fast tokenizer from gguf metadata.";
+  return HFTokenizer::from_file(tokenizer_dir_ + "/tokenizer.json");
+}
+
+std::unique_ptr<StateDict> GGUFModelLoader::load_state_dict(
+    size_t index) const {
+  CHECK_LT(index, model_weights_files_.size());
+  LOG(INFO) << "Loading model weights from " << model_weights_files_[index];
+  const auto file = GGUFFile::open(model_weights_files_[index]);
+  CHECK(file != nullptr) << "Failed to open gguf file "
+                         << model_weights_files_[index];
+  // tensors hold a reference to the mapping, so that they can outlive it
+  const auto mem_map = file->mem_map();
+  const auto deleter = [mem_map](void* /*data*/) {};
+
+  const int64_t n_heads = args_.n_heads();
+  const int64_t n_kv_heads = args_.n_kv_heads().value_or(n_heads);
+
+  std::unordered_map<std::string, torch::Tensor> dict;
+  for (const auto& info : file->tensors()) {
+    std::string name;
+    if (!map_tensor_name(info.name, &name)) {
+      LOG(WARNING) << "Skipping unused gguf tensor " << info.name;
+      continue;
+    }
+    const auto type = static_cast<GGMLType>(info.type);
+    CHECK(kernel::ggml::is_supported(type))
+        << "Unsupported ggml type " << kernel::ggml::type_name(type) << " ("
+        << info.type << ") of tensor " << info.name;
+
+    // dims are stored with the innermost first
+    const int64_t n = info.dims.empty() ? 1 : info.dims[0];
+    int64_t n_rows = 1;
+    for (size_t i = 1; i < info.dims.size(); ++i) {
+      n_rows *= info.dims[i];
+    }
+    const std::vector<int64_t> sizes(info.dims.rbegin(), info.dims.rend());
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    auto* data = const_cast<uint8_t*>(file->tensor_data(info));
+
+    int64_t permuted_heads = 0;
+    if (permuted_qk_) {
+      if (absl::StrContains(name, ".q_proj.")) {
+        permuted_heads = n_heads;
+      } else if (absl::StrContains(name, ".k_proj.")) {
+        permuted_heads = n_kv_heads;
+      }
+    }
+
+    // weights of linear layers stay in ggml blocks
+    if (info.dims.size() == 2 && absl::StartsWith(name, "model.layers.")) {
+      auto qweight = torch::from_blob(
+          data,
+          {n_rows, static_cast<int64_t>(kernel::ggml::row_bytes(type, n))},
+          deleter,
+          torch::kUInt8);
+      if (permuted_heads > 0) {
+        qweight = unpermute_rows(qweight, permuted_heads);
+      }
+      // strip "weight" from the name
+      const std::string prefix = name.substr(0, name.size() - 6);
+      dict[prefix + "qweight"] = qweight;
+      dict[prefix + "qtype"] =
+          torch::full({n_rows}, info.type, torch::dtype(torch::kInt32));
+      continue;
+    }
+
+    torch::Tensor tensor;
+    if (const auto dtype = get_dense_dtype(type)) {
+      tensor = torch::from_blob(data, sizes, deleter, torch::dtype(*dtype));
+    } else {
+      // dequantize other tensors, such as token embeddings, into half
+      const auto blocks = torch::from_blob(
+          data,
+          {n_rows, static_cast<int64_t>(kernel::ggml::row_bytes(type, n))},
+          torch::kUInt8);
+      tensor = kernel::ggml::dequantize(blocks, type, n, torch::kFloat16)
+                   .view(sizes);
+    }
+    if (permuted_heads > 0) {
+      tensor = unpermute_rows(tensor, permuted_heads);
+    }
+    if (tie_word_embeddings_ && name == "model.embed_tokens.weight") {
+      dict["lm_head.weight"] = tensor;
+    }
+    dict[name] = tensor;
+  }
+  return std::make_unique<StateDict>(mem_map, std::move(dict));
+}
+
+bool GGUFModelLoader::load_model_args(const GGUFFile& file,
+                                      int64_t vocab_size) {
+  arch_ = file.get_string("general.architecture").value_or("");
+  if (arch_ != "llama" && arch_ != "qwen2") {
+    LOG(ERROR) << "Unsupported gguf architecture: " << arch_;
+    return false;
+  }
+  permuted_qk_ = arch_ == "llama";
+
+  // map metadata to a huggingface config to reuse the model args loader
+  nlohmann::json config;
+  config["model_type"] = arch_;
+  auto set_int = [&](const char* name, const std::string& key) {
+    if (auto v = file.get_int(key)) {
+      config[name] = v.value();
+    }
+  };
+  auto set_float = [&](const char* name, const std::string& key) {
+    if (auto v = file.get_float(key)) {
+      config[name] = v.value();
+    }
+  };
+  const std::string prefix = arch_ + ".";
+  set_int("hidden_size", prefix + "embedding_length");
+  set_int("num_hidden_layers", prefix + "block_count");
+  set_int("num_attention_heads", prefix + "attention.head_count");
+  set_int("num_key_value_heads", prefix + "attention.head_count_kv");
+  set_int("intermediate_size", prefix + "feed_forward_length");
+  set_int("max_position_embeddings", prefix + "context_length");
+  set_int("head_dim", prefix + "attention.key_length");
+  set_float("rms_norm_eps", prefix + "attention.layer_norm_rms_epsilon");
+  set_float("rope_theta", prefix + "rope.freq_base");
+  set_int("bos_token_id", "tokenizer.ggml.bos_token_id");
+  set_int("eos_token_id", "tokenizer.ggml.eos_token_id");
+  if (vocab_size > 0) {
+    config["vocab_size"] = vocab_size;
+  } else if (const auto* tokens = file.get_strings("tokenizer.ggml.tokens")) {
+    config["vocab_size"] = tokens->size();
+  }
+
+  auto args_loader = ModelRegistry::get_model_args_loader(arch_);
+  if (args_loader == nullptr) {
+    LOG(ERROR) << "Failed to find model args loader for model type "
+               << arch_;
+    return false;
+  }
+  const JsonReader reader(std::move(config));
+  args_loader(reader, &args_);
+  if (auto v = file.get_int("tokenizer.ggml.eot_token_id")) {
+    args_.stop_token_ids().insert(static_cast<int32_t>(v.value()));
+  }
+
+  // weights of linear layers are kept in ggml block formats
+  quant_args_.quant_method() = "gguf";
+
+  if (auto v = file.get_string("tokenizer.chat_template")) {
+    tokenizer_args_.chat_template() = v.value();
+  }
+
+  // apply args override from gflag if exists
+  override_args_from_gflag(args_, quant_args_, tokenizer_args_);
+
+  // fix chat template, same as HFModelLoader
+  if (!tokenizer_args_.chat_template().empty()) {
+    std::string chat_template = tokenizer_args_.chat_template();
+    tokenizer_args_.chat_template() =
+        absl::StrReplaceAll(chat_template,
+                            {{"if not add_generation_prompt is defined",
+                              "if add_generation_prompt is undefined"}});
+  }
+  return true;
+}
+
+bool GGUFModelLoader::load_tokenizer(const GGUFFile& file) {
+  const auto model = file.get_string("tokenizer.ggml.model").value_or("");
+  const auto* tokens = file.get_strings("tokenizer.ggml.tokens");
+  if (tokens == nullptr || tokens->empty()) {
+    LOG(ERROR) << "Failed to find tokenizer.ggml.tokens in gguf metadata";
+    return false;
+  }
+  const auto* types = file.get_ints("tokenizer.ggml.token_type");
+  if (types != nullptr && types->size() != tokens->size()) {
+    LOG(ERROR) << "Mismatched sizes of tokenizer.ggml.token_type and tokens";
+    return false;
+  }
+  const auto token_type = [&](size_t id) {
+    return types != nullptr ? (*types)[id] : kTokenNormal;
+  };
+  const auto valid_id = [&](std::optional<int64_t> id) {
+    return id.has_value() && id.value() >= 0 &&
+           id.value() < static_cast<int64_t>(tokens->size());
+  };
+  const auto bos_id = file.get_int("tokenizer.ggml.bos_token_id");
+  const auto eos_id = file.get_int("tokenizer.ggml.eos_token_id");
+  const bool add_bos =
+      file.get_bool("tokenizer.ggml.add_bos_token").value_or(true) &&
+      valid_id(bos_id);
+
+  // tokenizer files are written into a directory keyed by the gguf file, so
+  // that they are shared across processes and restarts.
+  const auto path = std::filesystem::absolute(model_weights_files_[0]);
+  std::error_code ec;
+  const auto size = std::filesystem::file_size(path, ec);
+  const auto mtime =
+      std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+  const size_t key = std::hash<std::string>{}(
+      absl::StrCat(path.string(), ":", size, ":", mtime));
+  const auto dir = std::filesystem::temp_directory_path(ec) /
+                   absl::StrCat("scalellm-gguf-", absl::Hex(key));
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    LOG(ERROR) << "Failed to create directory " << dir << ": "
+               << ec.message();
+    return false;
+  }
+  tokenizer_dir_ = dir.string();
+
+  if (model == "llama") {
+    // build a sentencepiece model from the vocab
+    sentencepiece::ModelProto proto;
+    bool has_byte_pieces = false;
+    const auto* scores = file.get_floats("tokenizer.ggml.scores");
+    for (size_t i = 0; i < tokens->size(); ++i) {
+      auto* piece = proto.add_pieces();
+      piece->set_piece((*tokens)[i]);
+      piece->set_score(scores != nullptr && i < scores->size()
+                           ? static_cast<float>((*scores)[i])
+                           : 0.0f);
+      const auto type = token_type(i);
+      piece->set_type(
+          sentencepiece::ModelProto_SentencePiece_Type_IsValid(
+              static_cast<int>(type))
+              ? static_cast<sentencepiece::ModelProto_SentencePiece_Type>(type)
+              : sentencepiece::ModelProto_SentencePiece::NORMAL);
+      has_byte_pieces |= type == kTokenByte;
+    }
+    auto* trainer_spec = proto.mutable_trainer_spec();
+    trainer_spec->set_model_type(sentencepiece::TrainerSpec::BPE);
+    trainer_spec->set_byte_fallback(has_byte_pieces);
+    trainer_spec->set_unk_id(static_cast<int32_t>(
+        file.get_int("tokenizer.ggml.unknown_token_id").value_or(0)));
+    trainer_spec->set_bos_id(
+        valid_id(bos_id) ? static_cast<int32_t>(bos_id.value()) : -1);
+    trainer_spec->set_eos_id(
+        valid_id(eos_id) ? static_cast<int32_t>(eos_id.value()) : -1);
+    trainer_spec->set_pad_id(-1);
+    auto* normalizer_spec = proto.mutable_normalizer_spec();
+    normalizer_spec->set_name("identity");
+    normalizer_spec->set_add_dummy_prefix(
+        file.get_bool("tokenizer.ggml.add_space_prefix").value_or(true));
+    normalizer_spec->set_remove_extra_whitespaces(false);
+    normalizer_spec->set_escape_whitespaces(true);
+
+    if (!write_file(dir / "tokenizer.model", proto.SerializeAsString())) {
+      return false;
+    }
+    is_sentencepiece_ = true;
+    tokenizer_args_.tokenizer_type() = "sentencepiece";
+    tokenizer_args_.vocab_file() = "tokenizer.model";
+    if (add_bos) {
+      tokenizer_args_.prefix_tokens() = {(*tokens)[bos_id.value()]};
+    }
+    return true;
+  }
+
+  if (model == "gpt2") {
+    // build a fast tokenizer of byte level bpe
+    nlohmann::json vocab = nlohmann::json::object();
+    nlohmann::json added_tokens = nlohmann::json::array();
+    for (size_t i = 0; i < tokens->size(); ++i) {
+      vocab[(*tokens)[i]] = i;
+      const auto type = token_type(i);
+      if (type == kTokenControl || type == kTokenUserDefined) {
+        added_tokens.push_back({{"id", i},
+                                {"content", (*tokens)[i]},
+                                {"single_word", false},
+                                {"lstrip", false},
+                                {"rstrip", false},
+                                {"normalized", false},
+                                {"special", type == kTokenControl}});
+      }
+    }
+    const auto* merges = file.get_strings("tokenizer.ggml.merges");
+    if (merges == nullptr) {
+      LOG(ERROR) << "Failed to find tokenizer.ggml.merges in gguf metadata";
+      return false;
+    }
+
+    const auto pre = file.get_string("tokenizer.ggml.pre").value_or("");
+    const char* pattern = kGPT2Pattern;
+    if (pre == "llama-bpe" || pre == "llama3" || pre == "llama-v3") {
+      pattern = kLlama3Pattern;
+    } else if (pre == "qwen2") {
+      pattern = kQwen2Pattern;
+    }
+
+    nlohmann::json tokenizer;
+    tokenizer["version"] = "1.0";
+    tokenizer["added_tokens"] = std::move(added_tokens);
+    tokenizer["normalizer"] = nullptr;
+    tokenizer["pre_tokenizer"] = {
+        {"type", "Sequence"},
+        {"pretokenizers",
+         {{{"type", "Split"},
+           {"pattern", {{"Regex", pattern}}},
+           {"behavior", "Isolated"},
+           {"invert", false}},
+          {{"type", "ByteLevel"},
+           {"add_prefix_space", false},
+           {"trim_offsets", true},
+           {"use_regex", false}}}}};
+    tokenizer["post_processor"] = nullptr;
+    if (add_bos) {
+      const auto& bos = (*tokens)[bos_id.value()];
+      const nlohmann::json bos_token = {
+          {"SpecialToken", {{"id", bos}, {"type_id", 0}}}};
+      tokenizer["post_processor"] = {
+          {"type", "TemplateProcessing"},
+          {"single",
+           {bos_token, {{"Sequence", {{"id", "A"}, {"type_id", 0}}}}}},
+          {"pair",
+           {bos_token,
+            {{"Sequence", {{"id", "A"}, {"type_id", 0}}}},
+            bos_token,
+            {{"Sequence", {{"id", "B"}, {"type_id", 1}}}}}},
+          {"special_tokens",
+           {{bos,
+             {{"id", bos},
+              {"ids", nlohmann::json::array({bos_id.value()})},
+              {"tokens", nlohmann::json::array({bos})}}}}}};
+    }
+    tokenizer["decoder"] = {{"type", "ByteLevel"},
+                            {"add_prefix_space", true},
+                            {"trim_offsets", true},
+                            {"use_regex", true}};
+    tokenizer["model"] = {{"type", "BPE"},
+                          {"dropout", nullptr},
+                          {"unk_token", nullptr},
+                          {"continuing_subword_prefix", nullptr},
+                          {"end_of_word_suffix", nullptr},
+                          {"fuse_unk", false},
+                          {"byte_fallback", false},
+                          {"vocab", std::move(vocab)},
+                          {"merges", *merges}};
+
+    if (!write_file(dir / "tokenizer.json", tokenizer.dump())) {
+      return false;
+    }
+    is_sentencepiece_ = false;
+    return true;
+  }
+
+  LOG(ERROR) << "Unsupported gguf tokenizer model: " << model;
+  return false;
+}
+
+}  // namespace llm
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <torch/torch.h>
+
+#include <string>
+#include <vector>
+
+#include "gguf_file.h"
+#include "model_loader.h"
+
+namespace llm {
+
+// A model loader for gguf files of llama.cpp, split files are supported.
+// model args and the tokenizer are read from metadata of the first file.
+// tensors of linear layers are kept in their ggml block formats as
+// "qweight" and "qtype" for quant method "gguf", and are aliased from the
+// mapped files. other quantized tensors, such as token embeddings, are
+// dequantized when loaded.
+class GGUFModelLoader : public ModelLoader {
+ public:
+  // model_weights_path is a gguf file or a directory of gguf files
+  GGUFModelLoader(const std::string& model_weights_path);
+
+  const ModelArgs& model_args() const override { return args_; }
+
+  const QuantArgs& quant_args() const override { return quant_args_; }
+
+  const TokenizerArgs& tokenizer_args() const override {
+    return tokenizer_args_;
+  }
+
+  std::unique_ptr<Tokenizer> tokenizer() const override;
+
+  size_t weights_files_count() const override {
+    return model_weights_files_.size();
+  }
+
+  const std::vector<std::string>& weights_files() const override {
+    return model_weights_files_;
+  }
+
+  std::unique_ptr<StateDict> load_state_dict(size_t index) const override;
+
+  // support range-based for loop
+  StateDictIterator begin() const override { return {this, 0}; }
+  StateDictIterator end() const override {
+    return {this, weights_files_count()};
+  }
+
+ private:
+  // vocab_size is the number of rows of token embeddings
+  bool load_model_args(const GGUFFile& file, int64_t vocab_size);
+
+  bool load_tokenizer(const GGUFFile& file);
+
+  std::string model_weights_path_;
+
+  // loaded model args
+  ModelArgs args_;
+
+  // quantization args
+  QuantArgs quant_args_;
+
+  TokenizerArgs tokenizer_args_;
+
+  // sorted gguf files
+  std::vector<std::string> model_weights_files_;
+
+  // model architecture from gguf metadata
+  std::string arch_;
+
+  // whether q and k rows are permuted for interleaved rotary embedding
+  bool permuted_qk_ = false;
+
+  // whether lm_head shares the weight of token embeddings
+  bool tie_word_embeddings_ = false;
+
+  // tokenizer files written from gguf metadata
+  std::string tokenizer_dir_;
+  bool is_sentencepiece_ = false;
+};
+
+}  // namespace llm
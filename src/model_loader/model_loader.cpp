@@ -11,6 +11,7 @@
 
 #include "args_overrider.h"
 #include "common/json_reader.h"
+#include "gguf_model_loader.h"
 #include "model_loader/state_dict.h"
 #include "models/model_args.h"
 #include "models/model_registry.h"
@@ -19,29 +20,27 @@
 #include "tokenizer/tiktoken_tokenizer.h"
 
 namespace llm {
-StateDictIterator::StateDictIterator(
-    const std::vector<std::string>& model_weights_files,
-    size_t index,
-    bool is_pickle,
-    bool is_sharded)
-    : model_weights_files_(model_weights_files),
-      index_(index),
-      is_pickle_(is_pickle) {}
+StateDictIterator::StateDictIterator(const ModelLoader* loader, size_t index)
+    : loader_(loader), index_(index) {}
 
 const StateDict* StateDictIterator::get_state_dict() const {
-  const size_t num_weight_files = model_weights_files_.size();
-  CHECK(index_ < num_weight_files);
+  CHECK(index_ < loader_->weights_files_count());
   // lazy loading
   if (!state_dict_) {
-    LOG(INFO) << "Loading model weights from " << model_weights_files_[index_];
-    state_dict_ = StateDict::load(model_weights_files_[index_], is_pickle_);
+    state_dict_ = loader_->load_state_dict(index_);
   }
   return state_dict_.get();
 }
 
 std::unique_ptr<ModelLoader> ModelLoader::create(
     const std::string& model_weights_path) {
+  // a single gguf file
+  if (std::filesystem::path(model_weights_path).extension() == ".gguf") {
+    return std::make_unique<GGUFModelLoader>(model_weights_path);
+  }
+
   bool has_hf_weight_files = false;
+  bool has_gguf_files = false;
   for (const auto& entry :
        std::filesystem::directory_iterator(model_weights_path)) {
     if (entry.path().extension() == ".safetensors" ||
@@ -49,9 +48,16 @@ std::unique_ptr<ModelLoader> ModelLoader::create(
       has_hf_weight_files = true;
       break;
     }
+    if (entry.path().extension() == ".gguf") {
+      has_gguf_files = true;
+    }
+  }
+  if (!has_hf_weight_files && has_gguf_files) {
+    return std::make_unique<GGUFModelLoader>(model_weights_path);
   }
   CHECK(has_hf_weight_files)
-      << "Failed to find model weights files (*.safetensors, *.bin) in "
+      << "Failed to find model weights files (*.safetensors, *.bin, *.gguf) "
+         "in "
       << model_weights_path;
   return std::make_unique<HFModelLoader>(model_weights_path);
 }
@@ -106,6 +112,13 @@ std::unique_ptr<Tokenizer> HFModelLoader::tokenizer() const {
                                                   tokenizer_args_);
 }
 
+std::unique_ptr<StateDict> HFModelLoader::load_state_dict(
+    size_t index) const {
+  CHECK_LT(index, model_weights_files_.size());
+  LOG(INFO) << "Loading model weights from " << model_weights_files_[index];
+  return StateDict::load(model_weights_files_[index], is_pickle_);
+}
+
 bool HFModelLoader::load_model_args(const std::string& model_weights_path) {
   JsonReader reader;
   const std::string args_file_path = model_weights_path + "/config.json";
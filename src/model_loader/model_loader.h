@@ -2,6 +2,7 @@
 
 #include <torch/torch.h>
 
+#include <string>
 #include <vector>
 
 #include "model_loader/state_dict.h"
@@ -12,14 +13,13 @@
 
 namespace llm {
 
+class ModelLoader;
+
 // Iterator for StateDict, load the model weights file one by one to save
 // memory
 class StateDictIterator {
  public:
-  StateDictIterator(const std::vector<std::string>& model_weights_files,
-                    size_t index,
-                    bool is_pickle,
-                    bool is_sharded);
+  StateDictIterator(const ModelLoader* loader, size_t index);
 
   // load the next model weights file
   void operator++() {
@@ -37,8 +37,7 @@ class StateDictIterator {
 
   // return true if the iterator reaches the end
   bool operator==(const StateDictIterator& other) const {
-    return model_weights_files_ == other.model_weights_files_ &&
-           index_ == other.index_;
+    return loader_ == other.loader_ && index_ == other.index_;
   }
 
   // return true if the iterator does not reach the end
@@ -49,12 +48,10 @@ class StateDictIterator {
  private:
   const StateDict* get_state_dict() const;
 
-  // NOLINTNEXTLINE(cppcoreguidelines-avoid-const-or-ref-data-members)
-  const std::vector<std::string>& model_weights_files_;
+  // loader to load the model weights files
+  const ModelLoader* loader_ = nullptr;
   // index of the current model weights file
   size_t index_ = 0;
-  // whether the model weights file is a pickle file
-  bool is_pickle_ = false;
 
   // pointer to the current state dict, lazy loaded
   mutable std::unique_ptr<StateDict> state_dict_;
@@ -71,10 +68,18 @@ class ModelLoader {
   virtual std::unique_ptr<Tokenizer> tokenizer() const = 0;
 
   virtual size_t weights_files_count() const = 0;
+
+  // the sorted model weights files
+  virtual const std::vector<std::string>& weights_files() const = 0;
+
+  // load the weights file at index, thread safe.
+  virtual std::unique_ptr<StateDict> load_state_dict(size_t index) const = 0;
+
   virtual StateDictIterator begin() const = 0;
   virtual StateDictIterator end() const = 0;
 
-  // create a model loader from the given path
+  // create a model loader from the given path, a directory of huggingface
+  // model files, a gguf file or a directory of gguf files.
   static std::unique_ptr<ModelLoader> create(
       const std::string& model_weights_path);
 };
@@ -98,12 +103,16 @@ class HFModelLoader : public ModelLoader {
     return model_weights_files_.size();
   }
 
-  // support range-based for loop
-  StateDictIterator begin() const override {
-    return {model_weights_files_, 0, is_pickle_, false};
+  const std::vector<std::string>& weights_files() const override {
+    return model_weights_files_;
   }
+
+  std::unique_ptr<StateDict> load_state_dict(size_t index) const override;
+
+  // support range-based for loop
+  StateDictIterator begin() const override { return {this, 0}; }
   StateDictIterator end() const override {
-    return {model_weights_files_, weights_files_count(), true, false};
+    return {this, weights_files_count()};
   }
 
  private:
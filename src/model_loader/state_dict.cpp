@@ -4,6 +4,8 @@
 #include <absl/strings/match.h>
 #include <caffe2/serialize/inline_container.h>
 #include <glog/logging.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <torch/csrc/jit/serialization/import_read.h>
 #include <torch/csrc/jit/serialization/storage_context.h>
 #include <torch/torch.h>
@@ -103,9 +105,10 @@ std::unique_ptr<StateDict> StateDict::load_pickle_file(
 
 std::unique_ptr<StateDict> StateDict::load_safetensors(
     const std::string& weights_file) {
+  // pages are faulted in on first access or by prefetch()
   folly::MemoryMapping::Options options;
-  options.setPrefault(true).setReadable(true);
-  auto mem_map = std::make_unique<folly::MemoryMapping>(weights_file.c_str(),
+  options.setReadable(true);
+  auto mem_map = std::make_shared<folly::MemoryMapping>(weights_file.c_str(),
                                                         0,   // offset
                                                         -1,  // length
                                                         options);
@@ -139,9 +142,11 @@ std::unique_ptr<StateDict> StateDict::load_safetensors(
     const auto scalar_type = get_dtype(tensor_view->dtype);
     const void* tensor_data = data + tensor_view->start;
     const std::vector<int64_t> tensor_sizes = get_sizes(tensor_view);
+    // the tensor keeps the mapping alive, so that weights can alias it
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
     const auto tensor = at::from_blob(const_cast<void*>(tensor_data),
                                       tensor_sizes,
+                                      [mem_map](void* /*data*/) {},
                                       torch::dtype(scalar_type));
     CHECK(safetensors_free_tensor(tensor_view) == Status::Ok)
         << "Failed to free tensor view";
@@ -159,10 +164,32 @@ StateDict::StateDict(std::unordered_map<std::string, torch::Tensor> dict,
                      const std::string& prefix)
     : dict_(std::move(dict)), prefix_(prefix) {}
 
-StateDict::StateDict(std::unique_ptr<folly::MemoryMapping> mem_map,
+StateDict::StateDict(std::shared_ptr<folly::MemoryMapping> mem_map,
                      std::unordered_map<std::string, torch::Tensor> dict)
     : mem_map_(std::move(mem_map)), dict_(std::move(dict)) {}
 
+void StateDict::prefetch() const {
+  if (!mem_map_) {
+    return;
+  }
+  const folly::ByteRange content = mem_map_->range();
+  if (content.empty()) {
+    return;
+  }
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+  auto* data = const_cast<uint8_t*>(content.data());
+  const size_t size = content.size();
+  // start async readahead for the whole file, best effort
+  madvise(data, size, MADV_WILLNEED);
+  // then fault in pages, one byte per page
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  uint8_t sum = 0;
+  for (size_t offset = 0; offset < size; offset += page_size) {
+    sum += *static_cast<volatile const uint8_t*>(data + offset);
+  }
+  (void)sum;
+}
+
 torch::Tensor StateDict::get_tensor(const std::string& tensor_name) const {
   const auto it = dict_.find(tensor_name);
   if (it == dict_.end()) {
@@ -208,7 +235,9 @@ StateDict StateDict::select(const std::string& prefix) const {
       selected[name.substr(prefix.length())] = tensor;
     }
   }
-  return {std::move(selected), prefix_ + prefix};
+  StateDict selected_dict(std::move(selected), prefix_ + prefix);
+  selected_dict.mem_map_ = mem_map_;
+  return selected_dict;
 }
 
 StateDict StateDict::select_with_transform(
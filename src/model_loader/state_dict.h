@@ -17,13 +17,16 @@ class StateDict final {
   static std::unique_ptr<StateDict> load_pickle_file(
       const std::string& weights_file);
 
+  // map the safetensors file lazily, only the header is read until tensors
+  // are accessed or prefetched.
   static std::unique_ptr<StateDict> load_safetensors(
       const std::string& weights_file);
 
   StateDict(std::unordered_map<std::string, torch::Tensor> dict,
             const std::string& prefix = "");
 
-  StateDict(std::unique_ptr<folly::MemoryMapping> mem_map,
+  // tensors in dict should hold a reference to mem_map to keep it alive.
+  StateDict(std::shared_ptr<folly::MemoryMapping> mem_map,
             std::unordered_map<std::string, torch::Tensor> dict);
 
   // get the tensor with the given name. return nullptr if not found.
@@ -46,6 +49,14 @@ class StateDict final {
   StateDict select_with_transform(const std::string& prefix,
                                   TensorTransform transform_func) const;
 
+  // read the mapped file into the page cache ahead of use.
+  // no-op for state dicts not backed by a memory mapping.
+  void prefetch() const;
+
+  // whether tensors are backed by a read-only memory mapped file, which can
+  // be aliased by cpu weights instead of being copied.
+  bool is_memory_mapped() const { return mem_map_ != nullptr; }
+
   size_t size() const { return dict_.size(); }
 
   std::string_view prefix() const { return prefix_; }
@@ -55,8 +66,8 @@ class StateDict final {
   auto end() const { return dict_.end(); }
 
  private:
-  // memory mapping for safetensors
-  std::unique_ptr<folly::MemoryMapping> mem_map_;
+  // memory mapping for safetensors, shared with tensors and selected dicts
+  std::shared_ptr<folly::MemoryMapping> mem_map_;
 
   std::unordered_map<std::string, torch::Tensor> dict_;
 
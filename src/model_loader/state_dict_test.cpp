@@ -42,6 +42,35 @@ TEST(StateDictTest, LoadSafeTensors) {
   }
 }
 
+TEST(StateDictTest, PrefetchSafeTensors) {
+  auto state_dict = StateDict::load_safetensors("data/test.safetensors");
+  state_dict->prefetch();
+  EXPECT_EQ(state_dict->size(), 20);
+  for (int i = 0; i < 20; ++i) {
+    const std::string key = "key_" + std::to_string(i);
+    auto tensor = state_dict->get_tensor(key);
+    ASSERT_TRUE(tensor.defined());
+    EXPECT_TRUE(tensor.equal(torch::ones({10, 10}) * i));
+  }
+
+  // no-op without memory mapping
+  StateDict dict({{"tensor", torch::ones({2, 2})}});
+  dict.prefetch();
+  EXPECT_TRUE(dict.get_tensor("tensor").equal(torch::ones({2, 2})));
+}
+
+TEST(StateDictTest, TensorOutlivesMapping) {
+  auto state_dict = StateDict::load_safetensors("data/test.safetensors");
+  EXPECT_TRUE(state_dict->is_memory_mapped());
+  auto tensor = state_dict->get_tensor("key_3");
+  // the tensor keeps the memory mapping alive
+  state_dict.reset();
+  EXPECT_TRUE(tensor.equal(torch::ones({10, 10}) * 3));
+
+  StateDict dict({{"tensor", torch::ones({2, 2})}});
+  EXPECT_FALSE(dict.is_memory_mapped());
+}
+
 TEST(StateDictTest, SharedTensor) {
   // TODO: add more tests
   // create a list of tensors with same size
@@ -0,0 +1,246 @@
+#include "weight_cache.h"
+
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_format.h>
+#include <folly/system/MemoryMapping.h>
+#include <glog/logging.h>
+#include <sys/stat.h>
+#include <torch/torch.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace llm {
+namespace {
+
+constexpr char kMagic[8] = {'S', 'L', 'L', 'M', 'W', 'C', '0', '1'};
+
+// the alignment of the data section and tensors
+constexpr size_t kAlignment = 4096;
+
+size_t align_up(size_t size) {
+  return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// stable across processes, unlike std::hash
+uint64_t fnv1a_hash(const std::string& str) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char c : str) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// supported dtypes of cached tensors
+const std::vector<torch::ScalarType> kScalarTypes = {torch::kBool,
+                                                     torch::kUInt8,
+                                                     torch::kInt8,
+                                                     torch::kInt16,
+                                                     torch::kInt32,
+                                                     torch::kInt64,
+                                                     torch::kFloat16,
+                                                     torch::kBFloat16,
+                                                     torch::kFloat32,
+                                                     torch::kFloat64};
+
+std::optional<torch::ScalarType> parse_scalar_type(const std::string& name) {
+  for (const auto type : kScalarTypes) {
+    if (name == c10::toString(type)) {
+      return type;
+    }
+  }
+  return std::nullopt;
+}
+
+bool write_padding(std::ofstream& file, size_t size) {
+  static const std::vector<char> kZeros(kAlignment, 0);
+  const size_t padding = align_up(size) - size;
+  file.write(kZeros.data(), static_cast<std::streamsize>(padding));
+  return file.good();
+}
+
+}  // namespace
+
+bool WeightCache::save(
+    const std::string& path,
+    const std::string& key,
+    const std::vector<std::pair<std::string, torch::Tensor>>& tensors) {
+  // build the header with offsets relative to the data section
+  nlohmann::json tensors_json = nlohmann::json::array();
+  size_t offset = 0;
+  for (const auto& [name, tensor] : tensors) {
+    const auto type = tensor.scalar_type();
+    if (!parse_scalar_type(c10::toString(type)).has_value()) {
+      LOG(ERROR) << "Unsupported dtype " << type << " for " << name;
+      return false;
+    }
+    const size_t nbytes = tensor.numel() * tensor.element_size();
+    tensors_json.push_back({{"name", name},
+                            {"dtype", c10::toString(type)},
+                            {"shape", tensor.sizes().vec()},
+                            {"offset", offset},
+                            {"size", nbytes}});
+    offset += align_up(nbytes);
+  }
+  const nlohmann::json header = {{"key", key}, {"tensors", tensors_json}};
+  const std::string header_str = header.dump();
+  const uint64_t header_size = header_str.size();
+
+  // write into a unique temporary file, so that concurrent writers of the
+  // same cache never interleave.
+  std::string tmp_path = path + ".tmp.XXXXXX";
+  const int fd = ::mkstemp(tmp_path.data());
+  if (fd < 0) {
+    LOG(ERROR) << "Failed to create a temporary file for " << path;
+    return false;
+  }
+  // mkstemp creates the file readable by the owner only
+  ::fchmod(fd, 0644);
+  ::close(fd);
+  std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Failed to open " << tmp_path;
+    return false;
+  }
+  file.write(kMagic, sizeof(kMagic));
+  file.write(reinterpret_cast<const char*>(&header_size), sizeof(header_size));
+  file.write(header_str.data(), static_cast<std::streamsize>(header_size));
+  bool ok = write_padding(file, sizeof(kMagic) + sizeof(header_size) +
+                                    header_size);
+  for (const auto& [name, tensor] : tensors) {
+    if (!ok) {
+      break;
+    }
+    const auto cpu_tensor = tensor.to(torch::kCPU).contiguous();
+    const size_t nbytes = cpu_tensor.numel() * cpu_tensor.element_size();
+    file.write(static_cast<const char*>(cpu_tensor.data_ptr()),
+               static_cast<std::streamsize>(nbytes));
+    ok = write_padding(file, nbytes);
+  }
+  file.close();
+
+  std::error_code ec;
+  if (!ok || file.fail()) {
+    LOG(ERROR) << "Failed to write weight cache " << tmp_path;
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  std::filesystem::rename(tmp_path, path, ec);
+  if (ec) {
+    LOG(ERROR) << "Failed to rename " << tmp_path << " to " << path << ": "
+               << ec.message();
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<StateDict> WeightCache::load(const std::string& path,
+                                             const std::string& key) {
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(path, ec)) {
+    return nullptr;
+  }
+
+  folly::MemoryMapping::Options options;
+  options.setReadable(true);
+  auto mem_map =
+      std::make_shared<folly::MemoryMapping>(path.c_str(), 0, -1, options);
+  const folly::ByteRange content = mem_map->range();
+  const uint8_t* data = content.data();
+  const size_t size = content.size();
+
+  uint64_t header_size = 0;
+  const size_t prefix_size = sizeof(kMagic) + sizeof(header_size);
+  if (size < prefix_size || std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+    LOG(WARNING) << "Invalid weight cache " << path;
+    return nullptr;
+  }
+  std::memcpy(&header_size, data + sizeof(kMagic), sizeof(header_size));
+  if (header_size > size - prefix_size) {
+    LOG(WARNING) << "Invalid weight cache " << path;
+    return nullptr;
+  }
+  const nlohmann::json header = nlohmann::json::parse(
+      data + prefix_size,
+      data + prefix_size + header_size,
+      /*cb=*/nullptr,
+      /*allow_exceptions=*/false);
+  if (header.is_discarded() || !header.contains("key") ||
+      !header.contains("tensors")) {
+    LOG(WARNING) << "Invalid weight cache header " << path;
+    return nullptr;
+  }
+  if (header["key"] != key) {
+    LOG(WARNING) << "Weight cache " << path << " was saved for another model";
+    return nullptr;
+  }
+
+  const size_t data_start = align_up(prefix_size + header_size);
+  std::unordered_map<std::string, torch::Tensor> dict;
+  try {
+    for (const auto& item : header["tensors"]) {
+      const auto name = item.at("name").get<std::string>();
+      const auto type = parse_scalar_type(item.at("dtype").get<std::string>());
+      const auto shape = item.at("shape").get<std::vector<int64_t>>();
+      const auto offset = item.at("offset").get<size_t>();
+      const auto nbytes = item.at("size").get<size_t>();
+      if (!type.has_value() || data_start + offset + nbytes > size) {
+        LOG(WARNING) << "Invalid tensor " << name << " in weight cache "
+                     << path;
+        return nullptr;
+      }
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+      void* tensor_data = const_cast<uint8_t*>(data + data_start + offset);
+      auto tensor = at::from_blob(
+          tensor_data,
+          shape,
+          [mem_map](void* /*data*/) {},
+          torch::dtype(*type));
+      if (tensor.nbytes() != nbytes) {
+        LOG(WARNING) << "Invalid tensor " << name << " in weight cache "
+                     << path;
+        return nullptr;
+      }
+      dict[name] = tensor;
+    }
+  } catch (const nlohmann::json::exception& e) {
+    LOG(WARNING) << "Invalid weight cache header " << path << ": "
+                 << e.what();
+    return nullptr;
+  }
+  return std::make_unique<StateDict>(std::move(mem_map), std::move(dict));
+}
+
+std::string WeightCache::files_fingerprint(
+    const std::vector<std::string>& files) {
+  std::string fingerprint;
+  for (const auto& file : files) {
+    const auto path = std::filesystem::absolute(file);
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(path, ec);
+    const auto mtime =
+        std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    absl::StrAppend(&fingerprint, path.string(), ":", size, ":", mtime, ";");
+  }
+  return fingerprint;
+}
+
+std::string WeightCache::cache_path(const std::string& cache_dir,
+                                    const std::string& key,
+                                    int rank,
+                                    int world_size) {
+  const auto file_name = absl::StrFormat(
+      "weights-%016x-rank%d-of-%d.bin", fnv1a_hash(key), rank, world_size);
+  return (std::filesystem::path(cache_dir) / file_name).string();
+}
+
+}  // namespace llm
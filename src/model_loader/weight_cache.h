@@ -0,0 +1,44 @@
+#pragma once
+
+#include <torch/torch.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "state_dict.h"
+
+namespace llm {
+
+// A cache file of prepared weights for one rank, i.e. weights after dtype
+// conversion, fusion, sharding and repacking, which can be copied into
+// parameters as is.
+// layout: magic | header size (uint64) | json header | tensors, the data
+// section and each tensor start at page aligned offsets.
+class WeightCache final {
+ public:
+  // save tensors into the cache file, tagged with the key.
+  // the file is written into a unique temporary file and renamed at the end.
+  static bool save(
+      const std::string& path,
+      const std::string& key,
+      const std::vector<std::pair<std::string, torch::Tensor>>& tensors);
+
+  // map the cache file, returns nullptr if the file is missing, corrupted or
+  // saved with a different key.
+  static std::unique_ptr<StateDict> load(const std::string& path,
+                                         const std::string& key);
+
+  // the path, size and modification time of the files, used in the key so
+  // that updated checkpoints invalidate the cache.
+  static std::string files_fingerprint(const std::vector<std::string>& files);
+
+  // the cache file path for the key and rank
+  static std::string cache_path(const std::string& cache_dir,
+                                const std::string& key,
+                                int rank,
+                                int world_size);
+};
+
+}  // namespace llm
@@ -0,0 +1,98 @@
+#include "weight_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace llm {
+
+TEST(WeightCacheTest, SaveAndLoad) {
+  const auto cache_dir = std::filesystem::temp_directory_path();
+  const std::string key = "model=llama,world_size=2,dtype=half";
+  const auto path = WeightCache::cache_path(cache_dir, key, 1, 2);
+  EXPECT_NE(path, WeightCache::cache_path(cache_dir, key, 0, 2));
+
+  const auto weight = torch::randn({7, 9}).to(torch::kFloat16);
+  // non-contiguous tensors are saved as contiguous ones
+  const auto qweight = torch::randint(0, 100, {16, 8}, torch::kInt32).t();
+  const auto bias = torch::randn({3});
+  const auto empty = torch::empty({0, 4});
+  ASSERT_TRUE(WeightCache::save(path,
+                                key,
+                                {{"weight", weight},
+                                 {"qweight", qweight},
+                                 {"bias", bias},
+                                 {"empty", empty}}));
+
+  auto state_dict = WeightCache::load(path, key);
+  ASSERT_NE(state_dict, nullptr);
+  EXPECT_EQ(state_dict->size(), 4);
+  EXPECT_TRUE(state_dict->get_tensor("weight").equal(weight));
+  EXPECT_TRUE(state_dict->get_tensor("qweight").equal(qweight));
+  EXPECT_TRUE(state_dict->get_tensor("bias").equal(bias));
+  EXPECT_EQ(state_dict->get_tensor("empty").sizes(),
+            torch::IntArrayRef({0, 4}));
+
+  // tensors start at page aligned offsets
+  for (const auto& [name, tensor] : *state_dict) {
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(tensor.data_ptr()) % 4096, 0)
+        << name;
+  }
+
+  // stale or missing cache
+  EXPECT_EQ(WeightCache::load(path, "another key"), nullptr);
+  EXPECT_EQ(WeightCache::load(path + ".missing", key), nullptr);
+  std::filesystem::remove(path);
+}
+
+TEST(WeightCacheTest, ConcurrentSave) {
+  const auto cache_dir =
+      std::filesystem::temp_directory_path() / "weight_cache_test_concurrent";
+  std::filesystem::remove_all(cache_dir);
+  std::filesystem::create_directories(cache_dir);
+  const std::string key = "model=llama";
+  const auto path = WeightCache::cache_path(cache_dir, key, 0, 1);
+
+  // writers of the same cache file don't clobber each other
+  const auto weight = torch::randn({64, 64});
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      EXPECT_TRUE(WeightCache::save(path, key, {{"weight", weight}}));
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto state_dict = WeightCache::load(path, key);
+  ASSERT_NE(state_dict, nullptr);
+  EXPECT_TRUE(state_dict->get_tensor("weight").equal(weight));
+  // no temporary files left behind
+  size_t num_files = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(cache_dir)) {
+    EXPECT_EQ(entry.path().string(), path);
+    ++num_files;
+  }
+  EXPECT_EQ(num_files, 1);
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST(WeightCacheTest, FilesFingerprint) {
+  const auto file =
+      std::filesystem::temp_directory_path() / "weight_cache_test.bin";
+  std::ofstream(file) << "weights";
+  const auto fingerprint = WeightCache::files_fingerprint({file.string()});
+  EXPECT_EQ(fingerprint, WeightCache::files_fingerprint({file.string()}));
+
+  // updated checkpoints invalidate the cache
+  std::ofstream(file) << "new weights";
+  EXPECT_NE(fingerprint, WeightCache::files_fingerprint({file.string()}));
+  std::filesystem::remove(file);
+}
+
+}  // namespace llm
@@ -10,6 +10,8 @@
 #include <memory>
 #include <vector>
 
+#include "process_group_shm.h"
+
 namespace llm {
 namespace {
 
@@ -75,6 +77,10 @@ void check_input(torch::Tensor input) {
 std::vector<std::unique_ptr<ProcessGroup>> ProcessGroup::create_process_groups(
     const std::vector<torch::Device>& devices) {
   CHECK(!devices.empty()) << "devices should not be empty";
+  if (devices[0].is_cpu()) {
+    // cpu workers are threads of this process sharing memory
+    return ProcessGroupSHM::create_process_groups(devices);
+  }
   // all devices should be cuda devices
   for (const auto& device : devices) {
     CHECK(device.is_cuda()) << "device should be cuda device";
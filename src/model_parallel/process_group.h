@@ -30,7 +30,8 @@ class ProcessGroup {
   virtual void allgather(torch::Tensor input,
                          std::vector<torch::Tensor>& outputs) = 0;
 
-  // Create a process group where each process has a single GPU
+  // Create a process group where each process has a single GPU, or shares
+  // memory with other cpu workers of this process.
   // devices: list of devices to create process groups on.
   static std::vector<std::unique_ptr<ProcessGroup>> create_process_groups(
       const std::vector<torch::Device>& devices);
@@ -0,0 +1,153 @@
+#include "process_group_shm.h"
+
+#include <glog/logging.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace llm {
+namespace {
+// number of spins before yielding to other threads while waiting
+constexpr int kMaxSpins = 1 << 12;
+
+// sense-reversing barrier, all writes before wait() are visible to all
+// ranks after it.
+class SpinBarrier {
+ public:
+  explicit SpinBarrier(int count) : count_(count) {}
+
+  void wait() {
+    const uint64_t generation = generation_.load(std::memory_order_acquire);
+    if (arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 == count_) {
+      // last one to arrive releases the others
+      arrived_.store(0, std::memory_order_relaxed);
+      generation_.fetch_add(1, std::memory_order_release);
+      return;
+    }
+    int spins = 0;
+    while (generation_.load(std::memory_order_acquire) == generation) {
+      if (++spins >= kMaxSpins) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+ private:
+  const int count_;
+  alignas(64) std::atomic<int> arrived_{0};
+  alignas(64) std::atomic<uint64_t> generation_{0};
+};
+
+// [begin, end) of the slice owned by the rank
+std::pair<int64_t, int64_t> slice_range(int64_t numel,
+                                        int rank,
+                                        int world_size) {
+  const int64_t slice_size = (numel + world_size - 1) / world_size;
+  const int64_t begin = std::min(numel, rank * slice_size);
+  const int64_t end = std::min(numel, begin + slice_size);
+  return {begin, end};
+}
+
+void check_input(const torch::Tensor& input) {
+  CHECK(input.device().is_cpu()) << "input should be cpu tensor";
+  CHECK(input.is_contiguous()) << "input should be contiguous";
+  CHECK(!input.is_sparse()) << "input have to be cpu dense tensor";
+}
+}  // namespace
+
+struct ProcessGroupSHM::State {
+  explicit State(int world_size)
+      : inputs(world_size), slices(world_size), barrier(world_size) {}
+
+  // tensors published by each rank for the current collective
+  std::vector<torch::Tensor> inputs;
+
+  // reduced slice owned by each rank
+  std::vector<torch::Tensor> slices;
+
+  SpinBarrier barrier;
+};
+
+ProcessGroupSHM::ProcessGroupSHM(int rank,
+                                 int world_size,
+                                 const torch::Device& device,
+                                 std::shared_ptr<State> state)
+    : ProcessGroup(rank, world_size, device), state_(std::move(state)) {}
+
+std::vector<std::unique_ptr<ProcessGroup>>
+ProcessGroupSHM::create_process_groups(
+    const std::vector<torch::Device>& devices) {
+  for (const auto& device : devices) {
+    CHECK(device.is_cpu()) << "device should be cpu device";
+  }
+  const int world_size = static_cast<int>(devices.size());
+  auto state = std::make_shared<State>(world_size);
+
+  std::vector<std::unique_ptr<ProcessGroup>> process_groups;
+  process_groups.reserve(devices.size());
+  for (int i = 0; i < world_size; ++i) {
+    process_groups.emplace_back(std::make_unique<ProcessGroupSHM>(
+        /*rank=*/i, world_size, devices[i], state));
+  }
+  return process_groups;
+}
+
+void ProcessGroupSHM::allreduce(torch::Tensor& input) {
+  check_input(input);
+  const int rank = this->rank();
+  const int world_size = this->world_size();
+  auto& state = *state_;
+
+  // publish the input to other ranks
+  auto flat = input.view({-1});
+  const int64_t numel = flat.numel();
+  state.inputs[rank] = flat;
+  state.barrier.wait();
+
+  // reduce the owned slice of all inputs, starting from the next rank so
+  // that ranks read from different peers at the same time.
+  const auto [begin, end] = slice_range(numel, rank, world_size);
+  auto slice = flat.slice(/*dim=*/0, begin, end).clone();
+  for (int i = 1; i < world_size; ++i) {
+    const auto& peer = state.inputs[(rank + i) % world_size];
+    CHECK_EQ(peer.numel(), numel) << "input size mismatch across ranks";
+    CHECK_EQ(peer.scalar_type(), flat.scalar_type())
+        << "input dtype mismatch across ranks";
+    slice.add_(peer.slice(/*dim=*/0, begin, end));
+  }
+  state.slices[rank] = slice;
+  state.barrier.wait();
+
+  // inputs are no longer read by other ranks, copy back reduced slices
+  state.inputs[rank] = torch::Tensor();
+  for (int r = 0; r < world_size; ++r) {
+    const auto [b, e] = slice_range(numel, r, world_size);
+    flat.slice(/*dim=*/0, b, e).copy_(state.slices[r]);
+  }
+  // slices are overwritten after the first barrier of the next collective,
+  // when all ranks have finished reading them.
+}
+
+void ProcessGroupSHM::allgather(torch::Tensor input,
+                                std::vector<torch::Tensor>& outputs) {
+  check_input(input);
+  CHECK(outputs.size() == world_size())
+      << "outputs should have the same size as world_size";
+  const int rank = this->rank();
+  auto& state = *state_;
+
+  state.inputs[rank] = input;
+  state.barrier.wait();
+  for (int r = 0; r < world_size(); ++r) {
+    outputs[r].copy_(state.inputs[r]);
+  }
+  // the input can't be released until all ranks have copied it
+  state.barrier.wait();
+  state.inputs[rank] = torch::Tensor();
+}
+
+}  // namespace llm
@@ -0,0 +1,39 @@
+#pragma once
+#include <torch/torch.h>
+
+#include <memory>
+#include <vector>
+
+#include "process_group.h"
+
+namespace llm {
+
+// A process group for cpu workers running as threads of the same process.
+// Collectives exchange tensors through memory shared by all ranks, and
+// ranks synchronize with spinning barriers on atomics instead of locks.
+// allreduce: each rank reduces its own slice of all inputs, visiting peers
+// in ring order, then copies the reduced slices of all ranks back.
+class ProcessGroupSHM : public ProcessGroup {
+ public:
+  // state shared by all ranks of the group
+  struct State;
+
+  ProcessGroupSHM(int rank,
+                  int world_size,
+                  const torch::Device& device,
+                  std::shared_ptr<State> state);
+
+  void allreduce(torch::Tensor& input) override;
+
+  void allgather(torch::Tensor input,
+                 std::vector<torch::Tensor>& outputs) override;
+
+  // create process groups sharing the same state, one for each cpu device
+  static std::vector<std::unique_ptr<ProcessGroup>> create_process_groups(
+      const std::vector<torch::Device>& devices);
+
+ private:
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace llm
@@ -5,6 +5,8 @@
 #include <gtest/gtest.h>
 #include <torch/cuda.h>
 
+#include "process_group_shm.h"
+
 namespace llm {
 
 void run_collective_test(
@@ -103,4 +105,91 @@ TEST(ProcessGroupTest, NCCLAllGather) {
   }
 }
 
-}  // namespace llm
\ No newline at end of file
+namespace {
+// run collectives on cpu, each rank creates its process group in a thread
+void run_cpu_collective_test(
+    int world_size,
+    std::function<std::unique_ptr<ProcessGroup>(int rank)> create,
+    std::function<void(const std::vector<torch::Tensor>& tensors,
+                       ProcessGroup* pg)> func) {
+  // integer values to keep sums exact, sizes not divisible by world_size
+  const int num_test_tensors = 20;
+  std::vector<torch::Tensor> tensors;
+  tensors.reserve(num_test_tensors);
+  for (int i = 0; i < num_test_tensors; ++i) {
+    tensors.push_back(
+        torch::randint(-8, 8, {i + 1, 1023}, torch::kFloat).to(torch::kHalf));
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(world_size);
+  for (int i = 0; i < world_size; ++i) {
+    threads.emplace_back([&create, &func, &tensors, rank = i]() {
+      auto pg = create(rank);
+      func(tensors, pg.get());
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void check_allreduce(const std::vector<torch::Tensor>& tensors,
+                     ProcessGroup* pg) {
+  const int rank = pg->rank();
+  const int world_size = pg->world_size();
+  for (int i = 0; i <= tensors.size() - world_size; ++i) {
+    auto tensor = tensors[i + rank].clone();
+    pg->allreduce(tensor);
+    auto expected = torch::zeros_like(tensors[i]);
+    for (int j = 0; j < world_size; ++j) {
+      expected += tensors[i + j];
+    }
+    EXPECT_TRUE(torch::equal(tensor, expected));
+  }
+}
+
+void check_allgather(const std::vector<torch::Tensor>& tensors,
+                     ProcessGroup* pg) {
+  const int rank = pg->rank();
+  const int world_size = pg->world_size();
+  for (int i = 0; i <= tensors.size() - world_size; ++i) {
+    const auto& tensor = tensors[i + rank];
+    std::vector<torch::Tensor> outputs(world_size);
+    for (int j = 0; j < world_size; ++j) {
+      outputs[j] = torch::empty_like(tensor);
+    }
+    pg->allgather(tensor, outputs);
+    for (int j = 0; j < world_size; ++j) {
+      EXPECT_TRUE(torch::equal(tensors[i + j], outputs[j]));
+    }
+  }
+}
+
+std::function<std::unique_ptr<ProcessGroup>(int rank)> shm_process_groups(
+    int world_size) {
+  using ProcessGroups = std::vector<std::unique_ptr<ProcessGroup>>;
+  auto process_groups =
+      std::make_shared<ProcessGroups>(ProcessGroup::create_process_groups(
+          std::vector<torch::Device>(world_size, torch::kCPU)));
+  return [process_groups](int rank) {
+    return std::move((*process_groups)[rank]);
+  };
+}
+}  // namespace
+
+TEST(ProcessGroupTest, SHMAllReduce) {
+  for (int world_size = 2; world_size <= 4; ++world_size) {
+    run_cpu_collective_test(
+        world_size, shm_process_groups(world_size), check_allreduce);
+  }
+}
+
+TEST(ProcessGroupTest, SHMAllGather) {
+  for (int world_size = 2; world_size <= 4; ++world_size) {
+    run_cpu_collective_test(
+        world_size, shm_process_groups(world_size), check_allgather);
+  }
+}
+
+}  // namespace llm
@@ -3,8 +3,11 @@
 #include <c10/core/Device.h>
 #include <torch/torch.h>
 
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "layers/linear.h"
 #include "memory/kv_cache.h"
 #include "model_args.h"
 #include "model_loader/state_dict.h"
@@ -39,6 +42,14 @@ class CausalLM : public torch::nn::Module {
   // verify if the model is loaded correctly
   virtual void verify_loaded_weights() const = 0;
 
+  // prepare weights for faster forward once all weights are loaded
+  virtual void prepack_weights() = 0;
+
+  // all parameters and buffers of the model, which share storage with the
+  // model. used to save and restore the prepared weights.
+  virtual std::vector<std::pair<std::string, torch::Tensor>> named_weights()
+      const = 0;
+
   virtual torch::Device device() const = 0;
 
   virtual const torch::TensorOptions& options() const = 0;
@@ -77,6 +88,26 @@ class CausalLMImpl : public CausalLM {
     return model_->verify_loaded_weights();
   }
 
+  void prepack_weights() override {
+    for (const auto& module : model_->modules()) {
+      if (auto* linear = dynamic_cast<ParallelLinearImpl*>(module.get())) {
+        linear->prepack_weights();
+      }
+    }
+  }
+
+  std::vector<std::pair<std::string, torch::Tensor>> named_weights()
+      const override {
+    std::vector<std::pair<std::string, torch::Tensor>> weights;
+    for (const auto& item : model_->named_parameters(/*recurse=*/true)) {
+      weights.emplace_back(item.key(), item.value());
+    }
+    for (const auto& item : model_->named_buffers(/*recurse=*/true)) {
+      weights.emplace_back(item.key(), item.value());
+    }
+    return weights;
+  }
+
   torch::Device device() const override { return options_.device(); }
 
   const torch::TensorOptions& options() const override { return options_; }
@@ -24,6 +24,7 @@ struct InputParameters {
     params.new_cache_slots = safe_to(new_cache_slots, device);
     params.block_tables = safe_to(block_tables, device);
     params.cu_block_lens = safe_to(cu_block_lens, device);
+    params.tree_mask = safe_to(tree_mask, device);
     return params;
   }
 
@@ -57,6 +58,12 @@ struct InputParameters {
   // cumulative block length for each sequence.
   // IntTensor: [n_seq + 1]
   torch::Tensor cu_block_lens;
+
+  // attention mask among the query tokens of each sequence, used to verify
+  // token trees in speculative decoding. undefined for causal attention.
+  // the row of each token masks the query tokens of its own sequence.
+  // BoolTensor: [n_tokens, q_max_seq_len]
+  torch::Tensor tree_mask;
 };
 
 }  // namespace llm
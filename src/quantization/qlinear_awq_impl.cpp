@@ -38,6 +38,11 @@ torch::Tensor ColumnParallelQLinearAWQImpl::quant_matmul(
     const torch::Tensor& qweight,
     const torch::Tensor& qzeros,
     const torch::Tensor& scales) const {
+  // cuda kernels only, use cpu kernels of the base class
+  if (input.device().is_cpu()) {
+    return ColumnParallelQLinearImpl::quant_matmul(
+        input, qweight, qzeros, scales);
+  }
   const int64_t out_features = qweight.size(-1) * pack_factor_;
   torch::Tensor output =
       gemm_forward_cuda(input, qweight, scales, qzeros, pack_factor_);
@@ -71,6 +76,10 @@ torch::Tensor RowParallelQLinearAWQImpl::quant_matmul(
     const torch::Tensor& qweight,
     const torch::Tensor& qzeros,
     const torch::Tensor& scales) const {
+  // cuda kernels only, use cpu kernels of the base class
+  if (input.device().is_cpu()) {
+    return RowParallelQLinearImpl::quant_matmul(input, qweight, qzeros, scales);
+  }
   const int64_t out_features = qweight.size(-1) * pack_factor_;
   torch::Tensor output =
       gemm_forward_cuda(input, qweight, scales, qzeros, pack_factor_);
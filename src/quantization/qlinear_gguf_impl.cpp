@@ -0,0 +1,210 @@
+#include "qlinear_gguf_impl.h"
+
+#include <glog/logging.h>
+#include <torch/torch.h>
+
+#include "kernels/quantization/ggml/ggml_kernels.h"
+
+namespace llm {
+namespace {
+using kernel::ggml::GGMLType;
+
+// get the ggml type of loaded rows, all rows must share the same type
+GGMLType get_qtype(const torch::Tensor& qtype, std::string_view prefix) {
+  CHECK(qtype.defined()) << "qtype is not loaded for " << prefix << "qtype";
+  const auto types = qtype.flatten();
+  CHECK_GT(types.numel(), 0) << "empty qtype for " << prefix << "qtype";
+  const int64_t type = types[0].item<int64_t>();
+  CHECK(types.eq(type).all().item<bool>())
+      << "rows with mixed ggml types in " << prefix << "qweight";
+  const auto ggml_type = static_cast<GGMLType>(type);
+  CHECK(kernel::ggml::is_supported(ggml_type))
+      << "unsupported ggml type " << kernel::ggml::type_name(ggml_type)
+      << " (" << type << ") for " << prefix << "qweight";
+  return ggml_type;
+}
+
+// multiply the input of any rank with rows of blocks
+torch::Tensor quant_matmul(const torch::Tensor& input,
+                           const torch::Tensor& qweight,
+                           GGMLType qtype) {
+  auto sizes = input.sizes().vec();
+  auto output = kernel::ggml::matmul(
+      input.reshape({-1, input.size(-1)}), qweight, qtype);
+  sizes.back() = output.size(-1);
+  return output.view(sizes);
+}
+}  // namespace
+
+ColumnParallelQLinearGGUFImpl::ColumnParallelQLinearGGUFImpl(
+    int64_t in_features,
+    int64_t out_features,
+    bool bias,
+    const QuantArgs& /*quant_args*/,
+    bool gather_output,
+    const ParallelArgs& parallel_args,
+    const torch::TensorOptions& options)
+    : in_features_(in_features),
+      gather_output_(gather_output),
+      parallel_args_(parallel_args) {
+  CHECK(options.device().is_cpu()) << "gguf weights only support cpu";
+  const auto world_size = parallel_args_.world_size();
+  CHECK(out_features % world_size == 0)
+      << "out_features " << out_features << " not divisible by world_size "
+      << world_size;
+  out_features_per_partition_ = out_features / world_size;
+
+  // the size of rows depends on the ggml type, known after loading
+  qweight_ = register_parameter(
+      "qweight",
+      torch::empty({out_features_per_partition_, 0},
+                   options.dtype(torch::kUInt8)),
+      /*requires_grad=*/false);
+  if (bias) {
+    bias_ =
+        register_parameter("bias",
+                           torch::empty({out_features_per_partition_}, options),
+                           /*requires_grad=*/false);
+  }
+}
+
+torch::Tensor ColumnParallelQLinearGGUFImpl::forward(torch::Tensor input) {
+  auto output = quant_matmul(input, qweight_, qtype_);
+  if (bias_.defined()) {
+    output.add_(bias_);
+  }
+  if (parallel_args_.world_size() > 1 && gather_output_) {
+    output = gather_from_model_parallel_region(output, parallel_args_);
+  }
+  return output;
+}
+
+// load the weight from the checkpoint
+void ColumnParallelQLinearGGUFImpl::load_state_dict(
+    const StateDict& state_dict) {
+  const auto rank = parallel_args_.rank();
+  const auto world_size = parallel_args_.world_size();
+
+  // load sharded rows on dim 0
+  const auto qweight =
+      state_dict.get_sharded_tensor("qweight", 0, rank, world_size);
+  if (qweight.defined()) {
+    CHECK(!qweight_is_loaded_)
+        << "weight already loaded, name: " << state_dict.prefix() << "qweight";
+    qtype_ = get_qtype(
+        state_dict.get_sharded_tensor("qtype", 0, rank, world_size),
+        state_dict.prefix());
+    CHECK_EQ(qweight.size(0), out_features_per_partition_)
+        << "weight size mismatch for " << state_dict.prefix() << "qweight";
+    CHECK_EQ(qweight.size(1), kernel::ggml::row_bytes(qtype_, in_features_))
+        << "weight size mismatch for " << state_dict.prefix() << "qweight";
+    // rows are aliased instead of copied if memory mapped
+    WeightUtils::assign_weight(state_dict, qweight, qweight_);
+    qweight_is_loaded_ = true;
+  }
+
+  if (bias_.defined()) {
+    // load sharded bias on dim 0
+    LOAD_SHARDED_WEIGHT(bias, 0);
+  }
+}
+
+void ColumnParallelQLinearGGUFImpl::verify_loaded_weights(
+    const std::string& prefix) const {
+  CHECK(qweight_is_loaded_)
+      << "qweight is not loaded for " << prefix + "qweight";
+  CHECK(!bias_.defined() || bias_is_loaded_)
+      << "bias is not loaded for " << prefix + "bias";
+}
+
+RowParallelQLinearGGUFImpl::RowParallelQLinearGGUFImpl(
+    int64_t in_features,
+    int64_t out_features,
+    bool bias,
+    const QuantArgs& /*quant_args*/,
+    bool input_is_parallelized,
+    const ParallelArgs& parallel_args,
+    const torch::TensorOptions& options)
+    : out_features_(out_features),
+      input_is_parallelized_(input_is_parallelized),
+      parallel_args_(parallel_args) {
+  CHECK(options.device().is_cpu()) << "gguf weights only support cpu";
+  const auto world_size = parallel_args_.world_size();
+  CHECK(in_features % world_size == 0)
+      << "in_features " << in_features << " not divisible by world_size "
+      << world_size;
+  in_features_per_partition_ = in_features / world_size;
+
+  // the size of rows depends on the ggml type, known after loading
+  qweight_ = register_parameter(
+      "qweight",
+      torch::empty({out_features, 0}, options.dtype(torch::kUInt8)),
+      /*requires_grad=*/false);
+  if (bias) {
+    bias_ = register_parameter("bias",
+                               torch::empty({out_features}, options),
+                               /*requires_grad=*/false);
+  }
+}
+
+torch::Tensor RowParallelQLinearGGUFImpl::forward(torch::Tensor input) {
+  if (!input_is_parallelized_) {
+    input = scatter_to_model_parallel_region(input, parallel_args_);
+  }
+
+  auto output = quant_matmul(input, qweight_, qtype_);
+  if (parallel_args_.world_size() > 1) {
+    output = reduce_from_model_parallel_region(output, parallel_args_);
+  }
+  // N.B. need to apply bias after the reduce
+  if (bias_.defined()) {
+    output.add_(bias_);
+  }
+  return output;
+}
+
+// load the weight from the checkpoint
+void RowParallelQLinearGGUFImpl::load_state_dict(const StateDict& state_dict) {
+  const auto rank = parallel_args_.rank();
+  const auto world_size = parallel_args_.world_size();
+
+  const auto qtype = state_dict.get_tensor("qtype");
+  if (qtype.defined()) {
+    qtype_ = get_qtype(qtype, state_dict.prefix());
+  }
+  // load sharded blocks on dim 1, partitions must hold whole blocks
+  const auto qweight =
+      state_dict.get_sharded_tensor("qweight", 1, rank, world_size);
+  if (qweight.defined()) {
+    CHECK(!qweight_is_loaded_)
+        << "weight already loaded, name: " << state_dict.prefix() << "qweight";
+    CHECK(qtype.defined())
+        << "qtype is not loaded for " << state_dict.prefix() << "qtype";
+    CHECK_EQ(in_features_per_partition_ % kernel::ggml::block_size(qtype_), 0)
+        << "partition of " << state_dict.prefix()
+        << "qweight splits ggml blocks";
+    CHECK_EQ(qweight.size(0), out_features_)
+        << "weight size mismatch for " << state_dict.prefix() << "qweight";
+    CHECK_EQ(qweight.size(1),
+             kernel::ggml::row_bytes(qtype_, in_features_per_partition_))
+        << "weight size mismatch for " << state_dict.prefix() << "qweight";
+    // rows are aliased instead of copied if memory mapped and not sharded
+    WeightUtils::assign_weight(state_dict, qweight, qweight_);
+    qweight_is_loaded_ = true;
+  }
+
+  if (bias_.defined()) {
+    // load bias
+    LOAD_WEIGHT(bias);
+  }
+}
+
+void RowParallelQLinearGGUFImpl::verify_loaded_weights(
+    const std::string& prefix) const {
+  CHECK(qweight_is_loaded_)
+      << "qweight is not loaded for " << prefix + "qweight";
+  CHECK(!bias_.defined() || bias_is_loaded_)
+      << "bias is not loaded for " << prefix + "bias";
+}
+
+}  // namespace llm
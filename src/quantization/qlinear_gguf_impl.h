@@ -0,0 +1,114 @@
+#pragma once
+
+#include <torch/torch.h>
+
+#include "kernels/quantization/ggml/ggml_kernels.h"
+#include "layers/linear_impl.h"
+#include "layers/weight_utils.h"
+#include "model_loader/state_dict.h"
+#include "model_parallel/model_parallel.h"
+#include "models/model_args.h"
+
+namespace llm {
+// quantized linear layers for weights in ggml block formats from gguf files.
+// weights are loaded from "qweight" as uint8 rows of blocks, with the ggml
+// type of each row in "qtype". blocks stay quantized in memory and are
+// dequantized on the fly by cpu kernels, so only cpu devices are supported.
+
+// Quantized Linear layer with column parallelism.
+// The linear layer is defined as Y = XA + b. A is parallelized along
+// its second dimension as A = [A_1, ..., A_p].
+class ColumnParallelQLinearGGUFImpl : public ParallelLinearImpl {
+ public:
+  ColumnParallelQLinearGGUFImpl(int64_t in_features,
+                                int64_t out_features,
+                                bool bias,
+                                const QuantArgs& quant_args,
+                                bool gather_output,
+                                const ParallelArgs& parallel_args,
+                                const torch::TensorOptions& options);
+
+  torch::Tensor forward(torch::Tensor input) override;
+
+  // load the weight from the checkpoint
+  void load_state_dict(const StateDict& state_dict) override;
+
+  // whether the weight is loaded
+  void verify_loaded_weights(const std::string& prefix = "") const override;
+
+  void pretty_print(std::ostream& stream) const override {
+    stream << name() << " qweight=" << qweight_.sizes()
+           << " qtype=" << kernel::ggml::type_name(qtype_)
+           << " device=" << qweight_.device();
+  }
+
+ private:
+  // parameter members, must be registered
+  DEFINE_WEIGHT(qweight);
+  DEFINE_WEIGHT(bias);
+
+  // ggml type of qweight
+  kernel::ggml::GGMLType qtype_ = kernel::ggml::GGMLType::F32;
+
+  int64_t in_features_ = 0;
+  int64_t out_features_per_partition_ = 0;
+
+  // whether to gather the output
+  bool gather_output_;
+
+  // parallel args
+  ParallelArgs parallel_args_;
+};
+
+// Quantized Linear layer with row parallelism.
+//     The linear layer is defined as Y = XA + b. A is parallelized along
+//     its first dimension and X along its second dimension as:
+//                -   -
+//               | A_1 |
+//               | .   |
+//           A = | .   |       X = [X_1, ..., X_p]
+//               | .   |
+//               | A_p |
+//                -   -
+class RowParallelQLinearGGUFImpl : public ParallelLinearImpl {
+ public:
+  RowParallelQLinearGGUFImpl(int64_t in_features,
+                             int64_t out_features,
+                             bool bias,
+                             const QuantArgs& quant_args,
+                             bool input_is_parallelized,
+                             const ParallelArgs& parallel_args,
+                             const torch::TensorOptions& options);
+
+  torch::Tensor forward(torch::Tensor input) override;
+
+  // load the weight from the checkpoint
+  void load_state_dict(const StateDict& state_dict) override;
+
+  // whether the weight is loaded
+  void verify_loaded_weights(const std::string& prefix = "") const override;
+
+  void pretty_print(std::ostream& stream) const override {
+    stream << name() << " qweight=" << qweight_.sizes()
+           << " qtype=" << kernel::ggml::type_name(qtype_)
+           << " device=" << qweight_.device();
+  }
+
+ private:
+  // parameter members, must be registered
+  DEFINE_WEIGHT(qweight);
+  DEFINE_WEIGHT(bias);
+
+  // ggml type of qweight
+  kernel::ggml::GGMLType qtype_ = kernel::ggml::GGMLType::F32;
+
+  int64_t in_features_per_partition_ = 0;
+  int64_t out_features_ = 0;
+
+  // whether the input is already parallelized
+  bool input_is_parallelized_;
+
+  // parallel args
+  ParallelArgs parallel_args_;
+};
+}  // namespace llm
@@ -75,6 +75,11 @@ torch::Tensor ColumnParallelQLinearGPTQImpl::quant_matmul(
     const torch::Tensor& qweight,
     const torch::Tensor& qzeros,
     const torch::Tensor& scales) const {
+  // cuda kernels only, use cpu kernels of the base class
+  if (input.device().is_cpu()) {
+    return ColumnParallelQLinearImpl::quant_matmul(
+        input, qweight, qzeros, scales);
+  }
   const int64_t out_features = qweight.size(-1);
   // convert to float
   auto input_float = input.to(torch::kFloat32);
@@ -136,6 +141,10 @@ torch::Tensor RowParallelQLinearGPTQImpl::quant_matmul(
     const torch::Tensor& qweight,
     const torch::Tensor& qzeros,
     const torch::Tensor& scales) const {
+  // cuda kernels only, use cpu kernels of the base class
+  if (input.device().is_cpu()) {
+    return RowParallelQLinearImpl::quant_matmul(input, qweight, qzeros, scales);
+  }
   const int64_t out_features = qweight.size(-1);
   // convert to float
   auto input_float = input.to(torch::kFloat32);
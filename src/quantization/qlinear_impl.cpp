@@ -4,6 +4,7 @@
 #include <torch/torch.h>
 #include <torch/types.h>
 
+#include "kernels/quantization/cpu/qmatmul_kernels.h"
 #include "layers/linear_impl.h"
 #include "model_loader/state_dict.h"
 
@@ -13,6 +14,19 @@ int64_t round_up(int64_t num, int64_t multiple) {
   return ((num + multiple - 1) / multiple);
 }
 
+// dequantize tiles of weights on the fly instead of the whole weights
+torch::Tensor cpu_quant_matmul(const torch::Tensor& input,
+                               const torch::Tensor& qweight,
+                               const torch::Tensor& qzeros,
+                               const torch::Tensor& scales,
+                               int64_t bits,
+                               int64_t qweight_pack_dim) {
+  if (qweight_pack_dim == 0) {
+    return kernel::cpu::gptq_matmul(input, qweight, qzeros, scales, bits);
+  }
+  return kernel::cpu::awq_matmul(input, qweight, qzeros, scales, bits);
+}
+
 }  // namespace
 
 namespace detail {
@@ -110,6 +124,7 @@ ColumnParallelQLinearImpl::ColumnParallelQLinearImpl(
     const ParallelArgs& parallel_args,
     const torch::TensorOptions& options)
     : bits_(quant_args.bits()),
+      qweight_pack_dim_(qweight_pack_dim),
       gather_output_(gather_output),
       parallel_args_(parallel_args) {
   const auto bits = quant_args.bits();
@@ -162,6 +177,10 @@ torch::Tensor ColumnParallelQLinearImpl::quant_matmul(
     const torch::Tensor& qweight,
     const torch::Tensor& qzeros,
     const torch::Tensor& scales) const {
+  if (input.device().is_cpu()) {
+    return cpu_quant_matmul(
+        input, qweight, qzeros, scales, bits_, qweight_pack_dim_);
+  }
   const int64_t out_features = qweight.size(-1);
   torch::Tensor output =
       torch::zeros({input.size(0), out_features}, input.options());
@@ -227,6 +246,7 @@ RowParallelQLinearImpl::RowParallelQLinearImpl(
     const ParallelArgs& parallel_args,
     const torch::TensorOptions& options)
     : bits_(quant_args.bits()),
+      qweight_pack_dim_(qweight_pack_dim),
       input_is_parallelized_(input_is_parallelized),
       parallel_args_(parallel_args) {
   const auto bits = quant_args.bits();
@@ -280,6 +300,10 @@ torch::Tensor RowParallelQLinearImpl::quant_matmul(
     const torch::Tensor& qweight,
     const torch::Tensor& qzeros,
     const torch::Tensor& scales) const {
+  if (input.device().is_cpu()) {
+    return cpu_quant_matmul(
+        input, qweight, qzeros, scales, bits_, qweight_pack_dim_);
+  }
   const int64_t out_features = qweight.size(-1);
   torch::Tensor output =
       torch::zeros({input.size(0), out_features}, input.options());
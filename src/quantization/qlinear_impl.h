@@ -91,6 +91,9 @@ class ColumnParallelQLinearImpl : public ParallelLinearImpl {
 
   // quantization parameters
   int64_t bits_ = 0;
+  // 0 for gptq weights packed along in_features, 1 for awq weights packed
+  // along out_features
+  int64_t qweight_pack_dim_ = 0;
 
   // whether to gather the output
   bool gather_output_;
@@ -163,6 +166,9 @@ class RowParallelQLinearImpl : public ParallelLinearImpl {
 
   // quantization parameters
   int64_t bits_ = 0;
+  // 0 for gptq weights packed along in_features, 1 for awq weights packed
+  // along out_features
+  int64_t qweight_pack_dim_ = 0;
 
   // whether the input is already parallelized
   bool input_is_parallelized_;
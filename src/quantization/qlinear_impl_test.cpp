@@ -21,6 +21,43 @@ TEST(QlinearTest, Basic) {
   EXPECT_TRUE(torch::allclose(weights, weights_2));
 }
 
+TEST(QlinearTest, ColumnParallelQuantLinearCPU) {
+  const int64_t in_features = 256;
+  const int64_t out_features = 256;
+  QuantArgs quant_args;
+  quant_args.bits(4);
+  quant_args.group_size(128);
+  const auto options = torch::dtype(torch::kFloat32).device(torch::kCPU);
+  ColumnParallelQLinearImpl qlinear(in_features,
+                                    out_features,
+                                    /*bias=*/false,
+                                    quant_args,
+                                    /*qweight_pack_dim=*/0,
+                                    /*gather_output=*/false,
+                                    ParallelArgs(0, 1, nullptr),
+                                    options);
+  auto state_dict = StateDict::load_safetensors("data/gptq_small.safetensors");
+  auto weights = detail::construct_weights(
+      state_dict->get_tensor("qweight"),
+      state_dict->get_tensor("qzeros"),
+      state_dict->get_tensor("scales").to(torch::kFloat32),
+      /*bits=*/4);
+
+  qlinear.load_state_dict(*state_dict);
+  qlinear.verify_loaded_weights();
+
+  // both the gemv and the tiled gemm paths
+  for (const int64_t n_tokens : {1, 64}) {
+    auto input = torch::rand({n_tokens, in_features}, options);
+    auto output = qlinear.forward(input);
+    auto desired_output = torch::matmul(input, weights);
+    EXPECT_TRUE(torch::allclose(output,
+                                desired_output,
+                                /*rtol=*/1e-03,
+                                /*atol=*/1e-03));
+  }
+}
+
 TEST(QlinearTest, ColumnParallelQuantLinear) {
   if (!torch::cuda::is_available()) {
     GTEST_SKIP() << "CUDA not available, skipping test";
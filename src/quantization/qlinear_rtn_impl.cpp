@@ -0,0 +1,282 @@
+#include "qlinear_rtn_impl.h"
+
+#include <glog/logging.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+
+#include "layers/weight_utils.h"
+#include "model_loader/state_dict.h"
+#include "model_parallel/model_parallel.h"
+#include "pack_utils.h"
+
+namespace llm {
+namespace {
+// quantize the weight of the partition and load it into qlinear
+void load_quantized_weight(const StateDict& state_dict,
+                           const torch::Tensor& weight,
+                           int64_t bits,
+                           int64_t group_size,
+                           ParallelLinearImpl& qlinear) {
+  auto [qweight, qzeros, scales] =
+      detail::rtn_quantize(weight, bits, group_size);
+  const StateDict quantized({{"qweight", qweight},
+                             {"qzeros", qzeros},
+                             {"scales", scales.to(weight.scalar_type())}},
+                            std::string(state_dict.prefix()));
+  qlinear.load_state_dict(quantized);
+}
+}  // namespace
+
+namespace detail {
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> rtn_quantize(
+    const torch::Tensor& weight,
+    int64_t bits,
+    int64_t group_size) {
+  CHECK_EQ(weight.dim(), 2) << "weight must be 2-D";
+  CHECK(bits == 4 || bits == 8) << "Only 4 and 8 bits are supported for RTN";
+  const int64_t out_features = weight.size(0);
+  const int64_t in_features = weight.size(1);
+  if (group_size <= 0) {
+    group_size = in_features;
+  }
+  CHECK(in_features % group_size == 0)
+      << "in_features " << in_features << " not divisible by group_size "
+      << group_size;
+  const int64_t n_groups = in_features / group_size;
+
+  // symmetric quantization: q = round(w / scale) + zero, zero = 2^(bits-1)
+  const int64_t max_q = (1 << (bits - 1)) - 1;
+  // [out_features, n_groups, group_size]
+  const auto w =
+      weight.to(torch::kFloat32).reshape({out_features, n_groups, group_size});
+  // [out_features, n_groups, 1]
+  const auto scales =
+      w.abs().amax(/*dim=*/-1, /*keepdim=*/true).div(max_q).clamp_min(1e-8);
+  const auto q = torch::round(w / scales)
+                     .clamp(-max_q - 1, max_q)
+                     .add(max_q + 1)
+                     .to(torch::kInt32)
+                     .reshape({out_features, in_features});
+
+  // gptq packs qweight along in_features: [in_features / pack_factor, out]
+  const auto qweight =
+      pack_utils::pack_cols(q.cpu().contiguous(), bits).t().contiguous();
+  // gptq stores zeros minus one
+  const auto zeros = torch::full(
+      {n_groups, out_features}, max_q, torch::dtype(torch::kInt32));
+  const auto qzeros = pack_utils::pack_cols(zeros, bits);
+  return {qweight.to(weight.device()),
+          qzeros.to(weight.device()),
+          scales.squeeze(-1).t().contiguous()};
+}
+
+QuantArgs rtn_gptq_quant_args(const QuantArgs& quant_args) {
+  QuantArgs args;
+  args.quant_method() = "gptq";
+  args.bits() = quant_args.bits();
+  // -1 for one group per output feature
+  args.group_size() =
+      quant_args.group_size() > 0 ? quant_args.group_size() : -1;
+  args.is_sym() = true;
+  args.desc_act() = false;
+  return args;
+}
+}  // namespace detail
+
+ColumnParallelQLinearRTNImpl::ColumnParallelQLinearRTNImpl(
+    int64_t in_features,
+    int64_t out_features,
+    bool bias,
+    const QuantArgs& quant_args,
+    bool gather_output,
+    const ParallelArgs& parallel_args,
+    const torch::TensorOptions& options,
+    std::shared_ptr<ParallelLinearImpl> qlinear)
+    : bits_(quant_args.bits()),
+      group_size_(quant_args.group_size()),
+      gather_output_(gather_output),
+      parallel_args_(parallel_args) {
+  CHECK(bits_ == 4 || bits_ == 8) << "Only 4 and 8 bits are supported for RTN";
+  CHECK(group_size_ <= 0 || in_features % group_size_ == 0)
+      << "in_features " << in_features << " not divisible by group_size "
+      << group_size_;
+  const int64_t world_size = parallel_args.world_size();
+  CHECK(out_features % world_size == 0)
+      << "out_features " << out_features << " not divisible by world_size "
+      << world_size;
+  const int64_t out_features_per_partition = out_features / world_size;
+
+  qlinear_ = register_module("qlinear", std::move(qlinear));
+  if (bias) {
+    bias_ =
+        register_parameter("bias",
+                           torch::empty({out_features_per_partition}, options),
+                           /*requires_grad=*/false);
+  }
+}
+
+torch::Tensor ColumnParallelQLinearRTNImpl::forward(torch::Tensor input) {
+  auto output = qlinear_->forward(input);
+  if (bias_.defined()) {
+    output.add_(bias_);
+  }
+  if (parallel_args_.world_size() > 1 && gather_output_) {
+    output = gather_from_model_parallel_region(output, parallel_args_);
+  }
+  return output;
+}
+
+// load the weight from the checkpoint
+void ColumnParallelQLinearRTNImpl::load_state_dict(
+    const StateDict& state_dict) {
+  const auto rank = parallel_args_.rank();
+  const auto world_size = parallel_args_.world_size();
+
+  // quantize the partition sharded on dim 0 of [out_features, in_features]
+  if (!weight_is_loaded_) {
+    const auto weight =
+        state_dict.get_sharded_tensor("weight", 0, rank, world_size);
+    if (weight.defined()) {
+      load_quantized_weight(state_dict, weight, bits_, group_size_, *qlinear_);
+      weight_is_loaded_ = true;
+    }
+  }
+
+  // load bias if defined
+  if (bias_.defined()) {
+    // load sharded bias on dim 0
+    LOAD_SHARDED_WEIGHT(bias, 0);
+  }
+}
+
+// special load_state_dict for fused cases
+void ColumnParallelQLinearRTNImpl::load_state_dict(
+    const StateDict& state_dict,
+    const std::vector<std::string>& prefixes) {
+  const auto rank = parallel_args_.rank();
+  const auto world_size = parallel_args_.world_size();
+
+  // merge partitions of fused weights before quantizing them together
+  if (!weight_is_loaded_) {
+    if (weight_list_.size() < prefixes.size()) {
+      weight_list_.resize(prefixes.size());
+    }
+    for (size_t i = 0; i < prefixes.size(); ++i) {
+      if (weight_list_[i].defined()) {
+        continue;
+      }
+      const auto weight = state_dict.get_sharded_tensor(
+          prefixes[i] + "weight", 0, rank, world_size);
+      if (weight.defined()) {
+        // make a clone for safety
+        weight_list_[i] = weight.clone();
+      }
+    }
+    const bool all_loaded = std::all_of(
+        weight_list_.begin(), weight_list_.end(), [](const torch::Tensor& t) {
+          return t.defined();
+        });
+    if (all_loaded) {
+      load_quantized_weight(state_dict,
+                            torch::cat(weight_list_, /*dim=*/0),
+                            bits_,
+                            group_size_,
+                            *qlinear_);
+      weight_is_loaded_ = true;
+      // release the memory for weight_list
+      weight_list_.clear();
+    }
+  }
+
+  // load bias if defined
+  if (bias_.defined()) {
+    // load and merge bias on dim 0
+    LOAD_FUSED_WEIGHT(bias, 0);
+  }
+}
+
+void ColumnParallelQLinearRTNImpl::verify_loaded_weights(
+    const std::string& prefix) const {
+  CHECK(weight_is_loaded_) << "weight is not loaded for " << prefix + "weight";
+  CHECK(!bias_.defined() || bias_is_loaded_)
+      << "bias is not loaded for " << prefix + "bias";
+}
+
+RowParallelQLinearRTNImpl::RowParallelQLinearRTNImpl(
+    int64_t in_features,
+    int64_t out_features,
+    bool bias,
+    const QuantArgs& quant_args,
+    bool input_is_parallelized,
+    const ParallelArgs& parallel_args,
+    const torch::TensorOptions& options,
+    std::shared_ptr<ParallelLinearImpl> qlinear)
+    : bits_(quant_args.bits()),
+      group_size_(quant_args.group_size()),
+      input_is_parallelized_(input_is_parallelized),
+      parallel_args_(parallel_args) {
+  CHECK(bits_ == 4 || bits_ == 8) << "Only 4 and 8 bits are supported for RTN";
+  const int64_t world_size = parallel_args.world_size();
+  CHECK(in_features % world_size == 0)
+      << "in_features " << in_features << " not divisible by world_size "
+      << world_size;
+  const int64_t in_features_per_partition = in_features / world_size;
+  // groups can't span partitions
+  CHECK(group_size_ <= 0 || in_features_per_partition % group_size_ == 0)
+      << "in_features_per_partition " << in_features_per_partition
+      << " not divisible by group_size " << group_size_;
+
+  qlinear_ = register_module("qlinear", std::move(qlinear));
+  if (bias) {
+    bias_ = register_parameter("bias",
+                               torch::empty({out_features}, options),
+                               /*requires_grad=*/false);
+  }
+}
+
+torch::Tensor RowParallelQLinearRTNImpl::forward(torch::Tensor input) {
+  if (!input_is_parallelized_) {
+    input = scatter_to_model_parallel_region(input, parallel_args_);
+  }
+
+  auto output = qlinear_->forward(input);
+  if (parallel_args_.world_size() > 1) {
+    output = reduce_from_model_parallel_region(output, parallel_args_);
+  }
+  // N.B. need to apply bias after the reduce
+  if (bias_.defined()) {
+    output.add_(bias_);
+  }
+  return output;
+}
+
+// load the weight from the checkpoint
+void RowParallelQLinearRTNImpl::load_state_dict(const StateDict& state_dict) {
+  const auto rank = parallel_args_.rank();
+  const auto world_size = parallel_args_.world_size();
+
+  // quantize the partition sharded on dim 1 of [out_features, in_features]
+  if (!weight_is_loaded_) {
+    const auto weight =
+        state_dict.get_sharded_tensor("weight", 1, rank, world_size);
+    if (weight.defined()) {
+      load_quantized_weight(state_dict, weight, bits_, group_size_, *qlinear_);
+      weight_is_loaded_ = true;
+    }
+  }
+
+  if (bias_.defined()) {
+    // load bias
+    LOAD_WEIGHT(bias);
+  }
+}
+
+void RowParallelQLinearRTNImpl::verify_loaded_weights(
+    const std::string& prefix) const {
+  CHECK(weight_is_loaded_) << "weight is not loaded for " << prefix + "weight";
+  CHECK(!bias_.defined() || bias_is_loaded_)
+      << "bias is not loaded for " << prefix + "bias";
+}
+
+}  // namespace llm
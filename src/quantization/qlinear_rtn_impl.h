@@ -0,0 +1,146 @@
+#pragma once
+
+#include <torch/torch.h>
+
+#include <memory>
+#include <tuple>
+
+#include "layers/linear_impl.h"
+#include "layers/weight_utils.h"
+#include "model_loader/state_dict.h"
+#include "model_parallel/model_parallel.h"
+#include "models/model_args.h"
+
+namespace llm {
+
+namespace detail {
+// quantize weights with symmetric round-to-nearest into the gptq format,
+// the zero point is fixed to 2^(bits-1).
+// weight: [out_features, in_features]
+// returns: qweight [in_features / pack_factor, out_features] int32,
+//          qzeros [n_groups, out_features / pack_factor] int32,
+//          scales [n_groups, out_features] float
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> rtn_quantize(
+    const torch::Tensor& weight,
+    int64_t bits,
+    int64_t group_size);
+
+// quant args of the gptq layer holding weights quantized at load time
+QuantArgs rtn_gptq_quant_args(const QuantArgs& quant_args);
+}  // namespace detail
+
+// quantized linear layers for unquantized checkpoints, with quant method
+// "rtn". weights of the partition are quantized when loaded, to int8 or
+// int4 with one scale per output feature (group_size <= 0) or per group of
+// input features, and are held by a gptq layer without parallelism, so any
+// gptq implementation for the device can be used.
+
+// Quantized Linear layer with column parallelism.
+// The linear layer is defined as Y = XA + b. A is parallelized along
+// its second dimension as A = [A_1, ..., A_p].
+class ColumnParallelQLinearRTNImpl : public ParallelLinearImpl {
+ public:
+  // qlinear: gptq layer of [in_features, out_features / world_size]
+  ColumnParallelQLinearRTNImpl(int64_t in_features,
+                               int64_t out_features,
+                               bool bias,
+                               const QuantArgs& quant_args,
+                               bool gather_output,
+                               const ParallelArgs& parallel_args,
+                               const torch::TensorOptions& options,
+                               std::shared_ptr<ParallelLinearImpl> qlinear);
+
+  torch::Tensor forward(torch::Tensor input) override;
+
+  // load the weight from the checkpoint
+  void load_state_dict(const StateDict& state_dict) override;
+
+  // special load_state_dict for fused cases
+  void load_state_dict(const StateDict& state_dict,
+                       const std::vector<std::string>& prefixes) override;
+
+  // whether the weight is loaded
+  void verify_loaded_weights(const std::string& prefix = "") const override;
+
+  void pretty_print(std::ostream& stream) const override {
+    stream << name() << " bits=" << bits_ << " group_size=" << group_size_
+           << " qlinear=" << *qlinear_;
+  }
+
+ private:
+  // gptq layer holding quantized weights
+  std::shared_ptr<ParallelLinearImpl> qlinear_;
+
+  // parameter members, must be registered
+  DEFINE_FUSED_WEIGHT(bias);
+
+  // accumulated partitions of fused weights
+  std::vector<torch::Tensor> weight_list_;
+  bool weight_is_loaded_ = false;
+
+  // quantization parameters
+  int64_t bits_ = 0;
+  int64_t group_size_ = 0;
+
+  // whether to gather the output
+  bool gather_output_;
+
+  // parallel args
+  ParallelArgs parallel_args_;
+};
+
+// Quantized Linear layer with row parallelism.
+//     The linear layer is defined as Y = XA + b. A is parallelized along
+//     its first dimension and X along its second dimension as:
+//                -   -
+//               | A_1 |
+//               | .   |
+//           A = | .   |       X = [X_1, ..., X_p]
+//               | .   |
+//               | A_p |
+//                -   -
+class RowParallelQLinearRTNImpl : public ParallelLinearImpl {
+ public:
+  // qlinear: gptq layer of [in_features / world_size, out_features]
+  RowParallelQLinearRTNImpl(int64_t in_features,
+                            int64_t out_features,
+                            bool bias,
+                            const QuantArgs& quant_args,
+                            bool input_is_parallelized,
+                            const ParallelArgs& parallel_args,
+                            const torch::TensorOptions& options,
+                            std::shared_ptr<ParallelLinearImpl> qlinear);
+
+  torch::Tensor forward(torch::Tensor input) override;
+
+  // load the weight from the checkpoint
+  void load_state_dict(const StateDict& state_dict) override;
+
+  // whether the weight is loaded
+  void verify_loaded_weights(const std::string& prefix = "") const override;
+
+  void pretty_print(std::ostream& stream) const override {
+    stream << name() << " bits=" << bits_ << " group_size=" << group_size_
+           << " qlinear=" << *qlinear_;
+  }
+
+ private:
+  // gptq layer holding quantized weights
+  std::shared_ptr<ParallelLinearImpl> qlinear_;
+
+  // parameter members, must be registered
+  DEFINE_WEIGHT(bias);
+
+  bool weight_is_loaded_ = false;
+
+  // quantization parameters
+  int64_t bits_ = 0;
+  int64_t group_size_ = 0;
+
+  // whether the input is already parallelized
+  bool input_is_parallelized_;
+
+  // parallel args
+  ParallelArgs parallel_args_;
+};
+}  // namespace llm
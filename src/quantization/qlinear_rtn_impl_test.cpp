@@ -0,0 +1,157 @@
+#include "qlinear_rtn_impl.h"
+
+#include <gtest/gtest.h>
+#include <torch/torch.h>
+
+#include "model_loader/state_dict.h"
+#include "qlinear_impl.h"
+
+namespace llm {
+namespace {
+// quantization errors of all weights add up in outputs
+double relative_error(const torch::Tensor& output,
+                      const torch::Tensor& desired) {
+  return ((output - desired).norm() / desired.norm()).item<double>();
+}
+}  // namespace
+
+class QlinearRTNTest
+    : public ::testing::TestWithParam<std::tuple<int64_t, int64_t>> {};
+
+TEST_P(QlinearRTNTest, QuantizeRoundTrip) {
+  const auto [bits, group_size] = GetParam();
+  torch::manual_seed(0);
+  const int64_t in_features = 256;
+  const int64_t out_features = 64;
+  const auto weight = torch::randn({out_features, in_features});
+
+  const auto [qweight, qzeros, scales] =
+      detail::rtn_quantize(weight, bits, group_size);
+  const int64_t pack_factor = 32 / bits;
+  const int64_t n_groups = group_size > 0 ? in_features / group_size : 1;
+  EXPECT_EQ(qweight.sizes(),
+            torch::IntArrayRef({in_features / pack_factor, out_features}));
+  EXPECT_EQ(qzeros.sizes(),
+            torch::IntArrayRef({n_groups, out_features / pack_factor}));
+  EXPECT_EQ(scales.sizes(), torch::IntArrayRef({n_groups, out_features}));
+
+  // [in_features, out_features]
+  const auto weights =
+      detail::construct_weights(qweight, qzeros, scales, bits);
+  const int64_t group = group_size > 0 ? group_size : in_features;
+  const auto group_index = torch::arange(in_features).div(group, "floor");
+  // rounding error is at most half of the scale
+  const auto max_error = scales.index({group_index}) * 0.5 + 1e-6;
+  EXPECT_TRUE((weights - weight.t()).abs().le(max_error).all().item<bool>());
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    RTN,
+    QlinearRTNTest,
+    ::testing::Combine(::testing::Values(4, 8),
+                       ::testing::Values(-1, 64, 128)));
+
+TEST(QlinearRTNLayerTest, ColumnAndRowParallelCPU) {
+  torch::manual_seed(0);
+  const int64_t in_features = 256;
+  const int64_t out_features = 128;
+  QuantArgs quant_args;
+  quant_args.quant_method("rtn");
+  quant_args.bits(8);
+  quant_args.group_size(128);
+  const auto gptq_args = detail::rtn_gptq_quant_args(quant_args);
+  const auto options = torch::dtype(torch::kFloat32).device(torch::kCPU);
+  const ParallelArgs parallel_args(0, 1, nullptr);
+
+  const auto weight = torch::randn({out_features, in_features}, options);
+  const auto bias = torch::randn({out_features}, options);
+  StateDict state_dict({{"weight", weight}, {"bias", bias}});
+  const auto input = torch::randn({4, in_features}, options);
+  const auto desired_output =
+      torch::nn::functional::linear(input, weight, bias);
+
+  ColumnParallelQLinearRTNImpl column(
+      in_features,
+      out_features,
+      /*bias=*/true,
+      quant_args,
+      /*gather_output=*/false,
+      parallel_args,
+      options,
+      std::make_shared<ColumnParallelQLinearImpl>(in_features,
+                                                  out_features,
+                                                  /*bias=*/false,
+                                                  gptq_args,
+                                                  /*qweight_pack_dim=*/0,
+                                                  /*gather_output=*/false,
+                                                  parallel_args,
+                                                  options));
+  column.load_state_dict(state_dict);
+  column.verify_loaded_weights();
+  EXPECT_LT(relative_error(column.forward(input), desired_output), 2e-2);
+
+  RowParallelQLinearRTNImpl row(
+      in_features,
+      out_features,
+      /*bias=*/true,
+      quant_args,
+      /*input_is_parallelized=*/false,
+      parallel_args,
+      options,
+      std::make_shared<RowParallelQLinearImpl>(in_features,
+                                               out_features,
+                                               /*bias=*/false,
+                                               gptq_args,
+                                               /*qweight_pack_dim=*/0,
+                                               /*input_is_parallelized=*/true,
+                                               parallel_args,
+                                               options));
+  row.load_state_dict(state_dict);
+  row.verify_loaded_weights();
+  EXPECT_LT(relative_error(row.forward(input), desired_output), 2e-2);
+}
+
+TEST(QlinearRTNLayerTest, FusedColumnParallelCPU) {
+  torch::manual_seed(0);
+  const int64_t in_features = 128;
+  const int64_t out_features = 64;
+  QuantArgs quant_args;
+  quant_args.quant_method("rtn");
+  quant_args.bits(8);
+  const auto options = torch::dtype(torch::kFloat32).device(torch::kCPU);
+  const ParallelArgs parallel_args(0, 1, nullptr);
+
+  ColumnParallelQLinearRTNImpl fused(
+      in_features,
+      2 * out_features,
+      /*bias=*/false,
+      quant_args,
+      /*gather_output=*/false,
+      parallel_args,
+      options,
+      std::make_shared<ColumnParallelQLinearImpl>(
+          in_features,
+          2 * out_features,
+          /*bias=*/false,
+          detail::rtn_gptq_quant_args(quant_args),
+          /*qweight_pack_dim=*/0,
+          /*gather_output=*/false,
+          parallel_args,
+          options));
+  const auto gate = torch::randn({out_features, in_features}, options);
+  const auto up = torch::randn({out_features, in_features}, options);
+  // weights are loaded from different state dicts
+  fused.load_state_dict(StateDict({{"gate_proj.weight", gate}}),
+                        {"gate_proj.", "up_proj."});
+  EXPECT_DEATH(fused.verify_loaded_weights(), "weight is not loaded");
+  fused.load_state_dict(StateDict({{"up_proj.weight", up}}),
+                        {"gate_proj.", "up_proj."});
+  fused.verify_loaded_weights();
+
+  const auto input = torch::randn({2, in_features}, options);
+  const auto desired_output =
+      torch::matmul(input, torch::cat({gate, up}, /*dim=*/0).t());
+  EXPECT_LT(relative_error(fused.forward(input), desired_output), 2e-2);
+}
+
+}  // namespace llm
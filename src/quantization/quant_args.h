@@ -27,6 +27,10 @@ struct QuantArgs {
 
   // check if weights can be fused
   bool can_be_fused() const {
+    // can't fuse gguf weights since each tensor may use a different type
+    if (quant_method() == "gguf") {
+      return false;
+    }
     // can't fuse quantized weights if desc_act is true
     return quant_method().empty() || !desc_act();
   }
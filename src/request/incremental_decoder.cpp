@@ -1,16 +1,80 @@
 #include "incremental_decoder.h"
 
 #include <absl/strings/match.h>
+#include <glog/logging.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include <utility>
 
 #include "common/slice.h"
 #include "tokenizer/tokenizer.h"
 
 namespace llm {
+namespace {
+
+// the length of the utf-8 sequence from its lead byte, 0 if invalid
+size_t utf8_sequence_length(char c) {
+  const auto byte = static_cast<uint8_t>(c);
+  if (byte < 0x80) {
+    return 1;
+  }
+  if (byte >= 0xC2 && byte <= 0xDF) {
+    return 2;
+  }
+  if (byte >= 0xE0 && byte <= 0xEF) {
+    return 3;
+  }
+  if (byte >= 0xF0 && byte <= 0xF4) {
+    return 4;
+  }
+  return 0;
+}
+
+// the valid range of the second byte, which also rules out overlong
+// encodings, surrogates and code points above U+10FFFF
+std::pair<uint8_t, uint8_t> second_byte_range(uint8_t lead) {
+  switch (lead) {
+    case 0xE0:
+      return {0xA0, 0xBF};
+    case 0xED:
+      return {0x80, 0x9F};
+    case 0xF0:
+      return {0x90, 0xBF};
+    case 0xF4:
+      return {0x80, 0x8F};
+    default:
+      return {0x80, 0xBF};
+  }
+}
+
+// whether bytes is a valid prefix of a utf-8 sequence
+bool is_utf8_prefix(const std::string_view& bytes) {
+  const size_t len = utf8_sequence_length(bytes[0]);
+  if (len == 0 || bytes.size() > len) {
+    return false;
+  }
+  for (size_t i = 1; i < bytes.size(); ++i) {
+    const auto byte = static_cast<uint8_t>(bytes[i]);
+    const auto [lo, hi] = i == 1 ? second_byte_range(bytes[0])
+                                 : std::pair<uint8_t, uint8_t>{0x80, 0xBF};
+    if (byte < lo || byte > hi) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// whether bytes is exactly one valid utf-8 sequence
+bool is_valid_utf8(const std::string_view& bytes) {
+  return bytes.size() == utf8_sequence_length(bytes[0]) &&
+         is_utf8_prefix(bytes);
+}
+
+}  // namespace
 
 IncrementalDecoder::IncrementalDecoder(const std::string_view& prompt,
                                        size_t num_prompt_tokens,
@@ -24,18 +88,30 @@ IncrementalDecoder::IncrementalDecoder(const std::string_view& prompt,
   // prompt.
   prefix_offset_ = echo ? 0 : num_prompt_tokens_;
   output_offset_ = echo ? 0 : num_prompt_tokens_;
+  decoded_offset_ = output_offset_;
+  // decoding starts from the beginning of the text
+  strip_leading_space_ = output_offset_ == 0;
 }
 
 std::string IncrementalDecoder::decode(const Slice<int32_t>& token_ids,
-                                       const Tokenizer& tokenizer) {
-  std::stringstream ss;
+                                       const Tokenizer& tokenizer,
+                                       size_t max_generated_bytes) {
+  std::string text;
   // return prompt directly if prompt string is not empty
   if (output_offset_ < num_prompt_tokens_ && !prompt_.empty()) {
     // leave 6 tokens for the prefix to defeat cleanup algorithms in decode
     // which decide to add a space or not depending on the surrouding ids.
     prefix_offset_ = num_prompt_tokens_ <= 6 ? 0 : num_prompt_tokens_ - 6;
     output_offset_ = num_prompt_tokens_;
-    ss << prompt_;
+    decoded_offset_ = num_prompt_tokens_;
+    strip_leading_space_ = false;
+    text.append(prompt_);
+  }
+
+  const auto* table = tokenizer.token_bytes_table();
+  if (table != nullptr) {
+    stream_decode(token_ids, *table, max_generated_bytes, &text);
+    return text;
   }
 
   const auto prefix_text = tokenizer.decode(
@@ -48,9 +124,65 @@ std::string IncrementalDecoder::decode(const Slice<int32_t>& token_ids,
     prefix_offset_ = output_offset_;
     output_offset_ = token_ids.size();
     // only print the delta text
-    ss << new_text.substr(prefix_text.size());
+    text.append(new_text, prefix_text.size());
+  }
+  return text;
+}
+
+void IncrementalDecoder::stream_decode(const Slice<int32_t>& token_ids,
+                                       const TokenBytesTable& table,
+                                       size_t max_generated_bytes,
+                                       std::string* text) {
+  for (size_t i = decoded_offset_; i < token_ids.size(); ++i) {
+    const int32_t id = token_ids[i];
+    if (!table.contains(id)) {
+      LOG(ERROR) << "Failed to find token for id: " << id;
+      continue;
+    }
+    const auto bytes =
+        table.segment_bytes(id, skip_special_tokens_, &strip_leading_space_);
+    pending_bytes_.append(bytes);
+    if (i >= num_prompt_tokens_) {
+      num_generated_bytes_ += bytes.size();
+    }
+  }
+  decoded_offset_ = token_ids.size();
+
+  // hold back generated bytes over the limit, e.g. a partial stop string
+  size_t num_held_bytes = 0;
+  if (num_generated_bytes_ > max_generated_bytes) {
+    num_held_bytes = std::min(num_generated_bytes_ - max_generated_bytes,
+                              pending_bytes_.size());
+  }
+
+  // output complete utf-8 sequences and replace invalid bytes with U+FFFD
+  const std::string_view bytes(pending_bytes_.data(),
+                               pending_bytes_.size() - num_held_bytes);
+  const size_t text_size = text->size();
+  size_t offset = 0;
+  while (offset < bytes.size()) {
+    const size_t len = utf8_sequence_length(bytes[offset]);
+    if (offset + len > bytes.size() &&
+        is_utf8_prefix(bytes.substr(offset))) {
+      // hold back the unfinished sequence
+      break;
+    }
+    if (len > 0 && is_valid_utf8(bytes.substr(offset, len))) {
+      text->append(bytes.substr(offset, len));
+      offset += len;
+    } else {
+      // add replacement character � (U+FFFD) in UTF-8
+      text->append("�");
+      offset += 1;
+    }
+  }
+  pending_bytes_.erase(0, offset);
+
+  // all tokens are decoded once no bytes are held back except over the limit
+  if (text->size() > text_size && pending_bytes_.size() == num_held_bytes) {
+    prefix_offset_ = output_offset_;
+    output_offset_ = token_ids.size();
   }
-  return ss.str();
 }
 
 }  // namespace llm
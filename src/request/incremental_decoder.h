@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cstdint>
+#include <limits>
 #include <string>
+#include <string_view>
 
 #include "common/slice.h"
 #include "tokenizer/tokenizer.h"
@@ -18,8 +20,13 @@ class IncrementalDecoder final {
 
   // decode the token ids incrementally
   // return the decoded delta text since last call.
+  // at most max_generated_bytes bytes of generated tokens are sent, the rest
+  // are held back. only supported with the token bytes table.
   std::string decode(const Slice<int32_t>& token_ids,
-                     const Tokenizer& tokenizer);
+                     const Tokenizer& tokenizer,
+                     size_t max_generated_bytes = kNoLimit);
+
+  static constexpr size_t kNoLimit = std::numeric_limits<size_t>::max();
 
   // get the offset of the output text
   size_t output_offset() const { return output_offset_; }
@@ -28,6 +35,13 @@ class IncrementalDecoder final {
   size_t prefix_offset() const { return prefix_offset_; }
 
  private:
+  // decode new tokens byte by byte with the id to bytes table, only holding
+  // back incomplete utf-8 sequences.
+  void stream_decode(const Slice<int32_t>& token_ids,
+                     const TokenBytesTable& table,
+                     size_t max_generated_bytes,
+                     std::string* text);
+
   // the original prompt string, used to skip the prompt decoding when streaming
   std::string_view prompt_;
 
@@ -43,6 +57,16 @@ class IncrementalDecoder final {
   size_t prefix_offset_ = 0;
   // all tokens before output_offset_ have been decoded
   size_t output_offset_ = 0;
+
+  // states for streaming decoding
+  // all tokens before decoded_offset_ have been appended to pending_bytes_
+  size_t decoded_offset_ = 0;
+  // bytes of an incomplete utf-8 sequence held back from output
+  std::string pending_bytes_;
+  // number of bytes of generated tokens appended to pending_bytes_
+  size_t num_generated_bytes_ = 0;
+  // whether to strip the leading space of the next token, see TokenBytesTable
+  bool strip_leading_space_ = false;
 };
 
 }  // namespace llm
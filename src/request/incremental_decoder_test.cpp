@@ -0,0 +1,177 @@
+#include "incremental_decoder.h"
+
+#include <gtest/gtest.h>
+
+#include "tokenizer/token_bytes_table.h"
+#include "tokenizer/tokenizer.h"
+
+namespace llm {
+namespace {
+
+// a tokenizer that decodes tokens with a byte table
+class ByteTokenizer : public Tokenizer {
+ public:
+  explicit ByteTokenizer(bool use_table) : use_table_(use_table) {
+    // 0-255: raw bytes, 256: special token, 257-259: words
+    for (int32_t i = 0; i < 256; ++i) {
+      const char ch = static_cast<char>(i);
+      table_.add(i, std::string_view(&ch, 1));
+    }
+    table_.add(256, "<|end|>", /*special=*/true);
+    table_.add(257, "hello");
+    table_.add(258, " world");
+    table_.add(259, "你");
+  }
+
+  bool encode(const std::string_view& /*text*/,
+              std::vector<int32_t>* /*ids*/) const override {
+    return false;
+  }
+
+  std::string decode(const Slice<int32_t>& ids,
+                     bool skip_special_tokens) const override {
+    std::string text;
+    for (const auto id : ids) {
+      if (skip_special_tokens && table_.is_special(id)) {
+        continue;
+      }
+      text.append(table_.bytes(id));
+    }
+    // mark unfinished utf8 bytes at the end with � (U+FFFD)
+    for (size_t i = 1; i <= 3 && i <= text.size(); ++i) {
+      const auto byte = static_cast<uint8_t>(text[text.size() - i]);
+      if ((byte & 0xC0) != 0x80) {
+        const size_t len = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : 2;
+        if (byte >= 0xC0 && i < len) {
+          text.append("�");
+        }
+        break;
+      }
+    }
+    return text;
+  }
+
+  const TokenBytesTable* token_bytes_table() const override {
+    return use_table_ ? &table_ : nullptr;
+  }
+
+  std::optional<int32_t> token_to_id(
+      const std::string_view& /*token*/) const override {
+    return std::nullopt;
+  }
+
+  std::string id_to_token(int32_t id) const override {
+    return std::string(table_.bytes(id));
+  }
+
+  size_t vocab_size() const override { return table_.size(); }
+
+  std::unique_ptr<Tokenizer> clone() const override {
+    return std::make_unique<ByteTokenizer>(use_table_);
+  }
+
+ private:
+  TokenBytesTable table_;
+  bool use_table_ = true;
+};
+
+// decode token by token and collect the delta text
+std::string stream_decode(IncrementalDecoder& decoder,
+                          const std::vector<int32_t>& ids,
+                          const Tokenizer& tokenizer) {
+  std::string text;
+  for (size_t end = 1; end <= ids.size(); ++end) {
+    text += decoder.decode(Slice<int32_t>(ids, end), tokenizer);
+  }
+  return text;
+}
+
+}  // namespace
+
+TEST(IncrementalDecoderTest, HoldBackIncompleteUTF8) {
+  ByteTokenizer tokenizer(/*use_table=*/true);
+  // "好" = e5 a5 bd, split into byte tokens
+  const std::vector<int32_t> ids = {257, 0xE5, 0xA5, 0xBD, 258};
+  IncrementalDecoder decoder("",
+                             /*num_prompt_tokens=*/1,
+                             /*echo=*/false,
+                             /*skip_special_tokens=*/true);
+  EXPECT_EQ(decoder.decode(Slice<int32_t>(ids, 2), tokenizer), "");
+  EXPECT_EQ(decoder.output_offset(), 1);
+  EXPECT_EQ(decoder.decode(Slice<int32_t>(ids, 3), tokenizer), "");
+  EXPECT_EQ(decoder.output_offset(), 1);
+  EXPECT_EQ(decoder.decode(Slice<int32_t>(ids, 4), tokenizer), "好");
+  EXPECT_EQ(decoder.output_offset(), 4);
+  EXPECT_EQ(decoder.decode(Slice<int32_t>(ids, 5), tokenizer), " world");
+  EXPECT_EQ(decoder.output_offset(), 5);
+}
+
+TEST(IncrementalDecoderTest, InvalidUTF8) {
+  ByteTokenizer tokenizer(/*use_table=*/true);
+  // a stray continuation byte and a truncated sequence
+  const std::vector<int32_t> ids = {257, 0xA5, 0xE5, 0xA5, 258};
+  IncrementalDecoder decoder("",
+                             /*num_prompt_tokens=*/1,
+                             /*echo=*/false,
+                             /*skip_special_tokens=*/true);
+  EXPECT_EQ(stream_decode(decoder, ids, tokenizer), "��� world");
+  EXPECT_EQ(decoder.output_offset(), 5);
+}
+
+TEST(IncrementalDecoderTest, SpecialTokens) {
+  ByteTokenizer tokenizer(/*use_table=*/true);
+  const std::vector<int32_t> ids = {257, 259, 256, 258};
+  {
+    IncrementalDecoder decoder("hello",
+                               /*num_prompt_tokens=*/1,
+                               /*echo=*/true,
+                               /*skip_special_tokens=*/true);
+    EXPECT_EQ(stream_decode(decoder, ids, tokenizer), "hello你 world");
+  }
+  {
+    IncrementalDecoder decoder("hello",
+                               /*num_prompt_tokens=*/1,
+                               /*echo=*/true,
+                               /*skip_special_tokens=*/false);
+    EXPECT_EQ(stream_decode(decoder, ids, tokenizer), "hello你<|end|> world");
+  }
+}
+
+TEST(IncrementalDecoderTest, MaxGeneratedBytes) {
+  ByteTokenizer tokenizer(/*use_table=*/true);
+  const std::vector<int32_t> ids = {257, 257, 258, 0xE5, 0xA5, 0xBD};
+  IncrementalDecoder decoder("",
+                             /*num_prompt_tokens=*/1,
+                             /*echo=*/false,
+                             /*skip_special_tokens=*/true);
+  // hold back " world"
+  EXPECT_EQ(decoder.decode(Slice<int32_t>(ids, 3), tokenizer, 6), "hello ");
+  EXPECT_EQ(decoder.output_offset(), 3);
+  EXPECT_EQ(decoder.decode(Slice<int32_t>(ids, 3), tokenizer, 6), "");
+  // release held bytes, stop in the middle of a utf-8 sequence
+  EXPECT_EQ(decoder.decode(Slice<int32_t>(ids, 6), tokenizer, 13), "world");
+  EXPECT_EQ(decoder.decode(Slice<int32_t>(ids, 6), tokenizer), "好");
+}
+
+TEST(IncrementalDecoderTest, SameAsFullDecode) {
+  ByteTokenizer table_tokenizer(/*use_table=*/true);
+  ByteTokenizer tokenizer(/*use_table=*/false);
+  const std::vector<int32_t> ids = {
+      257, 258, 0xE4, 0xBD, 0xA0, 259, 'a', 258, 0xF0, 0x9F, 0x98, 0x80, 257};
+  IncrementalDecoder table_decoder("",
+                                   /*num_prompt_tokens=*/1,
+                                   /*echo=*/false,
+                                   /*skip_special_tokens=*/true);
+  IncrementalDecoder decoder("",
+                             /*num_prompt_tokens=*/1,
+                             /*echo=*/false,
+                             /*skip_special_tokens=*/true);
+  for (size_t end = 1; end <= ids.size(); ++end) {
+    const Slice<int32_t> slice(ids, end);
+    EXPECT_EQ(table_decoder.decode(slice, table_tokenizer),
+              decoder.decode(slice, tokenizer));
+    EXPECT_EQ(table_decoder.output_offset(), decoder.output_offset());
+  }
+}
+
+}  // namespace llm
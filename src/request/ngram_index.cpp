@@ -0,0 +1,123 @@
+#include "ngram_index.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "common/slice.h"
+
+namespace llm {
+
+NGramIndex::NGramIndex(size_t max_ngram)
+    : max_ngram_(max_ngram), hashes_(max_ngram), positions_(max_ngram) {
+  CHECK_GT(max_ngram, 0) << "max_ngram should be positive";
+}
+
+uint64_t NGramIndex::hash_ngram(const Slice<int32_t>& tokens,
+                                size_t end,
+                                size_t n) {
+  // FNV-1a over token ids
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = end + 1 - n; i <= end; ++i) {
+    hash ^= static_cast<uint32_t>(tokens[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+void NGramIndex::update(const Slice<int32_t>& tokens) {
+  CHECK_GE(tokens.size(), num_tokens_) << "indexed tokens are truncated";
+  for (size_t pos = num_tokens_; pos < tokens.size(); ++pos) {
+    for (size_t n = 1; n <= max_ngram_; ++n) {
+      // not enough tokens for the n-gram
+      if (pos + 1 < n) {
+        hashes_[n - 1].push_back(0);
+        continue;
+      }
+      const uint64_t hash = hash_ngram(tokens, pos, n);
+      hashes_[n - 1].push_back(hash);
+      positions_[n - 1][hash].push_back(static_cast<uint32_t>(pos));
+    }
+  }
+  num_tokens_ = tokens.size();
+}
+
+void NGramIndex::truncate(size_t size) {
+  // remove positions in reverse order
+  for (size_t pos = num_tokens_; pos > size; --pos) {
+    const size_t end = pos - 1;
+    for (size_t n = 1; n <= max_ngram_ && n <= pos; ++n) {
+      auto& map = positions_[n - 1];
+      auto it = map.find(hashes_[n - 1][end]);
+      DCHECK(it != map.end() && it->second.back() == end);
+      it->second.pop_back();
+      if (it->second.empty()) {
+        map.erase(it);
+      }
+    }
+  }
+  if (size < num_tokens_) {
+    for (auto& hashes : hashes_) {
+      hashes.resize(size);
+    }
+    num_tokens_ = size;
+  }
+}
+
+std::optional<size_t> NGramIndex::find(const Slice<int32_t>& tokens) const {
+  const auto matches = find_all(tokens, /*max_matches=*/1);
+  if (matches.empty()) {
+    return std::nullopt;
+  }
+  return matches.front();
+}
+
+std::vector<size_t> NGramIndex::find_all(const Slice<int32_t>& tokens,
+                                         size_t max_matches) const {
+  CHECK_EQ(tokens.size(), num_tokens_) << "tokens are not indexed";
+  std::vector<size_t> matches;
+  if (num_tokens_ < 2 || max_matches == 0) {
+    return matches;
+  }
+
+  const size_t last = num_tokens_ - 1;
+  for (size_t n = std::min(max_ngram_, last); n > 0; --n) {
+    const auto it = positions_[n - 1].find(hashes_[n - 1][last]);
+    if (it == positions_[n - 1].end()) {
+      continue;
+    }
+    // search from the most recent occurrence, skipping the last n-gram itself
+    const auto& ends = it->second;
+    for (auto rit = ends.rbegin(); rit != ends.rend(); ++rit) {
+      const size_t end = *rit;
+      if (end >= last) {
+        continue;
+      }
+      // double check to rule out hash collisions
+      if (!std::equal(tokens.begin() + end + 1 - n,
+                      tokens.begin() + end + 1,
+                      tokens.begin() + last + 1 - n)) {
+        continue;
+      }
+      // skip occurrences followed by the same token as an earlier match
+      const int32_t next_token = tokens[end + 1];
+      const bool duplicated =
+          std::any_of(matches.begin(), matches.end(), [&](size_t pos) {
+            return tokens[pos] == next_token;
+          });
+      if (duplicated) {
+        continue;
+      }
+      matches.push_back(end + 1);
+      if (matches.size() >= max_matches) {
+        return matches;
+      }
+    }
+  }
+  return matches;
+}
+
+}  // namespace llm
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <absl/container/flat_hash_map.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "common/slice.h"
+
+namespace llm {
+
+// An incremental n-gram index over the token ids of a sequence, used to find
+// earlier occurrences of the latest tokens for prompt lookup decoding.
+// n-grams of size [1, max_ngram] are indexed by their end positions.
+class NGramIndex final {
+ public:
+  NGramIndex() = default;
+
+  explicit NGramIndex(size_t max_ngram);
+
+  // get the max n-gram size of the index
+  size_t max_ngram() const { return max_ngram_; }
+
+  // get the number of tokens indexed
+  size_t num_tokens() const { return num_tokens_; }
+
+  // index the new tokens in [num_tokens(), tokens.size())
+  // N.B. tokens[0, num_tokens()) should not be changed since last update.
+  void update(const Slice<int32_t>& tokens);
+
+  // drop index entries for tokens in [size, num_tokens()), should be called
+  // before any indexed tokens are overwritten, e.g. rejected draft tokens.
+  void truncate(size_t size);
+
+  // find the most recent earlier occurrence of the last n tokens, trying the
+  // longest n-gram first. returns the position right after the occurrence.
+  // tokens should be the same as the ones indexed.
+  std::optional<size_t> find(const Slice<int32_t>& tokens) const;
+
+  // find up to max_matches earlier occurrences of the last n tokens in the
+  // same order as find(), keeping only the first occurrence followed by each
+  // distinct token. returns the positions right after the occurrences.
+  std::vector<size_t> find_all(const Slice<int32_t>& tokens,
+                               size_t max_matches) const;
+
+ private:
+  // hash for the n-gram of size n ending at position end (inclusive)
+  static uint64_t hash_ngram(const Slice<int32_t>& tokens,
+                             size_t end,
+                             size_t n);
+
+  // max n-gram size to index
+  size_t max_ngram_ = 0;
+
+  // number of tokens indexed
+  size_t num_tokens_ = 0;
+
+  // hash of n-gram ending at each position, [max_ngram, num_tokens]
+  std::vector<std::vector<uint64_t>> hashes_;
+
+  // n-gram hash => end positions in ascending order, one map for each n
+  std::vector<absl::flat_hash_map<uint64_t, std::vector<uint32_t>>>
+      positions_;
+};
+
+}  // namespace llm
@@ -0,0 +1,71 @@
+#include "ngram_index.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace llm {
+
+TEST(NGramIndexTest, Basic) {
+  NGramIndex index(/*max_ngram=*/3);
+  std::vector<int32_t> tokens = {1, 2, 3, 4, 5};
+  index.update(tokens);
+  EXPECT_EQ(index.num_tokens(), tokens.size());
+  // no earlier occurrence of the last token
+  EXPECT_FALSE(index.find(tokens).has_value());
+
+  // [2, 3] appeared at [1, 2], continue from position 3
+  tokens.push_back(2);
+  tokens.push_back(3);
+  index.update(tokens);
+  EXPECT_EQ(index.find(tokens), 3);
+
+  // [1, 2, 3] matches the longest n-gram at the beginning
+  tokens = {1, 2, 3, 9, 2, 3, 8, 1, 2, 3};
+  index = NGramIndex(/*max_ngram=*/3);
+  index.update(tokens);
+  EXPECT_EQ(index.find(tokens), 3);
+
+  // fallback to shorter n-gram, most recent occurrence first
+  tokens = {7, 3, 6, 5, 3, 4, 3};
+  index = NGramIndex(/*max_ngram=*/3);
+  index.update(tokens);
+  EXPECT_EQ(index.find(tokens), 5);
+}
+
+TEST(NGramIndexTest, FindAll) {
+  NGramIndex index(/*max_ngram=*/3);
+  std::vector<int32_t> tokens = {1, 2, 3, 9, 2, 3, 8, 1, 2, 3};
+  index.update(tokens);
+  // [1, 2, 3] followed by 9, then [2, 3] followed by 8, other occurrences
+  // are followed by the same tokens
+  EXPECT_EQ(index.find_all(tokens, /*max_matches=*/4),
+            std::vector<size_t>({3, 6}));
+  EXPECT_EQ(index.find_all(tokens, /*max_matches=*/1),
+            std::vector<size_t>({3}));
+  EXPECT_TRUE(index.find_all(tokens, /*max_matches=*/0).empty());
+}
+
+TEST(NGramIndexTest, Truncate) {
+  NGramIndex index(/*max_ngram=*/2);
+  std::vector<int32_t> tokens = {1, 2, 3, 1, 2};
+  index.update(tokens);
+  EXPECT_EQ(index.find(tokens), 2);
+
+  // drop the last two tokens and overwrite them
+  index.truncate(3);
+  EXPECT_EQ(index.num_tokens(), 3);
+  tokens = {1, 2, 3, 4, 5};
+  index.update(tokens);
+  EXPECT_FALSE(index.find(tokens).has_value());
+
+  // truncate beyond the indexed tokens is a no-op
+  index.truncate(10);
+  EXPECT_EQ(index.num_tokens(), 5);
+
+  tokens.push_back(3);
+  index.update(tokens);
+  EXPECT_EQ(index.find(tokens), 3);
+}
+
+}  // namespace llm
@@ -3,8 +3,10 @@
 #include <absl/time/clock.h>
 #include <absl/time/time.h>
 
+#include <atomic>
 #include <cstdint>
 #include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -48,7 +50,9 @@ struct Request final {
   void cancel() { is_cancelled_.store(true, std::memory_order_relaxed); }
 
   bool is_cancelled() const {
-    return is_cancelled_.load(std::memory_order_relaxed);
+    return is_cancelled_.load(std::memory_order_relaxed) ||
+           (cancel_flag != nullptr &&
+            cancel_flag->load(std::memory_order_relaxed));
   }
 
   // Get the elapsed time since the request was created.
@@ -107,6 +111,26 @@ struct Request final {
   // function to call when an output is generated.
   OnOutput on_output;
 
+  // optional flag shared by requests that are cancelled together, e.g. the
+  // prompts of a batch call whose client has gone away.
+  std::shared_ptr<std::atomic_bool> cancel_flag;
+
+  // states to coalesce streaming outputs, used by the response handler only.
+  struct StreamState {
+    // the total number of generated tokens of all sequences at the last flush
+    size_t num_flushed_tokens = 0;
+
+    // the time of the last flush
+    absl::Time last_flush_time = absl::InfinitePast();
+
+    // the number of queued outputs that are not sent yet
+    std::atomic<int32_t> num_pending_outputs{0};
+
+    // whether the client could not keep up with the outputs
+    bool slow_client = false;
+  };
+  StreamState stream_state;
+
  private:
   // is the sequence cancelled
   std::atomic_bool is_cancelled_{false};
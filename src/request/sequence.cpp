@@ -23,6 +23,10 @@ DEFINE_COUNTER_INSTANCE(non_stream_decode_latency_seconds,
                         {{"mode", "non-stream"}});
 
 namespace llm {
+namespace {
+// smoothing factor for the moving average of draft acceptance rate
+constexpr double kAcceptanceRateSmoothing = 0.3;
+}  // namespace
 
 Sequence::Sequence(size_t index,
                    const std::string_view& prompt,
@@ -42,6 +46,12 @@ Sequence::Sequence(size_t index,
   CHECK_GT(capacity, prompt_token_ids.size()) << "capacity too small";
 
   num_prompt_tokens_ = prompt_token_ids.size();
+  stop_string_matcher_ =
+      StopStringMatcher(option.stopping_criteria.stop_strings,
+                        option.stopping_criteria.token_bytes_table,
+                        num_prompt_tokens_,
+                        capacity,
+                        option.skip_special_tokens);
   // allocate space for token ids, logprobs, top tokens and top logprobs
   token_ids_.resize(capacity);
   logprobs_.resize(capacity);
@@ -89,7 +99,37 @@ void Sequence::append_token(const Token& token) {
   finish_status_invalidated_ = true;
 }
 
+void Sequence::append_draft_token(int32_t token_id) {
+  CHECK(num_tokens_ < token_ids_.size())
+      << "exceed the token capacity of the sequence";
+  CHECK(!is_finished_) << "cannot append token to a finished sequence";
+
+  token_ids_[num_tokens_++] = token_id;
+  token_to_count_map_[token_id]++;
+
+  // invalidate the finish status once a new token is appended
+  finish_status_invalidated_ = true;
+}
+
+const NGramIndex& Sequence::ngram_index(size_t max_ngram) {
+  if (ngram_index_.max_ngram() != max_ngram) {
+    ngram_index_ = NGramIndex(max_ngram);
+  }
+  ngram_index_.update(token_ids());
+  return ngram_index_;
+}
+
 size_t Sequence::validate_tokens(const std::vector<Token>& tokens) {
+  size_t num_accepted_drafts = 0;
+  const size_t num_accepted = accept_draft_tokens(tokens, &num_accepted_drafts);
+  // the evaluated draft tokens, excluding the bonus token
+  update_draft_acceptance_rate(num_accepted_drafts,
+                               std::min(num_accepted, tokens.size() - 1));
+  return num_accepted;
+}
+
+size_t Sequence::accept_draft_tokens(const std::vector<Token>& tokens,
+                                     size_t* num_accepted_drafts) {
   const size_t len = tokens.size();
   CHECK_GT(len, 0) << "empty accepted token ids";
   CHECK_GT(num_tokens_, len) << "accepted tokens exceed the sequence length";
@@ -100,11 +140,16 @@ size_t Sequence::validate_tokens(const std::vector<Token>& tokens) {
   // validate the accepted tokens with draft tokens, stop at the first mismatch
   const size_t start_idx = num_tokens_ - len;
 
+  // draft tokens may be overwritten or discarded, drop them from the index
+  ngram_index_.truncate(start_idx);
+  stop_string_matcher_.truncate(start_idx);
+
   // check if the token is the first token after the prompt
   is_first_token_ = start_idx == num_prompt_tokens_;
 
   bool mismatch = false;
   size_t num_accpeted = 0;
+  *num_accepted_drafts = 0;
   for (size_t i = 0; i < len; ++i) {
     const auto& token = tokens[i];
     const size_t cur_idx = start_idx + i;
@@ -118,6 +163,9 @@ size_t Sequence::validate_tokens(const std::vector<Token>& tokens) {
     }
     ++num_accpeted;
     mismatch = target_token_id != draft_token_id;
+    if (!mismatch && i + 1 < len) {
+      ++(*num_accepted_drafts);
+    }
     if (mismatch) {
       // overwrite the token id with the accepted token id
       token_ids_[cur_idx] = target_token_id;
@@ -131,9 +179,7 @@ size_t Sequence::validate_tokens(const std::vector<Token>& tokens) {
     }
 
     // check if sequence is finished
-    const Slice<int32_t> token_ids(token_ids_, cur_idx + 1);
-    auto finish_reason = options_.stopping_criteria.check_finished(
-        token_ids, num_prompt_tokens_);
+    auto finish_reason = check_finished(cur_idx + 1);
     if (finish_reason != FinishReason::NONE) {
       finish_reason_ = finish_reason;
       is_finished_ = true;
@@ -161,6 +207,92 @@ size_t Sequence::validate_tokens(const std::vector<Token>& tokens) {
   return num_accpeted;
 }
 
+void Sequence::append_draft_tree(const std::vector<int32_t>& token_ids,
+                                 const std::vector<int32_t>& parents) {
+  CHECK_EQ(token_ids.size(), parents.size());
+  CHECK(draft_tree_parents_.empty()) << "draft tree is not validated";
+  draft_tree_start_ = num_tokens_;
+  for (size_t i = 0; i < token_ids.size(); ++i) {
+    // parents come before children in depth-first order
+    CHECK(parents[i] >= -1 && parents[i] < static_cast<int32_t>(i))
+        << "invalid parent " << parents[i] << " for node " << i;
+    append_draft_token(token_ids[i]);
+  }
+  draft_tree_parents_ = parents;
+}
+
+size_t Sequence::validate_tree_tokens(const std::vector<int32_t>& path,
+                                      const std::vector<Token>& tokens) {
+  const size_t num_nodes = draft_tree_parents_.size();
+  CHECK_GT(num_nodes, 0) << "no draft tree to validate";
+  CHECK_EQ(tokens.size(), path.size() + 1) << "one more token than the path";
+  const size_t start_idx = draft_tree_start();
+
+  // depth of the tree, nodes are in depth-first order
+  std::vector<size_t> depths(num_nodes);
+  size_t max_depth = 0;
+  for (size_t i = 0; i < num_nodes; ++i) {
+    const int32_t parent = draft_tree_parents_[i];
+    depths[i] = parent < 0 ? 1 : depths[parent] + 1;
+    max_depth = std::max(max_depth, depths[i]);
+  }
+
+  // the kv cache of path nodes is in place while the path follows the
+  // depth-first order, i.e. the first branch of the tree.
+  size_t num_in_place = 0;
+  while (num_in_place < path.size() &&
+         path[num_in_place] == static_cast<int32_t>(num_in_place)) {
+    ++num_in_place;
+  }
+
+  // replace the tree with the accepted path followed by the last token
+  std::vector<int32_t> path_token_ids;
+  path_token_ids.reserve(path.size() + 1);
+  for (const int32_t node : path) {
+    CHECK(node >= 0 && node < static_cast<int32_t>(num_nodes));
+    path_token_ids.push_back(token_ids_[start_idx + node]);
+  }
+  path_token_ids.push_back(static_cast<int32_t>(tokens.back().id));
+  // drop all tokens after the tree start, including the bonus token if any
+  stop_string_matcher_.truncate(start_idx);
+  for (size_t i = start_idx; i < num_tokens_; ++i) {
+    --token_to_count_map_[token_ids_[i]];
+  }
+  num_tokens_ = start_idx;
+  for (const int32_t token_id : path_token_ids) {
+    token_ids_[num_tokens_++] = token_id;
+    ++token_to_count_map_[token_id];
+  }
+  draft_tree_parents_.clear();
+
+  // discard the kv cache of other nodes without copying, the accepted tokens
+  // out of place would be processed again in the next step.
+  for (auto& num_kv_cache_tokens : num_kv_cache_tokens_) {
+    num_kv_cache_tokens =
+        std::min(num_kv_cache_tokens, start_idx + num_in_place);
+  }
+
+  size_t num_accepted_drafts = 0;
+  const size_t num_accepted = accept_draft_tokens(tokens, &num_accepted_drafts);
+  CHECK_EQ(num_accepted_drafts, std::min(path.size(), num_accepted))
+      << "accepted tokens mismatch with the path";
+  // the evaluated depth of the tree, excluding the bonus token
+  update_draft_acceptance_rate(num_accepted_drafts,
+                               std::min(path.size() + 1, max_depth));
+  return num_accepted;
+}
+
+void Sequence::update_draft_acceptance_rate(size_t num_accepted,
+                                            size_t num_drafts) {
+  if (num_drafts == 0) {
+    return;
+  }
+  const double rate = static_cast<double>(num_accepted) / num_drafts;
+  draft_acceptance_rate_ =
+      kAcceptanceRateSmoothing * rate +
+      (1.0 - kAcceptanceRateSmoothing) * draft_acceptance_rate_;
+}
+
 size_t Sequence::validate_tokens(const std::vector<int64_t>& token_ids) {
   std::vector<Token> tokens;
   tokens.reserve(token_ids.size());
@@ -180,8 +312,12 @@ std::optional<SequenceOutput> Sequence::build_delta_output_until(
 
   // record the start index of token ids
   const size_t start = incremental_decoder_.output_offset();
-  auto delta = incremental_decoder_.decode(ids, tokenizer);
-  if (delta.empty() && finish_reason_ == FinishReason::NONE) {
+  auto delta =
+      incremental_decoder_.decode(ids, tokenizer, num_output_bytes(size));
+  // outputs lagging behind the sequence don't carry the finish reason
+  const bool finished =
+      finish_reason_ != FinishReason::NONE && size == num_tokens_;
+  if (delta.empty() && !finished) {
     // no delta text and not finished
     return std::nullopt;
   }
@@ -189,7 +325,7 @@ std::optional<SequenceOutput> Sequence::build_delta_output_until(
   SequenceOutput output;
   output.index = index_;
   output.text = std::move(delta);
-  if (finish_reason_ != FinishReason::NONE) {
+  if (finished) {
     output.finish_reason = to_string(finish_reason_);
   }
 
@@ -226,7 +362,8 @@ SequenceOutput Sequence::build_output(const Tokenizer& tokenizer) {
   // incrementally decode tokens between [incremental_start, size)
   std::stringstream ss;
   for (size_t end = incremental_start; end <= size; ++end) {
-    ss << incremental_decoder_.decode(ids.slice(0, end), tokenizer);
+    ss << incremental_decoder_.decode(
+        ids.slice(0, end), tokenizer, num_output_bytes(end));
   }
 
   SequenceOutput output;
@@ -325,8 +462,7 @@ bool Sequence::is_finished() const {
   // reset the finish status invalidation flag
   finish_status_invalidated_ = false;
 
-  auto finish_reason = options_.stopping_criteria.check_finished(
-      token_ids(), num_prompt_tokens_);
+  auto finish_reason = check_finished(num_tokens_);
   if (finish_reason != FinishReason::NONE) {
     finish_reason_ = finish_reason;
     is_finished_ = true;
@@ -335,6 +471,25 @@ bool Sequence::is_finished() const {
   return false;
 }
 
+FinishReason Sequence::check_finished(size_t num_tokens) const {
+  const Slice<int32_t> token_ids(token_ids_, num_tokens);
+  if (stop_string_matcher_.match(token_ids)) {
+    return FinishReason::STOP;
+  }
+  return options_.stopping_criteria.check_finished(token_ids,
+                                                   num_prompt_tokens_);
+}
+
+size_t Sequence::num_output_bytes(size_t num_tokens) const {
+  if (!stop_string_matcher_.enabled()) {
+    return IncrementalDecoder::kNoLimit;
+  }
+  // release all bytes of the last token once finished
+  const bool finished =
+      finish_reason_ != FinishReason::NONE && num_tokens == num_tokens_;
+  return stop_string_matcher_.num_output_bytes(num_tokens, finished);
+}
+
 double Sequence::inter_token_latency(const absl::Time& now) {
   const double latency = absl::ToDoubleSeconds(now - last_token_time_);
   last_token_time_ = now;
@@ -364,14 +519,32 @@ std::vector<LogProb> Sequence::build_logprobs(size_t start_idx,
     start_idx = num_prompt_tokens_;
   }
 
+  // decode all tokens and top tokens in one batch
+  std::vector<int32_t> ids;
+  for (size_t i = start_idx; i < end_idx; ++i) {
+    if (logprobs_[i].has_value()) {
+      ids.push_back(token_ids_[i]);
+      ids.insert(ids.end(), top_tokens_[i].begin(), top_tokens_[i].end());
+    }
+  }
+  std::vector<Slice<int32_t>> slices;
+  slices.reserve(ids.size());
+  for (const int32_t& id : ids) {
+    slices.emplace_back(&id, 1);
+  }
+  const auto texts = tokenizer.decode_batch(
+      slices, options_.skip_special_tokens, /*threadpool=*/nullptr);
+
   std::vector<LogProb> logprob_contents;
+  size_t next_text = 0;
   for (size_t i = start_idx; i < end_idx; ++i) {
     if (logprobs_[i].has_value()) {
       const int32_t token_id = token_ids_[i];
-      auto token = tokenizer.decode(std::vector<int32_t>{token_id},
-                                    options_.skip_special_tokens);
+      auto token = texts[next_text++];
+      const auto& top_tokens = top_tokens_[i];
       // skip empty token
       if (token.empty()) {
+        next_text += top_tokens.size();
         continue;
       }
 
@@ -387,8 +560,7 @@ std::vector<LogProb> Sequence::build_logprobs(size_t start_idx,
       logprob_content.logprob = logprobs_[i].value();
 
       // add top logprobs if available
-      if (!top_tokens_[i].empty()) {
-        const auto& top_tokens = top_tokens_[i];
+      if (!top_tokens.empty()) {
         const auto& top_logprobs = top_logprobs_[i];
         DCHECK_EQ(top_tokens.size(), top_logprobs.size());
         std::vector<LogProbData> logprobs;
@@ -397,8 +569,7 @@ std::vector<LogProb> Sequence::build_logprobs(size_t start_idx,
           const int32_t top_token_id = top_tokens[j];
           const float top_logprob = top_logprobs[j];
 
-          auto top_token = tokenizer.decode(std::vector<int32_t>{top_token_id},
-                                            options_.skip_special_tokens);
+          auto top_token = texts[next_text++];
           if (absl::EndsWith(top_token, "�")) {
             top_token = tokenizer.id_to_token(top_token_id);
             logprob.finished_token = false;
@@ -8,8 +8,10 @@
 #include "common/slice.h"
 #include "incremental_decoder.h"
 #include "memory/block.h"
+#include "ngram_index.h"
 #include "output.h"
 #include "sampling/parameters.h"
+#include "stop_string_matcher.h"
 #include "stopping_criteria.h"
 #include "tokenizer/tokenizer.h"
 
@@ -145,15 +147,48 @@ class Sequence final {
   void append_token(const Token& token);
   void append_token(int64_t token_id) { append_token(Token(token_id)); }
 
+  // add a draft token proposed without a draft model, e.g. prompt lookup.
+  // unlike append_token, it is allowed for sequences in prefill stage whose
+  // prompt would be finished together with draft tokens in one step.
+  void append_draft_token(int32_t token_id);
+
   // validate draft tokens with accepted tokens for speculative decoding
   // N.B. take int64_t as input to be compatible with torch::Tensor
   // returns the number of accepted tokens, including the resampled token
   size_t validate_tokens(const std::vector<Token>& tokens);
   size_t validate_tokens(const std::vector<int64_t>& token_ids);
 
+  // add a tree of draft tokens in depth-first order for tree verification.
+  // parents are the node indices of parents, -1 for the children of the last
+  // token before the tree.
+  void append_draft_tree(const std::vector<int32_t>& token_ids,
+                         const std::vector<int32_t>& parents);
+
+  // get the parents of draft tree nodes, empty if there is no draft tree
+  const std::vector<int32_t>& draft_tree_parents() const {
+    return draft_tree_parents_;
+  }
+
+  // get the index of the first draft tree token
+  size_t draft_tree_start() const { return draft_tree_start_; }
+
+  // validate the draft tree with the accepted path of node indices and the
+  // accepted tokens, which has one more token (resampled or bonus) than path.
+  // returns the number of accepted tokens, including the last token
+  size_t validate_tree_tokens(const std::vector<int32_t>& path,
+                              const std::vector<Token>& tokens);
+
   // whether the new added token is the first token
   bool is_first_token() const { return is_first_token_; }
 
+  // get the moving average of the draft token acceptance rate in speculative
+  // decoding, starts optimistically from 1.0
+  double draft_acceptance_rate() const { return draft_acceptance_rate_; }
+
+  // get the n-gram index of token ids for prompt lookup decoding, the index
+  // is built lazily and kept in sync with token ids.
+  const NGramIndex& ngram_index(size_t max_ngram);
+
   // add new cache blocks
   void append_block(const Block& new_block) {
     return append_blocks({new_block});
@@ -234,6 +269,21 @@ class Sequence final {
 
   void update_logprobs(size_t index, const Token& token);
 
+  // check stopping criterias for the first num_tokens tokens
+  FinishReason check_finished(size_t num_tokens) const;
+
+  // the number of generated bytes that can be output for the first
+  // num_tokens tokens
+  size_t num_output_bytes(size_t num_tokens) const;
+
+  // validate the last tokens.size() tokens with accepted tokens, stopping at
+  // the first mismatch. returns the number of accepted tokens.
+  size_t accept_draft_tokens(const std::vector<Token>& tokens,
+                             size_t* num_accepted_drafts);
+
+  // update the moving average of the draft acceptance rate
+  void update_draft_acceptance_rate(size_t num_accepted, size_t num_drafts);
+
   // the index of the sequence in the request
   size_t index_ = 0;
 
@@ -265,6 +315,21 @@ class Sequence final {
   // the count of each token id
   std::unordered_map<int32_t, int32_t> token_to_count_map_;
 
+  // n-gram index of token ids, only used for prompt lookup decoding
+  NGramIndex ngram_index_;
+
+  // matcher of stop strings, kept in sync with token ids lazily
+  mutable StopStringMatcher stop_string_matcher_;
+
+  // moving average of the draft token acceptance rate
+  double draft_acceptance_rate_ = 1.0;
+
+  // parents of the draft tree nodes at the end of token ids
+  std::vector<int32_t> draft_tree_parents_;
+
+  // the index of the first draft tree token
+  size_t draft_tree_start_ = 0;
+
   // the length of the prompt tokens
   size_t num_prompt_tokens_ = 0;
 
@@ -3,7 +3,10 @@
 #include <absl/time/clock.h>
 #include <gtest/gtest.h>
 
+#include "common/aho_corasick.h"
 #include "memory/block.h"
+#include "tokenizer/token_bytes_table.h"
+#include "tokenizer/tokenizer.h"
 
 namespace llm {
 namespace {
@@ -327,6 +330,43 @@ TEST(SequenceTest, SpeculativePartiallyMatch) {
             validated_tokens.size() - 1);
 }
 
+TEST(SequenceTest, SpeculativeAcceptanceRate) {
+  std::vector<int32_t> prompt_tokens = {1, 2, 4};
+  Sequence::Options options;
+  options.stopping_criteria.max_tokens = 100;
+  Sequence sequence(prompt_tokens,
+                    /*capacity=*/200,
+                    options);
+
+  // allocate block
+  sequence.append_block({/*id=*/0, /*size=*/200});
+  EXPECT_DOUBLE_EQ(sequence.draft_acceptance_rate(), 1.0);
+
+  // 2 of 3 evaluated draft tokens are accepted
+  run_speculative_decoding(sequence,
+                           /*draft_token_ids=*/{1058, 338, 4473, 29973},
+                           /*bonus_token_id=*/4343,
+                           /*resample_token_id=*/1314,
+                           /*num_accepted_tokens=*/2);
+  EXPECT_NEAR(sequence.draft_acceptance_rate(), 0.3 * 2 / 3 + 0.7, 1e-6);
+
+  // no draft token is accepted
+  run_speculative_decoding(sequence,
+                           /*draft_token_ids=*/{1058, 338, 4473, 29973},
+                           /*bonus_token_id=*/4343,
+                           /*resample_token_id=*/1314,
+                           /*num_accepted_tokens=*/0);
+  EXPECT_NEAR(sequence.draft_acceptance_rate(), 0.7 * 0.9, 1e-6);
+
+  // all draft tokens are accepted
+  run_speculative_decoding(sequence,
+                           /*draft_token_ids=*/{1058, 338, 4473, 29973},
+                           /*bonus_token_id=*/4343,
+                           /*resample_token_id=*/1314,
+                           /*num_accepted_tokens=*/4);
+  EXPECT_NEAR(sequence.draft_acceptance_rate(), 0.3 + 0.7 * 0.63, 1e-6);
+}
+
 TEST(SequenceTest, SpeculativeStopMaxTokens) {
   // test scenarios speculative decoding
   std::vector<int32_t> prompt_tokens = {1, 2, 4};
@@ -393,4 +433,134 @@ TEST(SequenceTest, SpeculativeStopEosTokenId) {
             desired_tokens.size() - 1);
 }
 
+TEST(SequenceTest, SpeculativeStopStrings) {
+  TokenBytesTable table;
+  table.add(10, "Hello");
+  table.add(11, " Obs");
+  table.add(12, "erv");
+  table.add(13, "ation:");
+  table.add(14, " done");
+
+  std::vector<int32_t> prompt_tokens = {1, 2, 4};
+  Sequence::Options options;
+  options.stopping_criteria.max_tokens = 100;
+  options.stopping_criteria.ignore_eos = true;
+  options.stopping_criteria.stop_strings = std::make_shared<const AhoCorasick>(
+      std::vector<std::string>{"Observation:"});
+  options.stopping_criteria.token_bytes_table = &table;
+
+  Sequence sequence(prompt_tokens,
+                    /*capacity=*/20,
+                    options);
+  sequence.append_block({/*id=*/0, /*size=*/20});
+  sequence.commit_kv_cache(/*size=*/3);
+
+  sequence.append_token(10);
+  sequence.append_token(11);
+  EXPECT_FALSE(sequence.is_finished());
+
+  // draft tokens: "erv done", bonus token without bytes
+  sequence.append_draft_token(12);
+  sequence.append_draft_token(14);
+  sequence.append_draft_token(99);
+  EXPECT_FALSE(sequence.is_finished());
+
+  // " done" is rejected and resampled as "ation:"
+  EXPECT_EQ(sequence.validate_tokens(std::vector<int64_t>{12, 13, -1}), 2);
+  EXPECT_TRUE(sequence.is_finished());
+  EXPECT_EQ(sequence.finish_reason(), FinishReason::STOP);
+  const std::vector<int32_t> desired_tokens = {1, 2, 4, 10, 11, 12, 13};
+  EXPECT_EQ(sequence.token_ids(), desired_tokens);
+}
+
+namespace {
+// a tokenizer that decodes each token id into a lowercase letter, counting
+// the batch decode calls
+class CountingTokenizer : public Tokenizer {
+ public:
+  bool encode(const std::string_view& /*text*/,
+              std::vector<int32_t>* /*ids*/) const override {
+    return false;
+  }
+
+  std::string decode(const Slice<int32_t>& ids,
+                     bool /*skip_special_tokens*/) const override {
+    std::string text;
+    for (const auto id : ids) {
+      text.push_back(static_cast<char>('a' + id % 26));
+    }
+    return text;
+  }
+
+  std::vector<std::string> decode_batch(const std::vector<Slice<int32_t>>& ids,
+                                        bool skip_special_tokens,
+                                        ThreadPool* threadpool) const override {
+    ++num_decode_batch_calls;
+    return Tokenizer::decode_batch(ids, skip_special_tokens, threadpool);
+  }
+
+  std::optional<int32_t> token_to_id(
+      const std::string_view& /*token*/) const override {
+    return std::nullopt;
+  }
+
+  std::string id_to_token(int32_t id) const override {
+    return std::string(1, static_cast<char>('a' + id % 26));
+  }
+
+  size_t vocab_size() const override { return 26; }
+
+  std::unique_ptr<Tokenizer> clone() const override {
+    return std::make_unique<CountingTokenizer>();
+  }
+
+  mutable size_t num_decode_batch_calls = 0;
+};
+}  // namespace
+
+TEST(SequenceTest, BuildLogprobs) {
+  Sequence::Options options;
+  options.stopping_criteria.max_tokens = 3;
+  options.stopping_criteria.ignore_eos = true;
+  options.logprobs = true;
+  options.sampling_param.logprobs = true;
+  options.sampling_param.top_logprobs = 2;
+
+  Sequence sequence(std::vector<int32_t>{1, 2, 3},
+                    /*capacity=*/20,
+                    options);
+  sequence.append_block({/*id=*/0, /*size=*/20});
+  const std::vector<std::vector<int64_t>> top_tokens = {
+      {3, 4}, {5, 6}, {7, 8}};
+  const std::vector<float> top_logprobs = {-0.1f, -0.2f};
+  for (size_t i = 0; i < top_tokens.size(); ++i) {
+    sequence.commit_kv_cache(sequence.num_tokens_to_process());
+    Token token(top_tokens[i][0]);
+    token.logprob = -0.1 * (i + 1);
+    token.top_tokens = top_tokens[i];
+    token.top_logprobs = top_logprobs;
+    sequence.append_token(token);
+  }
+  EXPECT_TRUE(sequence.is_finished());
+
+  CountingTokenizer tokenizer;
+  const auto output = sequence.build_output(tokenizer);
+  EXPECT_EQ(output.text, "dfh");
+  ASSERT_TRUE(output.logprobs.has_value());
+  const auto& logprobs = output.logprobs.value();
+  ASSERT_EQ(logprobs.size(), 3);
+  for (size_t i = 0; i < logprobs.size(); ++i) {
+    EXPECT_EQ(logprobs[i].token_id, top_tokens[i][0]);
+    EXPECT_EQ(logprobs[i].token, tokenizer.id_to_token(top_tokens[i][0]));
+    ASSERT_TRUE(logprobs[i].top_logprobs.has_value());
+    ASSERT_EQ(logprobs[i].top_logprobs->size(), 2);
+    for (size_t j = 0; j < 2; ++j) {
+      EXPECT_EQ(logprobs[i].top_logprobs->at(j).token,
+                tokenizer.id_to_token(top_tokens[i][j]));
+    }
+  }
+  // tokens and top tokens are decoded in one batch
+  EXPECT_EQ(tokenizer.num_decode_batch_calls, 1);
+}
+
 }  // namespace llm
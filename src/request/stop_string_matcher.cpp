@@ -0,0 +1,92 @@
+#include "stop_string_matcher.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+namespace llm {
+
+StopStringMatcher::StopStringMatcher(
+    std::shared_ptr<const AhoCorasick> stop_strings,
+    const TokenBytesTable* token_bytes_table,
+    size_t num_prompt_tokens,
+    size_t capacity,
+    bool skip_special_tokens)
+    : token_bytes_table_(token_bytes_table),
+      num_prompt_tokens_(num_prompt_tokens),
+      skip_special_tokens_(skip_special_tokens) {
+  // stop strings can only be matched with the token bytes
+  if (stop_strings == nullptr || stop_strings->num_patterns() == 0 ||
+      token_bytes_table == nullptr) {
+    return;
+  }
+  CHECK_GE(capacity, num_prompt_tokens);
+  stop_strings_ = std::move(stop_strings);
+  states_.resize(capacity - num_prompt_tokens);
+}
+
+bool StopStringMatcher::match(const Slice<int32_t>& token_ids) {
+  if (!enabled()) {
+    return false;
+  }
+
+  State cur;
+  if (num_matched_ > 0) {
+    cur = states_[num_matched_ - 1];
+    if (cur.matched) {
+      return true;
+    }
+  }
+
+  for (size_t i = num_prompt_tokens_ + num_matched_; i < token_ids.size();
+       ++i) {
+    CHECK_LT(num_matched_, states_.size()) << "exceed the token capacity";
+    const std::string_view bytes = token_bytes_table_->segment_bytes(
+        token_ids[i], skip_special_tokens_, &cur.strip_leading_space);
+    for (size_t j = 0; j < bytes.size(); ++j) {
+      cur.state = stop_strings_->next_state(cur.state, bytes[j]);
+      const size_t length = stop_strings_->longest_match_length(cur.state);
+      if (length > 0) {
+        // stop at the first match, the stop string is excluded from output
+        cur.matched = true;
+        cur.num_output_bytes = cur.num_bytes + j + 1 - length;
+        break;
+      }
+    }
+    cur.num_bytes += bytes.size();
+    if (!cur.matched) {
+      // hold back the bytes that may be the start of a stop string
+      cur.num_output_bytes =
+          cur.num_bytes - stop_strings_->depth(cur.state);
+    }
+    states_[num_matched_++] = cur;
+    if (cur.matched) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void StopStringMatcher::truncate(size_t index) {
+  const size_t num_generated =
+      index > num_prompt_tokens_ ? index - num_prompt_tokens_ : 0;
+  num_matched_ = std::min(num_matched_, num_generated);
+}
+
+size_t StopStringMatcher::num_output_bytes(size_t num_tokens,
+                                           bool finished) const {
+  if (num_tokens <= num_prompt_tokens_) {
+    return 0;
+  }
+  const auto& state = states_[num_tokens - num_prompt_tokens_ - 1];
+  if (finished && !state.matched) {
+    return state.num_bytes;
+  }
+  return state.num_output_bytes;
+}
+
+}  // namespace llm
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "common/aho_corasick.h"
+#include "common/slice.h"
+#include "tokenizer/token_bytes_table.h"
+
+namespace llm {
+
+// A stateful matcher to find stop strings in the decoded text of generated
+// tokens. The bytes of each new token are fed into an aho-corasick automaton,
+// and the matching state after each token is kept so that draft tokens can be
+// rolled back for speculative decoding.
+class StopStringMatcher final {
+ public:
+  StopStringMatcher() = default;
+
+  // capacity is the maximum number of generated tokens.
+  StopStringMatcher(std::shared_ptr<const AhoCorasick> stop_strings,
+                    const TokenBytesTable* token_bytes_table,
+                    size_t num_prompt_tokens,
+                    size_t capacity,
+                    bool skip_special_tokens);
+
+  // whether there are stop strings to match
+  bool enabled() const { return stop_strings_ != nullptr; }
+
+  // match new generated tokens in token_ids, returns true once a stop string
+  // is found. tokens after the match are not matched.
+  bool match(const Slice<int32_t>& token_ids);
+
+  // drop the matching states of tokens at and after the index
+  void truncate(size_t index);
+
+  // the number of generated text bytes that can be sent to clients after the
+  // first num_tokens tokens, excluding the stop string and any partial match
+  // that may turn into a stop string. all bytes are released once finished
+  // without a stop string.
+  size_t num_output_bytes(size_t num_tokens, bool finished) const;
+
+ private:
+  struct State {
+    // automaton state after the token
+    int32_t state = AhoCorasick::kRootState;
+    // whether to strip the leading space of the next token
+    bool strip_leading_space = false;
+    // whether a stop string ends within the token
+    bool matched = false;
+    // total number of generated bytes until the token
+    size_t num_bytes = 0;
+    // number of bytes safe to output until the token
+    size_t num_output_bytes = 0;
+  };
+
+  std::shared_ptr<const AhoCorasick> stop_strings_;
+
+  const TokenBytesTable* token_bytes_table_ = nullptr;
+
+  size_t num_prompt_tokens_ = 0;
+
+  bool skip_special_tokens_ = true;
+
+  // matching states for generated tokens, preallocated to the capacity so
+  // that states of sent tokens can be read without synchronization.
+  std::vector<State> states_;
+
+  // number of generated tokens that have been matched
+  size_t num_matched_ = 0;
+};
+
+}  // namespace llm
@@ -0,0 +1,122 @@
+#include "stop_string_matcher.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+namespace llm {
+namespace {
+
+TokenBytesTable make_table() {
+  TokenBytesTable table;
+  table.add(0, "Hello");
+  table.add(1, " Obs");
+  table.add(2, "erv");
+  table.add(3, "ation");
+  table.add(4, ":");
+  table.add(5, " done");
+  table.add(6, "<|end|>", /*special=*/true);
+  return table;
+}
+
+}  // namespace
+
+TEST(StopStringMatcherTest, Disabled) {
+  const auto table = make_table();
+  StopStringMatcher matcher(nullptr,
+                            &table,
+                            /*num_prompt_tokens=*/1,
+                            /*capacity=*/10,
+                            /*skip_special_tokens=*/true);
+  EXPECT_FALSE(matcher.enabled());
+  EXPECT_FALSE(matcher.match(std::vector<int32_t>{0, 1, 2}));
+
+  // no token bytes table
+  auto stop_strings =
+      std::make_shared<const AhoCorasick>(std::vector<std::string>{"stop"});
+  StopStringMatcher no_table(stop_strings, nullptr, 1, 10, true);
+  EXPECT_FALSE(no_table.enabled());
+}
+
+TEST(StopStringMatcherTest, AcrossTokens) {
+  const auto table = make_table();
+  auto stop_strings = std::make_shared<const AhoCorasick>(
+      std::vector<std::string>{"Observation:", "xyz"});
+  StopStringMatcher matcher(stop_strings, &table, 1, 10, true);
+  ASSERT_TRUE(matcher.enabled());
+
+  // prompt tokens are not matched
+  std::vector<int32_t> token_ids = {1};
+  EXPECT_FALSE(matcher.match(token_ids));
+  EXPECT_EQ(matcher.num_output_bytes(1, false), 0);
+
+  // "Hello"
+  token_ids.push_back(0);
+  EXPECT_FALSE(matcher.match(token_ids));
+  EXPECT_EQ(matcher.num_output_bytes(2, false), 5);
+
+  // "Hello Obs": "Obs" is held back
+  token_ids.push_back(1);
+  EXPECT_FALSE(matcher.match(token_ids));
+  EXPECT_EQ(matcher.num_output_bytes(3, false), 6);
+  // all bytes are released once finished without a match
+  EXPECT_EQ(matcher.num_output_bytes(3, true), 9);
+
+  // "Hello Observation:"
+  token_ids.push_back(2);
+  token_ids.push_back(3);
+  EXPECT_FALSE(matcher.match(token_ids));
+  EXPECT_EQ(matcher.num_output_bytes(5, false), 6);
+  token_ids.push_back(4);
+  EXPECT_TRUE(matcher.match(token_ids));
+  // the stop string is excluded
+  EXPECT_EQ(matcher.num_output_bytes(6, false), 6);
+  EXPECT_EQ(matcher.num_output_bytes(6, true), 6);
+
+  // stay matched
+  token_ids.push_back(5);
+  EXPECT_TRUE(matcher.match(token_ids));
+}
+
+TEST(StopStringMatcherTest, Truncate) {
+  const auto table = make_table();
+  auto stop_strings = std::make_shared<const AhoCorasick>(
+      std::vector<std::string>{"Obs done"});
+  StopStringMatcher matcher(stop_strings, &table, 1, 10, true);
+
+  // draft tokens " Obs", "erv" are rejected and replaced with " done"
+  std::vector<int32_t> token_ids = {0, 0, 1, 2};
+  EXPECT_FALSE(matcher.match(token_ids));
+  EXPECT_EQ(matcher.num_output_bytes(4, false), 12);
+
+  matcher.truncate(3);
+  token_ids.resize(3);
+  token_ids.push_back(5);
+  EXPECT_TRUE(matcher.match(token_ids));
+  EXPECT_EQ(matcher.num_output_bytes(4, false), 6);
+
+  // roll back the match
+  matcher.truncate(2);
+  token_ids.resize(2);
+  token_ids.push_back(5);
+  EXPECT_FALSE(matcher.match(token_ids));
+  EXPECT_EQ(matcher.num_output_bytes(3, false), 10);
+}
+
+TEST(StopStringMatcherTest, SpecialTokens) {
+  const auto table = make_table();
+  auto stop_strings = std::make_shared<const AhoCorasick>(
+      std::vector<std::string>{"Hello<|end|>"});
+
+  // special tokens are skipped like the detokenizer
+  StopStringMatcher skip_matcher(stop_strings, &table, 1, 10, true);
+  EXPECT_FALSE(skip_matcher.match(std::vector<int32_t>{0, 0, 6}));
+  EXPECT_EQ(skip_matcher.num_output_bytes(3, false), 0);
+  EXPECT_EQ(skip_matcher.num_output_bytes(3, true), 5);
+
+  StopStringMatcher matcher(stop_strings, &table, 1, 10, false);
+  EXPECT_TRUE(matcher.match(std::vector<int32_t>{0, 0, 6}));
+  EXPECT_EQ(matcher.num_output_bytes(3, false), 0);
+}
+
+}  // namespace llm
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <unordered_set>
 #include <vector>
 
+#include "common/aho_corasick.h"
 #include "common/slice.h"
 #include "output.h"
+#include "tokenizer/token_bytes_table.h"
 
 namespace llm {
 
@@ -33,6 +36,13 @@ struct StoppingCriteria {
   // stop sequences
   std::vector<std::vector<int32_t>> stop_sequences;
 
+  // stop strings matched against the decoded text of generated tokens, see
+  // StopStringMatcher. the matched stop string is excluded from output.
+  std::shared_ptr<const AhoCorasick> stop_strings;
+
+  // token bytes table from tokenizer to match stop strings
+  const TokenBytesTable* token_bytes_table = nullptr;
+
   // max context length
   size_t max_context_len = 0;
 };
@@ -22,11 +22,25 @@ std::unique_ptr<LogitsProcessor> LogitsProcessor::create(
         params.repetition_penalties));
   }
 
+  if (params.logit_bias_token_ids.defined()) {
+    processors.push_back(std::make_unique<LogitBiasLogitsProcessor>(
+        params.logit_bias_token_ids, params.logit_bias));
+  }
+
+  if (params.bad_token_ids.defined()) {
+    processors.push_back(std::make_unique<BadWordsLogitsProcessor>(
+        params.bad_token_ids, params.bad_token_lens));
+  }
+
   if (params.temperatures.defined()) {
     processors.push_back(
         std::make_unique<TemperatureLogitsProcessor>(params.temperatures));
   }
 
+  if (params.min_p.defined()) {
+    processors.push_back(std::make_unique<MinPLogitsProcessor>(params.min_p));
+  }
+
   if (params.top_k.defined() || params.top_p.defined()) {
     processors.push_back(
         std::make_unique<TopKTopPLogitsProcessor>(params.top_k, params.top_p));
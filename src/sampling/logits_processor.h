@@ -1,6 +1,7 @@
 #pragma once
 #include <torch/torch.h>
 
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -57,7 +58,11 @@ inline void apply_frequency_presence_penalty(
 // supported logits processors:
 // 1. frequency and presence penalty
 // 2. repetition penalty
-// 3. temperature
+// 3. logit bias
+// 4. bad words
+// 5. temperature
+// 6. min_p
+// 7. top_k and top_p
 
 // inspired by transformers LogistProcessor:
 // https://github.com/huggingface/transformers/blob/main/src/transformers/generation/logits_process.py#L44
@@ -187,6 +192,77 @@ class RepetitionPenaltyLogitsProcessor : public LogitsProcessor {
   torch::Tensor penalties_;
 };
 
+// add per-sequence biases to the logits of the given tokens.
+// token_ids and biases are padded with zero biases so that all biases can be
+// added with a single scatter.
+class LogitBiasLogitsProcessor : public LogitsProcessor {
+ public:
+  LogitBiasLogitsProcessor(const torch::Tensor& token_ids,
+                           const torch::Tensor& biases)
+      : token_ids_(token_ids), biases_(biases) {
+    CHECK(token_ids.defined() && biases.defined());
+    CHECK(token_ids.sizes() == biases.sizes());
+  }
+
+  torch::Tensor forward(
+      const torch::Tensor& logits,
+      const torch::Tensor& /*unique_token_ids*/,
+      const torch::Tensor& /*unique_token_counts*/,
+      const torch::Tensor& /*unique_token_lens*/) const override {
+    CHECK_EQ(logits.size(0), token_ids_.size(0));
+    torch::Tensor logits_ = logits;
+    logits_.scatter_add_(
+        /*dim=*/1, /*index=*/token_ids_, /*src=*/biases_.to(logits_.dtype()));
+    return logits_;
+  }
+
+ private:
+  // [num_seqs, max_num_biases] LongTensor
+  torch::Tensor token_ids_;
+  // [num_seqs, max_num_biases] FloatTensor
+  torch::Tensor biases_;
+};
+
+// ban tokens that would complete a bad word. the banned tokens are matched
+// against the tail of each sequence when preparing the batch, here they are
+// turned into one ban mask for the whole batch.
+class BadWordsLogitsProcessor : public LogitsProcessor {
+ public:
+  BadWordsLogitsProcessor(const torch::Tensor& bad_token_ids,
+                          const torch::Tensor& bad_token_lens) {
+    CHECK(bad_token_ids.defined() && bad_token_lens.defined());
+    bad_token_ids_ = bad_token_ids;
+    // mask out the padding token ids
+    const auto max_bad_tokens = bad_token_ids.size(1);
+    const auto idx = torch::arange(max_bad_tokens, bad_token_lens.device());
+    valid_mask_ = (idx.unsqueeze(0) < bad_token_lens.unsqueeze(1));
+  }
+
+  torch::Tensor forward(
+      const torch::Tensor& logits,
+      const torch::Tensor& /*unique_token_ids*/,
+      const torch::Tensor& /*unique_token_counts*/,
+      const torch::Tensor& /*unique_token_lens*/) const override {
+    CHECK_EQ(logits.size(0), bad_token_ids_.size(0));
+    // accumulate instead of overwrite so that padding can't unban a token
+    auto ban_mask = torch::zeros(logits.sizes(),
+                                 logits.options().dtype(torch::kInt))
+                        .scatter_add_(/*dim=*/1,
+                                      /*index=*/bad_token_ids_,
+                                      /*src=*/valid_mask_.to(torch::kInt));
+    torch::Tensor logits_ = logits;
+    const float filter_value = -std::numeric_limits<float>::infinity();
+    logits_.masked_fill_(ban_mask > 0, filter_value);
+    return logits_;
+  }
+
+ private:
+  // [num_seqs, max_bad_tokens] LongTensor
+  torch::Tensor bad_token_ids_;
+  // [num_seqs, max_bad_tokens] BoolTensor
+  torch::Tensor valid_mask_;
+};
+
 class TemperatureLogitsProcessor : public LogitsProcessor {
  public:
   // Constructor
@@ -220,6 +296,36 @@ class TemperatureLogitsProcessor : public LogitsProcessor {
   torch::Tensor temperatures_;
 };
 
+// min_p keeps tokens with prob >= min_p * max_prob. since softmax is
+// monotonic, the threshold is applied on logits directly:
+// logit >= max_logit + log(min_p), without computing the softmax.
+class MinPLogitsProcessor : public LogitsProcessor {
+ public:
+  MinPLogitsProcessor(const torch::Tensor& min_p) {
+    CHECK(min_p.defined());
+    // [n_tokens, 1], log(0) = -inf disables min_p for the row
+    log_min_p_ = min_p.unsqueeze(1).log();
+  }
+
+  torch::Tensor forward(
+      const torch::Tensor& logits,
+      const torch::Tensor& /*unique_token_ids*/,
+      const torch::Tensor& /*unique_token_counts*/,
+      const torch::Tensor& /*unique_token_lens*/) const override {
+    CHECK_EQ(logits.size(0), log_min_p_.size(0));
+    const auto max_logits = logits.amax(/*dim=*/-1, /*keepdim=*/true);
+    const auto mask = logits < (max_logits + log_min_p_);
+    torch::Tensor logits_ = logits;
+    const float filter_value = -std::numeric_limits<float>::infinity();
+    logits_.masked_fill_(mask, filter_value);
+    return logits_;
+  }
+
+ private:
+  // [n_tokens, 1]
+  torch::Tensor log_min_p_;
+};
+
 // combine top_k and top_p sampling, apply top_k first then top_p
 class TopKTopPLogitsProcessor : public LogitsProcessor {
  public:
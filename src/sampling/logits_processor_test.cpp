@@ -355,4 +355,88 @@ TEST(LogitsProcessorTest, TopP) {
   }
 }
 
+TEST(LogitsProcessorTest, LogitBias) {
+  torch::ScalarType dtype(torch::kFloat32);
+  torch::Device device(torch::kCPU);
+  const auto options = torch::dtype(dtype).device(device);
+
+  int64_t batch_size = 2;
+  int64_t vocab_size = 100;
+  // the second row is padded with zero biases
+  const auto token_ids =
+      torch::tensor({{3, 7}, {5, 0}}, options.dtype(torch::kInt64));
+  const auto biases = torch::tensor({{1.5, -100.0}, {2.0, 0.0}}, options);
+  LogitBiasLogitsProcessor processor(token_ids, biases);
+
+  const auto logits = torch::randn({batch_size, vocab_size}, options);
+  auto desired_logits = logits.clone();
+  desired_logits[0][3] += 1.5;
+  desired_logits[0][7] -= 100.0;
+  desired_logits[1][5] += 2.0;
+
+  torch::Tensor unique_token_ids;
+  torch::Tensor unique_token_counts;
+  torch::Tensor unique_token_lens;
+  auto output = processor(
+      logits.clone(), unique_token_ids, unique_token_counts, unique_token_lens);
+  EXPECT_TRUE(torch::allclose(output, desired_logits));
+}
+
+TEST(LogitsProcessorTest, BadWords) {
+  torch::ScalarType dtype(torch::kFloat32);
+  torch::Device device(torch::kCPU);
+  const auto options = torch::dtype(dtype).device(device);
+
+  int64_t batch_size = 3;
+  int64_t vocab_size = 100;
+  // token 0 is only banned for the first row, padding should not ban it
+  const auto bad_token_ids =
+      torch::tensor({{0, 9}, {4, 0}, {0, 0}}, options.dtype(torch::kInt64));
+  const auto bad_token_lens = torch::tensor({2, 1, 0}, torch::kInt);
+  BadWordsLogitsProcessor processor(bad_token_ids, bad_token_lens);
+
+  const auto logits = torch::randn({batch_size, vocab_size}, options);
+  const float filter_value = -std::numeric_limits<float>::infinity();
+  auto desired_logits = logits.clone();
+  desired_logits[0][0] = filter_value;
+  desired_logits[0][9] = filter_value;
+  desired_logits[1][4] = filter_value;
+
+  torch::Tensor unique_token_ids;
+  torch::Tensor unique_token_counts;
+  torch::Tensor unique_token_lens;
+  auto output = processor(
+      logits.clone(), unique_token_ids, unique_token_counts, unique_token_lens);
+  EXPECT_TRUE(torch::equal(output, desired_logits));
+}
+
+TEST(LogitsProcessorTest, MinP) {
+  torch::ScalarType dtype(torch::kFloat32);
+  torch::Device device(torch::kCPU);
+  const auto options = torch::dtype(dtype).device(device);
+
+  int64_t batch_size = 3;
+  int64_t vocab_size = 100;
+  const std::vector<float> min_p_vec = {0.0, 0.1, 0.5};
+  const auto min_p = torch::tensor(min_p_vec, options);
+  MinPLogitsProcessor processor(min_p);
+
+  const auto logits = torch::randn({batch_size, vocab_size}, options);
+  torch::Tensor unique_token_ids;
+  torch::Tensor unique_token_counts;
+  torch::Tensor unique_token_lens;
+  auto output = processor(
+      logits.clone(), unique_token_ids, unique_token_counts, unique_token_lens);
+
+  const float filter_value = -std::numeric_limits<float>::infinity();
+  for (int64_t i = 0; i < batch_size; ++i) {
+    // keep tokens with prob >= min_p * max_prob
+    const auto probs = torch::softmax(logits[i], /*dim=*/-1);
+    const auto keep = probs >= probs.max() * min_p_vec[i];
+    const auto desired = torch::where(
+        keep, logits[i], torch::full_like(logits[i], filter_value));
+    EXPECT_TRUE(torch::equal(output[i], desired));
+  }
+}
+
 }  // namespace llm
@@ -18,12 +18,16 @@ void SamplingParameters::init(
     const std::vector<int32_t>& sample_idxes,
     const std::vector<std::vector<int64_t>>& unique_token_ids_vec,
     const std::vector<std::vector<int32_t>>& unique_token_counts_vec,
-    const std::vector<int32_t>& unique_token_lens_vec) {
+    const std::vector<int32_t>& unique_token_lens_vec,
+    const std::vector<std::vector<int64_t>>& bad_token_ids_vec,
+    const std::vector<int32_t>& bad_token_lens_vec) {
   CHECK_EQ(sampling_params.size(), selected_token_idxes.size());
   CHECK_GE(sampling_params.size(), sample_idxes.size());
   CHECK_EQ(sampling_params.size(), unique_token_ids_vec.size());
   CHECK_EQ(sampling_params.size(), unique_token_counts_vec.size());
   CHECK_EQ(sampling_params.size(), unique_token_lens_vec.size());
+  CHECK_EQ(sampling_params.size(), bad_token_ids_vec.size());
+  CHECK_EQ(sampling_params.size(), bad_token_lens_vec.size());
 
   std::vector<float> frequency_penalties;
   std::vector<float> presence_penalties;
@@ -31,8 +35,8 @@ void SamplingParameters::init(
   std::vector<float> temperatures;
   std::vector<float> top_p;
   std::vector<int64_t> top_k;
-  bool logprobs = false;
-  int64_t max_top_logprobs = 0;
+  std::vector<float> min_p;
+  size_t max_logit_bias = 0;
   for (const auto* p : sampling_params) {
     frequency_penalties.push_back(p->frequency_penalty);
     presence_penalties.push_back(p->presence_penalty);
@@ -40,8 +44,8 @@ void SamplingParameters::init(
     temperatures.push_back(p->temperature);
     top_p.push_back(p->top_p);
     top_k.push_back(p->top_k);
-    logprobs = logprobs || p->logprobs;
-    max_top_logprobs = std::max(max_top_logprobs, p->top_logprobs);
+    min_p.push_back(p->min_p);
+    max_logit_bias = std::max(max_logit_bias, p->logit_bias.size());
   }
 
   bool need_token_stats = false;
@@ -79,6 +83,34 @@ void SamplingParameters::init(
           top_p.begin(), top_p.end(), [](float t) { return t != 1.0; })) {
     this->top_p = torch::tensor(top_p, torch::kFloat32);
   }
+  if (std::any_of(
+          min_p.begin(), min_p.end(), [](float t) { return t > 0.0; })) {
+    this->min_p = torch::tensor(min_p, torch::kFloat32);
+  }
+  if (max_logit_bias > 0) {
+    // pad with zero biases so that the biases can be scattered in one shot
+    const auto n_rows = static_cast<int64_t>(sampling_params.size());
+    std::vector<int64_t> bias_token_ids(n_rows * max_logit_bias, 0);
+    std::vector<float> biases(n_rows * max_logit_bias, 0.0);
+    for (int64_t i = 0; i < n_rows; ++i) {
+      const auto& logit_bias = sampling_params[i]->logit_bias;
+      for (size_t j = 0; j < logit_bias.size(); ++j) {
+        bias_token_ids[i * max_logit_bias + j] = logit_bias[j].first;
+        biases[i * max_logit_bias + j] = logit_bias[j].second;
+      }
+    }
+    const auto n_cols = static_cast<int64_t>(max_logit_bias);
+    this->logit_bias_token_ids =
+        torch::tensor(bias_token_ids, torch::kInt64).view({n_rows, n_cols});
+    this->logit_bias =
+        torch::tensor(biases, torch::kFloat32).view({n_rows, n_cols});
+  }
+  if (std::any_of(bad_token_lens_vec.begin(),
+                  bad_token_lens_vec.end(),
+                  [](int32_t len) { return len > 0; })) {
+    this->bad_token_ids = create_2d_tensor(bad_token_ids_vec, torch::kInt64);
+    this->bad_token_lens = torch::tensor(bad_token_lens_vec, torch::kInt);
+  }
 
   this->selected_token_idxes = torch::tensor(selected_token_idxes, torch::kInt);
   if (need_token_stats) {
@@ -92,17 +124,38 @@ void SamplingParameters::init(
 
   // construct do sample tensor
   std::vector<int32_t> do_sample;
+  // sequences that need logprobs and top logprobs
+  std::vector<int32_t> logprobs_idxes;
+  std::vector<int32_t> top_logprobs_idxes;
+  int64_t max_top_logprobs = 0;
   for (const auto idx : sample_idxes) {
     const auto* p = sampling_params[idx];
     // need to do sample if any of following is true
     const bool sample = p->do_sample || p->temperature != 0.0 ||
-                        p->top_p != 1.0 || p->top_k > 0;
+                        p->top_p != 1.0 || p->top_k > 0 || p->min_p > 0.0;
     do_sample.push_back(sample ? 1 : 0);
+
+    const auto seq_idx = static_cast<int32_t>(do_sample.size() - 1);
+    if (p->logprobs) {
+      logprobs_idxes.push_back(seq_idx);
+      if (p->top_logprobs > 0) {
+        top_logprobs_idxes.push_back(seq_idx);
+        max_top_logprobs = std::max(max_top_logprobs, p->top_logprobs);
+      }
+    }
   }
   this->sample_idxes = torch::tensor(sample_idxes, torch::kInt);
   this->do_sample = torch::tensor(do_sample, torch::kBool);
-  this->logprobs = logprobs;
+  this->logprobs = !logprobs_idxes.empty();
   this->max_top_logprobs = max_top_logprobs;
+
+  // only keep the index when part of sequences need logprobs
+  if (this->logprobs && logprobs_idxes.size() < do_sample.size()) {
+    this->logprobs_idxes = torch::tensor(logprobs_idxes, torch::kInt);
+  }
+  if (max_top_logprobs > 0 && top_logprobs_idxes.size() < do_sample.size()) {
+    this->top_logprobs_idxes = torch::tensor(top_logprobs_idxes, torch::kInt);
+  }
 }
 
 }  // namespace llm
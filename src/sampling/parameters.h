@@ -2,6 +2,7 @@
 #include <torch/torch.h>
 
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 #include "common/tensor_helper.h"
@@ -18,6 +19,12 @@ struct SamplingParameter {
   float temperature = 0.7;
   float top_p = 1.0;
   int64_t top_k = -1;
+  // min_p sampling cutoff relative to the most likely token, 0.0 to disable
+  float min_p = 0.0;
+  // (token id, bias) pairs added to the logits before sampling
+  std::vector<std::pair<int32_t, float>> logit_bias;
+  // token sequences that are banned from being generated
+  std::vector<std::vector<int32_t>> bad_words;
   bool logprobs = false;
   int64_t top_logprobs = 0;
 
@@ -37,7 +44,9 @@ struct SamplingParameters {
             const std::vector<int32_t>& sample_idxes,
             const std::vector<std::vector<int64_t>>& unique_token_ids_vec,
             const std::vector<std::vector<int32_t>>& unique_token_counts_vec,
-            const std::vector<int32_t>& unique_token_lens_vec);
+            const std::vector<int32_t>& unique_token_lens_vec,
+            const std::vector<std::vector<int64_t>>& bad_token_ids_vec,
+            const std::vector<int32_t>& bad_token_lens_vec);
 
   SamplingParameters to(const torch::Device& device,
                         torch::ScalarType dtype) const {
@@ -53,6 +62,11 @@ struct SamplingParameters {
     params.temperatures = safe_to(temperatures, options);
     params.top_p = safe_to(top_p, options);
     params.top_k = safe_to(top_k, device);
+    params.min_p = safe_to(min_p, options);
+    params.logit_bias_token_ids = safe_to(logit_bias_token_ids, device);
+    params.logit_bias = safe_to(logit_bias, options);
+    params.bad_token_ids = safe_to(bad_token_ids, device);
+    params.bad_token_lens = safe_to(bad_token_lens, device);
 
     params.unique_token_ids = safe_to(unique_token_ids, device);
     params.unique_token_counts = safe_to(unique_token_counts, device);
@@ -62,6 +76,8 @@ struct SamplingParameters {
     params.do_sample = safe_to(do_sample, device);
     params.logprobs = logprobs;
     params.max_top_logprobs = max_top_logprobs;
+    params.logprobs_idxes = safe_to(logprobs_idxes, device);
+    params.top_logprobs_idxes = safe_to(top_logprobs_idxes, device);
 
     return params;
   }
@@ -90,6 +106,24 @@ struct SamplingParameters {
   // [num_tokens] LongTensor
   torch::Tensor top_k;
 
+  // [num_tokens] FloatTensor
+  torch::Tensor min_p;
+
+  // the token ids and biases added to logits, padded with zero biases.
+  // [num_tokens, max_num_biases] LongTensor
+  torch::Tensor logit_bias_token_ids;
+
+  // [num_tokens, max_num_biases] FloatTensor
+  torch::Tensor logit_bias;
+
+  // the banned next tokens that would complete a bad word for each token.
+  // [num_tokens, max_bad_tokens] LongTensor
+  torch::Tensor bad_token_ids;
+
+  // the number of banned tokens for each token.
+  // [num_tokens] IntTensor
+  torch::Tensor bad_token_lens;
+
   // the unique token id and count of each sequence in the batch.
   // [num_tokens, max_unique_tokens] LongTensor
   torch::Tensor unique_token_ids;
@@ -116,6 +150,16 @@ struct SamplingParameters {
   // max number of top logprobs in the batch.
   // only used when logprobs is true.
   int64_t max_top_logprobs = 0;
+
+  // the index of sequences that need logprobs, undefined if all sequences
+  // need logprobs. only used when logprobs is true.
+  // [num_logprobs_seqs] IntTensor
+  torch::Tensor logprobs_idxes;
+
+  // the index of sequences that need top logprobs, undefined if all sequences
+  // need top logprobs. only used when max_top_logprobs > 0.
+  // [num_top_logprobs_seqs] IntTensor
+  torch::Tensor top_logprobs_idxes;
 };
 
 struct SampleOutput {
@@ -5,53 +5,113 @@
 
 #include "sampling/parameters.h"
 namespace llm {
+namespace {
+
+// select rows from input, undefined index means all rows
+torch::Tensor select_rows(const torch::Tensor& input,
+                          const torch::Tensor& idxes) {
+  return idxes.defined() ? input.index_select(/*dim=*/0, idxes) : input;
+}
+
+// scatter rows into a zero tensor with num_rows rows, undefined index means
+// all rows
+torch::Tensor scatter_rows(const torch::Tensor& src,
+                           const torch::Tensor& idxes,
+                           int64_t num_rows) {
+  if (!idxes.defined()) {
+    return src;
+  }
+  auto sizes = src.sizes().vec();
+  sizes[0] = num_rows;
+  return torch::zeros(sizes, src.options())
+      .index_copy_(/*dim=*/0, idxes, src);
+}
+
+}  // namespace
 
 Sampler::Sampler(const torch::Tensor& do_sample,
                  bool logprobs,
-                 int64_t max_top_logprobs)
+                 int64_t max_top_logprobs,
+                 const torch::Tensor& logprobs_idxes,
+                 const torch::Tensor& top_logprobs_idxes)
     : logprobs_(logprobs), max_top_logprobs_(max_top_logprobs) {
   CHECK(do_sample.defined());
   do_sample_ = do_sample;
   all_random_sample_ = do_sample.all().item<bool>();
   all_greedy_sample_ = !do_sample.any().item<bool>();
+  if (!all_random_sample_ && !all_greedy_sample_) {
+    random_sample_idxes_ = do_sample.nonzero().view({-1});
+  }
+  // index_copy_ only supports LongTensor as index
+  if (logprobs_idxes.defined()) {
+    logprobs_idxes_ = logprobs_idxes.to(torch::kInt64);
+  }
+  if (top_logprobs_idxes.defined()) {
+    top_logprobs_idxes_ = top_logprobs_idxes.to(torch::kInt64);
+  }
+  // rows need top logprobs should be a subset of rows need logprobs
+  CHECK(top_logprobs_idxes_.defined() || !logprobs_idxes_.defined() ||
+        max_top_logprobs_ == 0);
 }
 
 SampleOutput Sampler::forward(const torch::Tensor& logits) const {
   // same batch size
   CHECK_EQ(logits.size(0), do_sample_.size(0));
-
-  // use float32 for probabilities and log probabilities
-  const auto probs =
-      torch::softmax(logits, /*dim=*/-1, /*dtype=*/torch::kFloat32);
+  const int64_t batch_size = logits.size(0);
 
   SampleOutput output;
-  output.probs = probs;
-
   torch::Tensor samples;
-  if (all_random_sample_) {
+  if (all_greedy_sample_) {
+    // softmax is monotonic, no need to compute probs for greedy sampling
+    samples = greedy_sample(logits);
+  } else if (all_random_sample_) {
+    // use float32 for probabilities
+    const auto probs =
+        torch::softmax(logits, /*dim=*/-1, /*dtype=*/torch::kFloat32);
+    output.probs = probs;
     samples = random_sample(probs);
-  } else if (all_greedy_sample_) {
-    samples = greedy_sample(probs);
   } else {
-    // mixed sample, sample both then choose based on do_sample_
-    auto random = random_sample(probs);
-    auto greedy = greedy_sample(probs);
-    samples = torch::where(do_sample_, random, greedy);
+    // mixed sample, only compute probs for rows that need random sampling
+    const auto random_logits =
+        logits.index_select(/*dim=*/0, random_sample_idxes_);
+    const auto probs =
+        torch::softmax(random_logits, /*dim=*/-1, /*dtype=*/torch::kFloat32);
+    // probs for greedy rows are left as zeros
+    output.probs = scatter_rows(probs, random_sample_idxes_, batch_size);
+    samples = greedy_sample(logits).index_copy_(
+        /*dim=*/0, random_sample_idxes_, random_sample(probs));
   }
   output.next_tokens = samples;
 
   if (logprobs_) {
-    // log_softmax is equivalent to log(softmax) but more numerically stable
-    const auto logprobs =
-        torch::log_softmax(logits, /*dim=*/-1, /*dtype=*/torch::kFloat32);
+    // logprobs = logits - logsumexp(logits), only for rows that need logprobs
+    // [num_logprobs_rows, vocab_size]
+    const auto logprobs_logits =
+        select_rows(logits, logprobs_idxes_).to(torch::kFloat32);
+    // [num_logprobs_rows, 1]
+    const auto lse = logprobs_logits.logsumexp(/*dim=*/-1, /*keepdim=*/true);
     // select the logprobs for each sequence
-    auto selected_logprobs = logprobs.gather(/*dim=*/-1, samples.view({-1, 1}));
-    output.logprobs = selected_logprobs.view({-1});
+    const auto selected_samples = select_rows(samples, logprobs_idxes_);
+    auto selected_logprobs =
+        logprobs_logits.gather(/*dim=*/-1, selected_samples.view({-1, 1}))
+            .sub_(lse);
+    output.logprobs = scatter_rows(
+        selected_logprobs.view({-1}), logprobs_idxes_, batch_size);
 
     if (max_top_logprobs_ > 0) {
-      auto [values, indices] = logprobs.topk(max_top_logprobs_, /*dim=*/-1);
-      output.top_logprobs = values;
-      output.top_tokens = indices;
+      // topk of logits is the same as topk of logprobs
+      auto top_logits = logprobs_logits;
+      auto top_lse = lse;
+      if (top_logprobs_idxes_.defined()) {
+        top_logits = logits.index_select(/*dim=*/0, top_logprobs_idxes_)
+                         .to(torch::kFloat32);
+        top_lse = top_logits.logsumexp(/*dim=*/-1, /*keepdim=*/true);
+      }
+      auto [values, indices] = top_logits.topk(max_top_logprobs_, /*dim=*/-1);
+      output.top_logprobs = scatter_rows(
+          values.sub_(top_lse), top_logprobs_idxes_, batch_size);
+      output.top_tokens =
+          scatter_rows(indices, top_logprobs_idxes_, batch_size);
     }
   }
 
@@ -9,9 +9,13 @@ namespace llm {
 
 class Sampler final {
  public:
+  // logprobs_idxes and top_logprobs_idxes are the index of rows that need
+  // logprobs and top logprobs, undefined means all rows.
   Sampler(const torch::Tensor& do_sample,
           bool logprobs,
-          int64_t max_top_logprobs);
+          int64_t max_top_logprobs,
+          const torch::Tensor& logprobs_idxes = {},
+          const torch::Tensor& top_logprobs_idxes = {});
 
   // operator() allows us to use the module as a function.
   template <typename... Args>
@@ -23,7 +27,7 @@ class Sampler final {
   SampleOutput forward(const torch::Tensor& logits) const;
 
   // helper functions
-  // probs: [..., vocab_size]
+  // probs: [..., vocab_size], logits also work since softmax is monotonic
   static torch::Tensor greedy_sample(const torch::Tensor& probs);
 
   // probs: [..., vocab_size]
@@ -36,8 +40,17 @@ class Sampler final {
   // max number of top logprobs in the batch
   int64_t max_top_logprobs_ = 0;
 
+  // [num_logprobs_rows] IntTensor, undefined means all rows
+  torch::Tensor logprobs_idxes_;
+
+  // [num_top_logprobs_rows] IntTensor, undefined means all rows
+  torch::Tensor top_logprobs_idxes_;
+
   // [batch_size]
   torch::Tensor do_sample_;
+
+  // [num_random_rows] LongTensor, only used for mixed sampling
+  torch::Tensor random_sample_idxes_;
   bool all_random_sample_ = true;
   bool all_greedy_sample_ = true;
 };
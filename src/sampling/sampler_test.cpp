@@ -56,14 +56,80 @@ TEST(SamplerTest, Logprobs) {
   auto selected_tokens = output.next_tokens;
   auto selected_logprobs =
       logprobs.gather(/*dim=*/-1, selected_tokens.view({-1, 1}));
-  EXPECT_TRUE(torch::equal(output.logprobs, selected_logprobs.view({-1})));
+  EXPECT_TRUE(torch::allclose(output.logprobs,
+                              selected_logprobs.view({-1}),
+                              /*rtol=*/1e-5,
+                              /*atol=*/1e-5));
 
   auto [top_k_values, top_k_indices] = logprobs.topk(
       top_logprobs, /*dim=*/-1, /*largest=*/true, /*sorted=*/true);
-  EXPECT_TRUE(torch::equal(output.top_logprobs, top_k_values));
+  EXPECT_TRUE(torch::allclose(output.top_logprobs,
+                              top_k_values,
+                              /*rtol=*/1e-5,
+                              /*atol=*/1e-5));
   EXPECT_TRUE(torch::equal(output.top_tokens, top_k_indices));
 }
 
+TEST(SamplerTest, PartialLogprobs) {
+  torch::ScalarType dtype(torch::kFloat32);
+  torch::Device device(torch::kCPU);
+  const auto options = torch::dtype(dtype).device(device);
+  const int64_t batch_size = 6;
+  const int64_t vocab_size = 32000;
+  const auto do_sample =
+      torch::tensor({false, true, false, false, true, false}, device);
+  // rows 1, 2 and 5 need logprobs, rows 2 and 5 need top logprobs
+  const auto logprobs_idxes = torch::tensor({1, 2, 5}, torch::kInt);
+  const auto top_logprobs_idxes = torch::tensor({2, 5}, torch::kInt);
+
+  const int64_t top_logprobs = 5;
+  Sampler sampler(do_sample,
+                  /*logprobs=*/true,
+                  top_logprobs,
+                  logprobs_idxes,
+                  top_logprobs_idxes);
+
+  const auto logits = torch::randn({batch_size, vocab_size}, options);
+  auto output = sampler(logits);
+
+  EXPECT_EQ(output.next_tokens.sizes(), torch::IntArrayRef({batch_size}));
+  EXPECT_EQ(output.logprobs.sizes(), torch::IntArrayRef({batch_size}));
+  EXPECT_EQ(output.top_logprobs.sizes(),
+            torch::IntArrayRef({batch_size, top_logprobs}));
+  EXPECT_EQ(output.top_tokens.sizes(),
+            torch::IntArrayRef({batch_size, top_logprobs}));
+
+  // greedy rows should use argmax of logits
+  const auto greedy_idxes = torch::tensor({0, 2, 3, 5}, torch::kInt);
+  EXPECT_TRUE(torch::equal(
+      output.next_tokens.index_select(/*dim=*/0, greedy_idxes),
+      logits.argmax(/*dim=*/-1).index_select(/*dim=*/0, greedy_idxes)));
+
+  const auto logprobs =
+      torch::log_softmax(logits, /*dim=*/-1, /*dtype=*/torch::kFloat32);
+  const auto selected_logprobs =
+      logprobs.gather(/*dim=*/-1, output.next_tokens.view({-1, 1})).view({-1});
+  EXPECT_TRUE(torch::allclose(
+      output.logprobs.index_select(/*dim=*/0, logprobs_idxes),
+      selected_logprobs.index_select(/*dim=*/0, logprobs_idxes),
+      /*rtol=*/1e-5,
+      /*atol=*/1e-5));
+
+  auto [top_k_values, top_k_indices] = logprobs.topk(top_logprobs, /*dim=*/-1);
+  EXPECT_TRUE(torch::allclose(
+      output.top_logprobs.index_select(/*dim=*/0, top_logprobs_idxes),
+      top_k_values.index_select(/*dim=*/0, top_logprobs_idxes),
+      /*rtol=*/1e-5,
+      /*atol=*/1e-5));
+  EXPECT_TRUE(torch::equal(
+      output.top_tokens.index_select(/*dim=*/0, top_logprobs_idxes),
+      top_k_indices.index_select(/*dim=*/0, top_logprobs_idxes)));
+
+  // no probs for greedy rows
+  EXPECT_TRUE(torch::equal(output.probs.index_select(/*dim=*/0, greedy_idxes),
+                           torch::zeros({4, vocab_size}, options)));
+}
+
 TEST(SamplerTest, Random) {
   // Test GreedySampler
   torch::ScalarType dtype(torch::kFloat32);
@@ -5,7 +5,9 @@
 #include <folly/MPMCQueue.h>
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <cstdint>
 #include <memory>
 
@@ -64,8 +66,15 @@ ContinuousScheduler::ContinuousScheduler(Engine* engine, const Options& options)
   CHECK(block_manager_ != nullptr);
 
   enable_prefix_cache_ = block_manager_->options().enable_prefix_cache();
-
-  response_handler_ = std::make_unique<ResponseHandler>(engine_->tokenizer());
+  max_speculative_tokens_ = options_.num_speculative_tokens();
+
+  ResponseHandler::Options response_options;
+  response_options.num_threads(options_.num_response_threads())
+      .flush_tokens(options_.stream_flush_tokens())
+      .flush_interval_ms(options_.stream_flush_interval_ms())
+      .max_pending_outputs(options_.max_pending_stream_outputs());
+  response_handler_ =
+      std::make_unique<ResponseHandler>(engine_->tokenizer(), response_options);
 }
 
 ContinuousScheduler::~ContinuousScheduler() {
@@ -155,6 +164,19 @@ Batch ContinuousScheduler::build_sequence_batch() {
   }
   running_requests_.clear();
 
+  if (options_.enable_adaptive_speculation() &&
+      options_.num_speculative_tokens() > 0) {
+    // the target model turns compute-bound with large batches, scale down the
+    // speculation length so that the decoding tokens fit into the token budget
+    // with the batch size of last step.
+    const size_t num_seqs = std::max<size_t>(running_sequences_.size(), 1);
+    const size_t avg_tokens = options_.max_tokens_per_batch() / num_seqs;
+    max_speculative_tokens_ =
+        std::clamp<size_t>(avg_tokens > 1 ? avg_tokens - 1 : 1,
+                           1,
+                           options_.num_speculative_tokens());
+  }
+
   // clear previous batch
   running_sequences_.clear();
   running_sequences_budgets_.clear();
@@ -464,7 +486,7 @@ bool ContinuousScheduler::allocate_blocks_for(Sequence* sequence,
       num_tokens >= num_prompt_tokens) {
     // reach decode phase, try to allocate slots for speculative tokens
     const size_t adjusted_num_tokens =
-        num_tokens + options_.num_speculative_tokens();
+        num_tokens + num_speculative_tokens_for(sequence);
     if (adjusted_num_tokens > num_kv_cache_tokens + token_budget) {
       // over budget, force the sequence in prefill phase
       num_tokens = num_prompt_tokens - 1;
@@ -484,4 +506,20 @@ bool ContinuousScheduler::allocate_blocks_for(Sequence* sequence,
   return block_manager_->allocate_blocks_for(sequence, num_tokens);
 }
 
+size_t ContinuousScheduler::num_speculative_tokens_for(
+    const Sequence* sequence) const {
+  if (!options_.enable_adaptive_speculation()) {
+    return options_.num_speculative_tokens();
+  }
+  // with acceptance rate a, the expected number of accepted tokens before the
+  // first rejection is a / (1 - a), speculate a bit beyond that.
+  const double rate = sequence->draft_acceptance_rate();
+  size_t num_tokens = max_speculative_tokens_;
+  if (rate < 1.0) {
+    num_tokens = static_cast<size_t>(std::ceil(rate / (1.0 - rate)));
+  }
+  // at least one speculative token to keep tracking the acceptance rate
+  return std::clamp<size_t>(num_tokens, 1, max_speculative_tokens_);
+}
+
 }  // namespace llm
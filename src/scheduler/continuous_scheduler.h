@@ -30,6 +30,22 @@ class ContinuousScheduler final : public Scheduler {
 
     // the number of speculative tokens per step
     DEFINE_ARG(int32_t, num_speculative_tokens) = 0;
+
+    // choose the number of speculative tokens for each sequence by its draft
+    // acceptance rate, num_speculative_tokens is used as the upper bound.
+    DEFINE_ARG(bool, enable_adaptive_speculation) = false;
+
+    // the number of threads to send responses
+    DEFINE_ARG(int32_t, num_response_threads) = 4;
+
+    // flush streaming outputs every n tokens, 0 to flush by interval only
+    DEFINE_ARG(int32_t, stream_flush_tokens) = 1;
+
+    // flush streaming outputs every n milliseconds, 0 to disable
+    DEFINE_ARG(int32_t, stream_flush_interval_ms) = 0;
+
+    // the max number of queued streaming outputs per request
+    DEFINE_ARG(int32_t, max_pending_stream_outputs) = 8;
   };
 
   ContinuousScheduler(Engine* engine, const Options& options);
@@ -76,6 +92,9 @@ class ContinuousScheduler final : public Scheduler {
                            size_t token_budget,
                            size_t* actual_tokens);
 
+  // get the number of speculative tokens for the sequence in this step
+  size_t num_speculative_tokens_for(const Sequence* sequence) const;
+
   const Options options_;
 
   // the engine to run the batch
@@ -115,6 +134,10 @@ class ContinuousScheduler final : public Scheduler {
 
   bool enable_prefix_cache_ = false;
 
+  // the upper bound of speculative tokens per sequence in this step, adapted
+  // to the batch size for adaptive speculation
+  size_t max_speculative_tokens_ = 0;
+
   // the number of requests that are waiting to be scheduled
   std::atomic<size_t> pending_requests_{0};
 };
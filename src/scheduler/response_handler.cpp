@@ -1,10 +1,13 @@
 #include "response_handler.h"
 
-#include <absl/synchronization/notification.h>
+#include <absl/hash/hash.h>
+#include <absl/synchronization/blocking_counter.h>
 #include <absl/time/clock.h>
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 #include "common/metrics.h"
 #include "request/request.h"
@@ -21,32 +24,140 @@ DEFINE_COUNTER_INSTANCE(non_stream_responsing_latency_seconds,
                         responsing_latency_seconds,
                         {{"mode", "non-stream"}});
 
+DEFINE_COUNTER(slow_stream_clients_total,
+               "Total number of streaming requests with slow clients");
+
 DEFINE_HISTOGRAM(
     end_2_end_latency_seconds,
     "Histogram of end to end latency in seconds",
     std::vector<double>{0.2, 0.5, 1.0, 2.0, 5.0, 10.0, 15.0, 20.0, 30.0, 60.0});
 
 namespace llm {
+namespace {
+
+// build delta outputs for sequences until given number of tokens
+RequestOutput build_delta_output(Request* request,
+                                 const std::vector<size_t>& indexes,
+                                 const std::vector<size_t>& num_tokens,
+                                 const Tokenizer& tokenizer) {
+  RequestOutput req_output;
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    Sequence& seq = request->sequences[indexes[i]];
+    auto seq_output = seq.build_delta_output_until(num_tokens[i], tokenizer);
+    if (seq_output.has_value()) {
+      req_output.outputs.push_back(std::move(seq_output.value()));
+    }
+  }
+  return req_output;
+}
 
-ResponseHandler::ResponseHandler(const Tokenizer* tokenizer)
-    : tokenizer_(tokenizer->clone()) {}
+}  // namespace
+
+ResponseHandler::ResponseHandler(const Tokenizer* tokenizer,
+                                 const Options& options)
+    : options_(options) {
+  const int32_t num_shards = std::max(options_.num_threads(), 1);
+  shards_.reserve(num_shards);
+  for (int32_t i = 0; i < num_shards; ++i) {
+    auto shard = std::make_unique<Shard>();
+    shard->tokenizer = tokenizer->clone();
+    shards_.push_back(std::move(shard));
+  }
+}
+
+ResponseHandler::Shard& ResponseHandler::shard_for(const Request* request) {
+  const size_t hash = absl::Hash<const Request*>{}(request);
+  return *shards_[hash % shards_.size()];
+}
 
 void ResponseHandler::on_request_finish(std::unique_ptr<Request> request) {
-  // schedule the response handling
-  response_threadpool_.schedule([tokenizer = tokenizer_.get(),
-                                 request = std::move(request)]() {
+  Shard& shard = shard_for(request.get());
+  // schedule the response handling after pending outputs of the request
+  shard.threadpool.schedule([tokenizer = shard.tokenizer.get(),
+                             request = std::move(request)]() {
     AUTO_COUNTER(non_stream_responsing_latency_seconds);
 
     // update the metrics for the request
     HISTOGRAM_OBSERVE(end_2_end_latency_seconds, request->elapsed_seconds());
 
+    if (request->is_streaming() && !request->is_cancelled()) {
+      // flush tokens held back by coalescing
+      std::vector<size_t> indexes;
+      std::vector<size_t> num_tokens;
+      for (size_t i = 0; i < request->sequences.size(); ++i) {
+        Sequence& seq = request->sequences[i];
+        if (!seq.is_closed()) {
+          indexes.push_back(i);
+          num_tokens.push_back(seq.num_tokens());
+          seq.close();
+        }
+      }
+      if (!indexes.empty()) {
+        auto req_output =
+            build_delta_output(request.get(), indexes, num_tokens, *tokenizer);
+        if (!req_output.outputs.empty()) {
+          request->on_output(req_output);
+        }
+      }
+    }
+
     request->on_output(request->build_output(*tokenizer));
   });
 }
 
+bool ResponseHandler::should_flush(Request* request, size_t num_tokens) const {
+  const auto& state = request->stream_state;
+  if (num_tokens <= state.num_flushed_tokens) {
+    // no new tokens since the last flush
+    return false;
+  }
+  const size_t num_new_tokens = num_tokens - state.num_flushed_tokens;
+  const int32_t flush_tokens = options_.flush_tokens();
+  const int32_t flush_interval_ms = options_.flush_interval_ms();
+  if (flush_tokens > 0 && num_new_tokens >= static_cast<size_t>(flush_tokens)) {
+    return true;
+  }
+  if (flush_interval_ms > 0 &&
+      absl::Now() - state.last_flush_time >=
+          absl::Milliseconds(flush_interval_ms)) {
+    return true;
+  }
+  // flush every step if both are disabled
+  return flush_tokens <= 0 && flush_interval_ms <= 0;
+}
+
 void ResponseHandler::on_request_stream(Request* request) {
   CHECK(request->is_streaming()) << "request is not a streaming request";
 
+  auto& state = request->stream_state;
+  size_t total_tokens = 0;
+  bool has_pending_tokens = false;
+  bool has_finished = false;
+  for (const Sequence& seq : request->sequences) {
+    total_tokens += seq.num_generated_tokens();
+    if (!seq.is_closed()) {
+      has_pending_tokens = has_pending_tokens || seq.has_pending_tokens();
+      has_finished = has_finished || seq.is_finished();
+    }
+  }
+  if (!has_pending_tokens && !has_finished) {
+    return;
+  }
+  // always send finish reason without waiting for more tokens
+  if (!has_finished && !should_flush(request, total_tokens)) {
+    return;
+  }
+  // coalesce new tokens into later outputs instead of blocking the scheduler
+  // if the client falls behind, the rest is flushed when the request finishes
+  if (state.num_pending_outputs.load(std::memory_order_relaxed) >=
+      options_.max_pending_outputs()) {
+    if (!state.slow_client) {
+      state.slow_client = true;
+      COUNTER_INC(slow_stream_clients_total);
+    }
+    return;
+  }
+
   std::vector<size_t> indexes;
   std::vector<size_t> num_tokens;
   for (size_t i = 0; i < request->sequences.size(); ++i) {
@@ -67,38 +178,36 @@ void ResponseHandler::on_request_stream(Request* request) {
       seq.close();
     }
   }
+  state.num_flushed_tokens = total_tokens;
+  state.last_flush_time = absl::Now();
+  state.num_pending_outputs.fetch_add(1, std::memory_order_relaxed);
 
   // output the delta text til the end of the sequence to the client
-  response_threadpool_.schedule([request,
-                                 indexes = std::move(indexes),
-                                 num_tokens = std::move(num_tokens),
-                                 tokenizer = tokenizer_.get()]() {
+  Shard& shard = shard_for(request);
+  shard.threadpool.schedule([request,
+                             indexes = std::move(indexes),
+                             num_tokens = std::move(num_tokens),
+                             tokenizer = shard.tokenizer.get()]() {
     AUTO_COUNTER(stream_responsing_latency_seconds);
 
-    RequestOutput req_output;
-    for (size_t i = 0; i < indexes.size(); ++i) {
-      const size_t index = indexes[i];
-      const size_t size = num_tokens[i];
-      Sequence& seq = request->sequences[index];
-
-      auto seq_output = seq.build_delta_output_until(size, *tokenizer);
-      if (seq_output.has_value()) {
-        req_output.outputs.push_back(std::move(seq_output.value()));
-      }
-    }
-
+    auto req_output =
+        build_delta_output(request, indexes, num_tokens, *tokenizer);
     if (!request->on_output(req_output)) {
       // cancel the request if on_stream returns false
       request->cancel();
     }
+    request->stream_state.num_pending_outputs.fetch_sub(
+        1, std::memory_order_relaxed);
   });
 }
 
 void ResponseHandler::wait_for_complete() {
-  // add a task to the end of the pool to wait for it to finish
-  absl::Notification done;
-  response_threadpool_.schedule([&done]() { done.Notify(); });
-  done.WaitForNotification();
+  // add a task to the end of each shard to wait for it to finish
+  absl::BlockingCounter done(static_cast<int>(shards_.size()));
+  for (auto& shard : shards_) {
+    shard->threadpool.schedule([&done]() { done.DecrementCount(); });
+  }
+  done.Wait();
 }
 
 }  // namespace llm
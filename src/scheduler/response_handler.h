@@ -3,6 +3,10 @@
 #include <common/threadpool.h>
 
 #include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "common/macros.h"
 
 namespace llm {
 
@@ -10,9 +14,29 @@ class BlockManager;
 class Request;
 class Sequence;
 class Tokenizer;
+
+// handles responses on a set of single-threaded shards, each request is pinned
+// to one shard by its hash so that its outputs are sent in order.
 class ResponseHandler final {
  public:
-  ResponseHandler(const Tokenizer* tokenizer);
+  struct Options {
+    // the number of threads to handle responses
+    DEFINE_ARG(int32_t, num_threads) = 4;
+
+    // flush streaming outputs once this many tokens are generated since the
+    // last flush, 0 to flush by interval only.
+    DEFINE_ARG(int32_t, flush_tokens) = 1;
+
+    // flush streaming outputs if this much time passed since the last flush,
+    // 0 to disable.
+    DEFINE_ARG(int32_t, flush_interval_ms) = 0;
+
+    // the max number of queued streaming outputs per request, new tokens are
+    // coalesced into later outputs for slow clients beyond this limit.
+    DEFINE_ARG(int32_t, max_pending_outputs) = 8;
+  };
+
+  ResponseHandler(const Tokenizer* tokenizer, const Options& options);
 
   // take over the ownership of the request
   void on_request_finish(std::unique_ptr<Request> request);
@@ -23,11 +47,23 @@ class ResponseHandler final {
   void wait_for_complete();
 
  private:
-  // the threadpool to handle responses
-  ThreadPool response_threadpool_;
+  struct Shard {
+    // single thread to keep responses of a request in order
+    ThreadPool threadpool;
+
+    // tokenizer instance to decode token ids
+    std::unique_ptr<Tokenizer> tokenizer;
+  };
+
+  // get the shard for the request
+  Shard& shard_for(const Request* request);
+
+  // whether to flush new tokens of the streaming request now
+  bool should_flush(Request* request, size_t num_tokens) const;
+
+  const Options options_;
 
-  // tokenizer instance to decode token ids
-  std::unique_ptr<Tokenizer> tokenizer_;
+  std::vector<std::unique_ptr<Shard>> shards_;
 };
 
 }  // namespace llm
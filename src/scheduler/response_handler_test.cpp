@@ -0,0 +1,270 @@
+#include "response_handler.h"
+
+#include <absl/synchronization/notification.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "request/request.h"
+#include "tokenizer/tokenizer.h"
+
+namespace llm {
+namespace {
+
+// a tokenizer that decodes each token id into a lowercase letter
+class LetterTokenizer : public Tokenizer {
+ public:
+  bool encode(const std::string_view& /*text*/,
+              std::vector<int32_t>* /*ids*/) const override {
+    return false;
+  }
+
+  std::string decode(const Slice<int32_t>& ids,
+                     bool /*skip_special_tokens*/) const override {
+    std::string text;
+    for (const auto id : ids) {
+      text.push_back(static_cast<char>('a' + id % 26));
+    }
+    return text;
+  }
+
+  std::optional<int32_t> token_to_id(
+      const std::string_view& /*token*/) const override {
+    return std::nullopt;
+  }
+
+  std::string id_to_token(int32_t id) const override {
+    return std::string(1, static_cast<char>('a' + id % 26));
+  }
+
+  size_t vocab_size() const override { return 26; }
+
+  std::unique_ptr<Tokenizer> clone() const override {
+    return std::make_unique<LetterTokenizer>();
+  }
+};
+
+// outputs received by the request callback
+struct Outputs {
+  std::mutex mutex;
+  std::vector<RequestOutput> outputs;
+
+  // number of generated tokens in each streaming output
+  std::vector<size_t> num_tokens() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<size_t> result;
+    for (const auto& output : outputs) {
+      if (!output.finished) {
+        size_t n = 0;
+        for (const auto& seq_output : output.outputs) {
+          n += seq_output.token_ids.size();
+        }
+        result.push_back(n);
+      }
+    }
+    return result;
+  }
+
+  // concatenated text of all streaming outputs
+  std::string text() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string result;
+    for (const auto& output : outputs) {
+      if (!output.finished) {
+        for (const auto& seq_output : output.outputs) {
+          result += seq_output.text;
+        }
+      }
+    }
+    return result;
+  }
+};
+
+std::unique_ptr<Request> make_request(size_t max_tokens, Outputs* outputs) {
+  auto request = std::make_unique<Request>("",
+                                           std::vector<int32_t>{0, 1, 2},
+                                           /*seq_capacity=*/32,
+                                           /*n=*/1,
+                                           /*best_of=*/1,
+                                           /*logprobs=*/false);
+  request->stream = true;
+  request->stopping_criteria.max_tokens = max_tokens;
+  request->stopping_criteria.ignore_eos = true;
+  request->on_output = [outputs](const RequestOutput& output) {
+    std::lock_guard<std::mutex> lock(outputs->mutex);
+    outputs->outputs.push_back(output);
+    return true;
+  };
+  request->add_sequence();
+  request->sequences[0].append_block({/*id=*/0, /*size=*/32});
+  return request;
+}
+
+// run one decoding step that generates the token for all sequences
+void generate(Request* request, int32_t token_id) {
+  for (auto& seq : request->sequences) {
+    seq.commit_kv_cache(seq.num_tokens_to_process());
+    seq.append_token(token_id);
+  }
+}
+
+}  // namespace
+
+TEST(ResponseHandlerTest, FlushByTokens) {
+  LetterTokenizer tokenizer;
+  ResponseHandler::Options options;
+  options.num_threads(1).flush_tokens(3).flush_interval_ms(0);
+  ResponseHandler handler(&tokenizer, options);
+
+  Outputs outputs;
+  auto request = make_request(/*max_tokens=*/7, &outputs);
+  for (int32_t i = 0; i < 7; ++i) {
+    generate(request.get(), 3 + i);
+    handler.on_request_stream(request.get());
+    handler.wait_for_complete();
+  }
+  // flushed every 3 tokens, the finish reason is sent without waiting
+  EXPECT_EQ(outputs.num_tokens(), (std::vector<size_t>{3, 3, 1}));
+  EXPECT_EQ(outputs.text(), "defghij");
+  {
+    std::lock_guard<std::mutex> lock(outputs.mutex);
+    EXPECT_EQ(outputs.outputs.back().outputs.back().finish_reason, "length");
+  }
+
+  handler.on_request_finish(std::move(request));
+  handler.wait_for_complete();
+  std::lock_guard<std::mutex> lock(outputs.mutex);
+  ASSERT_EQ(outputs.outputs.size(), 4);
+  EXPECT_TRUE(outputs.outputs.back().finished);
+}
+
+TEST(ResponseHandlerTest, FlushByInterval) {
+  LetterTokenizer tokenizer;
+  ResponseHandler::Options options;
+  options.num_threads(1).flush_tokens(0).flush_interval_ms(50);
+  ResponseHandler handler(&tokenizer, options);
+
+  Outputs outputs;
+  auto request = make_request(/*max_tokens=*/4, &outputs);
+  // the first token is sent right away
+  generate(request.get(), 3);
+  handler.on_request_stream(request.get());
+  handler.wait_for_complete();
+  EXPECT_EQ(outputs.num_tokens(), (std::vector<size_t>{1}));
+
+  // held back until the interval passed
+  generate(request.get(), 4);
+  handler.on_request_stream(request.get());
+  handler.wait_for_complete();
+  EXPECT_EQ(outputs.num_tokens(), (std::vector<size_t>{1}));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  generate(request.get(), 5);
+  handler.on_request_stream(request.get());
+  handler.wait_for_complete();
+  EXPECT_EQ(outputs.num_tokens(), (std::vector<size_t>{1, 2}));
+  EXPECT_EQ(outputs.text(), "def");
+
+  // the finish reason is sent without waiting for the interval
+  generate(request.get(), 6);
+  handler.on_request_stream(request.get());
+  handler.wait_for_complete();
+  EXPECT_EQ(outputs.num_tokens(), (std::vector<size_t>{1, 2, 1}));
+  EXPECT_EQ(outputs.text(), "defg");
+
+  handler.on_request_finish(std::move(request));
+  handler.wait_for_complete();
+  std::lock_guard<std::mutex> lock(outputs.mutex);
+  ASSERT_EQ(outputs.outputs.size(), 4);
+  EXPECT_EQ(outputs.outputs[2].outputs.back().finish_reason, "length");
+  EXPECT_TRUE(outputs.outputs[3].finished);
+}
+
+TEST(ResponseHandlerTest, Backpressure) {
+  LetterTokenizer tokenizer;
+  ResponseHandler::Options options;
+  options.num_threads(1).flush_tokens(1).max_pending_outputs(2);
+  ResponseHandler handler(&tokenizer, options);
+
+  Outputs outputs;
+  auto request = make_request(/*max_tokens=*/5, &outputs);
+  // a slow client that blocks on the first output
+  absl::Notification entered;
+  absl::Notification release;
+  request->on_output = [&](const RequestOutput& output) {
+    if (!entered.HasBeenNotified()) {
+      entered.Notify();
+      release.WaitForNotification();
+    }
+    std::lock_guard<std::mutex> lock(outputs.mutex);
+    outputs.outputs.push_back(output);
+    return true;
+  };
+
+  generate(request.get(), 3);
+  handler.on_request_stream(request.get());
+  entered.WaitForNotification();
+  EXPECT_FALSE(request->stream_state.slow_client);
+
+  // one more output is queued, the rest is held back
+  for (int32_t i = 1; i < 5; ++i) {
+    generate(request.get(), 3 + i);
+    handler.on_request_stream(request.get());
+  }
+  EXPECT_EQ(request->stream_state.num_pending_outputs.load(), 2);
+  EXPECT_TRUE(request->stream_state.slow_client);
+
+  release.Notify();
+  handler.wait_for_complete();
+  EXPECT_EQ(outputs.num_tokens(), (std::vector<size_t>{1, 1}));
+  EXPECT_EQ(request->stream_state.num_pending_outputs.load(), 0);
+
+  // held back tokens and the finish reason are sent before the final output
+  handler.on_request_finish(std::move(request));
+  handler.wait_for_complete();
+  EXPECT_EQ(outputs.num_tokens(), (std::vector<size_t>{1, 1, 3}));
+  EXPECT_EQ(outputs.text(), "defgh");
+  std::lock_guard<std::mutex> lock(outputs.mutex);
+  ASSERT_EQ(outputs.outputs.size(), 4);
+  EXPECT_EQ(outputs.outputs[2].outputs.back().finish_reason, "length");
+  EXPECT_TRUE(outputs.outputs[3].finished);
+}
+
+TEST(ResponseHandlerTest, OutputsInOrderAcrossShards) {
+  LetterTokenizer tokenizer;
+  ResponseHandler::Options options;
+  options.num_threads(4).flush_tokens(1);
+  ResponseHandler handler(&tokenizer, options);
+
+  const int kNumRequests = 16;
+  std::vector<Outputs> outputs(kNumRequests);
+  std::vector<std::unique_ptr<Request>> requests;
+  for (int i = 0; i < kNumRequests; ++i) {
+    requests.push_back(make_request(/*max_tokens=*/6, &outputs[i]));
+  }
+  for (int32_t step = 0; step < 6; ++step) {
+    for (auto& request : requests) {
+      generate(request.get(), 3 + step);
+      handler.on_request_stream(request.get());
+    }
+    handler.wait_for_complete();
+  }
+  for (auto& request : requests) {
+    handler.on_request_finish(std::move(request));
+  }
+  handler.wait_for_complete();
+
+  for (auto& output : outputs) {
+    EXPECT_EQ(output.text(), "defghi");
+    std::lock_guard<std::mutex> lock(output.mutex);
+    ASSERT_EQ(output.outputs.size(), 7);
+    EXPECT_TRUE(output.outputs.back().finished);
+  }
+}
+
+}  // namespace llm
@@ -1,3 +1,5 @@
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <grpc/grpc.h>
@@ -7,13 +9,28 @@
 #include <grpcpp/security/credentials.h>
 #include <grpcpp/support/sync_stream.h>
 
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "completion.grpc.pb.h"
 #include "completion.pb.h"
 
+DEFINE_string(server_address, "localhost:8888", "Address of the grpc server.");
+
+// benchmark streamed responses per second, e.g. against servers started with
+// different --grpc_num_threads:
+//   grpc_client --num_requests=10000 --concurrency=256 --max_tokens=64
+DEFINE_int32(num_requests,
+             0,
+             "Number of requests to send for benchmarking, 0 to run in "
+             "interactive mode.");
+DEFINE_int32(concurrency, 64, "Number of concurrent requests for benchmarking.");
+DEFINE_string(prompt, "Hello, my name is", "Prompt used for benchmarking.");
+
 DEFINE_string(priority,
               "DEFAULT",
               "priority of the request, DEFAULT, LOW, MEDIUM, HIGH");
@@ -38,7 +55,8 @@ class ChatClient final {
   ChatClient(std::shared_ptr<Channel> channel)
       : stub_(proto::Completion::NewStub(channel)) {}
 
-  void send_and_receive(const std::string& prompt) {
+  // returns the number of streamed responses received, -1 if rpc failed.
+  int64_t send_and_receive(const std::string& prompt, bool print = true) {
     // Create a message to send to the server
     proto::CompletionRequest request;
     request.set_prompt(prompt);
@@ -59,11 +77,14 @@ class ChatClient final {
         stub_->Complete(&context, request));
 
     proto::CompletionResponse message;
+    int64_t num_responses = 0;
     while (reader->Read(&message)) {
-      // LOG(ERROR) << "got response: " << message.DebugString();
+      ++num_responses;
+      if (!print) {
+        continue;
+      }
       // pretty print the response
       for (const auto& choice : message.choices()) {
-        // LOG(INFO) << choice.DebugString();
         std::cout << choice.text() << std::flush;
       }
     }
@@ -73,13 +94,56 @@ class ChatClient final {
       LOG(ERROR) << "RPC failed, error code: " << status.error_code()
                  << ", error message: " << status.error_message()
                  << ", error details: " << status.error_details();
+      return -1;
     }
+    return num_responses;
   }
 
  private:
   std::unique_ptr<proto::Completion::Stub> stub_;
 };
 
+// send num_requests requests with concurrency threads, each thread has its
+// own connection, and report the throughput of streamed responses.
+void run_benchmark() {
+  std::atomic<int32_t> next_request{0};
+  std::atomic<int64_t> num_responses{0};
+  std::atomic<int32_t> num_failed{0};
+
+  const absl::Time start = absl::Now();
+  std::vector<std::thread> threads;
+  threads.reserve(FLAGS_concurrency);
+  for (int32_t i = 0; i < FLAGS_concurrency; ++i) {
+    threads.emplace_back([&]() {
+      // avoid sharing the connection between threads
+      grpc::ChannelArguments args;
+      args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+      ChatClient client(grpc::CreateCustomChannel(
+          FLAGS_server_address, grpc::InsecureChannelCredentials(), args));
+      while (next_request.fetch_add(1) < FLAGS_num_requests) {
+        const int64_t n = client.send_and_receive(FLAGS_prompt, /*print=*/false);
+        if (n < 0) {
+          ++num_failed;
+        } else {
+          num_responses += n;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const double seconds = absl::ToDoubleSeconds(absl::Now() - start);
+
+  std::cout << "requests: " << FLAGS_num_requests
+            << ", failed: " << num_failed.load()
+            << ", concurrency: " << FLAGS_concurrency << '\n'
+            << "elapsed: " << seconds << "s\n"
+            << "requests/s: " << FLAGS_num_requests / seconds << '\n'
+            << "streamed responses/s: " << num_responses.load() / seconds
+            << std::endl;
+}
+
 }  // namespace llm
 
 int main(int argc, char* argv[]) {
@@ -87,12 +151,14 @@ int main(int argc, char* argv[]) {
   google::InitGoogleLogging(argv[0]);
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
-  // Define the server address and port
-  std::string server_address("localhost:8888");
+  if (FLAGS_num_requests > 0) {
+    llm::run_benchmark();
+    return 0;
+  }
 
   // Create a gRPC channel
-  auto channel =
-      grpc::CreateChannel(server_address, grpc::InsecureChannelCredentials());
+  auto channel = grpc::CreateChannel(FLAGS_server_address,
+                                     grpc::InsecureChannelCredentials());
 
   // Create a chat client
   llm::ChatClient client(channel);
@@ -4,6 +4,7 @@
 #include <glog/logging.h>
 #include <grpcpp/grpcpp.h>
 
+#include <algorithm>
 #include <memory>
 #include <thread>
 
@@ -26,83 +27,122 @@ bool GrpcServer::start(const Options& options) {
   builder.RegisterService(&completion_service_);
   builder.RegisterService(&chat_service_);
   builder.RegisterService(models_handler_.get());
-  // Get hold of the completion queue used for the asynchronous communication
+  // Get hold of the completion queues used for the asynchronous communication
   // with the gRPC runtime.
-  cq_ = builder.AddCompletionQueue();
+  int32_t num_cqs = options.num_cqs;
+  if (num_cqs <= 0) {
+    num_cqs = std::max<int32_t>(1, std::thread::hardware_concurrency());
+  }
+  for (int32_t i = 0; i < num_cqs; ++i) {
+    cqs_.push_back(builder.AddCompletionQueue());
+  }
   // Finally assemble the server.
   grpc_server_ = builder.BuildAndStart();
-  LOG(INFO) << "Started grpc server on " << server_address;
-
-  // Spawn a new CallData instance for complete request
-  {
-    auto on_register =
-        [this](grpc::ServerContext* context,
-               proto::CompletionRequest* request,
-               grpc::ServerAsyncWriter<proto::CompletionResponse>* responder,
-               grpc::ServerCompletionQueue* new_call_cq,
-               grpc::ServerCompletionQueue* notification_cq,
-               void* tag) {
-          completion_service_.RequestComplete(
-              context, request, responder, new_call_cq, notification_cq, tag);
-        };
-    auto on_request = [this](CompletionCallData* call_data) {
-      completion_handler_->complete_async(call_data);
-    };
-    // Spawn new CallData instances to serve new clients
-    new CompletionCallData(cq_.get(), on_register, on_request);
+  if (grpc_server_ == nullptr) {
+    LOG(ERROR) << "Failed to start grpc server on " << server_address;
+    cqs_.clear();
+    return false;
   }
-
-  // Spawn a new CallData instance for chat request
-  {
-    auto on_register =
-        [this](grpc::ServerContext* context,
-               proto::ChatRequest* request,
-               grpc::ServerAsyncWriter<proto::ChatResponse>* responder,
-               grpc::ServerCompletionQueue* new_call_cq,
-               grpc::ServerCompletionQueue* notification_cq,
-               void* tag) {
-          chat_service_.RequestComplete(
-              context, request, responder, new_call_cq, notification_cq, tag);
-        };
-    auto on_request = [this](ChatCallData* call_data) {
-      chat_handler_->chat_async(call_data);
-    };
-    new ChatCallData(cq_.get(), on_register, on_request);
+  LOG(INFO) << "Started grpc server on " << server_address << " with "
+            << num_cqs << " completion queues";
+
+  // Spawn CallData instances on each queue and proceed to the main loops.
+  const int32_t num_calls = std::max(options.num_calls_per_cq, 1);
+  for (auto& cq : cqs_) {
+    register_calls(cq.get(), num_calls);
+    handler_threads_.emplace_back(
+        [cq = cq.get()]() { GrpcServer::handle_rpcs(cq); });
   }
-
-  // Proceed to the server's main loop.
-  handler_thread_ = std::make_unique<std::thread>([this]() { handle_rpcs(); });
   return true;
 }
 
+void GrpcServer::register_calls(grpc::ServerCompletionQueue* cq,
+                                int32_t num_calls) {
+  // CallData instances for complete request
+  auto on_complete_register =
+      [this](grpc::ServerContext* context,
+             proto::CompletionRequest* request,
+             grpc::ServerAsyncWriter<proto::CompletionResponse>* responder,
+             grpc::ServerCompletionQueue* new_call_cq,
+             grpc::ServerCompletionQueue* notification_cq,
+             void* tag) {
+        completion_service_.RequestComplete(
+            context, request, responder, new_call_cq, notification_cq, tag);
+      };
+  auto on_complete_request = [this](CompletionCallData* call_data) {
+    completion_handler_->complete_async(call_data);
+  };
+
+  // CallData instances for batch complete request
+  auto on_batch_complete_register =
+      [this](grpc::ServerContext* context,
+             proto::BatchCompletionRequest* request,
+             grpc::ServerAsyncWriter<proto::BatchCompletionResponse>* responder,
+             grpc::ServerCompletionQueue* new_call_cq,
+             grpc::ServerCompletionQueue* notification_cq,
+             void* tag) {
+        completion_service_.RequestBatchComplete(
+            context, request, responder, new_call_cq, notification_cq, tag);
+      };
+  auto on_batch_complete_request = [this](BatchCompletionCallData* call_data) {
+    completion_handler_->batch_complete_async(call_data);
+  };
+
+  // CallData instances for chat request
+  auto on_chat_register =
+      [this](grpc::ServerContext* context,
+             proto::ChatRequest* request,
+             grpc::ServerAsyncWriter<proto::ChatResponse>* responder,
+             grpc::ServerCompletionQueue* new_call_cq,
+             grpc::ServerCompletionQueue* notification_cq,
+             void* tag) {
+        chat_service_.RequestComplete(
+            context, request, responder, new_call_cq, notification_cq, tag);
+      };
+  auto on_chat_request = [this](ChatCallData* call_data) {
+    chat_handler_->chat_async(call_data);
+  };
+
+  // Spawn new CallData instances to serve new clients, each instance spawns
+  // its replacement on the same queue once a request arrives.
+  for (int32_t i = 0; i < num_calls; ++i) {
+    new CompletionCallData(cq, on_complete_register, on_complete_request);
+    new BatchCompletionCallData(
+        cq, on_batch_complete_register, on_batch_complete_request);
+    new ChatCallData(cq, on_chat_register, on_chat_request);
+  }
+}
+
 void GrpcServer::stop() {
   if (grpc_server_) {
     grpc_server_->Shutdown();
   }
-  // Always shutdown the completion queue after the server.
-  if (cq_) {
-    cq_->Shutdown();
+  // Always shutdown the completion queues after the server.
+  for (auto& cq : cqs_) {
+    cq->Shutdown();
   }
 
-  // wait for the handler thread to drain event queue
-  if (handler_thread_ && handler_thread_->joinable()) {
-    handler_thread_->join();
+  // wait for the handler threads to drain event queues
+  for (auto& thread : handler_threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
   }
 
   // release resources
   grpc_server_.reset();
-  cq_.reset();
-  handler_thread_.reset();
+  cqs_.clear();
+  handler_threads_.clear();
 }
 
-// This can be run in multiple threads if needed.
-void GrpcServer::handle_rpcs() {
+// Each completion queue is polled by its own thread.
+void GrpcServer::handle_rpcs(grpc::ServerCompletionQueue* cq) {
   void* tag = nullptr;  // uniquely identifies a request.
   bool rpc_ok = false;
 
   // Block waiting to read the next event from the completion queue.
-  // returns if there is any kind of event or cq_ is shutting down.
-  while (cq_->Next(&tag, &rpc_ok)) {
+  // returns if there is any kind of event or cq is shutting down.
+  while (cq->Next(&tag, &rpc_ok)) {
     CallData* call_data = static_cast<CallData*>(tag);
     if (!call_data->proceed(rpc_ok)) {
       // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
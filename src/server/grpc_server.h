@@ -4,6 +4,7 @@
 
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "handlers/chat_handler.h"
 #include "handlers/completion_handler.h"
@@ -16,6 +17,11 @@ class GrpcServer final {
   struct Options {
     std::string address = "localhost";
     int32_t port = 8888;
+    // number of completion queues, each is polled by its own thread.
+    // 0 to use the number of cpu cores.
+    int32_t num_cqs = 0;
+    // number of calls pre-registered per service on each completion queue
+    int32_t num_calls_per_cq = 8;
   };
 
   GrpcServer(std::unique_ptr<CompletionHandler> completion_handler,
@@ -32,7 +38,11 @@ class GrpcServer final {
   void stop();
 
  private:
-  void handle_rpcs();
+  // poll events from the completion queue
+  static void handle_rpcs(grpc::ServerCompletionQueue* cq);
+
+  // register calls for all services on the completion queue
+  void register_calls(grpc::ServerCompletionQueue* cq, int32_t num_calls);
 
   // handler for completion requests
   std::unique_ptr<CompletionHandler> completion_handler_;
@@ -49,10 +59,11 @@ class GrpcServer final {
 
   // grpc server
   std::unique_ptr<grpc::Server> grpc_server_;
-  // completion queue: the producer-consumer queue where for asynchronous server
-  std::unique_ptr<grpc::ServerCompletionQueue> cq_;
-  // thread for handling rpcs
-  std::unique_ptr<std::thread> handler_thread_;
+  // completion queues: the producer-consumer queues for asynchronous server.
+  // calls are pinned to the queue they are registered on.
+  std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> cqs_;
+  // threads for handling rpcs, one for each completion queue
+  std::vector<std::thread> handler_threads_;
 };
 
 }  // namespace llm
@@ -2,80 +2,291 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <optional>
+#include <sstream>
 #include <string>
 #include <utility>
 
 namespace llm {
+namespace {
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+
+// timeout to wait for the next request on an idle connection
+constexpr std::chrono::seconds kIdleTimeout{60};
+// maximum size of the request body
+constexpr uint64_t kMaxBodySize = uint64_t(64) * 1024 * 1024;
+// maximum bytes of a streaming response queued for a slow client
+constexpr size_t kMaxPendingWriteBytes = size_t(16) * 1024 * 1024;
+
+// serialize a plain text response
+std::string to_string(http::status status,
+                      unsigned version,
+                      bool keep_alive,
+                      const std::string& body) {
+  http::response<http::string_body> res{status, version};
+  res.set(http::field::content_type, "text/plain");
+  res.keep_alive(keep_alive);
+  res.body() = body;
+  res.prepare_payload();
+  std::ostringstream ss;
+  ss << res;
+  return ss.str();
+}
+}  // namespace
+
+// a http connection that reads requests and writes responses in order.
+// all handlers run in the strand of the connection, and writes from other
+// threads are posted into the strand.
+class HttpServer::Session : public std::enable_shared_from_this<Session> {
+ public:
+  Session(tcp::socket&& socket, const HttpServer* server)
+      : stream_(std::move(socket)), server_(server) {}
+
+  void start() {
+    net::dispatch(stream_.get_executor(),
+                  [self = shared_from_this()] { self->do_read(); });
+  }
+
+  // queue bytes to write from any thread, last marks the end of the response.
+  // the connection is closed once the client falls too far behind.
+  void write(std::string data, bool last, bool keep_alive) {
+    const size_t pending = pending_bytes_.fetch_add(data.size()) + data.size();
+    if (!last && pending > kMaxPendingWriteBytes) {
+      LOG(WARNING) << "Closing the connection as the client can't keep up";
+      open_ = false;
+      net::post(stream_.get_executor(),
+                [self = shared_from_this()] { self->do_close(); });
+      return;
+    }
+    net::post(stream_.get_executor(),
+              [self = shared_from_this(),
+               data = std::move(data),
+               last,
+               keep_alive]() mutable {
+                if (!self->is_open()) {
+                  return;
+                }
+                self->write_queue_.push_back(std::move(data));
+                if (last) {
+                  self->response_complete_ = true;
+                  self->keep_alive_ = self->keep_alive_ && keep_alive;
+                }
+                if (!self->writing_) {
+                  self->do_write();
+                }
+              });
+  }
+
+  bool is_open() const { return open_.load(); }
+
+ private:
+  void do_read() {
+    // a new parser for each request
+    parser_.emplace();
+    parser_->body_limit(kMaxBodySize);
+    stream_.expires_after(kIdleTimeout);
+    http::async_read(
+        stream_,
+        buffer_,
+        *parser_,
+        [self = shared_from_this()](beast::error_code ec, size_t /*bytes*/) {
+          self->on_read(ec);
+        });
+  }
+
+  void on_read(beast::error_code ec) {
+    if (ec == http::error::body_limit) {
+      // reply before closing since the rest of the body is not read
+      write_queue_.push_back(to_string(http::status::payload_too_large,
+                                       parser_->get().version(),
+                                       /*keep_alive=*/false,
+                                       "The request body is too large."));
+      pending_bytes_ += write_queue_.back().size();
+      response_complete_ = true;
+      keep_alive_ = false;
+      do_write();
+      return;
+    }
+    if (ec) {
+      if (ec != http::error::end_of_stream &&
+          ec != beast::error::timeout && ec != net::error::eof) {
+        LOG(ERROR) << "Error in reading request: " << ec.message();
+      }
+      do_close();
+      return;
+    }
+
+    // the response may take long time, e.g. streaming generated tokens
+    stream_.expires_never();
+    response_complete_ = false;
+    auto request = parser_->release();
+    keep_alive_ = request.keep_alive();
+    auto transport =
+        std::make_shared<Transport>(shared_from_this(), std::move(request));
+    server_->handle_request(*transport);
+    // the next request is read once the response is complete
+  }
+
+  void do_write() {
+    writing_ = true;
+    net::async_write(
+        stream_,
+        net::buffer(write_queue_.front()),
+        [self = shared_from_this()](beast::error_code ec, size_t /*bytes*/) {
+          self->on_write(ec);
+        });
+  }
+
+  void on_write(beast::error_code ec) {
+    if (ec) {
+      LOG(WARNING) << "Error in writing response: " << ec.message();
+      do_close();
+      return;
+    }
+    pending_bytes_ -= write_queue_.front().size();
+    write_queue_.pop_front();
+    if (!write_queue_.empty()) {
+      do_write();
+      return;
+    }
+    writing_ = false;
+    if (response_complete_) {
+      if (keep_alive_) {
+        // serve pipelined or next requests on the same connection
+        do_read();
+      } else {
+        do_close();
+      }
+    }
+  }
+
+  void do_close() {
+    open_ = false;
+    write_queue_.clear();
+    beast::error_code ec;
+    stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+  }
+
+  beast::tcp_stream stream_;
+  beast::flat_buffer buffer_;
+  std::optional<http::request_parser<http::string_body>> parser_;
+
+  const HttpServer* server_;
+
+  // following states are accessed in the strand only
+  std::deque<std::string> write_queue_;
+  bool writing_ = false;
+  bool response_complete_ = false;
+  bool keep_alive_ = false;
+
+  std::atomic<bool> open_{true};
+  // bytes queued but not written yet, updated from any thread
+  std::atomic<size_t> pending_bytes_{0};
+};
 
 bool HttpServer::register_uri(const std::string& uri,
-                              HttpServer::Handler handler) {
+                              HttpServer::Handler handler,
+                              std::vector<http::verb> methods) {
   if (endpoints_.count(uri) != 0) {
     return false;
   }
-  endpoints_[uri] = handler;
+  endpoints_[uri] = Endpoint{std::move(handler), std::move(methods)};
   return true;
 }
 
-void HttpServer::async_accept(tcp::acceptor& acceptor) {
-  // create a new socket
-  const auto socket = std::make_shared<tcp::socket>(*io_context_);
-  acceptor.async_accept(
-      *socket, [this, &acceptor, socket](boost::system::error_code ec) {
-        // loop to accept new incoming connections
-        async_accept(acceptor);
-
+void HttpServer::async_accept() {
+  // each connection has its own strand
+  acceptor_->async_accept(
+      net::make_strand(*io_context_),
+      [this](boost::system::error_code ec, tcp::socket socket) {
         if (!ec) {
-          try {
-            // handle the request
-            handle_request(*socket);
-          } catch (const std::exception& e) {
-            LOG(ERROR) << "Exception in processing request: " << e.what();
-          }
+          std::make_shared<Session>(std::move(socket), this)->start();
         } else {
           LOG(ERROR) << "Error in accepting connection: " << ec.message();
         }
+        // loop to accept new incoming connections
+        if (acceptor_->is_open()) {
+          async_accept();
+        }
       });
 }
 
-void HttpServer::handle_request(tcp::socket& socket) {
-  // process the request
-  boost::beast::flat_buffer buffer;
-  boost::beast::http::request<boost::beast::http::string_body> req;
-  boost::beast::http::read(socket, buffer, req);
-  boost::beast::http::response<boost::beast::http::string_body> res;
-  res.version(req.version());
-  res.keep_alive(req.keep_alive());
-  const std::string target = req.target();
-  auto it = endpoints_.find(target);
+void HttpServer::handle_request(Transport& transport) const {
+  std::string_view target = transport.target();
+  // ignore the query string
+  const size_t pos = target.find('?');
+  if (pos != std::string_view::npos) {
+    target = target.substr(0, pos);
+  }
+  auto it = endpoints_.find(std::string(target));
   if (it == endpoints_.end()) {
-    res.result(boost::beast::http::status::not_found);
-    res.body() = "The resource '" + target + "' was not found.";
-    res.set(boost::beast::http::field::content_type, "text/plain");
-  } else {
-    auto& handler = it->second;
-    Transport transport(&res);
-    if (!handler(transport)) {
-      res.result(boost::beast::http::status::internal_server_error);
-      res.body() = "An error occurred processing the request.";
-      res.set(boost::beast::http::field::content_type, "text/plain");
-    }
+    transport.send_string(
+        "The resource '" + std::string(target) + "' was not found.",
+        "text/plain",
+        /*status_code=*/404);
+    return;
+  }
+  const auto& methods = it->second.methods;
+  if (!methods.empty() && std::find(methods.begin(),
+                                    methods.end(),
+                                    transport.method()) == methods.end()) {
+    transport.send_string(
+        "The method is not allowed for the resource.", "text/plain", 405);
+    return;
+  }
+
+  bool ok = false;
+  try {
+    ok = it->second.handler(transport);
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Exception in processing request: " << e.what();
+  }
+  // the handler may respond asynchronously if succeeded
+  if (!ok && !transport.responded()) {
+    transport.send_string("An error occurred processing the request.",
+                          "text/plain",
+                          /*status_code=*/500);
   }
-  boost::beast::http::write(socket, res);
-  socket.shutdown(tcp::socket::shutdown_send);
 }
 
 bool HttpServer::start(uint16_t port, int32_t num_threads) {
-  io_context_ = std::make_unique<boost::asio::io_context>(num_threads);
-
-  thread_ = std::thread([this, port] {
-    tcp::acceptor acceptor{*io_context_, tcp::endpoint{tcp::v4(), port}};
-    async_accept(acceptor);
-    io_context_->run();
-  });
-  LOG(INFO) << "Started http server on 0.0.0.0:" << port;
+  num_threads = std::max(num_threads, 1);
+  io_context_ = std::make_unique<net::io_context>(num_threads);
+  acceptor_ = std::make_unique<tcp::acceptor>(*io_context_);
+
+  boost::system::error_code ec;
+  const tcp::endpoint endpoint{tcp::v4(), port};
+  acceptor_->open(endpoint.protocol(), ec);
+  if (!ec) {
+    acceptor_->set_option(net::socket_base::reuse_address(true), ec);
+  }
+  if (!ec) {
+    acceptor_->bind(endpoint, ec);
+  }
+  if (!ec) {
+    acceptor_->listen(net::socket_base::max_listen_connections, ec);
+  }
+  if (ec) {
+    LOG(ERROR) << "Failed to listen on 0.0.0.0:" << port << ": "
+               << ec.message();
+    return false;
+  }
+
+  async_accept();
+  threads_.reserve(num_threads);
+  for (int32_t i = 0; i < num_threads; ++i) {
+    threads_.emplace_back([this] { io_context_->run(); });
+  }
+  LOG(INFO) << "Started http server on 0.0.0.0:" << port << " with "
+            << num_threads << " threads";
   return true;
 }
 
@@ -84,24 +295,95 @@ void HttpServer::stop() {
   if (io_context_) {
     io_context_->stop();
   }
-  // wait for thread to finish
-  if (thread_.joinable()) {
-    thread_.join();
+  // wait for threads to finish
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
   }
+  threads_.clear();
   endpoints_.clear();
 }
 
+HttpServer::Transport::Transport(std::shared_ptr<Session> session,
+                                 Request request)
+    : session_(std::move(session)), request_(std::move(request)) {
+  keep_alive_ = request_.keep_alive();
+  chunked_ = request_.version() >= 11;
+}
+
 bool HttpServer::Transport::send_string(const std::string& data,
-                                        const std::string& mime_type) {
-  res_->set(boost::beast::http::field::content_type, mime_type);
-  res_->body() = data;
-  res_->result(boost::beast::http::status::ok);
-  return true;
+                                        const std::string& mime_type,
+                                        int status_code) {
+  http::response<http::string_body> res{
+      static_cast<http::status>(status_code), request_.version()};
+  res.set(http::field::content_type, mime_type);
+  res.keep_alive(keep_alive_);
+  res.body() = data;
+  res.prepare_payload();
+
+  std::ostringstream ss;
+  ss << res;
+  return write(ss.str(), /*last=*/true);
 }
 
 bool HttpServer::Transport::send_status(int status_code) {
-  res_->result(status_code);
-  return true;
+  return send_string("", "text/plain", status_code);
+}
+
+bool HttpServer::Transport::start_stream(const std::string& mime_type) {
+  http::response<http::empty_body> res{http::status::ok, request_.version()};
+  res.set(http::field::content_type, mime_type);
+  res.set(http::field::cache_control, "no-cache");
+  if (chunked_) {
+    res.chunked(true);
+  } else {
+    // http/1.0 clients read until the connection is closed
+    keep_alive_ = false;
+  }
+  res.keep_alive(keep_alive_);
+
+  std::ostringstream ss;
+  ss << res.base();
+  return write(ss.str(), /*last=*/false);
+}
+
+bool HttpServer::Transport::send_chunk(const std::string& data) {
+  if (data.empty()) {
+    // an empty chunk ends the response
+    return is_open();
+  }
+  if (!chunked_) {
+    return write(data, /*last=*/false);
+  }
+  std::ostringstream ss;
+  ss << std::hex << data.size() << "\r\n" << data << "\r\n";
+  return write(ss.str(), /*last=*/false);
+}
+
+bool HttpServer::Transport::send_event(const std::string& data) {
+  return send_chunk("data: " + data + "\n\n");
+}
+
+bool HttpServer::Transport::finish_stream() {
+  return write(chunked_ ? "0\r\n\r\n" : "", /*last=*/true);
+}
+
+bool HttpServer::Transport::is_open() const {
+  return !finished_.load() && session_->is_open();
+}
+
+bool HttpServer::Transport::write(std::string data, bool last) {
+  if (finished_.load()) {
+    LOG(ERROR) << "Response has been finished";
+    return false;
+  }
+  responded_ = true;
+  if (last) {
+    finished_ = true;
+  }
+  session_->write(std::move(data), last, keep_alive_);
+  return session_->is_open();
 }
 
-}  // namespace llm
\ No newline at end of file
+}  // namespace llm
@@ -1,67 +1,132 @@
 #pragma once
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace llm {
 using tcp = boost::asio::ip::tcp;
-// a simple http server based on civetweb for serving model metrics and health
-// check endpoints
+// an asynchronous http/1.1 server based on boost beast, supports keep-alive,
+// pipelined requests and chunked streaming responses, e.g. server-sent events.
 class HttpServer {
  public:
+  class Session;
   class Transport;
   using Handler = std::function<bool(Transport&)>;
+  using Request =
+      boost::beast::http::request<boost::beast::http::string_body>;
 
   HttpServer() = default;
 
-  bool register_uri(const std::string& uri, Handler handler);
+  ~HttpServer() { stop(); }
 
+  // register a handler for the uri, the query string is ignored for routing.
+  // requests with other methods are rejected with 405 if methods is given.
+  bool register_uri(const std::string& uri,
+                    Handler handler,
+                    std::vector<boost::beast::http::verb> methods = {});
+
+  // start num_threads io threads to serve requests
   bool start(uint16_t port, int32_t num_threads);
 
   void stop();
 
   /**
-   * A helper class that request handler can use to query transport related
-   * information. one transport object is created for each request, and should
-   * be accessed from single thread only.
+   * A helper class that request handler can use to query request and send
+   * response. one transport object is created for each request. handlers
+   * can keep the transport alive with shared_from_this() to respond
+   * asynchronously from other threads, the response is sent in order of
+   * calls.
    */
-  class Transport {
-   private:
-    boost::beast::http::response<boost::beast::http::string_body>* res_;
-
+  class Transport : public std::enable_shared_from_this<Transport> {
    public:
-    explicit Transport(
-        boost::beast::http::response<boost::beast::http::string_body>* res)
-        : res_(res) {}
+    Transport(std::shared_ptr<Session> session, Request request);
 
     Transport(const Transport&) = delete;
     Transport& operator=(Transport&) = delete;
 
+    // the request method, target and body
+    boost::beast::http::verb method() const { return request_.method(); }
+    std::string_view target() const {
+      const auto target = request_.target();
+      return {target.data(), target.size()};
+    }
+    const std::string& body() const { return request_.body(); }
+
     // Send response
     bool send_string(
         const std::string& data,
-        const std::string& mime_type = "text/plain; charset=utf-8");
+        const std::string& mime_type = "text/plain; charset=utf-8",
+        int status_code = 200);
 
     // Send status code: 200 OK, 503 Service Unavailable, etc.
     bool send_status(int status_code);
+
+    // start a chunked response, followed by send_chunk() and finish_stream()
+    bool start_stream(const std::string& mime_type = "text/event-stream");
+
+    // send a chunk of data for a streaming response
+    bool send_chunk(const std::string& data);
+
+    // send a server-sent event: "data: <data>\n\n"
+    bool send_event(const std::string& data);
+
+    // end the streaming response
+    bool finish_stream();
+
+    // whether any response has been sent
+    bool responded() const { return responded_.load(); }
+
+    // whether the connection is still open
+    bool is_open() const;
+
+   private:
+    // queue bytes to write, last marks the end of the response
+    bool write(std::string data, bool last);
+
+    std::shared_ptr<Session> session_;
+
+    Request request_;
+
+    // whether to keep the connection alive after the response
+    bool keep_alive_ = true;
+
+    // whether to use chunked encoding for streaming, requires http/1.1
+    bool chunked_ = true;
+
+    std::atomic<bool> responded_{false};
+
+    // whether the response is complete
+    std::atomic<bool> finished_{false};
   };
 
  private:
-  void async_accept(tcp::acceptor& acceptor);
-  void handle_request(tcp::socket& socket);
+  void async_accept();
+
+  // dispatch the request to the registered handler
+  void handle_request(Transport& transport) const;
+
+  struct Endpoint {
+    Handler handler;
+    // allowed methods, empty for any method
+    std::vector<boost::beast::http::verb> methods;
+  };
 
   // hold the ownership of all request handlers
-  std::unordered_map<std::string, Handler> endpoints_;
+  std::unordered_map<std::string, Endpoint> endpoints_;
 
-  // io_context and thread for running the server
+  // io_context and threads for running the server
   std::unique_ptr<boost::asio::io_context> io_context_;
-  std::thread thread_;
+  std::unique_ptr<tcp::acceptor> acceptor_;
+  std::vector<std::thread> threads_;
 };
 
-}  // namespace llm
\ No newline at end of file
+}  // namespace llm
@@ -0,0 +1,224 @@
+#include "http_server.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace llm {
+namespace {
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+
+// find a free port on localhost
+uint16_t free_port() {
+  net::io_context ioc;
+  tcp::acceptor acceptor(ioc, tcp::endpoint(tcp::v4(), 0));
+  return acceptor.local_endpoint().port();
+}
+
+class HttpServerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    server_.register_uri("/echo", [](HttpServer::Transport& transport) {
+      return transport.send_string(transport.body());
+    });
+    server_.register_uri(
+        "/post",
+        [](HttpServer::Transport& transport) {
+          return transport.send_string("ok");
+        },
+        {http::verb::post});
+    server_.register_uri("/stream", [this](HttpServer::Transport& transport) {
+      // stream events from another thread until the client goes away
+      auto stream = transport.shared_from_this();
+      if (!stream->start_stream()) {
+        return false;
+      }
+      stream_thread_ = std::thread([this, stream] {
+        const auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (std::chrono::steady_clock::now() < deadline) {
+          if (!stream->send_event("token")) {
+            stream_closed_ = true;
+            return;
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      });
+      return true;
+    });
+    server_.register_uri("/flood", [this](HttpServer::Transport& transport) {
+      // send large events as fast as possible until sending fails
+      auto stream = transport.shared_from_this();
+      if (!stream->start_stream()) {
+        return false;
+      }
+      stream_thread_ = std::thread([this, stream] {
+        const std::string event(64 * 1024, 'x');
+        const auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (std::chrono::steady_clock::now() < deadline) {
+          if (!stream->send_event(event)) {
+            stream_closed_ = true;
+            return;
+          }
+        }
+      });
+      return true;
+    });
+
+    port_ = free_port();
+    ASSERT_TRUE(server_.start(port_, /*num_threads=*/2));
+  }
+
+  void TearDown() override {
+    if (stream_thread_.joinable()) {
+      stream_thread_.join();
+    }
+    server_.stop();
+  }
+
+  // connect to the server
+  beast::tcp_stream connect() {
+    beast::tcp_stream stream(ioc_);
+    stream.connect(tcp::endpoint(net::ip::make_address("127.0.0.1"), port_));
+    return stream;
+  }
+
+  static http::request<http::string_body> make_request(
+      http::verb method,
+      const std::string& target,
+      const std::string& body = "") {
+    http::request<http::string_body> req{method, target, 11};
+    req.set(http::field::host, "localhost");
+    req.body() = body;
+    req.prepare_payload();
+    return req;
+  }
+
+  net::io_context ioc_;
+  HttpServer server_;
+  uint16_t port_ = 0;
+
+  std::thread stream_thread_;
+  std::atomic<bool> stream_closed_{false};
+};
+
+TEST_F(HttpServerTest, KeepAliveAndPipelining) {
+  auto stream = connect();
+  // send two requests back to back before reading any response
+  std::ostringstream ss;
+  ss << make_request(http::verb::post, "/echo", "first")
+     << make_request(http::verb::post, "/echo?a=b", "second");
+  net::write(stream, net::buffer(ss.str()));
+
+  beast::flat_buffer buffer;
+  for (const std::string expected : {"first", "second"}) {
+    http::response<http::string_body> res;
+    http::read(stream, buffer, res);
+    EXPECT_EQ(res.result(), http::status::ok);
+    EXPECT_TRUE(res.keep_alive());
+    EXPECT_EQ(res.body(), expected);
+  }
+
+  // the connection is still usable for the next request
+  http::write(stream, make_request(http::verb::post, "/echo", "third"));
+  http::response<http::string_body> res;
+  http::read(stream, buffer, res);
+  EXPECT_EQ(res.body(), "third");
+}
+
+TEST_F(HttpServerTest, NotFoundAndMethodNotAllowed) {
+  auto stream = connect();
+  beast::flat_buffer buffer;
+
+  http::write(stream, make_request(http::verb::get, "/missing"));
+  http::response<http::string_body> not_found;
+  http::read(stream, buffer, not_found);
+  EXPECT_EQ(not_found.result(), http::status::not_found);
+
+  http::write(stream, make_request(http::verb::get, "/post"));
+  http::response<http::string_body> not_allowed;
+  http::read(stream, buffer, not_allowed);
+  EXPECT_EQ(not_allowed.result(), http::status::method_not_allowed);
+
+  http::write(stream, make_request(http::verb::post, "/post"));
+  http::response<http::string_body> ok;
+  http::read(stream, buffer, ok);
+  EXPECT_EQ(ok.result(), http::status::ok);
+  EXPECT_EQ(ok.body(), "ok");
+}
+
+TEST_F(HttpServerTest, OversizedBody) {
+  auto stream = connect();
+  // only send the header, the body limit is checked against content-length
+  const std::string header =
+      "POST /echo HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "Content-Length: 1073741824\r\n"
+      "\r\n";
+  net::write(stream, net::buffer(header));
+
+  beast::flat_buffer buffer;
+  http::response<http::string_body> res;
+  http::read(stream, buffer, res);
+  EXPECT_EQ(res.result(), http::status::payload_too_large);
+  EXPECT_FALSE(res.keep_alive());
+
+  // the server closes the connection after the response
+  beast::error_code ec;
+  http::response<http::string_body> next;
+  http::read(stream, buffer, next, ec);
+  EXPECT_EQ(ec, http::error::end_of_stream);
+}
+
+TEST_F(HttpServerTest, StreamingDisconnect) {
+  {
+    auto stream = connect();
+    http::write(stream, make_request(http::verb::get, "/stream"));
+
+    // read the header and some events, then go away
+    beast::flat_buffer buffer;
+    http::response_parser<http::string_body> parser;
+    http::read_header(stream, buffer, parser);
+    EXPECT_EQ(parser.get().result(), http::status::ok);
+    EXPECT_TRUE(parser.chunked());
+    beast::error_code ec;
+    stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+    stream.close();
+  }
+
+  // sending should fail once the server notices the disconnect
+  if (stream_thread_.joinable()) {
+    stream_thread_.join();
+  }
+  EXPECT_TRUE(stream_closed_);
+}
+
+TEST_F(HttpServerTest, StreamingSlowClient) {
+  auto stream = connect();
+  http::write(stream, make_request(http::verb::get, "/flood"));
+
+  // read the header, then stop reading without closing the connection
+  beast::flat_buffer buffer;
+  http::response_parser<http::string_body> parser;
+  http::read_header(stream, buffer, parser);
+  EXPECT_EQ(parser.get().result(), http::status::ok);
+
+  // sending fails once too many bytes are queued for the client
+  if (stream_thread_.joinable()) {
+    stream_thread_.join();
+  }
+  EXPECT_TRUE(stream_closed_);
+}
+
+}  // namespace
+}  // namespace llm
@@ -18,10 +18,16 @@
 #include "handlers/llm_handler.h"
 #include "handlers/models_handler.h"
 #include "http_server.h"
+#include "openai_handler.h"
 using namespace llm;
 
 DEFINE_int32(http_port, 9999, "Port for http server.");
 DEFINE_int32(grpc_port, 8888, "Port for grpc server.");
+DEFINE_int32(http_num_threads, 4, "Number of io threads for http server.");
+DEFINE_int32(grpc_num_threads,
+             0,
+             "Number of completion queues and polling threads for grpc server, "
+             "0 to use the number of cpu cores.");
 
 DEFINE_string(model_id, "", "hf model name.");
 
@@ -77,6 +83,43 @@ DEFINE_int32(max_seqs_per_batch, 128, "max number of sequences per batch");
 
 DEFINE_int32(num_speculative_tokens, 0, "number of speculative tokens");
 
+DEFINE_int32(prompt_lookup_max_ngram,
+             0,
+             "max ngram size for prompt lookup decoding without draft model");
+
+DEFINE_int32(prompt_lookup_num_branches,
+             1,
+             "max number of branches of the draft token tree for prompt "
+             "lookup decoding");
+
+DEFINE_bool(enable_adaptive_speculation,
+            false,
+            "adapt the number of speculative tokens to the acceptance rate");
+
+DEFINE_int32(num_response_threads, 4, "number of threads to send responses");
+
+DEFINE_int32(stream_flush_tokens,
+             1,
+             "flush streaming outputs every n tokens, 0 to flush by interval "
+             "only");
+
+DEFINE_int32(stream_flush_interval_ms,
+             0,
+             "flush streaming outputs every n milliseconds, 0 to disable");
+
+DEFINE_int32(max_pending_stream_outputs,
+             8,
+             "max number of queued streaming outputs per request");
+
+DEFINE_int32(num_loading_threads,
+             4,
+             "number of threads to read model weights files ahead");
+
+DEFINE_string(weight_cache_dir,
+              "",
+              "directory to cache prepared weights for faster restarts, empty "
+              "to disable");
+
 // NOLINTNEXTLINE
 static std::atomic<uint32_t> signal_received{0};
 void shutdown_handler(int signal) {
@@ -169,7 +212,16 @@ int main(int argc, char** argv) {
           parse_batch_sizes(FLAGS_draft_cuda_graph_batch_sizes))
       .max_tokens_per_batch(FLAGS_max_tokens_per_batch)
       .max_seqs_per_batch(FLAGS_max_seqs_per_batch)
-      .num_speculative_tokens(FLAGS_num_speculative_tokens);
+      .num_speculative_tokens(FLAGS_num_speculative_tokens)
+      .prompt_lookup_max_ngram(FLAGS_prompt_lookup_max_ngram)
+      .prompt_lookup_num_branches(FLAGS_prompt_lookup_num_branches)
+      .enable_adaptive_speculation(FLAGS_enable_adaptive_speculation)
+      .num_response_threads(FLAGS_num_response_threads)
+      .stream_flush_tokens(FLAGS_stream_flush_tokens)
+      .stream_flush_interval_ms(FLAGS_stream_flush_interval_ms)
+      .max_pending_stream_outputs(FLAGS_max_pending_stream_outputs)
+      .num_loading_threads(FLAGS_num_loading_threads)
+      .weight_cache_dir(FLAGS_weight_cache_dir);
 
   auto llm_handler = std::make_unique<LLMHandler>(options);
   llm_handler->start();
@@ -181,6 +233,10 @@ int main(int argc, char** argv) {
   auto chat_handler = std::make_unique<ChatHandler>(llm_handler.get(), models);
   auto models_handler = std::make_unique<ModelsHandler>(models);
 
+  // serve openai compatible apis over http directly
+  OpenAIHandler openai_handler(llm_handler.get(), models);
+  openai_handler.register_uris(&http_server);
+
   // start grpc server
   GrpcServer grpc_server(std::move(completion_handler),
                          std::move(chat_handler),
@@ -188,13 +244,14 @@ int main(int argc, char** argv) {
   GrpcServer::Options grpc_options;
   grpc_options.address = "0.0.0.0";
   grpc_options.port = FLAGS_grpc_port;
+  grpc_options.num_cqs = FLAGS_grpc_num_threads;
 
   if (!grpc_server.start(grpc_options)) {
     LOG(ERROR) << "failed to start grpc server on port " << FLAGS_grpc_port;
     return -1;
   }
 
-  if (!http_server.start(FLAGS_http_port, /*num_threads=*/2)) {
+  if (!http_server.start(FLAGS_http_port, FLAGS_http_num_threads)) {
     LOG(ERROR) << "Failed to start http server on port " << FLAGS_http_port;
     return -1;
   }
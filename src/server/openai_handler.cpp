@@ -0,0 +1,662 @@
+#include "openai_handler.h"
+
+#include <absl/strings/ascii.h>
+#include <absl/strings/numbers.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+#include <glog/logging.h>
+
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "chat_template/chat_template.h"
+#include "handlers/sampling_params.h"
+#include "handlers/uuid.h"
+#include "request/output.h"
+#include "request/status.h"
+
+namespace llm {
+
+namespace {
+using json = nlohmann::json;
+
+// NOLINTNEXTLINE
+thread_local ShortUUID short_uuid;
+
+json error_json(int status_code, const std::string& message) {
+  json error;
+  error["message"] = message;
+  error["type"] =
+      status_code < 500 ? "invalid_request_error" : "internal_server_error";
+  error["code"] = status_code;
+  return json{{"error", std::move(error)}};
+}
+
+// serialize json and replace invalid utf-8 bytes instead of throwing
+std::string dump(const json& value) {
+  return value.dump(/*indent=*/-1,
+                    /*indent_char=*/' ',
+                    /*ensure_ascii=*/false,
+                    json::error_handler_t::replace);
+}
+
+bool send_error(HttpServer::Transport& transport,
+                int status_code,
+                const std::string& message) {
+  return transport.send_string(detail::error_body(status_code, message),
+                               "application/json",
+                               status_code);
+}
+
+// get the value of the key if present and not null
+template <typename T>
+void get_value(const json& body, const char* key, T* value) {
+  const auto it = body.find(key);
+  if (it != body.end() && !it->is_null()) {
+    *value = it->get<T>();
+  }
+}
+
+// "stop" can be either a string or an array of strings
+std::optional<std::vector<std::string>> get_strings(const json& body,
+                                                    const char* key) {
+  const auto it = body.find(key);
+  if (it == body.end() || it->is_null()) {
+    return std::nullopt;
+  }
+  if (it->is_string()) {
+    return std::vector<std::string>{it->get<std::string>()};
+  }
+  return it->get<std::vector<std::string>>();
+}
+
+// "content" of a message can be a string, null or an array of content parts,
+// of which only text parts are supported.
+std::string get_content(const json& message) {
+  const auto& content = message.at("content");
+  if (content.is_null()) {
+    return "";
+  }
+  if (!content.is_array()) {
+    return content.get<std::string>();
+  }
+  std::string text;
+  for (const auto& part : content) {
+    const auto type = part.at("type").get<std::string>();
+    if (type != "text") {
+      throw std::invalid_argument("Unsupported content part type: " + type);
+    }
+    if (!text.empty()) {
+      text += "\n";
+    }
+    text += part.at("text").get<std::string>();
+  }
+  return text;
+}
+
+Priority get_priority(const json& body) {
+  std::string priority;
+  get_value(body, "priority", &priority);
+  absl::AsciiStrToLower(&priority);
+  if (priority == "high") {
+    return Priority::HIGH;
+  }
+  if (priority == "low") {
+    return Priority::LOW;
+  }
+  return Priority::NORMAL;
+}
+
+bool get_include_usage(const json& body) {
+  bool include_usage = false;
+  const auto it = body.find("stream_options");
+  if (it != body.end() && it->is_object()) {
+    get_value(*it, "include_usage", &include_usage);
+  }
+  return include_usage;
+}
+
+// parse sampling parameters shared by completion and chat requests
+SamplingParams to_sampling_params(const json& body) {
+  SamplingParams sp;
+  get_value(body, "max_tokens", &sp.max_tokens);
+  get_value(body, "n", &sp.n);
+  get_value(body, "frequency_penalty", &sp.frequency_penalty);
+  get_value(body, "presence_penalty", &sp.presence_penalty);
+  get_value(body, "repetition_penalty", &sp.repetition_penalty);
+  get_value(body, "temperature", &sp.temperature);
+  get_value(body, "top_p", &sp.top_p);
+  get_value(body, "top_k", &sp.top_k);
+  get_value(body, "min_p", &sp.min_p);
+  get_value(body, "skip_special_tokens", &sp.skip_special_tokens);
+  get_value(body, "ignore_eos", &sp.ignore_eos);
+  sp.stop = get_strings(body, "stop");
+  sp.bad_words = get_strings(body, "bad_words");
+
+  const auto stop_token_ids = body.find("stop_token_ids");
+  if (stop_token_ids != body.end() && !stop_token_ids->is_null()) {
+    sp.stop_token_ids = stop_token_ids->get<std::vector<int32_t>>();
+  }
+
+  // token ids are string keys in json
+  const auto logit_bias = body.find("logit_bias");
+  if (logit_bias != body.end() && logit_bias->is_object()) {
+    auto& biases = sp.logit_bias.emplace();
+    for (const auto& [key, bias] : logit_bias->items()) {
+      int32_t token_id = 0;
+      if (!absl::SimpleAtoi(key, &token_id)) {
+        throw std::invalid_argument("Invalid token id in logit_bias: " + key);
+      }
+      biases[token_id] = bias.get<float>();
+    }
+  }
+  return sp;
+}
+
+json usage_json(const Usage& usage) {
+  json result;
+  result["prompt_tokens"] = usage.num_prompt_tokens;
+  result["completion_tokens"] = usage.num_generated_tokens;
+  result["total_tokens"] = usage.num_total_tokens;
+  return result;
+}
+
+json response_json(const char* object,
+                   const std::string& request_id,
+                   int64_t created_time,
+                   const std::string& model) {
+  json response;
+  response["id"] = request_id;
+  response["object"] = object;
+  response["created"] = created_time;
+  response["model"] = model;
+  response["choices"] = json::array();
+  return response;
+}
+
+json completion_logprobs_json(
+    const std::optional<std::vector<LogProb>>& logprobs) {
+  if (!logprobs.has_value() || logprobs.value().empty()) {
+    return nullptr;
+  }
+  json tokens = json::array();
+  json token_ids = json::array();
+  json token_logprobs = json::array();
+  for (const auto& logprob : logprobs.value()) {
+    tokens.push_back(logprob.token);
+    token_ids.push_back(logprob.token_id);
+    token_logprobs.push_back(logprob.logprob);
+  }
+  return json{{"tokens", std::move(tokens)},
+              {"token_ids", std::move(token_ids)},
+              {"token_logprobs", std::move(token_logprobs)}};
+}
+
+json chat_logprobs_json(const std::optional<std::vector<LogProb>>& logprobs) {
+  if (!logprobs.has_value() || logprobs.value().empty()) {
+    return nullptr;
+  }
+  json content = json::array();
+  for (const auto& logprob : logprobs.value()) {
+    json item{{"token", logprob.token},
+              {"token_id", logprob.token_id},
+              {"logprob", logprob.logprob}};
+    if (logprob.top_logprobs.has_value()) {
+      json top_logprobs = json::array();
+      for (const auto& top_logprob : logprob.top_logprobs.value()) {
+        top_logprobs.push_back({{"token", top_logprob.token},
+                                {"token_id", top_logprob.token_id},
+                                {"logprob", top_logprob.logprob}});
+      }
+      item["top_logprobs"] = std::move(top_logprobs);
+    }
+    content.push_back(std::move(item));
+  }
+  return json{{"content", std::move(content)}};
+}
+
+// the state of a streaming response shared by output callbacks
+struct StreamState {
+  std::string request_id;
+  int64_t created_time = 0;
+  std::string model;
+  bool include_usage = false;
+  // whether the sse stream has been started
+  bool started = false;
+  // sequences that have sent the first chat message with role
+  std::unordered_set<size_t> first_message_sent;
+};
+
+// handle the error status, returns false if the request should be stopped
+bool handle_status(const RequestOutput& output,
+                   StreamState* state,
+                   HttpServer::Transport& transport) {
+  if (!output.status.has_value() || output.status.value().ok()) {
+    return true;
+  }
+  const auto& status = output.status.value();
+  const int status_code = detail::to_http_status_code(status.code());
+  if (!state->started) {
+    send_error(transport, status_code, status.message());
+    return false;
+  }
+  // the stream has been started, send the error as an event
+  transport.send_event(dump(error_json(status_code, status.message())));
+  transport.finish_stream();
+  return false;
+}
+
+bool send_completion_delta(const RequestOutput& output,
+                           StreamState* state,
+                           HttpServer::Transport& transport) {
+  if (!state->started) {
+    state->started = true;
+    if (!transport.start_stream()) {
+      return false;
+    }
+  }
+
+  const auto new_chunk = [state]() {
+    return response_json("text_completion",
+                         state->request_id,
+                         state->created_time,
+                         state->model);
+  };
+  for (const auto& seq_output : output.outputs) {
+    // send chunk with delta text
+    if (!seq_output.text.empty()) {
+      auto chunk = new_chunk();
+      chunk["choices"].push_back(
+          {{"index", seq_output.index},
+           {"text", seq_output.text},
+           {"logprobs", completion_logprobs_json(seq_output.logprobs)},
+           {"finish_reason", nullptr}});
+      if (!transport.send_event(dump(chunk))) {
+        return false;
+      }
+    }
+    // send a separate chunk with finish reason
+    if (seq_output.finish_reason.has_value()) {
+      auto chunk = new_chunk();
+      chunk["choices"].push_back(
+          {{"index", seq_output.index},
+           {"text", ""},
+           {"logprobs", nullptr},
+           {"finish_reason", seq_output.finish_reason.value()}});
+      if (!transport.send_event(dump(chunk))) {
+        return false;
+      }
+    }
+  }
+
+  // send additional chunk for usage statistics
+  if (state->include_usage && output.usage.has_value()) {
+    auto chunk = new_chunk();
+    chunk["usage"] = usage_json(output.usage.value());
+    if (!transport.send_event(dump(chunk))) {
+      return false;
+    }
+  }
+
+  if (output.finished) {
+    transport.send_event("[DONE]");
+    return transport.finish_stream();
+  }
+  return true;
+}
+
+bool send_completion_result(const RequestOutput& output,
+                            const StreamState& state,
+                            HttpServer::Transport& transport) {
+  auto response = response_json(
+      "text_completion", state.request_id, state.created_time, state.model);
+  for (const auto& seq_output : output.outputs) {
+    json choice{{"index", seq_output.index},
+                {"text", seq_output.text},
+                {"logprobs", completion_logprobs_json(seq_output.logprobs)},
+                {"finish_reason", nullptr}};
+    if (seq_output.finish_reason.has_value()) {
+      choice["finish_reason"] = seq_output.finish_reason.value();
+    }
+    response["choices"].push_back(std::move(choice));
+  }
+  if (output.usage.has_value()) {
+    response["usage"] = usage_json(output.usage.value());
+  }
+  return transport.send_string(dump(response), "application/json");
+}
+
+bool send_chat_delta(const RequestOutput& output,
+                     StreamState* state,
+                     HttpServer::Transport& transport) {
+  if (!state->started) {
+    state->started = true;
+    if (!transport.start_stream()) {
+      return false;
+    }
+  }
+
+  const auto new_chunk = [state]() {
+    return response_json("chat.completion.chunk",
+                         state->request_id,
+                         state->created_time,
+                         state->model);
+  };
+  for (const auto& seq_output : output.outputs) {
+    const auto index = seq_output.index;
+    // send first chunk with role as assistant
+    if (state->first_message_sent.insert(index).second) {
+      auto chunk = new_chunk();
+      chunk["choices"].push_back(
+          {{"index", index},
+           {"delta", {{"role", "assistant"}, {"content", ""}}},
+           {"logprobs", nullptr},
+           {"finish_reason", nullptr}});
+      if (!transport.send_event(dump(chunk))) {
+        return false;
+      }
+    }
+    // send chunk with delta message
+    if (!seq_output.text.empty()) {
+      auto chunk = new_chunk();
+      chunk["choices"].push_back(
+          {{"index", index},
+           {"delta", {{"content", seq_output.text}}},
+           {"logprobs", chat_logprobs_json(seq_output.logprobs)},
+           {"finish_reason", nullptr}});
+      if (!transport.send_event(dump(chunk))) {
+        return false;
+      }
+    }
+    // send a separate chunk with finish reason
+    if (seq_output.finish_reason.has_value()) {
+      auto chunk = new_chunk();
+      chunk["choices"].push_back(
+          {{"index", index},
+           {"delta", json::object()},
+           {"logprobs", nullptr},
+           {"finish_reason", seq_output.finish_reason.value()}});
+      if (!transport.send_event(dump(chunk))) {
+        return false;
+      }
+    }
+  }
+
+  // send additional chunk for usage statistics
+  if (state->include_usage && output.usage.has_value()) {
+    auto chunk = new_chunk();
+    chunk["usage"] = usage_json(output.usage.value());
+    if (!transport.send_event(dump(chunk))) {
+      return false;
+    }
+  }
+
+  if (output.finished) {
+    transport.send_event("[DONE]");
+    return transport.finish_stream();
+  }
+  return true;
+}
+
+bool send_chat_result(const RequestOutput& output,
+                      const StreamState& state,
+                      HttpServer::Transport& transport) {
+  auto response = response_json(
+      "chat.completion", state.request_id, state.created_time, state.model);
+  for (const auto& seq_output : output.outputs) {
+    json choice{
+        {"index", seq_output.index},
+        {"message", {{"role", "assistant"}, {"content", seq_output.text}}},
+        {"logprobs", chat_logprobs_json(seq_output.logprobs)},
+        {"finish_reason", nullptr}};
+    if (seq_output.finish_reason.has_value()) {
+      choice["finish_reason"] = seq_output.finish_reason.value();
+    }
+    response["choices"].push_back(std::move(choice));
+  }
+  if (output.usage.has_value()) {
+    response["usage"] = usage_json(output.usage.value());
+  }
+  return transport.send_string(dump(response), "application/json");
+}
+
+// parse the json body, returns nullopt if not a json object
+std::optional<json> parse_json(const std::string& body) {
+  auto value = json::parse(body, /*cb=*/nullptr, /*allow_exceptions=*/false);
+  if (value.is_discarded() || !value.is_object()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+}  // namespace
+
+namespace detail {
+
+Status parse_completion_request(const std::string& body,
+                                OpenAIRequest* request) {
+  const auto value = parse_json(body);
+  if (!value.has_value()) {
+    return {StatusCode::INVALID_ARGUMENT, "Invalid json body"};
+  }
+  try {
+    get_value(*value, "model", &request->model);
+    // only one prompt is supported for each request
+    const auto it = value->find("prompt");
+    if (it != value->end() && it->is_array() && it->size() == 1) {
+      request->prompt = it->at(0).get<std::string>();
+    } else if (it != value->end()) {
+      request->prompt = it->get<std::string>();
+    }
+    auto& sp = request->sampling_params;
+    sp = to_sampling_params(*value);
+    get_value(*value, "echo", &sp.echo);
+    uint32_t best_of = 0;
+    get_value(*value, "best_of", &best_of);
+    if (best_of > 0) {
+      sp.best_of = best_of;
+    }
+    int64_t logprobs = -1;
+    get_value(*value, "logprobs", &logprobs);
+    if (logprobs >= 0) {
+      sp.logprobs = true;
+      sp.top_logprobs = logprobs;
+    }
+    get_value(*value, "stream", &request->stream);
+    request->priority = get_priority(*value);
+    request->include_usage = get_include_usage(*value);
+  } catch (const std::exception& e) {
+    return {StatusCode::INVALID_ARGUMENT, e.what()};
+  }
+  // the best results are only known once all sequences are finished
+  const auto& sp = request->sampling_params;
+  if (request->stream && sp.best_of.value_or(sp.n) != sp.n) {
+    return {StatusCode::INVALID_ARGUMENT,
+            "best_of must be equal to n when streaming"};
+  }
+  return {};
+}
+
+Status parse_chat_request(const std::string& body, OpenAIRequest* request) {
+  const auto value = parse_json(body);
+  if (!value.has_value()) {
+    return {StatusCode::INVALID_ARGUMENT, "Invalid json body"};
+  }
+  try {
+    get_value(*value, "model", &request->model);
+    const auto it = value->find("messages");
+    if (it != value->end() && it->is_array()) {
+      request->messages.reserve(it->size());
+      for (const auto& message : *it) {
+        request->messages.emplace_back(message.at("role").get<std::string>(),
+                                       get_content(message));
+      }
+    }
+    auto& sp = request->sampling_params;
+    sp = to_sampling_params(*value);
+    get_value(*value, "logprobs", &sp.logprobs);
+    get_value(*value, "top_logprobs", &sp.top_logprobs);
+    get_value(*value, "stream", &request->stream);
+    request->priority = get_priority(*value);
+    request->include_usage = get_include_usage(*value);
+  } catch (const std::exception& e) {
+    return {StatusCode::INVALID_ARGUMENT, e.what()};
+  }
+  return {};
+}
+
+int to_http_status_code(StatusCode code) {
+  switch (code) {
+    case StatusCode::OK:
+      return 200;
+    case StatusCode::INVALID_ARGUMENT:
+      return 400;
+    case StatusCode::UNAUTHENTICATED:
+      return 401;
+    case StatusCode::RESOURCE_EXHAUSTED:
+      return 429;
+    case StatusCode::UNIMPLEMENTED:
+      return 501;
+    case StatusCode::UNAVAILABLE:
+      return 503;
+    case StatusCode::DEADLINE_EXCEEDED:
+      return 504;
+    default:
+      return 500;
+  }
+}
+
+std::string error_body(int status_code, const std::string& message) {
+  return dump(error_json(status_code, message));
+}
+
+}  // namespace detail
+
+OpenAIHandler::OpenAIHandler(LLMHandler* llm_handler,
+                             const std::vector<std::string>& models)
+    : llm_handler_(llm_handler),
+      models_(models),
+      model_set_(models.begin(), models.end()),
+      created_(absl::ToUnixSeconds(absl::Now())) {
+  CHECK(llm_handler_ != nullptr);
+  CHECK(!models_.empty());
+}
+
+void OpenAIHandler::register_uris(HttpServer* http_server) {
+  using boost::beast::http::verb;
+  http_server->register_uri(
+      "/v1/completions",
+      [this](HttpServer::Transport& transport) { return complete(transport); },
+      {verb::post});
+  http_server->register_uri(
+      "/v1/chat/completions",
+      [this](HttpServer::Transport& transport) { return chat(transport); },
+      {verb::post});
+  http_server->register_uri(
+      "/v1/models",
+      [this](HttpServer::Transport& transport) {
+        return list_models(transport);
+      },
+      {verb::get});
+}
+
+bool OpenAIHandler::complete(HttpServer::Transport& transport) {
+  OpenAIRequest request;
+  const auto status =
+      detail::parse_completion_request(transport.body(), &request);
+  if (!status.ok()) {
+    return send_error(transport,
+                      detail::to_http_status_code(status.code()),
+                      status.message());
+  }
+  if (!model_set_.contains(request.model)) {
+    return send_error(transport, 404, "Model not supported");
+  }
+
+  auto& sp = request.sampling_params;
+  const bool stream = request.stream;
+  StreamState state;
+  state.request_id = "cmpl-" + short_uuid.random();
+  state.created_time = absl::ToUnixSeconds(absl::Now());
+  state.model = std::move(request.model);
+  state.include_usage = request.include_usage;
+
+  // schedule the request
+  llm_handler_->schedule_async(
+      std::move(request.prompt),
+      std::move(sp),
+      request.priority,
+      stream,
+      [transport = transport.shared_from_this(),
+       stream,
+       state = std::move(state)](const RequestOutput& output) mutable {
+        if (!handle_status(output, &state, *transport)) {
+          return false;
+        }
+        if (stream) {
+          return send_completion_delta(output, &state, *transport);
+        }
+        return send_completion_result(output, state, *transport);
+      });
+  return true;
+}
+
+bool OpenAIHandler::chat(HttpServer::Transport& transport) {
+  OpenAIRequest request;
+  const auto status = detail::parse_chat_request(transport.body(), &request);
+  if (!status.ok()) {
+    return send_error(transport,
+                      detail::to_http_status_code(status.code()),
+                      status.message());
+  }
+  if (!model_set_.contains(request.model)) {
+    return send_error(transport, 404, "Model not supported");
+  }
+
+  const bool stream = request.stream;
+  StreamState state;
+  state.request_id = "chatcmpl-" + short_uuid.random();
+  state.created_time = absl::ToUnixSeconds(absl::Now());
+  state.model = std::move(request.model);
+  state.include_usage = request.include_usage;
+
+  // schedule the request
+  llm_handler_->schedule_chat_async(
+      std::move(request.messages),
+      std::move(request.sampling_params),
+      request.priority,
+      stream,
+      [transport = transport.shared_from_this(),
+       stream,
+       state = std::move(state)](const RequestOutput& output) mutable {
+        if (!handle_status(output, &state, *transport)) {
+          return false;
+        }
+        if (stream) {
+          return send_chat_delta(output, &state, *transport);
+        }
+        return send_chat_result(output, state, *transport);
+      });
+  return true;
+}
+
+bool OpenAIHandler::list_models(HttpServer::Transport& transport) const {
+  json data = json::array();
+  for (const auto& model : models_) {
+    data.push_back({{"id", model},
+                    {"object", "model"},
+                    {"created", created_},
+                    {"owned_by", "scalellm"}});
+  }
+  json response{{"object", "list"}, {"data", std::move(data)}};
+  return transport.send_string(dump(response), "application/json");
+}
+
+}  // namespace llm
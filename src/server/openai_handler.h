@@ -0,0 +1,81 @@
+#pragma once
+
+#include <absl/container/flat_hash_set.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chat_template/chat_template.h"
+#include "handlers/llm_handler.h"
+#include "handlers/sampling_params.h"
+#include "http_server.h"
+#include "request/output.h"
+#include "request/status.h"
+
+namespace llm {
+
+// a completion or chat request parsed from the json body
+struct OpenAIRequest {
+  std::string model;
+
+  // prompt of completion requests
+  std::string prompt;
+
+  // messages of chat requests
+  std::vector<Message> messages;
+
+  SamplingParams sampling_params;
+
+  Priority priority = Priority::NORMAL;
+
+  bool stream = false;
+
+  // whether to send usage statistics at the end of the stream
+  bool include_usage = false;
+};
+
+namespace detail {
+// parse the json body of requests, returns INVALID_ARGUMENT for bad requests
+Status parse_completion_request(const std::string& body,
+                                OpenAIRequest* request);
+
+Status parse_chat_request(const std::string& body, OpenAIRequest* request);
+
+int to_http_status_code(StatusCode code);
+
+// json body of error responses: {"error": {"message", "type", "code"}}
+std::string error_body(int status_code, const std::string& message);
+}  // namespace detail
+
+// a class to serve openai compatible completion and chat apis over http,
+// streaming responses are sent as server-sent events.
+// https://platform.openai.com/docs/api-reference
+class OpenAIHandler final {
+ public:
+  OpenAIHandler(LLMHandler* llm_handler,
+                const std::vector<std::string>& models);
+
+  // register /v1/completions, /v1/chat/completions and /v1/models.
+  // the handler should outlive the http server.
+  void register_uris(HttpServer* http_server);
+
+ private:
+  bool complete(HttpServer::Transport& transport);
+
+  bool chat(HttpServer::Transport& transport);
+
+  bool list_models(HttpServer::Transport& transport) const;
+
+  // llm handler
+  LLMHandler* llm_handler_;
+
+  std::vector<std::string> models_;
+
+  absl::flat_hash_set<std::string> model_set_;
+
+  // created time of models
+  int64_t created_ = 0;
+};
+
+}  // namespace llm
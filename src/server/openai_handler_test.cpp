@@ -0,0 +1,218 @@
+#include "openai_handler.h"
+
+#include <gtest/gtest.h>
+
+#include <nlohmann/json.hpp>
+#include <string>
+
+namespace llm {
+namespace {
+using json = nlohmann::json;
+
+TEST(OpenAIHandlerTest, CompletionRequest) {
+  const std::string body = R"({
+    "model": "llama",
+    "prompt": ["hello"],
+    "max_tokens": 32,
+    "n": 2,
+    "best_of": 3,
+    "echo": true,
+    "logprobs": 4,
+    "temperature": 0.5,
+    "top_p": 0.9,
+    "top_k": 40,
+    "min_p": 0.1,
+    "frequency_penalty": 0.2,
+    "presence_penalty": -0.3,
+    "repetition_penalty": 1.1,
+    "stop": "\n",
+    "stop_token_ids": [2, 3],
+    "logit_bias": {"7": 5.0, "11": -100},
+    "bad_words": ["foo", "bar"],
+    "ignore_eos": true,
+    "skip_special_tokens": false,
+    "priority": "HIGH",
+    "stream": false,
+    "stream_options": {"include_usage": true}
+  })";
+  OpenAIRequest request;
+  ASSERT_TRUE(detail::parse_completion_request(body, &request).ok());
+  EXPECT_EQ(request.model, "llama");
+  EXPECT_EQ(request.prompt, "hello");
+  EXPECT_EQ(request.priority, Priority::HIGH);
+  EXPECT_FALSE(request.stream);
+  EXPECT_TRUE(request.include_usage);
+
+  const auto& sp = request.sampling_params;
+  EXPECT_EQ(sp.max_tokens, 32);
+  EXPECT_EQ(sp.n, 2);
+  EXPECT_EQ(sp.best_of, 3);
+  EXPECT_TRUE(sp.echo);
+  EXPECT_TRUE(sp.logprobs);
+  EXPECT_EQ(sp.top_logprobs, 4);
+  EXPECT_FLOAT_EQ(sp.temperature, 0.5);
+  EXPECT_FLOAT_EQ(sp.top_p, 0.9);
+  EXPECT_EQ(sp.top_k, 40);
+  EXPECT_FLOAT_EQ(sp.min_p, 0.1);
+  EXPECT_FLOAT_EQ(sp.frequency_penalty, 0.2);
+  EXPECT_FLOAT_EQ(sp.presence_penalty, -0.3);
+  EXPECT_FLOAT_EQ(sp.repetition_penalty, 1.1);
+  EXPECT_EQ(sp.stop, std::vector<std::string>{"\n"});
+  EXPECT_EQ(sp.stop_token_ids, (std::vector<int32_t>{2, 3}));
+  ASSERT_TRUE(sp.logit_bias.has_value());
+  EXPECT_EQ(sp.logit_bias->size(), 2);
+  EXPECT_FLOAT_EQ(sp.logit_bias->at(7), 5.0);
+  EXPECT_FLOAT_EQ(sp.logit_bias->at(11), -100.0);
+  EXPECT_EQ(sp.bad_words, (std::vector<std::string>{"foo", "bar"}));
+  EXPECT_TRUE(sp.ignore_eos);
+  EXPECT_FALSE(sp.skip_special_tokens);
+}
+
+TEST(OpenAIHandlerTest, CompletionRequestDefaults) {
+  OpenAIRequest request;
+  ASSERT_TRUE(detail::parse_completion_request(
+                  R"({"model": "llama", "prompt": "hi", "top_p": null})",
+                  &request)
+                  .ok());
+  EXPECT_EQ(request.prompt, "hi");
+  EXPECT_EQ(request.priority, Priority::NORMAL);
+  EXPECT_FALSE(request.stream);
+  EXPECT_FALSE(request.include_usage);
+
+  const SamplingParams defaults;
+  const auto& sp = request.sampling_params;
+  EXPECT_EQ(sp.max_tokens, defaults.max_tokens);
+  EXPECT_EQ(sp.n, defaults.n);
+  EXPECT_FALSE(sp.best_of.has_value());
+  EXPECT_FALSE(sp.logprobs);
+  EXPECT_FLOAT_EQ(sp.temperature, defaults.temperature);
+  EXPECT_FLOAT_EQ(sp.top_p, defaults.top_p);
+  EXPECT_FALSE(sp.stop.has_value());
+  EXPECT_FALSE(sp.logit_bias.has_value());
+}
+
+TEST(OpenAIHandlerTest, ChatRequest) {
+  const std::string body = R"({
+    "model": "llama",
+    "messages": [
+      {"role": "system", "content": "be brief"},
+      {"role": "user", "content": "hello"}
+    ],
+    "logprobs": true,
+    "top_logprobs": 5,
+    "stop": ["a", "b"],
+    "priority": "low"
+  })";
+  OpenAIRequest request;
+  ASSERT_TRUE(detail::parse_chat_request(body, &request).ok());
+  EXPECT_EQ(request.model, "llama");
+  ASSERT_EQ(request.messages.size(), 2);
+  EXPECT_EQ(request.messages[0].role, "system");
+  EXPECT_EQ(request.messages[0].content, "be brief");
+  EXPECT_EQ(request.messages[1].role, "user");
+  EXPECT_EQ(request.messages[1].content, "hello");
+  EXPECT_EQ(request.priority, Priority::LOW);
+
+  const auto& sp = request.sampling_params;
+  EXPECT_TRUE(sp.logprobs);
+  EXPECT_EQ(sp.top_logprobs, 5);
+  EXPECT_EQ(sp.stop, (std::vector<std::string>{"a", "b"}));
+}
+
+TEST(OpenAIHandlerTest, StreamRequest) {
+  OpenAIRequest request;
+  ASSERT_TRUE(detail::parse_completion_request(
+                  R"({"model": "llama", "n": 2, "best_of": 2, "stream": true})",
+                  &request)
+                  .ok());
+  EXPECT_TRUE(request.stream);
+  EXPECT_EQ(request.sampling_params.best_of, 2);
+}
+
+TEST(OpenAIHandlerTest, ChatRequestContent) {
+  const std::string body = R"({
+    "model": "llama",
+    "messages": [
+      {"role": "user", "content": [
+        {"type": "text", "text": "hello"},
+        {"type": "text", "text": "world"}
+      ]},
+      {"role": "assistant", "content": null}
+    ]
+  })";
+  OpenAIRequest request;
+  ASSERT_TRUE(detail::parse_chat_request(body, &request).ok());
+  ASSERT_EQ(request.messages.size(), 2);
+  EXPECT_EQ(request.messages[0].content, "hello\nworld");
+  EXPECT_EQ(request.messages[1].role, "assistant");
+  EXPECT_EQ(request.messages[1].content, "");
+
+  // non-text parts are rejected with the part type
+  OpenAIRequest image_request;
+  const auto status = detail::parse_chat_request(
+      R"({"model": "llama", "messages": [{"role": "user", "content": [
+          {"type": "image_url", "image_url": {"url": "a.png"}}]}]})",
+      &image_request);
+  EXPECT_EQ(status.code(), StatusCode::INVALID_ARGUMENT);
+  EXPECT_EQ(status.message(), "Unsupported content part type: image_url");
+}
+
+TEST(OpenAIHandlerTest, InvalidRequest) {
+  const std::vector<std::string> completion_bodies = {
+      "",
+      "not json",
+      R"(["a json array"])",
+      R"({"model": "llama", "prompt": 1})",
+      R"({"model": "llama", "temperature": "hot"})",
+      R"({"model": "llama", "logit_bias": {"token": 1.0}})",
+      R"({"model": "llama", "stop_token_ids": ["a"]})",
+      // the best results can't be streamed
+      R"({"model": "llama", "n": 1, "best_of": 2, "stream": true})",
+  };
+  for (const auto& body : completion_bodies) {
+    OpenAIRequest request;
+    const auto status = detail::parse_completion_request(body, &request);
+    EXPECT_EQ(status.code(), StatusCode::INVALID_ARGUMENT) << body;
+    EXPECT_FALSE(status.message().empty()) << body;
+  }
+
+  const std::vector<std::string> chat_bodies = {
+      "{",
+      R"({"model": "llama", "messages": [{"role": "user"}]})",
+      R"({"model": "llama", "messages": [{"role": 1, "content": "hi"}]})",
+      R"({"model": "llama", "logprobs": 1})",
+      R"({"model": "llama", "messages": [{"role": "user", "content": 1}]})",
+  };
+  for (const auto& body : chat_bodies) {
+    OpenAIRequest request;
+    const auto status = detail::parse_chat_request(body, &request);
+    EXPECT_EQ(status.code(), StatusCode::INVALID_ARGUMENT) << body;
+  }
+}
+
+TEST(OpenAIHandlerTest, ErrorResponse) {
+  EXPECT_EQ(detail::to_http_status_code(StatusCode::OK), 200);
+  EXPECT_EQ(detail::to_http_status_code(StatusCode::INVALID_ARGUMENT), 400);
+  EXPECT_EQ(detail::to_http_status_code(StatusCode::UNAUTHENTICATED), 401);
+  EXPECT_EQ(detail::to_http_status_code(StatusCode::RESOURCE_EXHAUSTED), 429);
+  EXPECT_EQ(detail::to_http_status_code(StatusCode::UNIMPLEMENTED), 501);
+  EXPECT_EQ(detail::to_http_status_code(StatusCode::UNAVAILABLE), 503);
+  EXPECT_EQ(detail::to_http_status_code(StatusCode::DEADLINE_EXCEEDED), 504);
+  EXPECT_EQ(detail::to_http_status_code(StatusCode::UNKNOWN), 500);
+  EXPECT_EQ(detail::to_http_status_code(StatusCode::CANCELLED), 500);
+
+  const auto client_error =
+      json::parse(detail::error_body(400, "Invalid json body"));
+  EXPECT_EQ(client_error["error"]["message"], "Invalid json body");
+  EXPECT_EQ(client_error["error"]["type"], "invalid_request_error");
+  EXPECT_EQ(client_error["error"]["code"], 400);
+
+  // invalid utf-8 in the message is replaced instead of throwing
+  const auto server_error =
+      json::parse(detail::error_body(503, "overloaded \xff"));
+  EXPECT_EQ(server_error["error"]["type"], "internal_server_error");
+  EXPECT_EQ(server_error["error"]["code"], 503);
+}
+
+}  // namespace
+}  // namespace llm
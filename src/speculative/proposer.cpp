@@ -0,0 +1,198 @@
+#include "proposer.h"
+
+#include <glog/logging.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "common/tensor_helper.h"
+#include "engine/batch.h"
+#include "engine/llm_engine.h"
+#include "engine/parameters.h"
+#include "request/sequence.h"
+
+namespace llm {
+
+DraftModelProposer::DraftModelProposer(LLMEngine* draft_engine)
+    : draft_engine_(draft_engine) {
+  CHECK(draft_engine_ != nullptr);
+}
+
+Proposal DraftModelProposer::propose(Batch& batch,
+                                     const std::vector<uint32_t>& num_tokens) {
+  CHECK_EQ(num_tokens.size(), batch.size());
+  // rows of the proposal for sequences in decode stage
+  std::vector<Sequence*> sequences;
+  std::vector<uint32_t> num_draft_tokens;
+  uint32_t max_num_tokens = 0;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (num_tokens[i] > 0) {
+      sequences.push_back(batch[i]);
+      num_draft_tokens.push_back(num_tokens[i]);
+      max_num_tokens = std::max(max_num_tokens, num_tokens[i]);
+    }
+  }
+
+  // the following steps only run on sequences that need more draft tokens.
+  // build the batches before drafting since draft tokens may finish sequences.
+  std::vector<Batch> step_batches(max_num_tokens);
+  std::vector<std::vector<int64_t>> step_rows(max_num_tokens);
+  for (uint32_t step = 1; step < max_num_tokens; ++step) {
+    for (size_t r = 0; r < sequences.size(); ++r) {
+      if (num_draft_tokens[r] > step) {
+        step_batches[step].add(sequences[r]);
+        step_rows[step].push_back(static_cast<int64_t>(r));
+      }
+    }
+  }
+
+  // the first step runs on the whole batch to process the prefill tokens
+  batch.set_engine_type(EngineType::SSM);
+  auto output = draft_engine_->execute_model(batch);
+
+  Proposal proposal;
+  if (sequences.empty()) {
+    return proposal;
+  }
+
+  const auto& next_tokens = output.sample_output.next_tokens;
+  const auto& probs = output.sample_output.probs;
+  const int64_t num_seqs = static_cast<int64_t>(sequences.size());
+  proposal.draft_token_ids =
+      torch::zeros({num_seqs, max_num_tokens}, next_tokens.options());
+  proposal.draft_token_ids.select(/*dim=*/1, /*index=*/0).copy_(next_tokens);
+  if (probs.defined()) {
+    proposal.draft_probs = torch::zeros(
+        {num_seqs, max_num_tokens, probs.size(-1)}, probs.options());
+    proposal.draft_probs.select(/*dim=*/1, /*index=*/0).copy_(probs);
+  }
+
+  for (uint32_t step = 1; step < max_num_tokens; ++step) {
+    output = draft_engine_->execute_model(step_batches[step]);
+
+    const auto index = torch::tensor(step_rows[step], torch::kInt64)
+                           .to(proposal.draft_token_ids.device());
+    proposal.draft_token_ids.select(/*dim=*/1, step)
+        .index_copy_(/*dim=*/0, index, output.sample_output.next_tokens);
+    // probs are not computed for greedy sampling
+    const auto& step_probs = output.sample_output.probs;
+    if (proposal.draft_probs.defined() && step_probs.defined()) {
+      proposal.draft_probs.select(/*dim=*/1, step)
+          .index_copy_(/*dim=*/0, index, step_probs);
+    }
+  }
+  return proposal;
+}
+
+PromptLookupProposer::PromptLookupProposer(size_t max_ngram,
+                                           size_t num_branches)
+    : max_ngram_(max_ngram), num_branches_(num_branches) {
+  CHECK_GT(max_ngram, 0) << "max_ngram should be positive";
+  CHECK_GT(num_branches, 0) << "num_branches should be positive";
+}
+
+std::vector<int32_t> PromptLookupProposer::lookup(Sequence* sequence,
+                                                  size_t max_ngram,
+                                                  size_t num_tokens) {
+  std::vector<int32_t> parents;
+  return lookup_tree(
+      sequence, max_ngram, /*num_branches=*/1, num_tokens, &parents);
+}
+
+std::vector<int32_t> PromptLookupProposer::lookup_tree(
+    Sequence* sequence,
+    size_t max_ngram,
+    size_t num_branches,
+    size_t num_tokens,
+    std::vector<int32_t>* parents) {
+  const auto& index = sequence->ngram_index(max_ngram);
+  const auto token_ids = sequence->token_ids();
+  const auto starts =
+      index.find_all(token_ids, std::min(num_branches, num_tokens));
+
+  std::vector<int32_t> draft_token_ids;
+  draft_token_ids.reserve(num_tokens);
+  parents->clear();
+  parents->reserve(num_tokens);
+  if (starts.empty()) {
+    // no match, repeat the last token as a placeholder
+    for (size_t i = 0; i < num_tokens; ++i) {
+      draft_token_ids.push_back(token_ids.back());
+      parents->push_back(static_cast<int32_t>(i) - 1);
+    }
+    return draft_token_ids;
+  }
+
+  // split tokens evenly among branches, the most recent match gets the rest
+  const size_t depth = num_tokens / starts.size();
+  for (size_t b = 0; b < starts.size(); ++b) {
+    const size_t num_branch_tokens =
+        b == 0 ? num_tokens - depth * (starts.size() - 1) : depth;
+    const size_t offset = draft_token_ids.size();
+    for (size_t i = 0; i < num_branch_tokens; ++i) {
+      // copy the tokens following the match, which may run into the draft
+      // tokens themselves to extend periodic patterns
+      const size_t pos = starts[b] + i;
+      draft_token_ids.push_back(
+          pos < token_ids.size()
+              ? token_ids[pos]
+              : draft_token_ids[offset + pos - token_ids.size()]);
+      parents->push_back(i == 0 ? -1 : static_cast<int32_t>(offset + i - 1));
+    }
+  }
+  return draft_token_ids;
+}
+
+Proposal PromptLookupProposer::propose(
+    Batch& batch,
+    const std::vector<uint32_t>& num_tokens) {
+  CHECK_EQ(num_tokens.size(), batch.size());
+  // no draft kv cache, track the kv cache of the target model
+  batch.set_engine_type(EngineType::LLM);
+
+  const bool tree = num_branches_ > 1;
+  // [num_seqs, max_num_tokens]
+  std::vector<std::vector<int64_t>> draft_token_ids;
+  std::vector<std::vector<int64_t>> draft_parents;
+  size_t max_num_tokens = 0;
+  std::vector<int32_t> parents;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    // skip sequences that stay in prefill stage after this step
+    if (num_tokens[i] == 0) {
+      continue;
+    }
+
+    Sequence* sequence = batch[i];
+    const auto token_ids = lookup_tree(
+        sequence, max_ngram_, num_branches_, num_tokens[i], &parents);
+    if (tree) {
+      sequence->append_draft_tree(token_ids, parents);
+    } else {
+      for (const int32_t token_id : token_ids) {
+        sequence->append_draft_token(token_id);
+      }
+    }
+    draft_token_ids.emplace_back(token_ids.begin(), token_ids.end());
+    draft_parents.emplace_back(parents.begin(), parents.end());
+    max_num_tokens = std::max(max_num_tokens, token_ids.size());
+  }
+
+  Proposal proposal;
+  if (draft_token_ids.empty()) {
+    return proposal;
+  }
+  // pad the draft tokens to the same length
+  for (size_t i = 0; i < draft_token_ids.size(); ++i) {
+    draft_token_ids[i].resize(max_num_tokens, /*pad_value=*/0);
+    draft_parents[i].resize(max_num_tokens, /*pad_value=*/-2);
+  }
+  proposal.draft_token_ids = create_2d_tensor(draft_token_ids, torch::kInt64);
+  if (tree) {
+    proposal.parents = create_2d_tensor(draft_parents, torch::kInt64);
+  }
+  return proposal;
+}
+
+}  // namespace llm
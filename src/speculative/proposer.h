@@ -0,0 +1,90 @@
+#pragma once
+
+#include <torch/torch.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "engine/batch.h"
+#include "engine/llm_engine.h"
+#include "engine/parameters.h"
+#include "request/sequence.h"
+
+namespace llm {
+
+// draft tokens proposed for the sequences in decode stage, padded to the max
+// number of draft tokens in the batch.
+struct Proposal {
+  // [num_seqs, max_num_tokens] LongTensor
+  torch::Tensor draft_token_ids;
+
+  // [num_seqs, max_num_tokens, vocab_size] FloatTensor, undefined for
+  // deterministic proposals, which are treated as one-hot distributions.
+  torch::Tensor draft_probs;
+
+  // [num_seqs, max_num_tokens] LongTensor, parent of each draft token in the
+  // token tree, -1 for children of the root and -2 for padding. undefined for
+  // chains of draft tokens.
+  torch::Tensor parents;
+};
+
+// Proposer generates draft tokens for speculative decoding. The draft tokens
+// are appended to the sequences in the batch, and then verified by the target
+// model with the rejection sampler.
+class Proposer {
+ public:
+  virtual ~Proposer() = default;
+
+  // propose num_tokens[i] draft tokens for the i-th sequence in the batch.
+  // sequences with zero draft tokens stay in prefill stage after this step.
+  virtual Proposal propose(Batch& batch,
+                           const std::vector<uint32_t>& num_tokens) = 0;
+};
+
+// propose draft tokens by running a smaller draft model autoregressively.
+class DraftModelProposer final : public Proposer {
+ public:
+  explicit DraftModelProposer(LLMEngine* draft_engine);
+
+  Proposal propose(Batch& batch,
+                   const std::vector<uint32_t>& num_tokens) override;
+
+ private:
+  // not owned
+  LLMEngine* draft_engine_ = nullptr;
+};
+
+// propose draft tokens without a draft model by matching the last n tokens
+// against the prompt and earlier outputs (prompt lookup decoding), and copying
+// the tokens following the most recent match. with multiple branches, the
+// continuations of several matches are proposed as a token tree.
+class PromptLookupProposer final : public Proposer {
+ public:
+  PromptLookupProposer(size_t max_ngram, size_t num_branches = 1);
+
+  Proposal propose(Batch& batch,
+                   const std::vector<uint32_t>& num_tokens) override;
+
+  // lookup num_tokens draft tokens for the sequence
+  static std::vector<int32_t> lookup(Sequence* sequence,
+                                     size_t max_ngram,
+                                     size_t num_tokens);
+
+  // lookup a token tree of num_tokens nodes with up to num_branches branches
+  // from the root, one for each match. returns tokens in depth-first order
+  // and the parent of each node, -1 for children of the root.
+  static std::vector<int32_t> lookup_tree(Sequence* sequence,
+                                          size_t max_ngram,
+                                          size_t num_branches,
+                                          size_t num_tokens,
+                                          std::vector<int32_t>* parents);
+
+ private:
+  // max n-gram size to match
+  size_t max_ngram_ = 0;
+
+  // max number of branches in the token tree, 1 for a chain
+  size_t num_branches_ = 1;
+};
+
+}  // namespace llm
@@ -0,0 +1,128 @@
+#include "proposer.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "request/sequence.h"
+
+namespace llm {
+
+TEST(PromptLookupProposerTest, Lookup) {
+  Sequence::Options options;
+  // prompt: a b c d a b
+  Sequence sequence({1, 2, 3, 4, 1, 2}, /*capacity=*/20, options);
+
+  // [1, 2] matches at the beginning, copy the following tokens
+  EXPECT_EQ(PromptLookupProposer::lookup(
+                &sequence, /*max_ngram=*/3, /*num_tokens=*/2),
+            std::vector<int32_t>({3, 4}));
+
+  // the copy runs into the draft tokens for periodic patterns
+  EXPECT_EQ(PromptLookupProposer::lookup(
+                &sequence, /*max_ngram=*/3, /*num_tokens=*/6),
+            std::vector<int32_t>({3, 4, 1, 2, 3, 4}));
+
+  // repeat the last token if no match
+  Sequence no_match({1, 2, 3}, /*capacity=*/20, options);
+  EXPECT_EQ(PromptLookupProposer::lookup(
+                &no_match, /*max_ngram=*/3, /*num_tokens=*/3),
+            std::vector<int32_t>({3, 3, 3}));
+}
+
+TEST(PromptLookupProposerTest, ValidateDraftTokens) {
+  Sequence::Options options;
+  Sequence sequence({1, 2, 3, 4, 1, 2}, /*capacity=*/20, options);
+  sequence.set_engine_type(EngineType::LLM);
+  sequence.append_block({/*id=*/0, /*size=*/20});
+
+  const auto draft_token_ids = PromptLookupProposer::lookup(
+      &sequence, /*max_ngram=*/2, /*num_tokens=*/3);
+  EXPECT_EQ(draft_token_ids, std::vector<int32_t>({3, 4, 1}));
+  for (const auto token_id : draft_token_ids) {
+    sequence.append_draft_token(token_id);
+  }
+  // target model processes the prompt and draft tokens
+  sequence.commit_kv_cache(sequence.num_tokens_to_process());
+  // bonus token
+  sequence.append_token(7);
+
+  // accept the first draft token and reject the rest
+  const auto num_accepted = sequence.validate_tokens({3, 5, -1, -1});
+  EXPECT_EQ(num_accepted, 2);
+  EXPECT_EQ(sequence.token_ids(),
+            std::vector<int32_t>({1, 2, 3, 4, 1, 2, 3, 5}));
+
+  // the index is kept in sync with the accepted tokens
+  const auto& index = sequence.ngram_index(/*max_ngram=*/2);
+  EXPECT_EQ(index.num_tokens(), sequence.num_tokens());
+  EXPECT_FALSE(index.find(sequence.token_ids()).has_value());
+}
+
+TEST(PromptLookupProposerTest, LookupTree) {
+  Sequence::Options options;
+  Sequence sequence({1, 2, 3, 9, 2, 3, 8, 2, 3}, /*capacity=*/20, options);
+
+  // [2, 3] is followed by 8 and 9, the most recent match gets more tokens
+  std::vector<int32_t> parents;
+  EXPECT_EQ(PromptLookupProposer::lookup_tree(&sequence,
+                                              /*max_ngram=*/3,
+                                              /*num_branches=*/2,
+                                              /*num_tokens=*/5,
+                                              &parents),
+            std::vector<int32_t>({8, 2, 3, 9, 2}));
+  EXPECT_EQ(parents, std::vector<int32_t>({-1, 0, 1, -1, 3}));
+
+  // one branch is a chain
+  EXPECT_EQ(PromptLookupProposer::lookup_tree(&sequence,
+                                              /*max_ngram=*/3,
+                                              /*num_branches=*/1,
+                                              /*num_tokens=*/3,
+                                              &parents),
+            std::vector<int32_t>({8, 2, 3}));
+  EXPECT_EQ(parents, std::vector<int32_t>({-1, 0, 1}));
+}
+
+TEST(PromptLookupProposerTest, ValidateDraftTree) {
+  Sequence::Options options;
+  const std::vector<int32_t> prompt = {1, 2, 3, 9, 2, 3, 8, 2, 3};
+  for (const bool first_branch : {true, false}) {
+    Sequence sequence(prompt, /*capacity=*/20, options);
+    sequence.set_engine_type(EngineType::LLM);
+    sequence.append_block({/*id=*/0, /*size=*/20});
+
+    std::vector<int32_t> parents;
+    const auto draft_token_ids =
+        PromptLookupProposer::lookup_tree(&sequence,
+                                          /*max_ngram=*/3,
+                                          /*num_branches=*/2,
+                                          /*num_tokens=*/4,
+                                          &parents);
+    EXPECT_EQ(draft_token_ids, std::vector<int32_t>({8, 2, 9, 2}));
+    sequence.append_draft_tree(draft_token_ids, parents);
+    EXPECT_EQ(sequence.draft_tree_start(), prompt.size());
+    // target model processes the prompt and the tree
+    sequence.commit_kv_cache(sequence.num_tokens_to_process());
+    // bonus token
+    sequence.append_token(7);
+
+    const std::vector<int32_t> path =
+        first_branch ? std::vector<int32_t>{0, 1} : std::vector<int32_t>{2};
+    const std::vector<int64_t> tokens = first_branch
+                                            ? std::vector<int64_t>{8, 2, 5}
+                                            : std::vector<int64_t>{9, 5};
+    std::vector<Token> accepted_tokens(tokens.begin(), tokens.end());
+    EXPECT_EQ(sequence.validate_tree_tokens(path, accepted_tokens),
+              tokens.size());
+    EXPECT_TRUE(sequence.draft_tree_parents().empty());
+
+    std::vector<int32_t> desired_tokens = prompt;
+    desired_tokens.insert(desired_tokens.end(), tokens.begin(), tokens.end());
+    EXPECT_EQ(sequence.token_ids(), desired_tokens);
+    // kv cache of the first branch is in place, others are discarded
+    EXPECT_EQ(sequence.num_kv_cache_tokens(EngineType::LLM),
+              prompt.size() + (first_branch ? 2 : 0));
+  }
+}
+
+}  // namespace llm
@@ -5,6 +5,11 @@
 #include <glog/logging.h>
 #include <torch/torch.h>
 
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
 #include "sampling/sampler.h"
 
 namespace llm {
@@ -17,6 +22,49 @@ torch::Tensor index_select_2d(const torch::Tensor& input,
   return input.gather(dim, index.unsqueeze(dim)).squeeze(dim);
 }
 
+// sample from a host distribution with a uniform random number in [0, 1)
+int64_t sample_from(const std::vector<float>& probs, float uniform_rand) {
+  const float sum = std::accumulate(probs.begin(), probs.end(), 0.0f);
+  const float target = uniform_rand * sum;
+  float cumsum = 0.0f;
+  int64_t last = 0;
+  for (size_t i = 0; i < probs.size(); ++i) {
+    if (probs[i] <= 0.0f) {
+      continue;
+    }
+    cumsum += probs[i];
+    last = static_cast<int64_t>(i);
+    if (target < cumsum) {
+      break;
+    }
+  }
+  // rounding may leave target beyond the sum, take the last candidate
+  return last;
+}
+
+// reject the padded draft tokens beyond num_draft_tokens
+torch::Tensor mask_padded_tokens(const torch::Tensor& accepted,
+                                 const torch::Tensor& num_draft_tokens) {
+  if (!num_draft_tokens.defined()) {
+    return accepted;
+  }
+  const auto indices =
+      torch::arange(accepted.size(1), accepted.device()).unsqueeze(/*dim=*/0);
+  return accepted & (indices < num_draft_tokens.unsqueeze(/*dim=*/1));
+}
+
+// place the bonus token right after the valid draft tokens
+torch::Tensor place_bonus_tokens(const torch::Tensor& token_ids,
+                                 const torch::Tensor& bonus_token_ids,
+                                 const torch::Tensor& num_draft_tokens) {
+  auto combined = torch::cat({token_ids, bonus_token_ids}, /*dim=*/-1);
+  if (num_draft_tokens.defined()) {
+    combined.scatter_(
+        /*dim=*/1, num_draft_tokens.unsqueeze(/*dim=*/1), bonus_token_ids);
+  }
+  return combined;
+}
+
 }  // namespace
 
 RejectionSampler::RejectionSampler(const torch::Tensor& do_sample,
@@ -38,10 +86,13 @@ SampleOutput RejectionSampler::forward(const torch::Tensor& draft_token_ids,
                                        const torch::Tensor& draft_probs,
                                        const torch::Tensor& target_logits,
                                        const torch::Tensor& bonus_token_ids,
-                                       bool mask_out_rejected_tokens) const {
+                                       bool mask_out_rejected_tokens,
+                                       const torch::Tensor& num_draft_tokens)
+    const {
   CHECK_EQ(draft_token_ids.size(0), do_sample_.size(0))
       << "batch size mismatch";
-  DCHECK_EQ(draft_token_ids.size(1), draft_probs.size(1));
+  DCHECK(!draft_probs.defined() ||
+         draft_token_ids.size(1) == draft_probs.size(1));
   // DCHECK_EQ(draft_probs.sizes(), target_probs.sizes());
 
   // [batch_size, n_speculative_tokens + 1, vocab_size] FloatTensor
@@ -51,6 +102,14 @@ SampleOutput RejectionSampler::forward(const torch::Tensor& draft_token_ids,
   target_probs = target_probs.slice(
       /*dim=*/1, /*start=*/0, /*end=*/target_probs.size(1) - 1);
 
+  // draft tokens without probs are deterministic proposals, e.g. prompt
+  // lookup or greedy draft sampling, which are one-hot distributions
+  auto draft_dist = draft_probs;
+  if (!draft_dist.defined() && !all_greedy_sample_) {
+    draft_dist = torch::one_hot(draft_token_ids, target_logits.size(-1))
+                     .to(target_probs.dtype());
+  }
+
   // [batch_size, n_speculative_tokens + 1]
   torch::Tensor accepted_token_ids;
   torch::Tensor masked_accepted_token_ids;
@@ -59,31 +118,35 @@ SampleOutput RejectionSampler::forward(const torch::Tensor& draft_token_ids,
         greedy_sample(draft_token_ids,
                       target_probs,
                       bonus_token_ids,
-                      mask_out_rejected_tokens);
+                      mask_out_rejected_tokens,
+                      num_draft_tokens);
   } else if (all_random_sample_) {
     auto uniform_rand =
-        torch::rand(draft_token_ids.sizes(), draft_probs.options());
+        torch::rand(draft_token_ids.sizes(), draft_dist.options());
     std::tie(accepted_token_ids, masked_accepted_token_ids) =
         random_sample(draft_token_ids,
-                      draft_probs,
+                      draft_dist,
                       target_probs,
                       uniform_rand,
                       bonus_token_ids,
-                      mask_out_rejected_tokens);
+                      mask_out_rejected_tokens,
+                      num_draft_tokens);
   } else {
     auto uniform_rand =
-        torch::rand(draft_token_ids.sizes(), draft_probs.options());
+        torch::rand(draft_token_ids.sizes(), draft_dist.options());
     // mixed sample, sample both then choose based on do_sample_
     auto [random, masked_random] = random_sample(draft_token_ids,
-                                                 draft_probs,
+                                                 draft_dist,
                                                  target_probs,
                                                  uniform_rand,
                                                  bonus_token_ids,
-                                                 mask_out_rejected_tokens);
+                                                 mask_out_rejected_tokens,
+                                                 num_draft_tokens);
     auto [greedy, masked_greedy] = greedy_sample(draft_token_ids,
                                                  target_probs,
                                                  bonus_token_ids,
-                                                 mask_out_rejected_tokens);
+                                                 mask_out_rejected_tokens,
+                                                 num_draft_tokens);
     accepted_token_ids = torch::where(do_sample_, random, greedy);
     if (mask_out_rejected_tokens) {
       masked_accepted_token_ids =
@@ -117,6 +180,191 @@ SampleOutput RejectionSampler::forward(const torch::Tensor& draft_token_ids,
   return output;
 }
 
+std::tuple<SampleOutput, torch::Tensor> RejectionSampler::forward_tree(
+    const torch::Tensor& draft_token_ids,
+    const torch::Tensor& draft_probs,
+    const torch::Tensor& parents,
+    const torch::Tensor& target_logits) const {
+  CHECK_EQ(draft_token_ids.size(0), do_sample_.size(0))
+      << "batch size mismatch";
+  CHECK(draft_token_ids.sizes() == parents.sizes());
+  CHECK_EQ(target_logits.size(1), draft_token_ids.size(1) + 1);
+
+  // [batch_size, n_nodes + 1, vocab_size] FloatTensor
+  const auto target_probs =
+      torch::softmax(target_logits, /*dim=*/-1, /*dtype=*/torch::kFloat32);
+  auto [accepted_token_ids, accepted_path] =
+      tree_sample(draft_token_ids,
+                  all_greedy_sample_ ? torch::Tensor() : draft_probs,
+                  parents,
+                  target_probs,
+                  do_sample_.squeeze(/*dim=*/-1));
+
+  SampleOutput output;
+  output.next_tokens = accepted_token_ids.to(target_logits.device());
+
+  if (logprobs_) {
+    // the logits row where each accepted token is sampled from, the root
+    // for the first token and the previous node for the others
+    const auto path = accepted_path.to(target_logits.device());
+    auto rows = torch::cat(
+        {torch::zeros({path.size(0), 1}, path.options()), path + 1},
+        /*dim=*/-1);
+    rows.clamp_min_(0);
+    // [batch_size, n_nodes + 1, vocab_size]
+    const auto target_logprobs = torch::log_softmax(
+        target_logits, /*dim=*/-1, /*dtype=*/torch::kFloat32);
+    // [batch_size, n_nodes + 1, vocab_size]
+    const auto path_logprobs = target_logprobs.gather(
+        /*dim=*/1, rows.unsqueeze(-1).expand_as(target_logprobs));
+    output.logprobs = index_select_2d(
+        path_logprobs, /*dim=*/-1, output.next_tokens.clamp_min(0));
+
+    if (max_top_logprobs_ > 0) {
+      auto [values, indices] =
+          path_logprobs.topk(max_top_logprobs_, /*dim=*/-1);
+      output.top_logprobs = values;
+      output.top_tokens = indices;
+    }
+  }
+  return {output, accepted_path.to(target_logits.device())};
+}
+
+std::tuple<torch::Tensor, torch::Tensor> RejectionSampler::tree_sample(
+    const torch::Tensor& draft_token_ids,
+    const torch::Tensor& draft_probs,
+    const torch::Tensor& parents,
+    const torch::Tensor& target_probs,
+    const torch::Tensor& do_sample) {
+  const int64_t batch_size = draft_token_ids.size(0);
+  const int64_t n_nodes = draft_token_ids.size(1);
+
+  // walking the trees is sequential, do it on cpu
+  const auto token_ids_cpu = draft_token_ids.to(torch::kCPU, torch::kInt64);
+  const auto parents_cpu = parents.to(torch::kCPU, torch::kInt64);
+  const auto do_sample_cpu = do_sample.to(torch::kCPU, torch::kBool);
+  const bool has_random = do_sample_cpu.any().item<bool>();
+  // [batch_size, n_nodes + 1]
+  const auto greedy_cpu =
+      target_probs.argmax(/*dim=*/-1).to(torch::kCPU, torch::kInt64);
+  // copy the probabilities to host once, the walk below reads plain memory
+  const int64_t vocab_size = target_probs.size(-1);
+  torch::Tensor target_probs_cpu;
+  torch::Tensor draft_probs_cpu;
+  torch::Tensor uniform_rand;
+  torch::Tensor residual_rand;
+  const float* target_data = nullptr;
+  const float* draft_data = nullptr;
+  const float* uniform_data = nullptr;
+  const float* residual_data = nullptr;
+  if (has_random) {
+    target_probs_cpu =
+        target_probs.to(torch::kCPU, torch::kFloat32).contiguous();
+    target_data = target_probs_cpu.data_ptr<float>();
+    if (draft_probs.defined()) {
+      draft_probs_cpu =
+          draft_probs.to(torch::kCPU, torch::kFloat32).contiguous();
+      draft_data = draft_probs_cpu.data_ptr<float>();
+    }
+    uniform_rand = torch::rand({batch_size, n_nodes});
+    uniform_data = uniform_rand.data_ptr<float>();
+    // for sampling from the residual distribution at each row
+    residual_rand = torch::rand({batch_size, n_nodes + 1});
+    residual_data = residual_rand.data_ptr<float>();
+  }
+
+  const auto token_ids = token_ids_cpu.accessor<int64_t, 2>();
+  const auto parent_ids = parents_cpu.accessor<int64_t, 2>();
+  const auto sample = do_sample_cpu.accessor<bool, 1>();
+  const auto greedy = greedy_cpu.accessor<int64_t, 2>();
+  auto accepted_token_ids =
+      torch::full({batch_size, n_nodes + 1}, -1, torch::kInt64);
+  auto accepted_path = torch::full({batch_size, n_nodes}, -1, torch::kInt64);
+  auto accepted = accepted_token_ids.accessor<int64_t, 2>();
+  auto path = accepted_path.accessor<int64_t, 2>();
+
+  std::vector<std::vector<int64_t>> children(n_nodes + 1);
+  std::vector<float> probs;
+  for (int64_t b = 0; b < batch_size; ++b) {
+    // children of each node, index 0 for the root
+    for (auto& nodes : children) {
+      nodes.clear();
+    }
+    for (int64_t i = 0; i < n_nodes; ++i) {
+      const int64_t parent = parent_ids[b][i];
+      if (parent >= -1) {
+        CHECK_LT(parent, i) << "parents should come before children";
+        children[parent + 1].push_back(i);
+      }
+    }
+
+    const bool random = sample[b];
+    int64_t depth = 0;
+    // the root is at row 0 and node i at row i + 1
+    int64_t row = 0;
+    while (true) {
+      const auto& nodes = children[row];
+      int64_t next_node = -1;
+      int64_t token_id = -1;
+      if (!random) {
+        // accept the child matching the target token
+        token_id = greedy[b][row];
+        for (const int64_t node : nodes) {
+          if (token_ids[b][node] == token_id) {
+            next_node = node;
+            break;
+          }
+        }
+      } else {
+        const float* p = target_data + (b * (n_nodes + 1) + row) * vocab_size;
+        probs.assign(p, p + vocab_size);
+        for (const int64_t node : nodes) {
+          const int64_t draft_token_id = token_ids[b][node];
+          // without draft probabilities the draft token has probability 1
+          const float* q = draft_data == nullptr
+                               ? nullptr
+                               : draft_data + (b * n_nodes + node) * vocab_size;
+          const float p_x = probs[draft_token_id];
+          const float q_x = q == nullptr ? 1.0f : q[draft_token_id];
+          // accept with probability min(1, p(x) / q(x))
+          if (uniform_data[b * n_nodes + node] * q_x < p_x) {
+            next_node = node;
+            token_id = draft_token_id;
+            break;
+          }
+          // continue with the residual distribution
+          if (q == nullptr) {
+            probs[draft_token_id] = 0.0f;
+          } else {
+            for (int64_t v = 0; v < vocab_size; ++v) {
+              probs[v] = std::max(probs[v] - q[v], 0.0f);
+            }
+          }
+          const float sum = std::accumulate(probs.begin(), probs.end(), 0.0f);
+          const float scale = 1.0f / std::max(sum, 1e-6f);
+          for (auto& prob : probs) {
+            prob *= scale;
+          }
+        }
+        if (next_node < 0) {
+          // all children are rejected, or no child: sample from the residual
+          token_id =
+              sample_from(probs, residual_data[b * (n_nodes + 1) + row]);
+        }
+      }
+
+      accepted[b][depth] = token_id;
+      if (next_node < 0) {
+        break;
+      }
+      path[b][depth] = next_node;
+      ++depth;
+      row = next_node + 1;
+    }
+  }
+  return {accepted_token_ids, accepted_path};
+}
+
 // build mask from accepted matrix
 // for example: [[1, 1, 0, 1],   ->   [[1, 1, 1, 0, 0],
 //               [1, 0, 0, 0]]         [1, 1, 0, 0, 0]]
@@ -148,7 +396,8 @@ std::tuple<torch::Tensor, torch::Tensor> RejectionSampler::random_sample(
     const torch::Tensor& target_probs,
     const torch::Tensor& uniform_rand,
     const torch::Tensor& bonus_token_ids,
-    bool mask_out_rejected_tokens) {
+    bool mask_out_rejected_tokens,
+    const torch::Tensor& num_draft_tokens) {
   auto selected_draft_probs =
       index_select_2d(draft_probs, /*dim=*/-1, draft_token_ids);
   auto selected_target_probs =
@@ -156,7 +405,8 @@ std::tuple<torch::Tensor, torch::Tensor> RejectionSampler::random_sample(
 
   // std::min(probs, 1.0) element-wise
   auto acceptance_probs = (selected_target_probs / selected_draft_probs);
-  auto accepted = (uniform_rand < acceptance_probs);
+  auto accepted = mask_padded_tokens(uniform_rand < acceptance_probs,
+                                     num_draft_tokens);
 
   // construct recovered probs
   auto recovered_probs = (target_probs - draft_probs).clamp_min_(0);
@@ -170,7 +420,8 @@ std::tuple<torch::Tensor, torch::Tensor> RejectionSampler::random_sample(
 
   auto combined = torch::where(accepted, draft_token_ids, recovered_token_ids);
   // [batch_size, n_speculative_tokens + 1]
-  auto accepted_token_ids = torch::cat({combined, bonus_token_ids}, /*dim=*/-1);
+  auto accepted_token_ids =
+      place_bonus_tokens(combined, bonus_token_ids, num_draft_tokens);
   torch::Tensor masked_accepted_token_ids;
   if (mask_out_rejected_tokens) {
     // build the mask for the first rejected token
@@ -188,17 +439,19 @@ std::tuple<torch::Tensor, torch::Tensor> RejectionSampler::greedy_sample(
     const torch::Tensor& draft_token_ids,
     const torch::Tensor& target_probs,
     const torch::Tensor& bonus_token_ids,
-    bool mask_out_rejected_tokens) {
+    bool mask_out_rejected_tokens,
+    const torch::Tensor& num_draft_tokens) {
   auto target_token_ids = Sampler::greedy_sample(target_probs);
 
   // mask out the rejected tokens with -1
   // [batch_size, n_speculative_tokens + 1]
   auto accepted_token_ids =
-      torch::cat({target_token_ids, bonus_token_ids}, /*dim=*/-1);
+      place_bonus_tokens(target_token_ids, bonus_token_ids, num_draft_tokens);
   torch::Tensor masked_accepted_token_ids;
   if (mask_out_rejected_tokens) {
     // [batch_size, n_speculative_tokens + 1]
-    auto accepted = (target_token_ids == draft_token_ids);
+    auto accepted = mask_padded_tokens(target_token_ids == draft_token_ids,
+                                       num_draft_tokens);
     auto accepted_mask = build_accepted_mask(accepted);
     // mask out the rejected tokens with -1
     masked_accepted_token_ids =
@@ -20,14 +20,35 @@ class RejectionSampler final {
 
   // Sample tokens ids using rejection sampling.
   // draft_token_ids: [batch_size, n_speculative_tokens]
-  // draft_probs: [batch_size, n_speculative_tokens, vocab_size]
+  // draft_probs: [batch_size, n_speculative_tokens, vocab_size], undefined
+  // for deterministic proposals
   // target_logits: [batch_size, n_speculative_tokens + 1, vocab_size]
   // bonus_token_ids: [batch_size, 1]
+  // num_draft_tokens: [batch_size] LongTensor, the number of valid draft
+  // tokens for each sequence, undefined if all draft tokens are valid. the
+  // bonus token is placed right after the valid draft tokens.
   SampleOutput forward(const torch::Tensor& draft_token_ids,
                        const torch::Tensor& draft_probs,
                        const torch::Tensor& target_logits,
                        const torch::Tensor& bonus_token_ids,
-                       bool mask_out_rejected_tokens = false) const;
+                       bool mask_out_rejected_tokens = false,
+                       const torch::Tensor& num_draft_tokens = {}) const;
+
+  // Verify token trees and select the longest accepted path for each sequence.
+  // draft_token_ids: [batch_size, n_nodes] tree nodes in depth-first order
+  // draft_probs: [batch_size, n_nodes, vocab_size], the distribution each
+  // node was sampled from, undefined for deterministic proposals
+  // parents: [batch_size, n_nodes] parent of each node, -1 for children of
+  // the root and -2 for padded nodes
+  // target_logits: [batch_size, n_nodes + 1, vocab_size], the root followed
+  // by tree nodes
+  // returns accepted tokens [batch_size, n_nodes + 1] padded with -1, and the
+  // accepted path of node indices [batch_size, n_nodes] padded with -1.
+  std::tuple<SampleOutput, torch::Tensor> forward_tree(
+      const torch::Tensor& draft_token_ids,
+      const torch::Tensor& draft_probs,
+      const torch::Tensor& parents,
+      const torch::Tensor& target_logits) const;
 
   // build mask from accepted matrix
   // for example: [[1, 1, 0, 1],   ->   [[1, 1, 1, 0, 0],
@@ -40,13 +61,26 @@ class RejectionSampler final {
       const torch::Tensor& target_probs,
       const torch::Tensor& uniform_rand,
       const torch::Tensor& bonus_token_ids,
-      bool mask_out_rejected_tokens);
+      bool mask_out_rejected_tokens,
+      const torch::Tensor& num_draft_tokens = {});
+
+  // walk down the trees from the roots, accepting one child at each level.
+  // for random sampling, children are tried in order with the rejection rule
+  // and the target distribution is updated to the residual after each
+  // rejection. returns accepted tokens and the accepted path.
+  static std::tuple<torch::Tensor, torch::Tensor> tree_sample(
+      const torch::Tensor& draft_token_ids,
+      const torch::Tensor& draft_probs,
+      const torch::Tensor& parents,
+      const torch::Tensor& target_probs,
+      const torch::Tensor& do_sample);
 
   static std::tuple<torch::Tensor, torch::Tensor> greedy_sample(
       const torch::Tensor& draft_token_ids,
       const torch::Tensor& target_probs,
       const torch::Tensor& bonus_token_ids,
-      bool mask_out_rejected_tokens);
+      bool mask_out_rejected_tokens,
+      const torch::Tensor& num_draft_tokens = {});
 
  private:
   // whether to return logprobs
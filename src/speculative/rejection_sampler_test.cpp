@@ -127,6 +127,68 @@ TEST(RejectionSamplerTest, Greedy) {
                               bonus_token_ids));
 }
 
+TEST(RejectionSamplerTest, VariableDraftTokens) {
+  torch::Device device(torch::kCPU);
+  const auto options = torch::dtype(torch::kInt64).device(device);
+  const int64_t vocab_size = 5;
+
+  // the second sequence has only one draft token, padded with 0
+  const auto draft_token_ids = torch::tensor({{1, 2, 3}, {1, 0, 0}}, options);
+  const auto num_draft_tokens = torch::tensor({3, 1}, options);
+  // target tokens: [[1, 2, 3], [1, 4, 4]]
+  const auto target_probs =
+      torch::one_hot(torch::tensor({{1, 2, 3}, {1, 4, 4}}, options),
+                     vocab_size)
+          .to(torch::kFloat32);
+  const auto bonus_token_ids = torch::tensor({{4}, {2}}, options);
+
+  auto [output, masked_output] =
+      RejectionSampler::greedy_sample(draft_token_ids,
+                                      target_probs,
+                                      bonus_token_ids,
+                                      /*mask_out_rejected_tokens=*/true,
+                                      num_draft_tokens);
+  // bonus token is placed right after the valid draft tokens
+  const auto desired_masked_output =
+      torch::tensor({{1, 2, 3, 4}, {1, 2, -1, -1}}, options);
+  EXPECT_TRUE(torch::equal(masked_output, desired_masked_output));
+}
+
+TEST(RejectionSamplerTest, TreeSample) {
+  torch::Device device(torch::kCPU);
+  const auto options = torch::dtype(torch::kInt64).device(device);
+  const int64_t vocab_size = 10;
+
+  // tree: root -> {5 -> 6, 7 -> 8}, the second sequence has padded nodes
+  const auto draft_token_ids =
+      torch::tensor({{5, 6, 7, 8}, {5, 6, 0, 0}}, options);
+  const auto parents =
+      torch::tensor({{-1, 0, -1, 2}, {-1, 0, -2, -2}}, options);
+  // target tokens for the root and each node
+  const auto target_probs =
+      torch::one_hot(
+          torch::tensor({{7, 1, 1, 8, 9}, {5, 3, 1, 1, 1}}, options),
+          vocab_size)
+          .to(torch::kFloat32);
+
+  // deterministic target distributions give the same result for both
+  for (const bool do_sample : {false, true}) {
+    auto [token_ids, path] = RejectionSampler::tree_sample(
+        draft_token_ids,
+        /*draft_probs=*/torch::Tensor(),
+        parents,
+        target_probs,
+        torch::tensor({do_sample, do_sample}, device));
+    // accept the second branch: 7 -> 8, then the bonus token 9
+    const auto desired_token_ids =
+        torch::tensor({{7, 8, 9, -1, -1}, {5, 3, -1, -1, -1}}, options);
+    const auto desired_path =
+        torch::tensor({{2, 3, -1, -1}, {0, -1, -1, -1}}, options);
+    EXPECT_TRUE(torch::equal(token_ids, desired_token_ids));
+    EXPECT_TRUE(torch::equal(path, desired_path));
+  }
+}
+
 TEST(RejectionSamplerTest, LogProbs) {
   torch::ScalarType dtype(torch::kFloat32);
   torch::Device device(torch::kCPU);
@@ -228,4 +290,43 @@ TEST(RejectionSamplerTest, Random) {
                               /*atol=*/1e-3));
 }
 
+TEST(RejectionSamplerTest, TreeRandom) {
+  torch::ScalarType dtype(torch::kFloat32);
+  torch::Device device(torch::kCPU);
+  const auto options = torch::dtype(dtype).device(device);
+
+  // set random seed
+  torch::manual_seed(100);
+
+  const int64_t vocab_size = 50;
+  const int64_t num_samples = 200000;
+
+  // two children of the root drawn independently from the same draft
+  auto target_prob = torch::randn({vocab_size}, options).softmax(/*dim=*/-1);
+  auto target_probs =
+      target_prob.reshape({1, 1, -1}).repeat({num_samples, 3, 1});
+  auto draft_prob = torch::randn({vocab_size}, options).softmax(/*dim=*/-1);
+  auto draft_probs = draft_prob.reshape({1, 1, -1}).repeat({num_samples, 2, 1});
+  auto draft_token_ids = Sampler::random_sample(draft_probs);
+  auto parents = torch::full({num_samples, 2}, -1, torch::kInt64);
+
+  auto [token_ids, path] = RejectionSampler::tree_sample(
+      draft_token_ids,
+      draft_probs,
+      parents,
+      target_probs,
+      torch::ones({num_samples}, torch::dtype(torch::kBool)));
+
+  // the first token follows the target distribution
+  auto first_token_ids = token_ids.select(/*dim=*/1, /*index=*/0);
+  auto bincount = first_token_ids.bincount(/*weights=*/torch::nullopt,
+                                           /*minlength=*/vocab_size);
+  auto sample_prob = bincount.to(torch::kFloat) / num_samples;
+
+  EXPECT_TRUE(torch::allclose(target_prob,
+                              sample_prob,
+                              /*rtol=*/1e-2,
+                              /*atol=*/2e-3));
+}
+
 }  // namespace llm
@@ -3,12 +3,15 @@
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 #include "common/metrics.h"
 #include "common/timer.h"
 #include "engine/llm_engine.h"
 #include "engine/parameters.h"
+#include "layers/attention/handler.h"
 #include "rejection_sampler.h"
 
 DEFINE_COUNTER_FAMILY(speculative_execution_latency_seconds,
@@ -37,7 +40,9 @@ SpeculativeEngine::SpeculativeEngine(const Options& options)
       .max_memory_utilization(options.max_memory_utilization())
       .enable_prefix_cache(options.enable_prefix_cache())
       .enable_cuda_graph(options.enable_cuda_graph())
-      .cuda_graph_max_seq_len(options.cuda_graph_max_seq_len());
+      .cuda_graph_max_seq_len(options.cuda_graph_max_seq_len())
+      .num_loading_threads(options.num_loading_threads())
+      .weight_cache_dir(options.weight_cache_dir());
 
   // target engine
   engine_options.devices(options.devices())
@@ -45,11 +50,32 @@ SpeculativeEngine::SpeculativeEngine(const Options& options)
       .cuda_graph_batch_sizes(options.cuda_graph_batch_sizes());
   engine_ = std::make_unique<LLMEngine>(engine_options);
 
+  if (options.prompt_lookup_max_ngram() > 0) {
+    // multiple branches are verified with a tree attention mask
+    int32_t num_branches = options.prompt_lookup_num_branches();
+    if (num_branches > 1) {
+      for (const auto& device : options.devices()) {
+        if (!AttentionHandler::support_tree_mask(device)) {
+          LOG(WARNING) << "Tree attention mask is not supported on device "
+                       << device << ", falling back to a single branch "
+                       << "for prompt lookup decoding";
+          num_branches = 1;
+          break;
+        }
+      }
+    }
+    // no draft model for prompt lookup decoding
+    proposer_ = std::make_unique<PromptLookupProposer>(
+        options.prompt_lookup_max_ngram(), num_branches);
+    return;
+  }
+
   // draft engine
   engine_options.devices(options.draft_devices())
       .num_decoding_tokens(1)
       .cuda_graph_batch_sizes(options.draft_cuda_graph_batch_sizes());
   draft_engine_ = std::make_unique<LLMEngine>(engine_options);
+  proposer_ = std::make_unique<DraftModelProposer>(draft_engine_.get());
 
   // check if llm and ssm are using the same device
   for (const auto& target : options.devices()) {
@@ -64,6 +90,15 @@ SpeculativeEngine::SpeculativeEngine(const Options& options)
 
 bool SpeculativeEngine::init(const std::string& model_weights_path,
                              const std::string& draft_model_weights_path) {
+  if (draft_engine_ == nullptr) {
+    // prompt lookup decoding, only the target model is needed
+    if (!engine_->init(model_weights_path)) {
+      return false;
+    }
+    model_args_ = engine_->model_args();
+    return true;
+  }
+
   if (!init_model(model_weights_path, draft_model_weights_path)) {
     return false;
   }
@@ -160,14 +195,10 @@ bool SpeculativeEngine::init_kv_cache() {
 }
 
 ModelOutput SpeculativeEngine::execute_model(Batch& batch) {
-  // run the draft model to get proposals
+  // run the proposer to get draft tokens
   Timer timer;
-  std::vector<ModelOutput> draft_outputs;
-  batch.set_engine_type(EngineType::SSM);
-  for (size_t i = 0; i < options_.num_speculative_tokens(); ++i) {
-    auto draft_output = draft_engine_->execute_model(batch);
-    draft_outputs.push_back(draft_output);
-  }
+  const auto num_tokens = num_draft_tokens(batch);
+  const auto proposal = proposer_->propose(batch, num_tokens);
   COUNTER_ADD(draft_execution_latency_seconds, timer.elapsed_seconds());
 
   // run the target model to get the verification scores
@@ -178,14 +209,33 @@ ModelOutput SpeculativeEngine::execute_model(Batch& batch) {
 
   // verify the proposals with target and update the batch
   timer.reset();
-  validate(batch, draft_outputs, output);
+  validate(batch, num_tokens, proposal, output);
   COUNTER_ADD(validation_latency_seconds, timer.elapsed_seconds());
 
   return output;
 }
 
+std::vector<uint32_t> SpeculativeEngine::num_draft_tokens(Batch& batch) const {
+  const uint32_t max_num_tokens = options_.num_speculative_tokens();
+  std::vector<uint32_t> num_tokens(batch.size(), 0);
+  for (size_t i = 0; i < batch.size(); ++i) {
+    const auto* sequence = batch[i];
+    const size_t num_tokens_to_process =
+        sequence->num_tokens() -
+        sequence->num_kv_cache_tokens(EngineType::LLM);
+    // the scheduler reserves budget for draft tokens in decode stage
+    const uint32_t budget = batch.token_budget(i);
+    if (budget > num_tokens_to_process) {
+      num_tokens[i] =
+          std::min<uint32_t>(budget - num_tokens_to_process, max_num_tokens);
+    }
+  }
+  return num_tokens;
+}
+
 void SpeculativeEngine::validate(Batch& batch,
-                                 const std::vector<ModelOutput>& draft_outputs,
+                                 const std::vector<uint32_t>& num_draft_tokens,
+                                 const Proposal& proposal,
                                  const ModelOutput& target_output) {
   if (!target_output.sample_output.next_tokens.defined()) {
     // a pure prefill batch, no sampling needed
@@ -196,46 +246,84 @@ void SpeculativeEngine::validate(Batch& batch,
       target_output.sample_output.next_tokens.view({-1, 1});
   const int64_t batch_size = bonus_token_ids.size(/*dim=*/0);
   const int64_t vocab_size = target_output.logits.size(/*dim=*/-1);
-  const int64_t num_speculative_tokens =
-      static_cast<int64_t>(draft_outputs.size());
-
-  // [batch_size, n_speculative_tokens, vocab_size]
-  auto target_logits = target_output.logits.view(
-      {batch_size, num_speculative_tokens + /*bonus_tokens*/ 1, vocab_size});
-
-  // prepare input for rejection sampling
-  std::vector<torch::Tensor> draft_token_ids_vec;
-  std::vector<torch::Tensor> draft_probs_vec;
-  for (const auto& draft_output : draft_outputs) {
-    auto draft_token_ids =
-        draft_output.sample_output.next_tokens.view({batch_size, 1});
-    auto draft_probs =
-        draft_output.sample_output.probs.view({{batch_size, 1, vocab_size}});
-    draft_token_ids_vec.push_back(draft_token_ids);
-    draft_probs_vec.push_back(draft_probs);
+  // [batch_size, n_speculative_tokens]
+  const auto draft_token_ids = proposal.draft_token_ids.to(bonus_token_ids);
+  CHECK_EQ(draft_token_ids.size(/*dim=*/0), batch_size);
+  const int64_t num_speculative_tokens = draft_token_ids.size(/*dim=*/1);
+
+  // number of draft tokens for sequences in decode stage
+  std::vector<int64_t> num_tokens;
+  num_tokens.reserve(batch_size);
+  for (const uint32_t n : num_draft_tokens) {
+    if (n > 0) {
+      num_tokens.push_back(n);
+    }
+  }
+  CHECK_EQ(static_cast<int64_t>(num_tokens.size()), batch_size);
+  const bool same_num_tokens =
+      std::all_of(num_tokens.begin(), num_tokens.end(), [&](int64_t n) {
+        return n == num_speculative_tokens;
+      });
+
+  // [batch_size, n_speculative_tokens + 1, vocab_size]
+  torch::Tensor target_logits;
+  torch::Tensor num_tokens_tensor;
+  if (same_num_tokens) {
+    target_logits = target_output.logits.view(
+        {batch_size, num_speculative_tokens + /*bonus_tokens*/ 1, vocab_size});
+  } else {
+    // the target logits are packed with n + 1 rows for each sequence, gather
+    // them into the padded layout, repeating the bonus row for padded slots.
+    std::vector<int64_t> logits_idxes;
+    logits_idxes.reserve(batch_size * (num_speculative_tokens + 1));
+    int64_t offset = 0;
+    for (const int64_t n : num_tokens) {
+      for (int64_t j = 0; j <= num_speculative_tokens; ++j) {
+        logits_idxes.push_back(offset + std::min(j, n));
+      }
+      offset += n + 1;
+    }
+    CHECK_EQ(offset, target_output.logits.size(/*dim=*/0));
+    const auto device = target_output.logits.device();
+    target_logits =
+        target_output.logits
+            .index_select(/*dim=*/0, torch::tensor(logits_idxes).to(device))
+            .view({batch_size, num_speculative_tokens + 1, vocab_size});
+    num_tokens_tensor = torch::tensor(num_tokens).to(device);
   }
 
-  // concatenate the draft token ids and probs along the last dimension
-  const auto draft_token_ids =
-      torch::cat(draft_token_ids_vec, /*dim=*/1).to(bonus_token_ids);
-  const auto draft_probs =
-      torch::cat(draft_probs_vec, /*dim=*/1).to(target_logits.device());
+  torch::Tensor draft_probs;
+  if (proposal.draft_probs.defined()) {
+    draft_probs = proposal.draft_probs.to(target_logits.device());
+  }
 
   auto rejection_sampler =
       std::make_unique<RejectionSampler>(target_output.do_sample,
                                          target_output.logprobs,
                                          target_output.max_top_logprobs);
 
+  if (proposal.parents.defined()) {
+    // select the longest accepted path in the token trees
+    const auto [output, accepted_path] =
+        rejection_sampler->forward_tree(draft_token_ids,
+                                        draft_probs,
+                                        proposal.parents,
+                                        target_logits);
+    batch.process_validate_tree_output(output, accepted_path);
+    return;
+  }
+
   // get the accepted tokens
   const auto output =
       rejection_sampler->forward(draft_token_ids,
                                  draft_probs,
                                  target_logits,
                                  bonus_token_ids,
-                                 /*mask_out_rejected_tokens=*/true);
+                                 /*mask_out_rejected_tokens=*/true,
+                                 num_tokens_tensor);
 
   // update the batch with the accpeted tokens
-  batch.process_validate_output(output);
+  batch.process_validate_output(output, num_draft_tokens);
 }
 
 int64_t SpeculativeEngine::calculate_kv_cache_blocks(
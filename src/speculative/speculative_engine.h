@@ -6,6 +6,7 @@
 #include "engine/llm_engine.h"
 #include "memory/block_manager.h"
 #include "models/model_args.h"
+#include "proposer.h"
 #include "tokenizer/tokenizer.h"
 #include "tokenizer/tokenizer_args.h"
 
@@ -33,6 +34,14 @@ class SpeculativeEngine : public Engine {
     // the number of speculative tokens per step
     DEFINE_ARG(int32_t, num_speculative_tokens) = 0;
 
+    // max n-gram size for prompt lookup decoding. if positive, draft tokens
+    // are proposed by matching n-grams in the sequence instead of a draft model
+    DEFINE_ARG(int32_t, prompt_lookup_max_ngram) = 0;
+
+    // max number of branches of the draft token tree for prompt lookup
+    // decoding, verified with tree attention. 1 for a chain of draft tokens.
+    DEFINE_ARG(int32_t, prompt_lookup_num_branches) = 1;
+
     // enable cuda graph
     DEFINE_ARG(bool, enable_cuda_graph) = true;
 
@@ -45,6 +54,12 @@ class SpeculativeEngine : public Engine {
     // batch sizes to capture cuda graphs for draft model
     DEFINE_ARG(std::optional<std::vector<uint32_t>>,
                draft_cuda_graph_batch_sizes);
+
+    // the number of threads to read weights files ahead while loading
+    DEFINE_ARG(int32_t, num_loading_threads) = 4;
+
+    // the directory to cache prepared weights, empty to disable
+    DEFINE_ARG(std::string, weight_cache_dir);
   };
 
   // create an engine with the given devices
@@ -52,6 +67,7 @@ class SpeculativeEngine : public Engine {
 
   virtual ~SpeculativeEngine() = default;
 
+  // draft_model_weights_path is ignored for prompt lookup decoding
   bool init(const std::string& model_weights_path,
             const std::string& draft_model_weights_path);
 
@@ -79,8 +95,13 @@ class SpeculativeEngine : public Engine {
 
   int64_t calculate_kv_cache_blocks(int64_t cache_size_in_bytes) const;
 
+  // get the number of draft tokens for each sequence in the batch from its
+  // token budget, zero for sequences staying in prefill stage.
+  std::vector<uint32_t> num_draft_tokens(Batch& batch) const;
+
   static void validate(Batch& batch,
-                       const std::vector<ModelOutput>& draft_outputs,
+                       const std::vector<uint32_t>& num_draft_tokens,
+                       const Proposal& proposal,
                        const ModelOutput& target_output);
 
   // options
@@ -89,9 +110,12 @@ class SpeculativeEngine : public Engine {
   // engine
   std::unique_ptr<LLMEngine> engine_;
 
-  // draft engine
+  // draft engine, null for prompt lookup decoding
   std::unique_ptr<LLMEngine> draft_engine_;
 
+  // proposer to generate draft tokens
+  std::unique_ptr<Proposer> proposer_;
+
   // whether target and draft engine are sharing the same device
   bool share_device_ = false;
 
@@ -52,6 +52,66 @@ std::string HFTokenizer::decode(const Slice<int32_t>& ids,
   return {data, len};
 }
 
+bool HFTokenizer::encode_batch(const std::vector<std::string_view>& texts,
+                               ThreadPool* /*threadpool*/,
+                               std::vector<std::vector<int32_t>>* ids) const {
+  const size_t num_texts = texts.size();
+  std::vector<const char*> data;
+  std::vector<size_t> lens;
+  data.reserve(num_texts);
+  lens.reserve(num_texts);
+  for (const auto& text : texts) {
+    data.push_back(text.data());
+    lens.push_back(text.size());
+  }
+  tokenizer_encode_batch(handle_,
+                         data.data(),
+                         lens.data(),
+                         num_texts,
+                         /*add_special_tokens=*/true);
+
+  ids->clear();
+  ids->resize(num_texts);
+  for (size_t i = 0; i < num_texts; ++i) {
+    const uint32_t* id_data = nullptr;
+    size_t len = 0;
+    tokenizer_get_encode_batch_ids(handle_, i, &id_data, &len);
+    auto& seq_ids = (*ids)[i];
+    seq_ids.reserve(len);
+    for (size_t j = 0; j < len; ++j) {
+      seq_ids.push_back(static_cast<int32_t>(id_data[j]));
+    }
+  }
+  return true;
+}
+
+std::vector<std::string> HFTokenizer::decode_batch(
+    const std::vector<Slice<int32_t>>& ids,
+    bool skip_special_tokens,
+    ThreadPool* /*threadpool*/) const {
+  const size_t num_seqs = ids.size();
+  std::vector<const uint32_t*> data;
+  std::vector<size_t> lens;
+  data.reserve(num_seqs);
+  lens.reserve(num_seqs);
+  for (const auto& seq_ids : ids) {
+    data.push_back(reinterpret_cast<const uint32_t*>(seq_ids.data()));
+    lens.push_back(seq_ids.size());
+  }
+  tokenizer_decode_batch(
+      handle_, data.data(), lens.data(), num_seqs, skip_special_tokens);
+
+  std::vector<std::string> texts;
+  texts.reserve(num_seqs);
+  for (size_t i = 0; i < num_seqs; ++i) {
+    const char* text_data = nullptr;
+    size_t len = 0;
+    tokenizer_get_decode_batch_str(handle_, i, &text_data, &len);
+    texts.emplace_back(text_data, len);
+  }
+  return texts;
+}
+
 std::optional<int32_t> HFTokenizer::token_to_id(
     const std::string_view& token) const {
   int32_t id = tokenizer_token_to_id(handle_, token.data(), token.size());
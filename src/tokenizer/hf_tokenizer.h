@@ -19,6 +19,16 @@ class HFTokenizer : public Tokenizer {
   std::string decode(const Slice<int32_t>& ids,
                      bool skip_special_tokens) const override;
 
+  // batch encode/decode in one ffi call, parallelized by hf/tokenizers.
+  // the threadpool is not used.
+  bool encode_batch(const std::vector<std::string_view>& texts,
+                    ThreadPool* threadpool,
+                    std::vector<std::vector<int32_t>>* ids) const override;
+
+  std::vector<std::string> decode_batch(const std::vector<Slice<int32_t>>& ids,
+                                        bool skip_special_tokens,
+                                        ThreadPool* threadpool) const override;
+
   std::optional<int32_t> token_to_id(
       const std::string_view& token) const override;
 
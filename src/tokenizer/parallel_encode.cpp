@@ -0,0 +1,63 @@
+#include "parallel_encode.h"
+
+#include <glog/logging.h>
+
+#include <future>
+#include <string_view>
+#include <vector>
+
+namespace llm {
+
+bool parallel_encode(const Tokenizer& tokenizer,
+                     const std::string_view& text,
+                     size_t chunk_size,
+                     ThreadPool* threadpool,
+                     std::vector<int32_t>* ids) {
+  CHECK_GT(chunk_size, 0);
+  if (threadpool == nullptr || text.size() < 2 * chunk_size) {
+    return tokenizer.encode(text, ids);
+  }
+
+  const auto chunks = tokenizer.split_text(text, chunk_size);
+  if (chunks.size() <= 1) {
+    return tokenizer.encode(text, ids);
+  }
+
+  // encode the rest chunks on the threadpool
+  const size_t num_chunks = chunks.size();
+  std::vector<std::vector<int32_t>> chunk_ids(num_chunks);
+  std::vector<std::future<bool>> futures;
+  futures.reserve(num_chunks - 1);
+  for (size_t i = 1; i < num_chunks; ++i) {
+    std::promise<bool> promise;
+    futures.emplace_back(promise.get_future());
+    threadpool->schedule([&tokenizer,
+                          chunk = chunks[i],
+                          chunk_ids = &chunk_ids[i],
+                          promise = std::move(promise)]() mutable {
+      promise.set_value(tokenizer.encode_chunk(chunk, chunk_ids));
+    });
+  }
+
+  // encode the first chunk with prefix tokens in current thread
+  bool ok = tokenizer.encode(chunks[0], ids);
+  // wait for all chunks even on failure since they reference local states
+  for (auto& future : futures) {
+    ok = future.get() && ok;
+  }
+  if (!ok) {
+    return false;
+  }
+
+  size_t num_ids = ids->size();
+  for (size_t i = 1; i < num_chunks; ++i) {
+    num_ids += chunk_ids[i].size();
+  }
+  ids->reserve(num_ids);
+  for (size_t i = 1; i < num_chunks; ++i) {
+    ids->insert(ids->end(), chunk_ids[i].begin(), chunk_ids[i].end());
+  }
+  return true;
+}
+
+}  // namespace llm
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "common/threadpool.h"
+#include "tokenizer.h"
+
+namespace llm {
+
+// encode a long text by splitting it into chunks at safe pre-tokenizer
+// boundaries and encoding the chunks concurrently on the threadpool.
+// the result is identical to tokenizer.encode(text, ids), which is used
+// directly if the text can't be split.
+bool parallel_encode(const Tokenizer& tokenizer,
+                     const std::string_view& text,
+                     size_t chunk_size,
+                     ThreadPool* threadpool,
+                     std::vector<int32_t>* ids);
+
+}  // namespace llm
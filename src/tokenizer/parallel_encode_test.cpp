@@ -0,0 +1,119 @@
+#include "parallel_encode.h"
+
+#include <gtest/gtest.h>
+
+#include "common/threadpool.h"
+#include "hf_tokenizer.h"
+#include "sentencepiece_tokenizer.h"
+#include "tiktoken_tokenizer.h"
+#include "tokenizer_args.h"
+
+namespace llm {
+namespace {
+
+std::string long_text(const std::string& special_token) {
+  const std::vector<std::string> sentences = {
+      "Hello, world! ",
+      "The quick brown fox jumps over the lazy dog.\n",
+      "  Large language models   tokenize text into tokens. ",
+      "你好，世界！ ",
+      "x=1234567; y = x * 2;\n\n",
+      special_token,
+  };
+  std::string text;
+  for (int i = 0; i < 200; ++i) {
+    text += sentences[i % sentences.size()];
+    text += sentences[(i * 7) % sentences.size()];
+  }
+  return text;
+}
+
+void expect_same_encoding(const Tokenizer& tokenizer,
+                          const std::string& text,
+                          ThreadPool* threadpool) {
+  std::vector<int32_t> desired_ids;
+  ASSERT_TRUE(tokenizer.encode(text, &desired_ids));
+  for (size_t chunk_size : {1, 7, 64, 1000}) {
+    std::vector<int32_t> ids;
+    ASSERT_TRUE(
+        parallel_encode(tokenizer, text, chunk_size, threadpool, &ids));
+    EXPECT_EQ(ids, desired_ids) << "chunk_size: " << chunk_size;
+  }
+}
+
+void expect_same_batch(const Tokenizer& tokenizer,
+                       const std::string& special_token,
+                       ThreadPool* threadpool) {
+  std::vector<std::string> texts;
+  for (int i = 0; i < 37; ++i) {
+    texts.push_back(long_text(special_token).substr(0, i * 7));
+  }
+  // cut at ascii chars to keep utf-8 valid
+  for (auto& text : texts) {
+    while (!text.empty() && static_cast<uint8_t>(text.back()) >= 0x80) {
+      text.pop_back();
+    }
+  }
+  const std::vector<std::string_view> views(texts.begin(), texts.end());
+
+  std::vector<std::vector<int32_t>> ids;
+  ASSERT_TRUE(tokenizer.encode_batch(views, threadpool, &ids));
+  ASSERT_EQ(ids.size(), texts.size());
+  std::vector<Slice<int32_t>> slices;
+  for (size_t i = 0; i < texts.size(); ++i) {
+    std::vector<int32_t> desired_ids;
+    ASSERT_TRUE(tokenizer.encode(texts[i], &desired_ids));
+    EXPECT_EQ(ids[i], desired_ids) << "text: " << texts[i];
+    slices.emplace_back(ids[i]);
+  }
+
+  const auto decoded = tokenizer.decode_batch(
+      slices, /*skip_special_tokens=*/false, threadpool);
+  ASSERT_EQ(decoded.size(), texts.size());
+  for (size_t i = 0; i < texts.size(); ++i) {
+    EXPECT_EQ(decoded[i],
+              tokenizer.decode(slices[i], /*skip_special_tokens=*/false));
+  }
+}
+
+}  // namespace
+
+TEST(ParallelEncodeTest, Tiktoken) {
+  TokenizerArgs args;
+  args.vocab_file() = "test.tiktoken";
+  args.pattern() =
+      R"((?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+[^\S]|\s+)";
+  args.special_tokens() = {{"<|end|>", 300}, {"<|user|>", 301}};
+  TiktokenTokenizer tokenizer("data", args);
+
+  const auto text = long_text("<|user|>");
+  EXPECT_GT(tokenizer.split_text(text, /*chunk_size=*/64).size(), 1);
+  ThreadPool threadpool(4);
+  expect_same_encoding(tokenizer, text, &threadpool);
+  expect_same_batch(tokenizer, "<|user|>", &threadpool);
+}
+
+TEST(ParallelEncodeTest, SentencePiece) {
+  TokenizerArgs args;
+  args.vocab_file() = "tokenizer.model";
+  args.prefix_tokens() = {"<s>"};
+  args.special_tokens() = {{"[INST]", 32000}, {"[/INST]", 32001}};
+  SentencePieceTokenizer tokenizer("data", args);
+
+  const auto text = long_text("[INST]");
+  EXPECT_GT(tokenizer.split_text(text, /*chunk_size=*/64).size(), 1);
+  ThreadPool threadpool(4);
+  expect_same_encoding(tokenizer, text, &threadpool);
+  expect_same_batch(tokenizer, "[INST]", &threadpool);
+}
+
+TEST(ParallelEncodeTest, HFTokenizer) {
+  auto tokenizer = HFTokenizer::from_file("data/tokenizer.json");
+
+  const auto text = long_text("<|endoftext|>");
+  ThreadPool threadpool(4);
+  expect_same_encoding(*tokenizer, text, &threadpool);
+  expect_same_batch(*tokenizer, "<|endoftext|>", &threadpool);
+}
+
+}  // namespace llm
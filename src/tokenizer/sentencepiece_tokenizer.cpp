@@ -1,7 +1,10 @@
 #include "sentencepiece_tokenizer.h"
 
+#include <absl/strings/ascii.h>
+#include <absl/strings/numbers.h>
 #include <absl/strings/str_cat.h>
 #include <absl/strings/str_join.h>
+#include <absl/strings/str_replace.h>
 #include <absl/strings/string_view.h>
 #include <glog/logging.h>
 #include <re2/re2.h>
@@ -9,6 +12,7 @@
 #include <string_view>
 
 #include "sentencepiece.pb.h"
+#include "sentencepiece_model.pb.h"
 #include "sentencepiece/sentencepiece_processor.h"
 
 #define RETURN_FALSE_IF_ERROR(expr)  \
@@ -43,6 +47,18 @@ SentencePieceTokenizer::SentencePieceTokenizer(const std::string_view& dir_path,
     load_special_tokens(args.special_tokens());
   }
 
+  // words never span whitespaces and each encoded text starts with a dummy
+  // whitespace, so a text can be split at a whitespace by dropping it.
+  const auto& model_proto = sp_processor_.model_proto();
+  splittable_ = model_proto.normalizer_spec().add_dummy_prefix() &&
+                model_proto.trainer_spec().split_by_whitespace() &&
+                !model_proto.trainer_spec().treat_whitespace_as_suffix();
+
+  // the denormalizer rewrites the whole text, tokens can't be decoded alone
+  if (model_proto.denormalizer_spec().precompiled_charsmap().empty()) {
+    load_token_bytes_table();
+  }
+
   // construct prefix tokens
   if (!args.prefix_tokens().empty()) {
     for (const auto& token : args.prefix_tokens()) {
@@ -60,6 +76,44 @@ SentencePieceTokenizer::SentencePieceTokenizer(const std::string_view& dir_path,
   }
 }
 
+void SentencePieceTokenizer::load_token_bytes_table() {
+  // mirror SentencePieceProcessor::Decode for a single piece
+  static constexpr std::string_view kSpaceSymbol = "\xe2\x96\x81";
+  const auto& model_proto = sp_processor_.model_proto();
+  const std::string unk_surface = model_proto.trainer_spec().has_unk_surface()
+                                      ? model_proto.trainer_spec().unk_surface()
+                                      : " \xE2\x81\x87 ";
+  const int num_pieces = sp_processor_.GetPieceSize();
+  for (int id = 0; id < num_pieces; ++id) {
+    if (sp_processor_.IsControl(id)) {
+      // <s>, </s> are invisible
+      token_bytes_table_.add(id, "");
+    } else if (sp_processor_.IsUnknown(id)) {
+      token_bytes_table_.add(id, unk_surface);
+    } else if (sp_processor_.IsByte(id)) {
+      // byte pieces look like <0x0A>
+      const auto& piece = sp_processor_.IdToPiece(id);
+      uint32_t byte = 0;
+      CHECK(piece.size() == 6 &&
+            absl::SimpleHexAtoi(absl::string_view(piece).substr(3, 2), &byte))
+          << "Invalid byte piece: " << piece;
+      const char ch = static_cast<char>(byte);
+      token_bytes_table_.add(id, std::string_view(&ch, 1));
+    } else {
+      const auto& piece = sp_processor_.IdToPiece(id);
+      token_bytes_table_.add(id,
+                             absl::StrReplaceAll(piece, {{kSpaceSymbol, " "}}));
+    }
+  }
+  for (const auto& [token, id] : special_token_decoder_) {
+    token_bytes_table_.add(id, token, /*special=*/true);
+  }
+  // the dummy prefix of each decoded segment is removed
+  token_bytes_table_.set_strip_leading_space(
+      model_proto.normalizer_spec().add_dummy_prefix() ||
+      model_proto.normalizer_spec().remove_extra_whitespaces());
+}
+
 void SentencePieceTokenizer::load_special_tokens(
     const std::vector<SpecialToken>& special_tokens) {
   // for each special token, add to encoder and decoder
@@ -118,7 +172,11 @@ bool SentencePieceTokenizer::encode(const std::string_view& text,
     ids->insert(
         ids->begin(), prefix_token_ids_.begin(), prefix_token_ids_.end());
   }
+  return encode_chunk(text, ids);
+}
 
+bool SentencePieceTokenizer::encode_chunk(const std::string_view& text,
+                                          std::vector<int32_t>* ids) const {
   if (special_token_regex_ == nullptr) {
     return encode_internal(text, ids);
   }
@@ -151,6 +209,70 @@ bool SentencePieceTokenizer::encode(const std::string_view& text,
   return encode_internal({input.data(), input.size()}, ids);
 }
 
+std::vector<size_t> SentencePieceTokenizer::special_token_offsets(
+    const std::string_view& text) const {
+  std::vector<size_t> offsets;
+  if (special_token_regex_ == nullptr) {
+    return offsets;
+  }
+  // the same matches as encode_chunk()
+  absl::string_view input{text.data(), text.size()};
+  absl::string_view special;
+  while (re2::RE2::FindAndConsume(&input, *special_token_regex_, &special)) {
+    const size_t start = special.data() - text.data();
+    const size_t end = start + special.size();
+    if (start > 0 && (offsets.empty() || offsets.back() != start)) {
+      offsets.push_back(start);
+    }
+    if (end < text.size()) {
+      offsets.push_back(end);
+    }
+  }
+  return offsets;
+}
+
+std::vector<std::string_view> SentencePieceTokenizer::split_text(
+    const std::string_view& text,
+    size_t chunk_size) const {
+  if (!splittable_) {
+    return {text};
+  }
+
+  std::vector<std::string_view> chunks;
+  size_t chunk_start = 0;
+  // cut at a single space between two visible ascii chars, the space is
+  // dropped since the dummy prefix of the next chunk stands for it.
+  auto cut_segment = [&](size_t start, size_t end) {
+    for (size_t i = start + 1; i + 1 < end; ++i) {
+      if (i >= chunk_start + chunk_size && text[i] == ' ' &&
+          absl::ascii_isgraph(text[i - 1]) &&
+          absl::ascii_isgraph(text[i + 1])) {
+        chunks.push_back(text.substr(chunk_start, i - chunk_start));
+        chunk_start = i + 1;
+      }
+    }
+  };
+
+  if (special_token_regex_ == nullptr) {
+    cut_segment(0, text.size());
+  } else {
+    // only cut between special tokens
+    absl::string_view input{text.data(), text.size()};
+    absl::string_view special;
+    while (true) {
+      const size_t start = input.data() - text.data();
+      if (!re2::RE2::FindAndConsume(&input, *special_token_regex_, &special)) {
+        break;
+      }
+      cut_segment(start, special.data() - text.data());
+    }
+    cut_segment(input.data() - text.data(), text.size());
+  }
+
+  chunks.push_back(text.substr(chunk_start));
+  return chunks;
+}
+
 void SentencePieceTokenizer::decode_internal(const Slice<int32_t>& ids,
                                              size_t start,
                                              size_t end,
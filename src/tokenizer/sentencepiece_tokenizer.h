@@ -19,9 +19,22 @@ class SentencePieceTokenizer : public Tokenizer {
   bool encode(const std::string_view& text,
               std::vector<int32_t>* ids) const override;
 
+  std::vector<std::string_view> split_text(const std::string_view& text,
+                                           size_t chunk_size) const override;
+
+  std::vector<size_t> special_token_offsets(
+      const std::string_view& text) const override;
+
+  bool encode_chunk(const std::string_view& text,
+                    std::vector<int32_t>* ids) const override;
+
   std::string decode(const Slice<int32_t>& ids,
                      bool skip_special_tokens) const override;
 
+  const TokenBytesTable* token_bytes_table() const override {
+    return token_bytes_table_.size() > 0 ? &token_bytes_table_ : nullptr;
+  }
+
   std::optional<int32_t> token_to_id(
       const std::string_view& token) const override;
 
@@ -34,6 +47,8 @@ class SentencePieceTokenizer : public Tokenizer {
  private:
   void load_special_tokens(const std::vector<SpecialToken>& special_tokens);
 
+  void load_token_bytes_table();
+
   bool encode_internal(const std::string_view& text,
                        std::vector<int32_t>* ids) const;
   void decode_internal(const Slice<int32_t>& ids,
@@ -53,11 +68,17 @@ class SentencePieceTokenizer : public Tokenizer {
   // special token ids to tokens
   absl::flat_hash_map<int32_t, std::string> special_token_decoder_;
 
+  // id to decoded bytes of each token, empty if not supported
+  TokenBytesTable token_bytes_table_;
+
   // special token regex (optional)
   std::unique_ptr<re2::RE2> special_token_regex_;
 
   // token ids to add to the beginning of the input sequence
   std::vector<int32_t> prefix_token_ids_;
+
+  // whether text can be split at whitespaces for chunked encoding
+  bool splittable_ = false;
 };
 
 }  // namespace llm
@@ -1,16 +1,19 @@
 #include "tiktoken_tokenizer.h"
 
+#include <absl/hash/hash.h>
 #include <absl/strings/escaping.h>
 #include <absl/strings/numbers.h>
 #include <absl/strings/str_cat.h>
-#include <absl/strings/str_join.h>
 #include <absl/strings/str_split.h>
 #include <absl/strings/string_view.h>
 #include <glog/logging.h>
 #include <re2/re2.h>
 
 #include <fstream>
+#include <functional>
 #include <optional>
+#include <shared_mutex>
+#include <queue>
 #include <string>
 #include <string_view>
 
@@ -18,6 +21,11 @@ namespace llm {
 namespace {
 constexpr uint32_t kUnicodeError = 0xFFFD;
 
+// max number of pieces in the piece cache, a shard is cleared when full
+constexpr size_t kMaxPieceCacheSize = 64 * 1024;
+// only cache short pieces, long ones are rarely repeated
+constexpr size_t kMaxCachedPieceLen = 64;
+
 // copied from #include "sentencepiece/util.h" to avoid build warnings
 using char32 = uint32_t;
 
@@ -130,27 +138,24 @@ void TiktokenTokenizer::load_special_tokens(
       LOG(WARNING) << "Duplicate special token: " << token << ", id: " << id;
     }
 
-    if (!special_token_decoder_.try_emplace(id, token).second) {
+    if (decoder_.contains(id) && decoder_.is_special(id)) {
       LOG(WARNING) << "Duplicate special token: " << token << ", id: " << id;
     }
+    decoder_.add(id, token, /*special=*/true);
   }
 
-  // build special token regex
-  std::vector<std::string> escaped_tokens;
-  escaped_tokens.reserve(special_tokens.size());
+  // build special token matcher
+  std::vector<std::string> tokens;
+  tokens.reserve(special_tokens.size());
   for (const auto& [token, id] : special_tokens) {
     if (token.empty()) {
       continue;
     }
-    // escape each token
-    const auto escaped_token = re2::RE2::QuoteMeta(token);
-    escaped_tokens.push_back(escaped_token);
+    tokens.push_back(token);
+    special_token_ids_.push_back(id);
   }
-  if (!escaped_tokens.empty()) {
-    const auto special_token_regex_str = absl::StrJoin(escaped_tokens, "|");
-    // surround with () to match special tokens
-    const auto regex_str = absl::StrCat("(", special_token_regex_str, ")");
-    special_token_regex_ = std::make_unique<re2::RE2>(regex_str);
+  if (!tokens.empty()) {
+    special_token_matcher_ = std::make_unique<AhoCorasick>(tokens);
   }
 }
 
@@ -188,9 +193,10 @@ void TiktokenTokenizer::load_vocab(const std::string& vocab_file_path) {
     if (!encoder_.try_emplace(token, rank).second) {
       LOG(WARNING) << "Duplicate token: " << token;
     }
-    if (!decoder_.try_emplace(rank, token).second) {
+    if (decoder_.contains(rank)) {
       LOG(WARNING) << "Duplicate rank: " << rank;
     }
+    decoder_.add(rank, token);
   }
 }
 
@@ -201,71 +207,78 @@ void TiktokenTokenizer::byte_pair_encode(const std::string_view& piece,
     return;
   }
 
-  // This is a vector of (start, rank) pairs.
-  // The rank is of the byte pair startig at position start.
-  // The rank of the last item in the vector is not a valid value.
-  std::vector<std::pair<int32_t, int32_t>> parts;
-  parts.reserve(piece.size() + 1);
+  // parts form a linked list indexed by their start offsets in the piece.
+  // part i spans [i, next[i]) and ranks[i] is the rank of the byte pair
+  // merging part i with its next part.
+  const int32_t n = static_cast<int32_t>(piece.size());
   const int32_t kMaxRank = std::numeric_limits<int32_t>::max();
-  for (int32_t i = 0; i <= piece.size(); ++i) {
-    parts.emplace_back(i, kMaxRank);
-  }
-
-  auto get_rank = [&piece, &parts, this](
-                      int32_t start, int32_t skip) -> std::optional<int32_t> {
-    if (start + skip + 2 < parts.size()) {
-      auto s = parts[start].first;
-      auto e = parts[start + skip + 2].first;
-      const auto key = piece.substr(s, e - s);
-      auto it = encoder_.find({key.data(), key.size()});
-      if (it != encoder_.end()) {
-        return it->second;
-      }
+  std::vector<int32_t> prev(n);
+  std::vector<int32_t> next(n);
+  std::vector<int32_t> ranks(n, kMaxRank);
+  for (int32_t i = 0; i < n; ++i) {
+    prev[i] = i - 1;
+    next[i] = i + 1;
+  }
+
+  auto get_rank = [&piece, &next, n, kMaxRank, this](int32_t i) -> int32_t {
+    const int32_t j = next[i];
+    if (j >= n) {
+      return kMaxRank;
     }
-    return std::nullopt;
+    const auto key = piece.substr(i, next[j] - i);
+    auto it = encoder_.find({key.data(), key.size()});
+    if (it == encoder_.end()) {
+      return kMaxRank;
+    }
+    // kMaxRank is a sentinel value and cannot be a valid rank.
+    CHECK(it->second != kMaxRank) << "Invalid rank";
+    return it->second;
   };
 
-  // We look up the ranks once in the beginning and iteratively update
-  // them during each merge, which reduces the number of rank lookups.
-  for (int32_t i = 0; i < parts.size() - 2; ++i) {
-    const auto rank = get_rank(i, 0);
-    if (rank.has_value()) {
-      // kMaxRank is a sentinel value and cannot be a valid rank.
-      CHECK(rank.value() != kMaxRank) << "Invalid rank";
-      parts[i].second = rank.value();
-    }
-  }
-
-  while (parts.size() > 1) {
-    // find i with min rank. kMaxRank is a sentinel value.
-    int32_t min_rank = kMaxRank;
-    int32_t min_i = 0;
-    for (int32_t i = 0; i < parts.size() - 1; ++i) {
-      const auto rank = parts[i].second;
-      if (rank < min_rank) {
-        min_rank = rank;
-        min_i = i;
-      }
+  // min heap of (rank, start), ties are broken by the leftmost part.
+  // entries are invalidated lazily by comparing with the current rank.
+  using Entry = std::pair<int32_t, int32_t>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap;
+  for (int32_t i = 0; i + 1 < n; ++i) {
+    ranks[i] = get_rank(i);
+    if (ranks[i] != kMaxRank) {
+      heap.emplace(ranks[i], i);
     }
+  }
 
-    if (min_rank == kMaxRank) {
-      // No more merges possible.
-      break;
+  while (!heap.empty()) {
+    const auto [rank, i] = heap.top();
+    heap.pop();
+    if (ranks[i] != rank) {
+      // stale entry
+      continue;
+    }
+
+    // merge part i with its next part j
+    const int32_t j = next[i];
+    next[i] = next[j];
+    if (next[j] < n) {
+      prev[next[j]] = i;
     }
+    ranks[j] = kMaxRank;
 
-    // remove parts[min_i + 1].
-    parts[min_i].second = get_rank(min_i, 1).value_or(kMaxRank);
-    if (min_i > 0) {
-      parts[min_i - 1].second = get_rank(min_i - 1, 1).value_or(kMaxRank);
+    // update ranks of the merged part and its previous part
+    ranks[i] = get_rank(i);
+    if (ranks[i] != kMaxRank) {
+      heap.emplace(ranks[i], i);
+    }
+    if (prev[i] >= 0) {
+      const int32_t p = prev[i];
+      ranks[p] = get_rank(p);
+      if (ranks[p] != kMaxRank) {
+        heap.emplace(ranks[p], p);
+      }
     }
-    parts.erase(parts.begin() + min_i + 1);
   }
 
-  for (int32_t i = 0; i < parts.size() - 1; ++i) {
-    const auto s = parts[i].first;
-    const auto e = parts[i + 1].first;
+  for (int32_t i = 0; i < n; i = next[i]) {
     // get rank for each piece
-    const auto key = piece.substr(s, e - s);
+    const auto key = piece.substr(i, next[i] - i);
     auto it = encoder_.find({key.data(), key.size()});
     if (it == encoder_.end()) {
       LOG(ERROR) << "Failed to find key: " << key;
@@ -275,6 +288,42 @@ void TiktokenTokenizer::byte_pair_encode(const std::string_view& piece,
   }
 }
 
+void TiktokenTokenizer::encode_piece(const std::string_view& piece,
+                                     std::vector<int32_t>* ids) const {
+  const absl::string_view key{piece.data(), piece.size()};
+  auto it = encoder_.find(key);
+  if (it != encoder_.end()) {
+    ids->push_back(it->second);
+    return;
+  }
+
+  if (piece.size() > kMaxCachedPieceLen) {
+    byte_pair_encode(piece, ids);
+    return;
+  }
+
+  auto& shard =
+      piece_cache_[absl::Hash<absl::string_view>{}(key) % kNumPieceCacheShards];
+  {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto cit = shard.pieces.find(key);
+    if (cit != shard.pieces.end()) {
+      ids->insert(ids->end(), cit->second.begin(), cit->second.end());
+      return;
+    }
+  }
+
+  const size_t offset = ids->size();
+  byte_pair_encode(piece, ids);
+
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  if (shard.pieces.size() >= kMaxPieceCacheSize / kNumPieceCacheShards) {
+    shard.pieces.clear();
+  }
+  shard.pieces.try_emplace(
+      key, std::vector<int32_t>(ids->begin() + offset, ids->end()));
+}
+
 void TiktokenTokenizer::encode_internal(const std::string_view& text,
                                         std::vector<int32_t>* ids) const {
   if (regex_ == nullptr) {
@@ -286,12 +335,7 @@ void TiktokenTokenizer::encode_internal(const std::string_view& text,
   absl::string_view piece;
   // std::string_view piece;
   while (re2::RE2::FindAndConsume(&input, *regex_, &piece)) {
-    auto it = encoder_.find(piece);
-    if (it != encoder_.end()) {
-      ids->push_back(it->second);
-      continue;
-    }
-    byte_pair_encode({piece.data(), piece.size()}, ids);
+    encode_piece({piece.data(), piece.size()}, ids);
   }
 }
 
@@ -302,80 +346,132 @@ bool TiktokenTokenizer::encode(const std::string_view& text,
     ids->insert(
         ids->begin(), prefix_token_ids_.begin(), prefix_token_ids_.end());
   }
+  return encode_chunk(text, ids);
+}
 
-  if (special_token_regex_ == nullptr) {
+bool TiktokenTokenizer::encode_chunk(const std::string_view& text,
+                                     std::vector<int32_t>* ids) const {
+  if (special_token_matcher_ == nullptr) {
     encode_internal(text, ids);
     return true;
   }
 
-  absl::string_view input{text.data(), text.size()};
-  absl::string_view special;
-  while (true) {
-    const auto* start = input.begin();
-    if (!re2::RE2::FindAndConsume(&input, *special_token_regex_, &special)) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const auto match = special_token_matcher_->find(text, pos);
+    if (!match.has_value()) {
       // no more special tokens
       break;
     }
-
     // encode text before special token if exists
-    const std::string_view sub_input(start,
-                                     input.begin() - start - special.size());
-    encode_internal(sub_input, ids);
-
-    // add special token id if exists
-    const auto sit = special_token_encoder_.find(special);
-    if (sit != special_token_encoder_.end()) {
-      // find one special token
-      ids->push_back(sit->second);
-    }
+    encode_internal(text.substr(pos, match->start - pos), ids);
+    ids->push_back(special_token_ids_[match->pattern]);
+    pos = match->start + match->length;
   }
 
   // encode remaining text if exists
-  encode_internal({input.data(), input.size()}, ids);
+  encode_internal(text.substr(pos), ids);
   return true;
 }
 
+std::vector<size_t> TiktokenTokenizer::special_token_offsets(
+    const std::string_view& text) const {
+  std::vector<size_t> offsets;
+  if (special_token_matcher_ == nullptr) {
+    return offsets;
+  }
+  // the same matches as encode_chunk()
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const auto match = special_token_matcher_->find(text, pos);
+    if (!match.has_value()) {
+      break;
+    }
+    const size_t end = match->start + match->length;
+    const size_t start = match->start;
+    if (start > 0 && (offsets.empty() || offsets.back() != start)) {
+      offsets.push_back(start);
+    }
+    if (end < text.size()) {
+      offsets.push_back(end);
+    }
+    pos = end;
+  }
+  return offsets;
+}
+
+std::vector<std::string_view> TiktokenTokenizer::split_text(
+    const std::string_view& text,
+    size_t chunk_size) const {
+  std::vector<std::string_view> chunks;
+  size_t chunk_start = 0;
+  // cut a chunk at pos if it is large enough
+  auto maybe_cut = [&](size_t pos) {
+    if (pos - chunk_start >= chunk_size && pos < text.size()) {
+      chunks.push_back(text.substr(chunk_start, pos - chunk_start));
+      chunk_start = pos;
+    }
+  };
+  // cut at regex piece boundaries, the regex has no look-around assertions,
+  // so restarting it at a piece boundary gives the same following pieces.
+  auto cut_segment = [&](size_t start, size_t end) {
+    if (regex_ == nullptr) {
+      // the whole segment is encoded as one piece
+      return;
+    }
+    absl::string_view input{text.data() + start, end - start};
+    absl::string_view piece;
+    while (re2::RE2::FindAndConsume(&input, *regex_, &piece)) {
+      maybe_cut(input.data() - text.data());
+    }
+  };
+
+  size_t pos = 0;
+  while (special_token_matcher_ != nullptr && pos < text.size()) {
+    const auto match = special_token_matcher_->find(text, pos);
+    if (!match.has_value()) {
+      break;
+    }
+    // no special token starts inside a segment, so it can't span chunks
+    cut_segment(pos, match->start);
+    maybe_cut(match->start);
+    pos = match->start + match->length;
+    maybe_cut(pos);
+  }
+  cut_segment(pos, text.size());
+
+  chunks.push_back(text.substr(chunk_start));
+  return chunks;
+}
+
 std::string TiktokenTokenizer::decode(const Slice<int32_t>& ids,
                                       bool skip_special_tokens) const {
-  std::stringstream ss;
+  std::string data;
   for (const auto& id : ids) {
-    // encode special token
-    const auto sit = special_token_decoder_.find(id);
-    if (sit != special_token_decoder_.end()) {
-      if (!skip_special_tokens) {
-        ss << sit->second;
-      }
+    if (!decoder_.contains(id)) {
+      LOG(ERROR) << "Failed to find token for id: " << id;
       continue;
     }
-
-    // encode token
-    const auto it = decoder_.find(id);
-    if (it != decoder_.end()) {
-      ss << it->second;
+    if (skip_special_tokens && decoder_.is_special(id)) {
       continue;
     }
-    LOG(ERROR) << "Failed to find token for id: " << id;
+    data.append(decoder_.bytes(id));
   }
 
-  std::string data = ss.str();
-  std::string_view bytes(data);
-
   // replace unfinished utf8 bytes with � (U+FFFD)
-  std::stringstream utf8_ss;
+  const std::string_view bytes(data);
   size_t offset = 0;
   while (offset < bytes.size()) {
     size_t consumed = 0;
-    const bool is_valid = is_valid_decode_utf8(bytes.substr(offset), &consumed);
-    if (is_valid) {
-      utf8_ss << bytes.substr(offset, consumed);
-    } else {
+    if (!is_valid_decode_utf8(bytes.substr(offset), &consumed)) {
       // add replacement character � (U+FFFD) in UTF-8
-      utf8_ss << "�";
+      data.resize(offset);
+      data.append("�");
       break;
     }
     offset += consumed;
   }
-  return utf8_ss.str();
+  return data;
 }
 
 size_t TiktokenTokenizer::vocab_size() const {
@@ -405,18 +501,10 @@ std::optional<int32_t> TiktokenTokenizer::token_to_id(
 }
 
 std::string TiktokenTokenizer::id_to_token(int32_t id) const {
-  // encode special token
-  const auto sit = special_token_decoder_.find(id);
-  if (sit != special_token_decoder_.end()) {
-    return sit->second;
-  }
-
-  // encode token
-  const auto it = decoder_.find(id);
-  if (it != decoder_.end()) {
-    return it->second;
+  if (!decoder_.contains(id)) {
+    return "";
   }
-  return "";
+  return std::string(decoder_.bytes(id));
 }
 
 }  // namespace llm
@@ -3,8 +3,13 @@
 #include <absl/container/flat_hash_map.h>
 #include <re2/re2.h>
 
+#include <array>
+#include <memory>
+#include <shared_mutex>
 #include <vector>
 
+#include "common/aho_corasick.h"
+#include "token_bytes_table.h"
 #include "tokenizer.h"
 #include "tokenizer_args.h"
 
@@ -20,9 +25,22 @@ class TiktokenTokenizer : public Tokenizer {
   bool encode(const std::string_view& text,
               std::vector<int32_t>* ids) const override;
 
+  std::vector<std::string_view> split_text(const std::string_view& text,
+                                           size_t chunk_size) const override;
+
+  std::vector<size_t> special_token_offsets(
+      const std::string_view& text) const override;
+
+  bool encode_chunk(const std::string_view& text,
+                    std::vector<int32_t>* ids) const override;
+
   std::string decode(const Slice<int32_t>& ids,
                      bool skip_special_tokens) const override;
 
+  const TokenBytesTable* token_bytes_table() const override {
+    return &decoder_;
+  }
+
   std::optional<int32_t> token_to_id(
       const std::string_view& token) const override;
 
@@ -40,6 +58,10 @@ class TiktokenTokenizer : public Tokenizer {
   void encode_internal(const std::string_view& text,
                        std::vector<int32_t>* ids) const;
 
+  // encode a piece produced by regex_, using the piece cache if possible
+  void encode_piece(const std::string_view& piece,
+                    std::vector<int32_t>* ids) const;
+
   void byte_pair_encode(const std::string_view& piece,
                         std::vector<int32_t>* ids) const;
 
@@ -49,8 +71,8 @@ class TiktokenTokenizer : public Tokenizer {
 
   // token to ids
   absl::flat_hash_map<std::string, int32_t> encoder_;
-  // id to token
-  absl::flat_hash_map<int32_t, std::string> decoder_;
+  // id to token bytes, including special tokens
+  TokenBytesTable decoder_;
 
   // a regex pattern to tokenize text
   // N.B. RE2 doesn't support look-around assertions.
@@ -60,11 +82,21 @@ class TiktokenTokenizer : public Tokenizer {
   // special tokens to ids
   absl::flat_hash_map<std::string, int32_t> special_token_encoder_;
 
-  // special token ids to tokens
-  absl::flat_hash_map<int32_t, std::string> special_token_decoder_;
-
-  // special token regex (optional)
-  std::unique_ptr<re2::RE2> special_token_regex_;
+  // special token matcher (optional)
+  std::unique_ptr<AhoCorasick> special_token_matcher_;
+
+  // special token ids indexed by the pattern index of the matcher
+  std::vector<int32_t> special_token_ids_;
+
+  // a bounded cache from piece to token ids, mostly repeated words. sharded
+  // by the hash of the piece, and lookups only share the lock of a shard, so
+  // that threads encoding in parallel rarely wait for each other.
+  struct PieceCacheShard {
+    std::shared_mutex mutex;
+    absl::flat_hash_map<std::string, std::vector<int32_t>> pieces;
+  };
+  static constexpr size_t kNumPieceCacheShards = 32;
+  mutable std::array<PieceCacheShard, kNumPieceCacheShards> piece_cache_;
 
   // token ids to add to the beginning of the input sequence
   std::vector<int32_t> prefix_token_ids_;
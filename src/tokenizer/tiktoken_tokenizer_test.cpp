@@ -2,6 +2,10 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "tokenizer/tokenizer_args.h"
 
 namespace llm {
@@ -105,6 +109,74 @@ TEST(TiktokenTokenizerTest, PatternTest) {
   }
 }
 
+TEST(TiktokenTokenizerTest, LongPieceTest) {
+  const std::string pattern =
+      R"((?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+[^\S]|\s+)";
+  TokenizerArgs args;
+  args.vocab_file() = "test.tiktoken";
+  args.pattern() = pattern;
+  TiktokenTokenizer tokenizer("data", args);
+
+  // long whitespace runs and repeated words
+  std::string test_text(10000, ' ');
+  for (int i = 0; i < 1000; ++i) {
+    test_text += " Hello world";
+  }
+  std::vector<int> ids;
+  ASSERT_TRUE(tokenizer.encode(test_text, &ids));
+  EXPECT_EQ(tokenizer.decode(ids, /*skip_special_tokens=*/false), test_text);
+
+  // encode again with cached pieces
+  std::vector<int> cached_ids;
+  ASSERT_TRUE(tokenizer.encode(test_text, &cached_ids));
+  EXPECT_EQ(cached_ids, ids);
+}
+
+TEST(TiktokenTokenizerTest, MultiThreadedEncodeTest) {
+  const std::string pattern =
+      R"((?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+[^\S]|\s+)";
+  TokenizerArgs args;
+  args.vocab_file() = "test.tiktoken";
+  args.pattern() = pattern;
+  TiktokenTokenizer tokenizer("data", args);
+
+  // distinct words per thread, sharing the piece cache
+  const int kNumThreads = 8;
+  std::vector<std::string> texts(kNumThreads);
+  for (int t = 0; t < kNumThreads; ++t) {
+    for (int i = 0; i < 500; ++i) {
+      texts[t] += " Hello" + std::to_string(t * 7 + i % 13) + " world";
+    }
+  }
+  std::vector<std::vector<int>> desired_ids(kNumThreads);
+  {
+    // encode with a fresh tokenizer to get uncached ids
+    TiktokenTokenizer fresh("data", args);
+    for (int t = 0; t < kNumThreads; ++t) {
+      ASSERT_TRUE(fresh.encode(texts[t], &desired_ids[t]));
+    }
+  }
+
+  std::vector<std::vector<int>> ids(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int round = 0; round < 2; ++round) {
+        ids[t].clear();
+        EXPECT_TRUE(tokenizer.encode(texts[t], &ids[t]));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < kNumThreads; ++t) {
+    EXPECT_EQ(ids[t], desired_ids[t]);
+    EXPECT_EQ(tokenizer.decode(ids[t], /*skip_special_tokens=*/false),
+              texts[t]);
+  }
+}
+
 TEST(TiktokenTokenizerTest, SpecialTokenTest) {
   std::vector<SpecialToken> special_tokens = {{"[gMASK]", 300},
                                               {"[sMASK]", 301},
@@ -167,4 +239,26 @@ TEST(TiktokenTokenizerTest, SpecialTokenTest) {
   }
 }
 
+TEST(TiktokenTokenizerTest, SpecialTokenOffsetsTest) {
+  TokenizerArgs args;
+  args.vocab_file() = "test.tiktoken";
+  args.special_tokens() = {{"<|user|>", 300}, {"<|assistant|>", 301}};
+  TiktokenTokenizer tokenizer("data", args);
+
+  const std::string text = "<|user|> Hello<|assistant|>Hi <|user|>";
+  const auto offsets = tokenizer.special_token_offsets(text);
+  const std::vector<size_t> desired_offsets = {8, 14, 27, 30};
+  EXPECT_EQ(offsets, desired_offsets);
+
+  // encoding split at each offset gives the same ids
+  std::vector<int> desired_ids;
+  ASSERT_TRUE(tokenizer.encode(text, &desired_ids));
+  for (const size_t offset : offsets) {
+    std::vector<int> ids;
+    ASSERT_TRUE(tokenizer.encode(text.substr(0, offset), &ids));
+    ASSERT_TRUE(tokenizer.encode_chunk(text.substr(offset), &ids));
+    EXPECT_EQ(ids, desired_ids) << "offset: " << offset;
+  }
+}
+
 }  // namespace llm
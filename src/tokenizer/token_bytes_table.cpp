@@ -0,0 +1,46 @@
+#include "token_bytes_table.h"
+
+#include <glog/logging.h>
+
+namespace llm {
+
+void TokenBytesTable::add(int32_t id,
+                          const std::string_view& bytes,
+                          bool special) {
+  CHECK_GE(id, 0) << "invalid token id: " << id;
+  if (static_cast<size_t>(id) >= entries_.size()) {
+    entries_.resize(id + 1);
+  }
+  auto& entry = entries_[id];
+  entry.offset = static_cast<uint32_t>(data_.size());
+  entry.length = static_cast<uint32_t>(bytes.size());
+  entry.valid = true;
+  entry.special = special;
+  data_.append(bytes);
+}
+
+std::string_view TokenBytesTable::segment_bytes(
+    int32_t id,
+    bool skip_special_tokens,
+    bool* strip_leading_space) const {
+  if (!contains(id)) {
+    return {};
+  }
+  std::string_view token_bytes = bytes(id);
+  if (is_special(id)) {
+    // text after a special token is decoded as a new segment
+    *strip_leading_space = true;
+    return skip_special_tokens ? std::string_view() : token_bytes;
+  }
+  if (token_bytes.empty()) {
+    return token_bytes;
+  }
+  if (*strip_leading_space && strip_leading_space_ &&
+      token_bytes.front() == ' ') {
+    token_bytes.remove_prefix(1);
+  }
+  *strip_leading_space = false;
+  return token_bytes;
+}
+
+}  // namespace llm
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace llm {
+
+// a contiguous id to bytes table used for byte-level streaming decoding.
+// the bytes of all tokens are stored in one buffer and indexed by id, so
+// decoding a token is a bounds check plus an append.
+class TokenBytesTable final {
+ public:
+  // set the bytes of the token id, grows the table if needed.
+  // special tokens are dropped when decoding with skip_special_tokens.
+  void add(int32_t id, const std::string_view& bytes, bool special = false);
+
+  // whether the table has bytes for the token id
+  bool contains(int32_t id) const {
+    return id >= 0 && static_cast<size_t>(id) < entries_.size() &&
+           entries_[id].valid;
+  }
+
+  // the bytes of the token id, the id must be in the table.
+  std::string_view bytes(int32_t id) const {
+    const auto& entry = entries_[id];
+    return {data_.data() + entry.offset, entry.length};
+  }
+
+  bool is_special(int32_t id) const { return entries_[id].special; }
+
+  // the bytes of the token id appended to a decoded text, empty for unknown
+  // ids and skipped special tokens. strip_leading_space carries over whether
+  // the next token starts a new text segment.
+  std::string_view segment_bytes(int32_t id,
+                                 bool skip_special_tokens,
+                                 bool* strip_leading_space) const;
+
+  // the number of ids in the table, including holes
+  size_t size() const { return entries_.size(); }
+
+  // whether to drop the leading space of the first token in a text segment,
+  // used by sentencepiece to remove the dummy prefix.
+  bool strip_leading_space() const { return strip_leading_space_; }
+  void set_strip_leading_space(bool strip) { strip_leading_space_ = strip; }
+
+ private:
+  struct Entry {
+    uint32_t offset = 0;
+    uint32_t length = 0;
+    bool valid = false;
+    bool special = false;
+  };
+
+  // all token bytes
+  std::string data_;
+
+  // token id to its bytes in data_
+  std::vector<Entry> entries_;
+
+  bool strip_leading_space_ = false;
+};
+
+}  // namespace llm
@@ -0,0 +1,76 @@
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <future>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/threadpool.h"
+
+namespace llm {
+namespace {
+
+// run func(start, end) over [0, n) in contiguous ranges, one per thread in
+// the threadpool plus the current thread.
+template <typename Func>
+void parallel_for(size_t n, ThreadPool* threadpool, Func&& func) {
+  const size_t num_ranges =
+      threadpool == nullptr ? 1 : std::min(n, threadpool->size() + 1);
+  if (num_ranges <= 1) {
+    func(0, n);
+    return;
+  }
+
+  const size_t range_size = (n + num_ranges - 1) / num_ranges;
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_ranges - 1);
+  for (size_t start = range_size; start < n; start += range_size) {
+    std::promise<void> promise;
+    futures.emplace_back(promise.get_future());
+    threadpool->schedule([&func,
+                          start,
+                          end = std::min(start + range_size, n),
+                          promise = std::move(promise)]() mutable {
+      func(start, end);
+      promise.set_value();
+    });
+  }
+  // run the first range in current thread
+  func(0, std::min(range_size, n));
+  for (auto& future : futures) {
+    future.wait();
+  }
+}
+
+}  // namespace
+
+bool Tokenizer::encode_batch(const std::vector<std::string_view>& texts,
+                             ThreadPool* threadpool,
+                             std::vector<std::vector<int32_t>>* ids) const {
+  ids->clear();
+  ids->resize(texts.size());
+  // use char instead of bool to avoid data races on std::vector<bool>
+  std::vector<char> oks(texts.size(), 0);
+  parallel_for(texts.size(), threadpool, [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      oks[i] = encode(texts[i], &(*ids)[i]);
+    }
+  });
+  return std::all_of(oks.begin(), oks.end(), [](char ok) { return ok; });
+}
+
+std::vector<std::string> Tokenizer::decode_batch(
+    const std::vector<Slice<int32_t>>& ids,
+    bool skip_special_tokens,
+    ThreadPool* threadpool) const {
+  std::vector<std::string> texts(ids.size());
+  parallel_for(ids.size(), threadpool, [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      texts[i] = decode(ids[i], skip_special_tokens);
+    }
+  });
+  return texts;
+}
+
+}  // namespace llm
@@ -6,10 +6,15 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "token_bytes_table.h"
+
 namespace llm {
 
+class ThreadPool;
+
 // Fundamentally, Large Language Models (LLM) are designed to generate text
 // based on given prompts. To process text effectively, LLM models typically
 // work with sequences of integers as inputs and produce sequences of integers
@@ -30,9 +35,51 @@ class Tokenizer {
   virtual bool encode(const std::string_view& text,
                       std::vector<int32_t>* ids) const = 0;
 
+  // split text into chunks at safe pre-tokenizer boundaries, so that encoding
+  // the first chunk with encode(), the rest with encode_chunk() and
+  // concatenating the ids gives the same result as encode(text). chunks may
+  // be encoded concurrently, each one has at least chunk_size bytes except
+  // the last one. returns the whole text if it can't be split safely.
+  virtual std::vector<std::string_view> split_text(
+      const std::string_view& text,
+      size_t /*chunk_size*/) const {
+    return {text};
+  }
+
+  // offsets in text where special tokens start or end, in ascending order and
+  // excluding 0 and text.size(). text can always be split at these offsets:
+  // encode(text[0, offset)) followed by encode_chunk(text[offset, end)) gives
+  // the same ids as encode(text).
+  virtual std::vector<size_t> special_token_offsets(
+      const std::string_view& /*text*/) const {
+    return {};
+  }
+
+  // encode a chunk following the first one, without prefix tokens.
+  virtual bool encode_chunk(const std::string_view& text,
+                            std::vector<int32_t>* ids) const {
+    return encode(text, ids);
+  }
+
   virtual std::string decode(const Slice<int32_t>& ids,
                              bool skip_special_tokens) const = 0;
 
+  // encode a batch of texts, split across the threadpool if provided.
+  // returns false if any text fails to encode.
+  virtual bool encode_batch(const std::vector<std::string_view>& texts,
+                            ThreadPool* threadpool,
+                            std::vector<std::vector<int32_t>>* ids) const;
+
+  // decode a batch of sequences, split across the threadpool if provided.
+  virtual std::vector<std::string> decode_batch(
+      const std::vector<Slice<int32_t>>& ids,
+      bool skip_special_tokens,
+      ThreadPool* threadpool) const;
+
+  // id to bytes table for streaming decoding, nullptr if the tokenizer can't
+  // decode tokens independently.
+  virtual const TokenBytesTable* token_bytes_table() const { return nullptr; }
+
   virtual std::optional<int32_t> token_to_id(
       const std::string_view& token) const = 0;
 